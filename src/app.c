@@ -3,6 +3,17 @@
 #include "sim.h"
 #include "misc.h"
 #include "perf.h"
+#include "hist.h"
+#include "gov.h"
+#include "hwc.h"
+#include "rec.h"
+#include "journal.h"
+#include "ens.h"
+#include "tracer.h"
+#include "ctl.h"
+#include "thread.h"
+#include <time.h>
+#include <math.h>
 
 #define DIFF_MIN  (0.0f)
 #define DIFF_MAX  (1e-3f)
@@ -12,12 +23,56 @@
 #define VISC_MAX  (1e-3f)
 #define VISC_STEP ((VISC_MAX - VISC_MIN) / 200.0f)
 
+#define REC_RING_SIZE          16
+#define REC_KEYFRAME_INTERVAL  60
+
+#define OBSTACLE_RADIUS  2.5f // [cells] brush of the right mouse button
+
+#define TRACER_EMIT_DIVISOR  500 // particles emitted per density event: capacity / divisor
+#define TRACER_EMIT_RADIUS   2.0f // [cells]
+#define TRACER_LIFETIME      600 // [steps]
+#define TRACER_INTENSITY     0.35f
+#define TRACER_PIXEL         ((pixel_t){ .r = 0xff, .g = 0xff, .b = 0xff })
+
+#define SWEEP_DEFAULT_SIZE   4
+#define SWEEP_DEFAULT_STEPS  500
+
+#define STATS_DEFAULT_INTERVAL  1000.0 // [ms]
+
+#define FPS_DEFAULT  60 // of a live window, replays and streams are not paced unless `--fps` is given
+
+#define REST_SPEED    0.25f // [cells per step] a slower flow with no density in it shows nothing, and resumes as it was
+#define REST_DENSITY  0.5f // below which every cell shades black
+
+#define GRID_DEFAULT_SIZE  80 // [cells] of the window, and of the sim unless `--grid` is given
+#define GRID_MIN_SIZE      16
+#define GRID_MAX_SIZE      1024
+#define GRID_RESIZE_STEP   16 // [cells] per `+`/`-` key press
+
+#define VELOCITY_MAX_COARSENING  4 // `F6` cycles 1, 2, 4
+
+#define GOV_MIN_SOLVE_ITER  4
+#define GOV_MAX_SOLVE_ITER  20
+#define GOV_MIN_RENDER_SCALE  0.25f
+
+typedef enum {
+    APP_TIMING_FRAME,
+    APP_TIMING_INPUT, // overlay, fade and input injection
+    APP_TIMING_STEP, // sim and tracers
+    APP_TIMING_RENDER,
+    APP_TIMING_PRESENT, // window update and event polling
+    APP_TIMING_COUNT,
+} app_timing_e;
+
+static const char* const s_timing_names[APP_TIMING_COUNT] = { "frame", "input", "step", "render", "present" };
+
 struct _app_obj_t {
     float d_add_step;
     float d_fade_step;
     float f_add_scale;
     float diff_factor, visc_factor;
     bool_t fl_grayscale;
+    sim_filter_e render_filter; // nearest draws grid cells, the others filter the density at the window resolution
     bool_t fl_render_overlay;
 
     struct {
@@ -27,17 +82,225 @@ struct _app_obj_t {
         bool_t fl_cursor_first_moving;
         int32_t last_cursor_xpos, last_cursor_ypos;
         int32_t last_cursor_xdelta, last_cursor_ydelta;
+        int32_t last_paint_xpos, last_paint_ypos; // -1 if nothing painted since the right button went down
+        bool_t fl_woken; // an event arrived since the last frame, the next one runs even at rest
     } vis_state;
 
-    char overlay_buff[256];
+    char overlay_buff[2048];
     double curr_frame_time, curr_acc_frame_time;
     size_t curr_fps, frame_counter;
 
+    int64_t step_idx;
+    int64_t max_steps; // 0 if unlimited
+    int32_t target_fps; // paces the frames, 0 if unpaced
+    perf_obj_t pace_perf; // since the start of the frame period
+    double total_frame_time, min_frame_time, max_frame_time;
+    bool_t fl_headless;
+    journal_obj_t jrn_writer; // records the input applied before each step
+    journal_obj_t jrn_reader; // replays a recorded journal instead of live input
+
+    const char* sweep_path; // CSV output of the headless parameter sweep
+    int32_t sweep_size; // sweep grid is `sweep_size` diffusion x `sweep_size` viscosity values
+    int32_t thread_count; // 0 if one per cpu
+    int32_t tracer_capacity; // 0 without tracers
+
     perf_obj_t perf;
+    perf_obj_t stage_perf;
+    hist_obj_t timing_hists[APP_TIMING_COUNT]; // reset every stats interval
+    hist_obj_t run_hist; // frame times of the whole run
+    hist_summary_t timing_stats[APP_TIMING_COUNT]; // of the last stats interval
+    double stage_ms[APP_TIMING_COUNT]; // of the last frame
+    double stats_interval, stats_acc_time; // [ms]
+    FILE* stats_fp; // NULL if not dumped
+    bool_t fl_stats_json; // JSON Lines instead of CSV
+    char stats_fp_buff[4096]; // NOTE: Stream buffer owned by the app, so the dump never allocates in the frame loop.
+
+    bool_t fl_counters; // count hardware events per stage, `hwc` is created by `app_run()`
+    hwc_obj_t hwc; // NULL without counters
+    hwc_totals_t counter_totals[APP_TIMING_COUNT]; // of the whole run, the frame is the sum of the stages
+
+    ctl_obj_t ctl; // NULL without a control socket
+
+    gov_obj_t gov; // NULL without a frame budget
+    float render_scale; // of filtered renders, set by the governor
+    bool_t fl_scaled_render; // the last frame was a filtered render, whose cost follows `render_scale`
+
+    rec_obj_t rec;
     sim_obj_t sim;
+    tracer_obj_t tracer;
+    pixel_t* frame; // rendered frame when the tracers or a filter are used, row-major
+    size_t frame_cap;
     vis_obj_t vis;
 };
 
+static bool_t _app_reserve_frame(app_obj_t self, size_t size)
+{
+    if (self->frame_cap >= size) {
+        return TRUE;
+    }
+    pixel_t* const new_frame = (pixel_t*)realloc(self->frame, size * sizeof(pixel_t));
+    if (!new_frame) {
+        return FALSE;
+    }
+    self->frame = new_frame;
+    self->frame_cap = size;
+    return TRUE;
+}
+
+static void _app_resize(app_obj_t self, int32_t box_size)
+{
+    assert(self);
+
+    // NOTE: The window keeps its grid, a sim of another size is drawn by the scaled render. The bounds
+    //       are checked here, resize events of a replayed journal do not come from the key handler.
+    if (box_size < GRID_MIN_SIZE || box_size > GRID_MAX_SIZE ||
+        (self->tracer && !_app_reserve_frame(self, (size_t)box_size * box_size)) ||
+        !sim_resize(self->sim, box_size))
+    {
+        fprintf(stderr, "failed to resize the grid to %d!\n", box_size);
+        return;
+    }
+
+    if (self->tracer) {
+        tracer_resize(self->tracer, box_size);
+    }
+    if (self->rec) {
+        rec_destroy(&self->rec); // NOTE: Recordings have a fixed frame size.
+        fprintf(stderr, "recording stopped, the grid was resized to %d\n", box_size);
+    }
+}
+
+static void _app_inject(app_obj_t self, journal_event_t* ev)
+{
+    assert(self);
+    assert(ev);
+
+    switch (ev->type) {
+    case JOURNAL_EVENT_ADD_DENSITY:
+        sim_add_density(self->sim, ev->x, ev->y, ev->v0);
+        if (self->tracer) {
+            tracer_emit(self->tracer, (float)ev->x, (float)ev->y, TRACER_EMIT_RADIUS, max(self->tracer_capacity / TRACER_EMIT_DIVISOR, 1));
+        }
+        break;
+    case JOURNAL_EVENT_ADD_FORCE:
+        sim_add_force(self->sim, ev->x, ev->y, ev->v0, ev->v1);
+        break;
+    case JOURNAL_EVENT_SET_DIFFUSION:
+        self->diff_factor = ev->v0;
+        sim_set_diffusion(self->sim, self->diff_factor);
+        break;
+    case JOURNAL_EVENT_SET_VISCOSITY:
+        self->visc_factor = ev->v0;
+        sim_set_viscosity(self->sim, self->visc_factor);
+        break;
+    case JOURNAL_EVENT_SET_SOLVER:
+        if (0 <= ev->x && ev->x < SIM_SOLVER_COUNT) {
+            sim_set_solver(self->sim, (sim_solver_e)ev->x);
+        }
+        break;
+    case JOURNAL_EVENT_SET_SOLVE_ITER:
+        if (ev->x >= 1) {
+            sim_set_solve_iter_size(self->sim, ev->x);
+        }
+        break;
+    case JOURNAL_EVENT_PAINT_OBSTACLE:
+        if (!sim_paint_obstacle(self->sim, ev->x, ev->y, ev->v0, ev->v1 != 0.0f)) {
+            fprintf(stderr, "failed to update the obstacles!\n");
+        }
+        break;
+    case JOURNAL_EVENT_CLEAR_OBSTACLES:
+        sim_set_obstacles(self->sim, NULL);
+        break;
+    case JOURNAL_EVENT_RESIZE:
+        _app_resize(self, ev->x);
+        break;
+    case JOURNAL_EVENT_SET_VELOCITY_COARSENING:
+        if (!sim_set_velocity_coarsening(self->sim, ev->x)) {
+            fprintf(stderr, "failed to solve the velocity %dx coarser!\n", ev->x);
+        }
+        break;
+    }
+
+    if (self->jrn_writer) {
+        ev->step = self->step_idx;
+        journal_write(self->jrn_writer, ev);
+    }
+}
+
+static void _app_ctl_cmd_cb(void* ctx, const ctl_cmd_t* cmd)
+{
+    const app_obj_t self = (app_obj_t)ctx;
+
+    // NOTE: Clients are untrusted, values are checked like the keyboard would limit them.
+    if (!isfinite(cmd->v0) || !isfinite(cmd->v1)) {
+        return;
+    }
+    switch (cmd->type) {
+    case CTL_CMD_ADD_DENSITY:
+        _app_inject(self, &(journal_event_t) {
+            .type = JOURNAL_EVENT_ADD_DENSITY,
+            .x = cmd->x,
+            .y = cmd->y,
+            .v0 = cmd->v0,
+        });
+        break;
+    case CTL_CMD_ADD_FORCE:
+        _app_inject(self, &(journal_event_t) {
+            .type = JOURNAL_EVENT_ADD_FORCE,
+            .x = cmd->x,
+            .y = cmd->y,
+            .v0 = cmd->v0,
+            .v1 = cmd->v1,
+        });
+        break;
+    case CTL_CMD_SET_DIFFUSION:
+        _app_inject(self, &(journal_event_t) {
+            .type = JOURNAL_EVENT_SET_DIFFUSION,
+            .v0 = clamp(cmd->v0, DIFF_MIN, DIFF_MAX),
+        });
+        break;
+    case CTL_CMD_SET_VISCOSITY:
+        _app_inject(self, &(journal_event_t) {
+            .type = JOURNAL_EVENT_SET_VISCOSITY,
+            .v0 = clamp(cmd->v0, VISC_MIN, VISC_MAX),
+        });
+        break;
+    case CTL_CMD_PAINT_OBSTACLE:
+        _app_inject(self, &(journal_event_t) {
+            .type = JOURNAL_EVENT_PAINT_OBSTACLE,
+            .x = cmd->x,
+            .y = cmd->y,
+            .v0 = clamp(cmd->v0, 0.0f, (float)GRID_MAX_SIZE),
+            .v1 = cmd->v1,
+        });
+        break;
+    case CTL_CMD_CLEAR_OBSTACLES:
+        _app_inject(self, &(journal_event_t) {
+            .type = JOURNAL_EVENT_CLEAR_OBSTACLES,
+        });
+        break;
+    }
+}
+
+static void _app_publish_stats(app_obj_t self, double frame_ms)
+{
+    assert(self);
+    assert(self->ctl);
+
+    const ctl_stats_t stats = {
+        .step = self->step_idx,
+        .rows = sim_get_rows(self->sim),
+        .cols = sim_get_cols(self->sim),
+        .diff = self->diff_factor,
+        .visc = self->visc_factor,
+        .frame_ms = frame_ms,
+        .step_ms = self->stage_ms[APP_TIMING_STEP],
+        .frame_p50_ms = self->timing_stats[APP_TIMING_FRAME].p50_ms,
+        .frame_p99_ms = self->timing_stats[APP_TIMING_FRAME].p99_ms,
+    };
+    ctl_publish_stats(self->ctl, &stats);
+}
+
 static void _app_vis_key_cb(vis_obj_t vis, 
     vis_key_e key, 
     int scancode, 
@@ -49,6 +312,7 @@ static void _app_vis_key_cb(vis_obj_t vis,
 
     app_obj_t self = (app_obj_t)vis_get_user_context(vis);
     assert(self);
+    self->vis_state.fl_woken = TRUE;
 
     if (action == VIS_ACTION_RELEASE)
     {
@@ -56,9 +320,54 @@ static void _app_vis_key_cb(vis_obj_t vis,
         case VIS_KEY_F1:
             self->fl_grayscale = !self->fl_grayscale;
             break;
+        case VIS_KEY_F2:
+            if (!self->jrn_reader) {
+                _app_inject(self, &(journal_event_t) {
+                    .type = JOURNAL_EVENT_SET_SOLVER,
+                    .x = (sim_get_solver(self->sim) + 1) % SIM_SOLVER_COUNT,
+                });
+            }
+            break;
+        case VIS_KEY_F3:
+            if (!self->jrn_reader) {
+                _app_inject(self, &(journal_event_t) {
+                    .type = JOURNAL_EVENT_CLEAR_OBSTACLES,
+                });
+            }
+            break;
+        case VIS_KEY_F4:
+            self->render_filter = (self->render_filter + 1) % SIM_FILTER_COUNT;
+            break;
+        case VIS_KEY_F6:
+            if (!self->jrn_reader) {
+                const int32_t factor = sim_get_velocity_coarsening(self->sim) * 2;
+                _app_inject(self, &(journal_event_t) {
+                    .type = JOURNAL_EVENT_SET_VELOCITY_COARSENING,
+                    .x = (factor > VELOCITY_MAX_COARSENING) ? 1 : factor,
+                });
+            }
+            break;
+        case VIS_KEY_F5:
+            if (self->rec) {
+                rec_destroy(&self->rec);
+            } else {
+                char path_buff[64];
+                snprintf(path_buff, sizeof(path_buff), "fluid_%lld.frc", (long long)time(NULL));
+                self->rec = rec_create(path_buff,
+                    sim_get_rows(self->sim),
+                    sim_get_cols(self->sim),
+                    REC_RING_SIZE,
+                    REC_KEYFRAME_INTERVAL
+                );
+                if (!self->rec) {
+                    fprintf(stderr, "failed to start recording to '%s'!\n", path_buff);
+                }
+            }
+            break;
         case VIS_KEY_F12:
             self->fl_render_overlay = !self->fl_render_overlay;
             vis_set_overlay_visibility(self->vis, self->fl_render_overlay);
+            sim_set_stats_enabled(self->sim, self->fl_render_overlay);
             break;
         }
     }
@@ -67,13 +376,35 @@ static void _app_vis_key_cb(vis_obj_t vis,
         switch (key) {
         case VIS_KEY_LEFT:
         case VIS_KEY_RIGHT:
-            self->diff_factor = clamp(self->diff_factor + DIFF_STEP * ((key == VIS_KEY_LEFT) ? -1 : 1), DIFF_MIN, DIFF_MAX);
-            sim_set_diffusion(self->sim, self->diff_factor);
+            if (!self->jrn_reader) {
+                _app_inject(self, &(journal_event_t) {
+                    .type = JOURNAL_EVENT_SET_DIFFUSION,
+                    .v0 = clamp(self->diff_factor + DIFF_STEP * ((key == VIS_KEY_LEFT) ? -1 : 1), DIFF_MIN, DIFF_MAX),
+                });
+            }
             break;
         case VIS_KEY_UP:
         case VIS_KEY_DOWN:
-            self->visc_factor = clamp(self->visc_factor + VISC_STEP * ((key == VIS_KEY_UP) ? 1 : -1), VISC_MIN, VISC_MAX);
-            sim_set_viscosity(self->sim, self->visc_factor);
+            if (!self->jrn_reader) {
+                _app_inject(self, &(journal_event_t) {
+                    .type = JOURNAL_EVENT_SET_VISCOSITY,
+                    .v0 = clamp(self->visc_factor + VISC_STEP * ((key == VIS_KEY_UP) ? 1 : -1), VISC_MIN, VISC_MAX),
+                });
+            }
+            break;
+        case VIS_KEY_ADD:
+        case VIS_KEY_SUBTRACT:
+            if (!self->jrn_reader) {
+                const int32_t
+                    curr_size = sim_get_cols(self->sim),
+                    new_size = clamp(curr_size + GRID_RESIZE_STEP * ((key == VIS_KEY_ADD) ? 1 : -1), GRID_MIN_SIZE, GRID_MAX_SIZE);
+                if (new_size != curr_size) {
+                    _app_inject(self, &(journal_event_t) {
+                        .type = JOURNAL_EVENT_RESIZE,
+                        .x = new_size,
+                    });
+                }
+            }
             break;
         }
     }
@@ -88,6 +419,7 @@ static void _app_vis_mousebtn_cb(vis_obj_t vis,
 
     app_obj_t self = (app_obj_t)vis_get_user_context(vis);
     assert(self);
+    self->vis_state.fl_woken = TRUE;
 
     const int pressed = (action == VIS_ACTION_PRESS);
     switch (button) {
@@ -96,6 +428,7 @@ static void _app_vis_mousebtn_cb(vis_obj_t vis,
         break;
     case VIS_MOUSEBTN_R:
         self->vis_state.fl_rmouse_pressed = pressed;
+        self->vis_state.last_paint_xpos = self->vis_state.last_paint_ypos = -1; // reset
         break;
     }
 }
@@ -104,6 +437,7 @@ static void _app_vis_cursorenter_cb(vis_obj_t vis, bool_t entered)
 {
     app_obj_t self = (app_obj_t)vis_get_user_context(vis);
     assert(self);
+    self->vis_state.fl_woken = TRUE;
 
     self->vis_state.fl_cursor_first_moving = entered && (self->vis_state.fl_cursor_entered ^ entered);
     self->vis_state.fl_cursor_entered = entered;
@@ -116,6 +450,7 @@ static void _app_vis_cursorpos_cb(vis_obj_t vis, int32_t xpos, int32_t ypos)
 {
     app_obj_t self = (app_obj_t)vis_get_user_context(vis);
     assert(self);
+    self->vis_state.fl_woken = TRUE;
 
     if (self->vis_state.fl_cursor_first_moving) {
         self->vis_state.last_cursor_xdelta = self->vis_state.last_cursor_ydelta = 0; // reset
@@ -130,18 +465,275 @@ static void _app_vis_cursorpos_cb(vis_obj_t vis, int32_t xpos, int32_t ypos)
     self->vis_state.fl_cursor_first_moving = FALSE; // reset
 }
 
+static inline float _app_get_cell_scale(app_obj_t self)
+{
+    // NOTE: Sim cells per window cell, the interiors of both grids are aligned like in `sim_resize()`.
+    return self->vis ? (float)(sim_get_cols(self->sim) - 2) / (float)(vis_get_cols(self->vis) - 2) : 1.0f;
+}
+
+static inline int32_t _app_to_sim_cell(app_obj_t self, int32_t v, float scale)
+{
+    return clamp((int32_t)floorf(((float)v - 0.5f) * scale + 1.0f), 0, sim_get_cols(self->sim) - 1);
+}
+
+static void _app_null_pixel_transfer(void* ctx, int32_t row, int32_t col, pixel_t clr)
+{
+    UNUSED_PARAM(ctx);
+    UNUSED_PARAM(row);
+    UNUSED_PARAM(col);
+    UNUSED_PARAM(clr);
+}
+
+static void _app_frame_pixel_transfer(void* ctx, int32_t row, int32_t col, pixel_t clr)
+{
+    const app_obj_t self = (app_obj_t)ctx;
+    self->frame[col * sim_get_cols(self->sim) + row] = clr; // NOTE: Same argument order as `vis_draw()`.
+}
+
+static void _app_upscale(pixel_t* dst/* out */, int32_t width, int32_t height, const pixel_t* src, int32_t src_width, int32_t src_height)
+{
+    // NOTE: Nearest neighbour, the source is already filtered. Pixel centers in 16.16 fixed point.
+    const uint32_t
+        x_step = (uint32_t)(((uint64_t)src_width << 16) / (uint64_t)width),
+        y_step = (uint32_t)(((uint64_t)src_height << 16) / (uint64_t)height);
+    uint32_t sy = y_step / 2;
+    for (int32_t y = 0; y < height; ++y, sy += y_step) {
+        const pixel_t* const src_row = src + (size_t)(sy >> 16) * src_width;
+        pixel_t* const dst_row = dst + (size_t)y * width;
+        uint32_t sx = x_step / 2;
+        for (int32_t x = 0; x < width; ++x, sx += x_step) {
+            dst_row[x] = src_row[sx >> 16];
+        }
+    }
+}
+
+static void _app_render(app_obj_t self)
+{
+    assert(self);
+
+    self->fl_scaled_render = FALSE;
+    const bool_t fl_grid_match = !self->vis || vis_get_cols(self->vis) == sim_get_cols(self->sim);
+    if (self->vis && (self->render_filter != SIM_FILTER_NEAREST || !fl_grid_match)) {
+        // NOTE: Filtered at the window resolution, so the image is smooth whatever the grid size. Below
+        //       a render scale of 1 it is filtered at the lower resolution behind the frame and upscaled.
+        //       A resized grid no longer matches the cells of the window, so it is drawn this way too.
+        const int32_t
+            width = vis_get_width(self->vis),
+            height = vis_get_height(self->vis),
+            render_width = clamp((int32_t)((float)width * self->render_scale), 1, width),
+            render_height = clamp((int32_t)((float)height * self->render_scale), 1, height);
+        const size_t
+            size = (size_t)width * height,
+            render_size = (render_width < width || render_height < height) ? (size_t)render_width * render_height : 0;
+        if (_app_reserve_frame(self, size + render_size) &&
+            sim_render_density_scaled(self->sim, self->frame + (render_size ? size : 0), render_width, render_height, self->render_filter, self->fl_grayscale))
+        {
+            self->fl_scaled_render = TRUE;
+            if (render_size) {
+                _app_upscale(self->frame, width, height, self->frame + size, render_width, render_height);
+            }
+            if (self->tracer) {
+                tracer_render(self->tracer, sim_get_pool(self->sim), self->frame, width, height, TRACER_PIXEL, TRACER_INTENSITY);
+            }
+            vis_present(self->vis, self->frame, width, height);
+            return;
+        }
+        // NOTE: Out of memory, falls back to the grid.
+        if (!fl_grid_match) {
+            return;
+        }
+    }
+
+    if (!self->tracer) {
+        if (self->vis) {
+            vis_begin_draw(self->vis); // NOTE: Here, `vis_draw()` runs on the render workers.
+            sim_render_density(self->sim, vis_draw, self->vis, self->fl_grayscale);
+        } else {
+            sim_render_density(self->sim, _app_null_pixel_transfer, NULL, self->fl_grayscale); // NOTE: Keeps the headless workload identical to the windowed one.
+        }
+        return;
+    }
+
+    const int32_t N = sim_get_cols(self->sim);
+    sim_render_density(self->sim, _app_frame_pixel_transfer, self, self->fl_grayscale);
+    tracer_render(self->tracer, sim_get_pool(self->sim), self->frame, N, N, TRACER_PIXEL, TRACER_INTENSITY);
+    if (self->vis) {
+        vis_begin_draw(self->vis);
+        for (int32_t row = 0; row < N; ++row) {
+            for (int32_t col = 0; col < N; ++col) {
+                vis_draw(self->vis, col, row, self->frame[row * N + col]);
+            }
+        }
+    }
+}
+
+static inline bool_t _app_should_close(app_obj_t self)
+{
+    assert(self);
+
+    if (self->vis && vis_should_close(self->vis)) {
+        return TRUE;
+    }
+
+    if (self->max_steps > 0 && self->step_idx >= self->max_steps) {
+        return TRUE;
+    }
+
+    if (self->fl_headless && self->jrn_reader && self->step_idx >= journal_get_step_count(self->jrn_reader)) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static inline void _app_end_stage(app_obj_t self, app_timing_e stage)
+{
+    perf_end(self->stage_perf);
+    self->stage_ms[stage] = perf_get_delta_ms(self->stage_perf);
+    hist_record(self->timing_hists[stage], self->stage_ms[stage]);
+    if (self->hwc) {
+        hwc_end(self->hwc, &self->counter_totals[stage]); // NOTE: Also begins the next stage.
+    }
+    perf_begin(self->stage_perf);
+}
+
+static void _app_govern(app_obj_t self, double frame_ms)
+{
+    assert(self);
+    assert(self->gov);
+
+    // NOTE: A replay applies the recorded sweeps, and the spectral solver does not sweep (but around
+    //       obstacles), so in both cases only the render scale is governed.
+    const bool_t fl_iter_fixed = self->jrn_reader ||
+        (sim_get_solver(self->sim) == SIM_SOLVER_SPECTRAL && !sim_has_obstacles(self->sim));
+    gov_set_solve_iter_size(self->gov, sim_get_solve_iter_size(self->sim), fl_iter_fixed);
+
+    // NOTE: Only a filtered render gets cheaper with the render scale.
+    const double render_ms = self->fl_scaled_render ? self->stage_ms[APP_TIMING_RENDER] : 0.0;
+    if (!gov_update(self->gov, frame_ms, self->stage_ms[APP_TIMING_STEP], render_ms)) {
+        return;
+    }
+
+    const gov_state_t* const st = gov_get_state(self->gov);
+    self->render_scale = st->render_scale;
+    if (!fl_iter_fixed && st->solve_iter_size != sim_get_solve_iter_size(self->sim)) {
+        // NOTE: Injected as an event, so a recorded journal replays with the same sweeps.
+        _app_inject(self, &(journal_event_t) {
+            .type = JOURNAL_EVENT_SET_SOLVE_ITER,
+            .x = st->solve_iter_size,
+        });
+    }
+}
+
+static void _app_flush_stats(app_obj_t self)
+{
+    assert(self);
+
+    // NOTE: Reset on read, so every interval reports only its own frames.
+    for (int32_t i = 0; i < APP_TIMING_COUNT; ++i) {
+        hist_read(self->timing_hists[i], &self->timing_stats[i], TRUE);
+    }
+
+    if (!self->stats_fp) {
+        return;
+    }
+
+    for (int32_t i = 0; i < APP_TIMING_COUNT; ++i) {
+        const hist_summary_t* const st = &self->timing_stats[i];
+        fprintf(self->stats_fp,
+            self->fl_stats_json
+                ? "{\"step\":%lld,\"stage\":\"%s\",\"count\":%lld,\"mean_ms\":%.3f,\"min_ms\":%.3f,\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,\"max_ms\":%.3f}\n"
+                : "%lld,%s,%lld,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n"
+            , (long long)self->step_idx
+            , s_timing_names[i]
+            , (long long)st->count
+            , st->mean_ms
+            , st->min_ms
+            , st->p50_ms
+            , st->p90_ms
+            , st->p99_ms
+            , st->p999_ms
+            , st->max_ms
+        );
+    }
+    fflush(self->stats_fp);
+}
+
+static bool_t _app_wait_at_rest(app_obj_t self)
+{
+    assert(self);
+
+    // NOTE: A replay steps through its journal regardless. Waits do not count as steps, so
+    //       `--steps` and a recorded journal only see the frames that ran.
+    if (self->jrn_reader || self->vis_state.fl_woken ||
+        (self->vis_state.fl_cursor_entered && (
+            self->vis_state.fl_lmouse_pressed || self->vis_state.fl_rmouse_pressed ||
+            self->vis_state.last_cursor_xdelta || self->vis_state.last_cursor_ydelta)) ||
+        (self->tracer && tracer_get_count(self->tracer)) ||
+        (self->ctl && ctl_wait(self->ctl, 0)))
+    {
+        return FALSE;
+    }
+
+    sim_peaks_t peaks;
+    sim_get_peaks(self->sim, &peaks);
+    if (peaks.speed > REST_SPEED || peaks.density > REST_DENSITY) {
+        return FALSE;
+    }
+
+    // NOTE: The control socket is Linux only, where the window is a stream without input,
+    //       so one of the two at most can wake us up.
+    if (self->vis && vis_wait(self->vis, VIS_WAIT_FOREVER)) {
+        return TRUE;
+    }
+    if (self->ctl) {
+        ctl_wait(self->ctl, UINT32_MAX);
+        return TRUE;
+    }
+    return FALSE; // NOTE: Nothing to wake us up (a stream or a headless run), keep stepping.
+}
+
+static void _app_pace(app_obj_t self)
+{
+    assert(self);
+    assert(self->target_fps > 0);
+
+    // NOTE: Waits out the rest of the frame period, still taking input. A late frame starts the
+    //       next period at once rather than catching up.
+    const double period_ms = 1000.0 / (double)self->target_fps;
+    for (;;) {
+        perf_end(self->pace_perf);
+        const double remaining_ms = period_ms - perf_get_delta_ms(self->pace_perf);
+        if (remaining_ms < 1.0) {
+            break;
+        }
+        if (!self->vis || !vis_wait(self->vis, (uint32_t)remaining_ms)) {
+            thread_sleep_ms((uint32_t)remaining_ms);
+        }
+    }
+    perf_begin(self->pace_perf);
+}
+
 static inline void _app_poll(app_obj_t self)
 {
     assert(self);
 
-    if (self->fl_render_overlay) {
-        const int32_t cch = snprintf(
+    self->vis_state.fl_woken = FALSE; // NOTE: Events of this frame's poll wake the next one.
+    perf_begin(self->stage_perf);
+    if (self->hwc) {
+        hwc_begin(self->hwc);
+    }
+
+    if (self->vis && self->fl_render_overlay) {
+        int32_t cch = snprintf(
             self->overlay_buff, 
             sizeof(self->overlay_buff),
             "Frame time: %05.2fms (%zufps)\n"
             "Diffusion: %f (%.1f%%)\n"
             "Viscosity: %f (%.1f%%)\n"
-            "Render mode: %s"
+            "Render mode: %s, %s\n"
+            "Solver: %s%s, velocity grid %dx%d\n"
+            "Kernels: %s"
             , self->curr_frame_time
             , self->curr_fps
             , self->diff_factor
@@ -149,79 +741,545 @@ static inline void _app_poll(app_obj_t self)
             , self->visc_factor
             , 100.0f * ((self->visc_factor - VISC_MIN) / (VISC_MAX - VISC_MIN))
             , self->fl_grayscale ? "gray" : "color"
+            , sim_filter_get_name(self->render_filter)
+            , sim_solver_get_name(sim_get_solver(self->sim))
+            , (sim_get_solver(self->sim) == SIM_SOLVER_SPECTRAL && sim_has_obstacles(self->sim)) ? " (gauss-seidel around obstacles)" : ""
+            , sim_get_velocity_cols(self->sim)
+            , sim_get_velocity_cols(self->sim)
+            , sim_isa_get_name(sim_get_isa(self->sim))
         );
 
+        sim_stats_t field;
+        sim_get_stats(self->sim, &field);
+        cch += snprintf(
+            self->overlay_buff + cch,
+            sizeof(self->overlay_buff) - cch,
+            "\nField: mass %.1f, energy %.3g, speed %.3f cells/step\n"
+            "Projection: divergence %.2e, residual %.2e per step"
+            , field.mass
+            , field.energy
+            , field.speed
+            , field.divergence
+            , field.residual
+        );
+
+        cch += snprintf(
+            self->overlay_buff + cch,
+            sizeof(self->overlay_buff) - cch,
+            "\nLatency (p50 / p90 / p99 / max):"
+        );
+        for (int32_t i = 0; i < APP_TIMING_COUNT; ++i) {
+            const hist_summary_t* const st = &self->timing_stats[i];
+            cch += snprintf(
+                self->overlay_buff + cch,
+                sizeof(self->overlay_buff) - cch,
+                "\n  %s: %.2f / %.2f / %.2f / %.2fms"
+                , s_timing_names[i]
+                , st->p50_ms
+                , st->p90_ms
+                , st->p99_ms
+                , st->max_ms
+            );
+        }
+
+        if (self->gov) {
+            const gov_state_t* const st = gov_get_state(self->gov);
+            cch += snprintf(
+                self->overlay_buff + cch,
+                sizeof(self->overlay_buff) - cch,
+                "\nGovernor: %.1fms budget, %d sweeps, render %.0f%% (%lld cuts, %lld raises)"
+                , gov_get_config(self->gov)->target_ms
+                , st->solve_iter_size
+                , 100.0f * st->render_scale
+                , (long long)st->degrade_count
+                , (long long)st->upgrade_count
+            );
+        }
+
+        if (self->hwc && hwc_get_counter_mask(self->hwc)) {
+            const hwc_totals_t* const st = &self->counter_totals[APP_TIMING_STEP];
+            cch += snprintf(
+                self->overlay_buff + cch,
+                sizeof(self->overlay_buff) - cch,
+                "\nStep counters: %.2f ipc, %.1f l1d / %.1f llc / %.1f dtlb misses per 1k instructions"
+                , hwc_totals_get_ipc(st)
+                , hwc_totals_get_mpki(st, HWC_L1D_MISSES)
+                , hwc_totals_get_mpki(st, HWC_LLC_MISSES)
+                , hwc_totals_get_mpki(st, HWC_DTLB_MISSES)
+            );
+        }
+
+        if (self->tracer) {
+            cch += snprintf(
+                self->overlay_buff + cch,
+                sizeof(self->overlay_buff) - cch,
+                "\nTracers: %d / %d"
+                , tracer_get_count(self->tracer)
+                , tracer_get_capacity(self->tracer)
+            );
+        }
+
+        if (self->rec) {
+            cch += snprintf(
+                self->overlay_buff + cch,
+                sizeof(self->overlay_buff) - cch,
+                "\nRecording: %lld frames, %.1fMB (%lld dropped)"
+                , (long long)rec_get_frame_count(self->rec)
+                , (double)rec_get_bytes_written(self->rec) / (1024.0 * 1024.0)
+                , (long long)rec_get_dropped_count(self->rec)
+            );
+        }
+
+        if (self->ctl) {
+            cch += snprintf(
+                self->overlay_buff + cch,
+                sizeof(self->overlay_buff) - cch,
+                "\nControl: %d clients"
+                , ctl_get_client_count(self->ctl)
+            );
+        }
+
         vis_set_overlay_text(self->vis, self->overlay_buff, cch);
     }
 
     sim_fade_density(self->sim, self->d_fade_step);
 
-    if (self->vis_state.fl_cursor_entered) {
+    if (self->jrn_reader) {
+        journal_event_t ev;
+        while (journal_next(self->jrn_reader, self->step_idx, &ev)) {
+            _app_inject(self, &ev);
+        }
+    } else if (self->vis_state.fl_cursor_entered) {
+        const float cell_scale = _app_get_cell_scale(self);
         const int32_t
-            xpos = self->vis_state.last_cursor_xpos,
-            ypos = self->vis_state.last_cursor_ypos,
+            xpos = _app_to_sim_cell(self, self->vis_state.last_cursor_xpos, cell_scale),
+            ypos = _app_to_sim_cell(self, self->vis_state.last_cursor_ypos, cell_scale),
             xdelta = self->vis_state.last_cursor_xdelta,
             ydelta = self->vis_state.last_cursor_ydelta;
 
         if (self->vis_state.fl_lmouse_pressed) {
-            sim_add_density(self->sim,
-                xpos,
-                ypos,
-                self->d_add_step
-            );
+            _app_inject(self, &(journal_event_t) {
+                .type = JOURNAL_EVENT_ADD_DENSITY,
+                .x = xpos,
+                .y = ypos,
+                .v0 = self->d_add_step,
+            });
+        }
+
+        if (self->vis_state.fl_rmouse_pressed &&
+            (xpos != self->vis_state.last_paint_xpos || ypos != self->vis_state.last_paint_ypos))
+        {
+            _app_inject(self, &(journal_event_t) {
+                .type = JOURNAL_EVENT_PAINT_OBSTACLE,
+                .x = xpos,
+                .y = ypos,
+                .v0 = OBSTACLE_RADIUS * cell_scale,
+                .v1 = 1.0f,
+            });
+            self->vis_state.last_paint_xpos = xpos;
+            self->vis_state.last_paint_ypos = ypos;
         }
 
         if (xdelta || ydelta) {
             const float scale = self->f_add_scale;
-            sim_add_force(self->sim,
-                xpos,
-                ypos,
-                (float)xdelta * scale,
-                (float)ydelta * scale
-            );
+            _app_inject(self, &(journal_event_t) {
+                .type = JOURNAL_EVENT_ADD_FORCE,
+                .x = xpos,
+                .y = ypos,
+                .v0 = (float)xdelta * scale,
+                .v1 = (float)ydelta * scale,
+            });
             self->vis_state.last_cursor_xdelta = self->vis_state.last_cursor_ydelta = 0; // reset
         }
     }
 
+    if (self->ctl && !self->jrn_reader) {
+        ctl_drain(self->ctl, _app_ctl_cmd_cb, self); // NOTE: Recorded like any other input.
+    }
+
+    _app_end_stage(self, APP_TIMING_INPUT);
+
     sim_update(self->sim);
-    sim_render_density(self->sim, vis_draw, self->vis, self->fl_grayscale);
+    if (self->tracer) {
+        tracer_update(self->tracer, self->sim);
+    }
+    ++self->step_idx;
+    _app_end_stage(self, APP_TIMING_STEP);
 
-    vis_update(self->vis);
-    vis_poll(self->vis);
+    if (self->rec) {
+        rec_push_frame(self->rec, sim_get_field_data(self->sim, SIM_FIELD_DENSITY));
+    }
+    if (self->ctl) {
+        ctl_publish_frame(self->ctl, sim_get_field_data(self->sim, SIM_FIELD_DENSITY), sim_get_rows(self->sim), sim_get_cols(self->sim), self->step_idx);
+    }
+
+    _app_render(self);
+    _app_end_stage(self, APP_TIMING_RENDER);
+
+    if (self->vis) {
+        vis_update(self->vis);
+        vis_poll(self->vis);
+    }
+    _app_end_stage(self, APP_TIMING_PRESENT);
+}
+
+static void _app_sweep_inject(void* ctx, int32_t member_idx, sim_obj_t sim, int64_t step)
+{
+    UNUSED_PARAM(member_idx);
+
+    const app_obj_t self = (app_obj_t)ctx;
+    assert(self);
+
+    // NOTE: Same scripted source for every member: a dye jet at the center, slowly swinging left and right.
+    const int32_t center = sim_get_rows(sim) / 2;
+    const float scale = self->f_add_scale * 4.0f;
+    sim_fade_density(sim, self->d_fade_step);
+    sim_add_density(sim, center, center, self->d_add_step);
+    sim_add_force(sim, center, center, scale * sinf((float)step * 0.05f), -scale);
+}
+
+static void _app_run_sweep(app_obj_t self)
+{
+    assert(self);
+
+    const int32_t
+        n = self->sweep_size,
+        member_count = n * n,
+        step_count = (self->max_steps > 0) ? (int32_t)self->max_steps : SWEEP_DEFAULT_STEPS;
+
+    ens_obj_t ens = ens_create(member_count, sim_get_rows(self->sim), self->thread_count);
+    if (!ens) {
+        fprintf(stderr, "failed to create ensemble!\n");
+        return;
+    }
+
+    for (int32_t i = 0; i < member_count; ++i) {
+        const float
+            tx = (n > 1) ? (float)(i % n) / (float)(n - 1) : 0.0f,
+            ty = (n > 1) ? (float)(i / n) / (float)(n - 1) : 0.0f;
+        sim_obj_t const member = ens_get_member(ens, i);
+        sim_set_diffusion(member, DIFF_MIN + (DIFF_MAX - DIFF_MIN) * tx);
+        sim_set_viscosity(member, VISC_MIN + (VISC_MAX - VISC_MIN) * ty);
+        sim_set_solver(member, sim_get_solver(self->sim));
+    }
+    ens_set_inject_cb(ens, _app_sweep_inject, self);
+
+    perf_begin(self->perf);
+    ens_step(ens, step_count);
+    perf_end(self->perf);
+    const double total_ms = perf_get_delta_ms(self->perf);
+
+    FILE* const fp = fopen(self->sweep_path, "w");
+    if (fp) {
+        fprintf(fp, "member,diffusion,viscosity,steps,mass,kinetic_energy,max_velocity,step_time_ms\n");
+        for (int32_t i = 0; i < member_count; ++i) {
+            const sim_obj_t member = ens_get_member(ens, i);
+            const ens_metrics_t* const m = ens_get_metrics(ens, i);
+            fprintf(fp, "%d,%g,%g,%lld,%g,%g,%g,%.3f\n"
+                , i
+                , sim_get_diffusion(member)
+                , sim_get_viscosity(member)
+                , (long long)m->step_count
+                , m->mass
+                , m->kinetic_energy
+                , m->max_velocity
+                , m->step_time_ms
+            );
+        }
+        fclose(fp);
+    } else {
+        fprintf(stderr, "failed to write '%s'!\n", self->sweep_path);
+    }
+
+    printf("members: %d, workers: %d, steps: %d, total: %.2fms, throughput: %.1f member-steps/s\n"
+        , member_count
+        , ens_get_worker_count(ens)
+        , step_count
+        , total_ms
+        , (total_ms > 0.0) ? (double)member_count * step_count * 1000.0 / total_ms : 0.0
+    );
+
+    ens_destroy(&ens);
+}
+
+static bool_t _app_parse_solver(const char* name, sim_solver_e* psolver)
+{
+    for (int32_t i = 0; i < SIM_SOLVER_COUNT; ++i) {
+        if (!strcmp(name, sim_solver_get_name((sim_solver_e)i))) {
+            *psolver = (sim_solver_e)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static bool_t _app_parse_filter(const char* name, sim_filter_e* pfilter)
+{
+    for (int32_t i = 0; i < SIM_FILTER_COUNT; ++i) {
+        if (!strcmp(name, sim_filter_get_name((sim_filter_e)i))) {
+            *pfilter = (sim_filter_e)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
 }
 
-app_obj_t app_create() {
+static void _app_print_usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --record-input <path>  record the input applied to each step into a journal\n"
+        "  --replay <path>        replay a recorded input journal instead of live input\n"
+        "  --headless             run without a window (requires --replay, --steps or --sweep)\n"
+        "  --steps <n>            stop after <n> steps\n"
+        "  --sweep <path>         run a headless diffusion/viscosity sweep and write the results as CSV\n"
+        "  --sweep-size <n>       number of values per parameter in the sweep (default: %d)\n"
+        "  --threads <n>          number of worker threads (default: one per cpu)\n"
+        "  --solver <name>        linear solver: gauss-seidel (default) or spectral\n"
+        "  --tracers <n>          advect up to <n> tracer particles, emitted with the density\n"
+        "  --filter <name>        density filter: nearest (default), bilinear or catmull-rom\n"
+        "  --stats <path>         append frame/stage latency percentiles every interval (.json: JSON Lines, otherwise CSV)\n"
+        "  --stats-interval <ms>  latency statistics interval (default: %g)\n"
+        "  --frame-budget <ms>    adapt the solver sweeps and the render resolution to hold this frame time\n"
+        "  --grid <n>             simulation grid size in cells, %d to %d (default: %d)\n"
+        "  --coarse-velocity <n>  solve the velocity on a grid <n> times coarser than the density\n"
+        "  --counters             count cycles, instructions, cache/TLB and branch misses per stage (Linux)\n"
+        "  --control <path>       serve injection, statistics and density frames on a Unix socket (Linux)\n"
+        "  --fps <n>              pace the frames to <n> per second, 0 for unpaced (default: %d with a window)\n"
+        , prog
+        , SWEEP_DEFAULT_SIZE
+        , STATS_DEFAULT_INTERVAL
+        , GRID_MIN_SIZE
+        , GRID_MAX_SIZE
+        , GRID_DEFAULT_SIZE
+        , FPS_DEFAULT
+    );
+}
+
+app_obj_t app_create(int argc, char* argv[]) {
     app_obj_t newobj = (app_obj_t)calloc(1, sizeof(struct _app_obj_t));
     if (!newobj) {
         return NULL;
     }
 
-    const int32_t box_size = 80;
+    const char* record_input_path = NULL;
+    const char* replay_path = NULL;
+    const char* stats_path = NULL;
+    const char* control_path = NULL;
+    double frame_budget = 0.0;
+    int32_t box_size = GRID_DEFAULT_SIZE;
+    int32_t velocity_coarsening = 1;
+    int32_t target_fps = -1; // negative for the default
+    sim_solver_e solver = SIM_SOLVER_GAUSS_SEIDEL;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--record-input") && i + 1 < argc) {
+            record_input_path = argv[++i];
+        } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (!strcmp(argv[i], "--headless")) {
+            newobj->fl_headless = TRUE;
+        } else if (!strcmp(argv[i], "--steps") && i + 1 < argc) {
+            newobj->max_steps = strtoll(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--sweep") && i + 1 < argc) {
+            newobj->sweep_path = argv[++i];
+            newobj->fl_headless = TRUE;
+        } else if (!strcmp(argv[i], "--sweep-size") && i + 1 < argc) {
+            newobj->sweep_size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            newobj->thread_count = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--solver") && i + 1 < argc && _app_parse_solver(argv[i + 1], &solver)) {
+            ++i;
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc && _app_parse_filter(argv[i + 1], &newobj->render_filter)) {
+            ++i;
+        } else if (!strcmp(argv[i], "--tracers") && i + 1 < argc) {
+            newobj->tracer_capacity = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--stats") && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (!strcmp(argv[i], "--stats-interval") && i + 1 < argc) {
+            newobj->stats_interval = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--frame-budget") && i + 1 < argc) {
+            frame_budget = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--grid") && i + 1 < argc) {
+            box_size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--coarse-velocity") && i + 1 < argc) {
+            velocity_coarsening = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--counters")) {
+            newobj->fl_counters = TRUE;
+        } else if (!strcmp(argv[i], "--control") && i + 1 < argc) {
+            control_path = argv[++i];
+        } else if (!strcmp(argv[i], "--fps") && i + 1 < argc) {
+            target_fps = atoi(argv[++i]);
+        } else {
+            _app_print_usage(argv[0]);
+            app_destroy(&newobj);
+            return NULL;
+        }
+    }
+
+    if (newobj->sweep_size <= 0) {
+        newobj->sweep_size = SWEEP_DEFAULT_SIZE;
+    }
+
+    if (newobj->stats_interval <= 0.0) {
+        newobj->stats_interval = STATS_DEFAULT_INTERVAL;
+    }
+
+    if ((newobj->fl_headless && !replay_path && !newobj->sweep_path && newobj->max_steps <= 0) ||
+        box_size < GRID_MIN_SIZE || box_size > GRID_MAX_SIZE)
+    {
+        _app_print_usage(argv[0]);
+        app_destroy(&newobj);
+        return NULL;
+    }
 
-    newobj->d_add_step = (float)box_size * 10.0f;
+    newobj->d_add_step = (float)GRID_DEFAULT_SIZE * 10.0f;
     newobj->d_fade_step = newobj->d_add_step * 1e-04f;
     newobj->f_add_scale = 0.5f;
     newobj->diff_factor = DIFF_MIN;
     newobj->visc_factor = VISC_MIN;
     newobj->fl_grayscale = FALSE;
     newobj->fl_render_overlay = TRUE;
+    newobj->min_frame_time = 1e+300;
+    newobj->render_scale = 1.0f;
+
+    if (replay_path) {
+        newobj->jrn_reader = journal_create_reader(replay_path);
+        if (!newobj->jrn_reader) {
+            fprintf(stderr, "failed to read input journal '%s'!\n", replay_path);
+            app_destroy(&newobj);
+            return NULL;
+        }
+
+        const journal_info_t* const info = journal_get_info(newobj->jrn_reader);
+        if (info->rows != info->cols || info->rows < GRID_MIN_SIZE || info->rows > GRID_MAX_SIZE) {
+            fprintf(stderr, "input journal '%s' has a %dx%d grid, replays need a square grid of %d to %d!\n",
+                replay_path, info->cols, info->rows, GRID_MIN_SIZE, GRID_MAX_SIZE);
+            app_destroy(&newobj);
+            return NULL;
+        }
+        box_size = info->rows;
+        newobj->d_fade_step = info->fade_step;
+        newobj->diff_factor = info->diff;
+        newobj->visc_factor = info->visc;
+    }
 
     newobj->perf = perf_create();
-    if (!newobj->perf) {
+    newobj->stage_perf = perf_create();
+    newobj->pace_perf = perf_create();
+    newobj->run_hist = hist_create();
+    if (!newobj->perf || !newobj->stage_perf || !newobj->pace_perf || !newobj->run_hist) {
         app_destroy(&newobj);
         return NULL;
     }
+    for (int32_t i = 0; i < APP_TIMING_COUNT; ++i) {
+        newobj->timing_hists[i] = hist_create();
+        if (!newobj->timing_hists[i]) {
+            app_destroy(&newobj);
+            return NULL;
+        }
+    }
+
+    if (stats_path) {
+        const char* const ext = strrchr(stats_path, '.');
+        newobj->fl_stats_json = ext && !strcmp(ext, ".json");
+        newobj->stats_fp = fopen(stats_path, "w");
+        if (!newobj->stats_fp) {
+            fprintf(stderr, "failed to create '%s'!\n", stats_path);
+            app_destroy(&newobj);
+            return NULL;
+        }
+        setvbuf(newobj->stats_fp, newobj->stats_fp_buff, _IOFBF, sizeof(newobj->stats_fp_buff));
+        if (!newobj->fl_stats_json) {
+            fprintf(newobj->stats_fp, "step,stage,count,mean_ms,min_ms,p50_ms,p90_ms,p99_ms,p999_ms,max_ms\n");
+        }
+    }
 
     newobj->sim = sim_create(box_size);
-    if (!newobj->sim) {
+    if (!newobj->sim || !sim_set_worker_count(newobj->sim, newobj->thread_count)) {
         app_destroy(&newobj);
         return NULL;
     }
 
+    if (newobj->tracer_capacity > 0) {
+        newobj->tracer = tracer_create(box_size, newobj->tracer_capacity);
+        if (!newobj->tracer || !_app_reserve_frame(newobj, (size_t)box_size * box_size)) {
+            fprintf(stderr, "failed to create %d tracers!\n", newobj->tracer_capacity);
+            app_destroy(&newobj);
+            return NULL;
+        }
+        tracer_set_lifetime(newobj->tracer, TRACER_LIFETIME);
+    }
+
     sim_set_diffusion(newobj->sim, newobj->diff_factor);
     sim_set_viscosity(newobj->sim, newobj->visc_factor);
+    if (newobj->jrn_reader) {
+        sim_set_time_step(newobj->sim, journal_get_info(newobj->jrn_reader)->dt);
+    }
+
+    if (record_input_path) {
+        const journal_info_t info = {
+            .rows = sim_get_rows(newobj->sim),
+            .cols = sim_get_cols(newobj->sim),
+            .dt = sim_get_time_step(newobj->sim),
+            .diff = newobj->diff_factor,
+            .visc = newobj->visc_factor,
+            .fade_step = newobj->d_fade_step,
+        };
+        newobj->jrn_writer = journal_create_writer(record_input_path, &info);
+        if (!newobj->jrn_writer) {
+            fprintf(stderr, "failed to create input journal '%s'!\n", record_input_path);
+            app_destroy(&newobj);
+            return NULL;
+        }
+    }
+
+    if (frame_budget > 0.0) {
+        const int32_t iter_size = sim_get_solve_iter_size(newobj->sim);
+        const gov_config_t config = {
+            .target_ms = frame_budget,
+            .min_solve_iter_size = min(GOV_MIN_SOLVE_ITER, iter_size),
+            .max_solve_iter_size = max(GOV_MAX_SOLVE_ITER, iter_size),
+            .min_render_scale = GOV_MIN_RENDER_SCALE,
+            .max_render_scale = 1.0f,
+        };
+        newobj->gov = gov_create(&config, iter_size, newobj->render_scale);
+        if (!newobj->gov) {
+            app_destroy(&newobj);
+            return NULL;
+        }
+    }
+
+    if (solver != SIM_SOLVER_GAUSS_SEIDEL && !newobj->jrn_reader) {
+        // NOTE: Injected as an event, so a recorded journal replays with the same solver.
+        _app_inject(newobj, &(journal_event_t) {
+            .type = JOURNAL_EVENT_SET_SOLVER,
+            .x = solver,
+        });
+    }
+
+    if (velocity_coarsening > 1 && !newobj->jrn_reader) {
+        _app_inject(newobj, &(journal_event_t) {
+            .type = JOURNAL_EVENT_SET_VELOCITY_COARSENING,
+            .x = velocity_coarsening,
+        });
+    }
+
+    if (control_path) {
+        newobj->ctl = ctl_create(control_path, GRID_MAX_SIZE * GRID_MAX_SIZE);
+        if (!newobj->ctl) {
+            fprintf(stderr, "failed to listen on '%s'!\n", control_path);
+            app_destroy(&newobj);
+            return NULL;
+        }
+    }
 
-    newobj->vis = vis_create(box_size, box_size, "Fluid.c");
+    newobj->vis_state.fl_woken = TRUE; // NOTE: The first frame runs.
+    newobj->target_fps = max(target_fps, 0);
+    if (newobj->fl_headless) {
+        return newobj;
+    }
+
+    newobj->vis = vis_create(GRID_DEFAULT_SIZE, GRID_DEFAULT_SIZE, "Fluid.c"); // NOTE: Fixed, the sim can be resized under it.
     if (!newobj->vis) {
         app_destroy(&newobj);
         return NULL;
@@ -233,6 +1291,11 @@ app_obj_t app_create() {
     vis_set_cursorenter_cb(newobj->vis, _app_vis_cursorenter_cb);
     vis_set_cursorpos_cb(newobj->vis, _app_vis_cursorpos_cb);
     vis_set_overlay_visibility(newobj->vis, newobj->fl_render_overlay);
+    sim_set_stats_enabled(newobj->sim, newobj->fl_render_overlay); // NOTE: Only shown in the overlay.
+
+    if (target_fps < 0 && !newobj->jrn_reader && vis_wait(newobj->vis, 0)) {
+        newobj->target_fps = FPS_DEFAULT; // NOTE: A zero wait only polls, and fails for a stream.
+    }
 
     return newobj;
 }
@@ -240,19 +1303,117 @@ app_obj_t app_create() {
 void app_destroy(app_obj_t* pself) {
     if (pself && *pself) {
         vis_destroy(&(*pself)->vis);
+        ctl_destroy(&(*pself)->ctl);
+        rec_destroy(&(*pself)->rec);
+        if ((*pself)->jrn_writer) {
+            journal_end((*pself)->jrn_writer, (*pself)->step_idx);
+            journal_destroy(&(*pself)->jrn_writer);
+        }
+        journal_destroy(&(*pself)->jrn_reader);
+        gov_destroy(&(*pself)->gov);
+        hwc_destroy(&(*pself)->hwc);
+        tracer_destroy(&(*pself)->tracer);
+        SAFE_FREE((*pself)->frame);
         sim_destroy(&(*pself)->sim);
+        if ((*pself)->stats_fp) {
+            fclose((*pself)->stats_fp);
+        }
+        for (int32_t i = 0; i < APP_TIMING_COUNT; ++i) {
+            hist_destroy(&(*pself)->timing_hists[i]);
+        }
+        hist_destroy(&(*pself)->run_hist);
+        perf_destroy(&(*pself)->pace_perf);
+        perf_destroy(&(*pself)->stage_perf);
         perf_destroy(&(*pself)->perf);
         SAFE_FREE(*pself);
     }
 }
 
+static void _app_print_counters(app_obj_t self)
+{
+    assert(self);
+    assert(self->hwc);
+
+    const char* const error = hwc_get_error(self->hwc);
+    if (error) {
+        printf("counters: unavailable (%s)\n", error);
+        return;
+    }
+
+    const uint32_t mask = hwc_get_counter_mask(self->hwc);
+    printf("counters: %d threads, per step (misses per 1k instructions):\n", hwc_get_thread_count(self->hwc));
+    printf("  %-8s %14s %14s %6s %8s %8s %8s %8s\n", "stage", "cycles", "instructions", "ipc", "l1d", "llc", "dtlb", "branch");
+    for (int32_t i = 0; i < APP_TIMING_COUNT; ++i) {
+        hwc_totals_t st;
+        if (i == APP_TIMING_FRAME) {
+            memset(&st, 0, sizeof(st));
+            for (int32_t j = APP_TIMING_FRAME + 1; j < APP_TIMING_COUNT; ++j) {
+                for (int32_t k = 0; k < HWC_COUNTER_COUNT; ++k) {
+                    st.values[k] += self->counter_totals[j].values[k];
+                }
+            }
+        } else {
+            st = self->counter_totals[i];
+        }
+        const double steps = self->step_idx ? (double)self->step_idx : 1.0;
+        printf("  %-8s %14.0f %14.0f %6.2f %8.2f %8.2f %8.2f %8.2f\n"
+            , s_timing_names[i]
+            , (double)st.values[HWC_CYCLES] / steps
+            , (double)st.values[HWC_INSTRUCTIONS] / steps
+            , hwc_totals_get_ipc(&st)
+            , hwc_totals_get_mpki(&st, HWC_L1D_MISSES)
+            , hwc_totals_get_mpki(&st, HWC_LLC_MISSES)
+            , hwc_totals_get_mpki(&st, HWC_DTLB_MISSES)
+            , hwc_totals_get_mpki(&st, HWC_BRANCH_MISSES)
+        );
+    }
+    for (int32_t k = 0; k < HWC_COUNTER_COUNT; ++k) {
+        if (!(mask & (1u << k))) {
+            printf("  (%s not counted)\n", hwc_counter_get_name((hwc_counter_e)k));
+        }
+    }
+}
+
 void app_run(app_obj_t self) {
     assert(self);
-    while (!vis_should_close(self->vis)) {
+
+    if (self->sweep_path) {
+        _app_run_sweep(self);
+        return;
+    }
+
+    if (self->fl_counters && !self->hwc) {
+        // NOTE: Here, so the counters cover every thread the sim and window have started.
+        self->hwc = hwc_create();
+        if (!self->hwc) {
+            fprintf(stderr, "failed to create the hardware counters!\n");
+        }
+    }
+
+    if (self->target_fps > 0) {
+        perf_begin(self->pace_perf);
+    }
+
+    while (!_app_should_close(self)) {
+        if (_app_wait_at_rest(self)) {
+            continue;
+        }
+
         perf_begin(self->perf);
         _app_poll(self);
         perf_end(self->perf);
         const double delta_ms = perf_get_delta_ms(self->perf);
+        hist_record(self->timing_hists[APP_TIMING_FRAME], delta_ms);
+        hist_record(self->run_hist, delta_ms);
+        if (self->gov) {
+            _app_govern(self, delta_ms);
+        }
+        if (self->ctl) {
+            _app_publish_stats(self, delta_ms);
+        }
+        self->total_frame_time += delta_ms;
+        self->min_frame_time = min(self->min_frame_time, delta_ms);
+        self->max_frame_time = max(self->max_frame_time, delta_ms);
         const double smoothing = 0.9; // NOTE: Larger smoothing value  -> gives a slower smoother changing value.
                                       //       Smaller smoothing value -> gives a quicker changing value.
         self->curr_frame_time = (self->curr_frame_time * smoothing) + (delta_ms * (1.0 - smoothing)); // calculate smoothed average
@@ -263,5 +1424,35 @@ void app_run(app_obj_t self) {
             self->curr_acc_frame_time -= 1000.0;
             self->frame_counter = 0;
         }
+        self->stats_acc_time += delta_ms;
+        if (self->stats_acc_time >= self->stats_interval) {
+            self->stats_acc_time = 0.0;
+            _app_flush_stats(self);
+        }
+        if (self->target_fps > 0) {
+            _app_pace(self);
+        }
+    }
+
+    if (self->stats_acc_time > 0.0) {
+        _app_flush_stats(self); // NOTE: The last, partial interval.
+    }
+
+    if (self->fl_headless || self->jrn_reader) {
+        hist_summary_t st;
+        hist_read(self->run_hist, &st, FALSE);
+        printf("steps: %lld, total: %.2fms, avg: %.3fms, min: %.3fms, max: %.3fms, p50: %.3fms, p99: %.3fms, p99.9: %.3fms\n"
+            , (long long)self->step_idx
+            , self->total_frame_time
+            , self->step_idx ? self->total_frame_time / (double)self->step_idx : 0.0
+            , self->step_idx ? self->min_frame_time : 0.0
+            , self->max_frame_time
+            , st.p50_ms
+            , st.p99_ms
+            , st.p999_ms
+        );
+        if (self->hwc) {
+            _app_print_counters(self);
+        }
     }
 }
\ No newline at end of file
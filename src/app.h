@@ -3,6 +3,6 @@
 
 DECL_OBJECT(app_obj_t);
 
-app_obj_t app_create();
+app_obj_t app_create(int argc, char* argv[]);
 void app_destroy(app_obj_t*);
 void app_run(app_obj_t);
\ No newline at end of file
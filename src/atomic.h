@@ -0,0 +1,100 @@
+﻿#pragma once
+#include "common.h"
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+// NOTE: Minimal set of atomic primitives shared by the multi-threaded modules.
+//       MSVC's C mode does not provide `<stdatomic.h>` reliably, so we wrap the
+//       compiler intrinsics directly. Loads are acquire, stores are release and
+//       read-modify-write operations are sequentially consistent.
+
+static inline int32_t atomic_load_i32(volatile int32_t* p) {
+#if defined(_MSC_VER)
+    const int32_t v = *p;
+    _ReadWriteBarrier();
+    return v;
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void atomic_store_i32(volatile int32_t* p, int32_t v) {
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+    *p = v;
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline int32_t atomic_add_i32(volatile int32_t* p, int32_t v) { // returns previous value
+#if defined(_MSC_VER)
+    return (int32_t)_InterlockedExchangeAdd((volatile long*)p, (long)v);
+#else
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline bool_t atomic_cas_i32(volatile int32_t* p, int32_t expected, int32_t desired) {
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange((volatile long*)p, (long)desired, (long)expected) == (long)expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline int64_t atomic_load_i64(volatile int64_t* p) {
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange64(p, 0, 0); // NOTE: plain 64-bit loads are not atomic on x86.
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void atomic_store_i64(volatile int64_t* p, int64_t v) {
+#if defined(_MSC_VER)
+    int64_t prev = *p;
+    for (;;) {
+        const int64_t cur = _InterlockedCompareExchange64(p, v, prev);
+        if (cur == prev) {
+            break;
+        }
+        prev = cur;
+    }
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline int64_t atomic_add_i64(volatile int64_t* p, int64_t v) { // returns previous value
+#if defined(_MSC_VER)
+    int64_t prev = *p;
+    for (;;) {
+        const int64_t cur = _InterlockedCompareExchange64(p, prev + v, prev);
+        if (cur == prev) {
+            return prev;
+        }
+        prev = cur;
+    }
+#else
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline bool_t atomic_cas_i64(volatile int64_t* p, int64_t expected, int64_t desired) {
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange64(p, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void atomic_pause(void) { // spin-wait hint
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
@@ -0,0 +1,873 @@
+﻿#include "common.h"
+#include "misc.h"
+#include "mat.h"
+#include "perf.h"
+#include "hwc.h"
+#include "pool.h"
+#include "sim.h"
+#include "sim_kern.h"
+#include "sim_spec.h"
+#include "sim_mask.h"
+#include "rec.h"
+#include <math.h>
+
+#define BENCH_WARMUP_DEFAULT     3
+#define BENCH_MIN_REPS_DEFAULT   5
+#define BENCH_MAX_REPS_DEFAULT   200
+#define BENCH_BUDGET_MS_DEFAULT  500.0 // target time spent on the timed repetitions of one case
+#define BENCH_THRESHOLD_DEFAULT  10.0  // [%]
+
+#define BENCH_DT              0.35f // same as the `sim` defaults
+#define BENCH_DIFF            1e-4f
+#define BENCH_SOLVE_ITER_SIZE 12
+#define BENCH_FADE_STEP       0.01f
+
+#define BENCH_SCALED_COLS   2560 // output of `render_density_scaled`, 1440p whatever the grid size
+#define BENCH_SCALED_ROWS   1440
+
+#define BENCH_CHANNELS      4 // scalar fields of `advect_channels`
+
+#define BENCH_SPLATS        10000 // splats per call of `splats`
+#define BENCH_SPLAT_RADII   6 // radii 1 to 6 in turn, each with both falloffs
+
+#define BENCH_REC_FRAMES             16 // frames of one recording of the `rec_` cases
+#define BENCH_REC_KEYFRAME_INTERVAL  8
+
+#define BENCH_MAX_SIZES     16
+#define BENCH_MAX_BASELINE  1024
+
+typedef struct {
+    int32_t N;
+    uint32_t rng;
+    const sim_kern_table_t* kt;
+    pool_obj_t pool; // NULL for one thread
+
+    // Kernel fixtures
+    mat2f_obj_t m_x, m_x0;
+    mat2f_obj_t m_vx, m_vy;
+    mat2f_obj_t m_p, m_div;
+    sim_spec_obj_t spec;
+    sim_mask_obj_t mask; // a few discs, see `_bench_fixture_create()`
+    float* px, *py; // `N * N` tracer positions, uniform over the interior
+    mat2f_obj_t m_c[BENCH_CHANNELS], m_c0[BENCH_CHANNELS]; // `BENCH_FIXTURE_CHANNELS` only
+
+    // `BENCH_FIXTURE_REC` fixture, frames alternate between `m_x0` and `m_x`
+    char rec_path[64]; // recorded and verified once, read by `rec_read` and `rec_seek`
+    char rec_write_path[64]; // rewritten by every `rec_write`
+    rec_reader_obj_t rec_reader;
+
+    // `sim_render_density()` and `sim_add_splats()` fixture
+    sim_obj_t sim;
+    sim_splat_t* splats; // `BENCH_SPLATS`
+    pixel_t* pixels;
+    pixel_t* scaled_pixels; // `BENCH_SCALED_ROWS * BENCH_SCALED_COLS`
+} bench_fixture_t;
+
+typedef enum {
+    BENCH_FIXTURE_FIELDS,
+    BENCH_FIXTURE_TILED, // `m_x`, `m_x0`, `m_vx` and `m_vy` in the tiled layout
+    BENCH_FIXTURE_CHANNELS, // also `m_c` and `m_c0`
+    BENCH_FIXTURE_SIM,
+    BENCH_FIXTURE_REC, // smooth `m_x0`, `m_x` one advection later, and a recording of them
+} bench_fixture_e;
+
+typedef struct {
+    const char* name;
+    bench_fixture_e fixture;
+    void(*fn)(bench_fixture_t* fx);
+    double(*bytes_fn)(double N); // nominal memory traffic of one call, in bytes
+    double(*cells_fn)(double N); // cell updates of one call
+} bench_kernel_t;
+
+typedef struct {
+    char kernel[64];
+    int32_t size;
+    double median_ms;
+} bench_baseline_entry_t;
+
+typedef struct {
+    int32_t sizes[BENCH_MAX_SIZES];
+    int32_t size_count;
+    const char* kernels; // comma separated filter, NULL for all
+    const char* out_path; // NULL for stdout
+    const char* baseline_path;
+    const char* isa; // NULL for the default
+    int32_t thread_count;
+    double threshold; // [%]
+    int32_t warmup, min_reps, max_reps;
+    double budget_ms;
+    bool_t fl_counters; // hardware counters of the timed repetitions
+} bench_opts_t;
+
+static inline float _bench_rand(bench_fixture_t* fx)
+{
+    // xorshift32, [0, 1)
+    uint32_t x = fx->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fx->rng = x;
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+static void _bench_fill(bench_fixture_t* fx, mat2f_obj_t m, float lo, float hi)
+{
+    for (int32_t i = 0; i < mat2f_get_size(m); ++i) {
+        *mat2f_at_index(m, i) = lo + (hi - lo) * _bench_rand(fx);
+    }
+}
+
+static void _bench_fixture_destroy(bench_fixture_t* fx)
+{
+    mat2f_destroy(&fx->m_x);
+    mat2f_destroy(&fx->m_x0);
+    mat2f_destroy(&fx->m_vx);
+    mat2f_destroy(&fx->m_vy);
+    mat2f_destroy(&fx->m_p);
+    mat2f_destroy(&fx->m_div);
+    sim_spec_destroy(&fx->spec);
+    sim_mask_destroy(&fx->mask);
+    SAFE_FREE(fx->px);
+    SAFE_FREE(fx->py);
+    for (int32_t c = 0; c < BENCH_CHANNELS; ++c) {
+        mat2f_destroy(&fx->m_c[c]);
+        mat2f_destroy(&fx->m_c0[c]);
+    }
+    sim_destroy(&fx->sim);
+    SAFE_FREE(fx->splats);
+    SAFE_FREE(fx->pixels);
+    SAFE_FREE(fx->scaled_pixels);
+    rec_reader_destroy(&fx->rec_reader);
+    if (fx->rec_path[0]) {
+        remove(fx->rec_path);
+    }
+    if (fx->rec_write_path[0]) {
+        remove(fx->rec_write_path);
+    }
+}
+
+static inline const float* _bench_rec_frame(bench_fixture_t* fx, int32_t frame_idx)
+{
+    return mat2f_at_index((frame_idx & 1) ? fx->m_x : fx->m_x0, 0);
+}
+
+static bool_t _bench_record(bench_fixture_t* fx, const char* path)
+{
+    // NOTE: The ring holds every frame, so none is dropped however slow the writer is.
+    rec_obj_t rec = rec_create(path, fx->N, fx->N, BENCH_REC_FRAMES, BENCH_REC_KEYFRAME_INTERVAL);
+    if (!rec) {
+        return FALSE;
+    }
+    bool_t ok = TRUE;
+    for (int32_t k = 0; k < BENCH_REC_FRAMES; ++k) {
+        ok = rec_push_frame(rec, _bench_rec_frame(fx, k)) && ok;
+    }
+    rec_destroy(&rec);
+    return ok;
+}
+
+static bool_t _bench_rec_verify(bench_fixture_t* fx)
+{
+    // NOTE: Plays the recording back in order, then seeks backwards onto frames between keyframes,
+    //       every frame must match the quantized field it was recorded from.
+    static const int32_t order[] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        15, 9, 3, 12, 1,
+    };
+    const int32_t size = fx->N * fx->N;
+    if (rec_reader_get_rows(fx->rec_reader) != fx->N ||
+        rec_reader_get_cols(fx->rec_reader) != fx->N ||
+        rec_reader_get_frame_count(fx->rec_reader) != BENCH_REC_FRAMES)
+    {
+        return FALSE;
+    }
+    for (size_t n = 0; n < sizeof(order) / sizeof(order[0]); ++n) {
+        const uint8_t* const frame = rec_reader_read_frame(fx->rec_reader, order[n]);
+        const float* const src = _bench_rec_frame(fx, order[n]);
+        if (!frame) {
+            return FALSE;
+        }
+        for (int32_t i = 0; i < size; ++i) {
+            const float d = src[i];
+            if (frame[i] != (uint8_t)(((d > 0.0f) ? ((d < 255.0f) ? d : 255.0f) : 0.0f) + 0.5f)) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+static bool_t _bench_tile(mat2f_obj_t* pm/* inout */)
+{
+    mat2f_obj_t tiled = mat2f_create_tiled(mat2f_get_rows(*pm), mat2f_get_cols(*pm));
+    if (!tiled) {
+        return FALSE;
+    }
+    mat2f_convert(tiled, *pm);
+    mat2f_destroy(pm);
+    *pm = tiled;
+    return TRUE;
+}
+
+static bool_t _bench_fixture_create(bench_fixture_t* fx, const sim_kern_table_t* kt, pool_obj_t pool, int32_t N, bench_fixture_e kind)
+{
+    memset(fx, 0, sizeof(*fx));
+    fx->N = N;
+    fx->rng = 0x9e3779b9u;
+    fx->kt = kt;
+    fx->pool = pool;
+
+    fx->pixels = (pixel_t*)malloc((size_t)N * N * sizeof(pixel_t));
+    if (!fx->pixels) {
+        return FALSE;
+    }
+
+    // NOTE: Velocities move a particle by at most 2 cells per step, like a lively but stable flow.
+    const float v_max = 2.0f / (BENCH_DT * (float)(N - 2));
+
+    if (kind == BENCH_FIXTURE_SIM) {
+        fx->sim = sim_create_shared(N);
+        fx->scaled_pixels = (pixel_t*)malloc((size_t)BENCH_SCALED_COLS * BENCH_SCALED_ROWS * sizeof(pixel_t));
+        fx->splats = (sim_splat_t*)malloc(BENCH_SPLATS * sizeof(sim_splat_t));
+        if (!fx->sim || !fx->scaled_pixels || !fx->splats || !sim_set_isa(fx->sim, kt->isa) ||
+            !sim_set_worker_count(fx->sim, pool ? pool_get_worker_count(pool) : 1))
+        {
+            _bench_fixture_destroy(fx);
+            return FALSE;
+        }
+        for (int32_t y = 0; y < N; ++y) {
+            for (int32_t x = 0; x < N; ++x) {
+                sim_add_density(fx->sim, x, y, 255.0f * _bench_rand(fx));
+            }
+        }
+        // NOTE: Spread over the box with mixed radii and falloffs, like a batch of brush strokes.
+        for (int32_t k = 0; k < BENCH_SPLATS; ++k) {
+            fx->splats[k] = (sim_splat_t) {
+                .x = 1.0f + (float)(N - 3) * _bench_rand(fx),
+                .y = 1.0f + (float)(N - 3) * _bench_rand(fx),
+                .radius = (float)(1 + k % BENCH_SPLAT_RADII),
+                .density = 10.0f * _bench_rand(fx),
+                .fx = v_max * (2.0f * _bench_rand(fx) - 1.0f),
+                .fy = v_max * (2.0f * _bench_rand(fx) - 1.0f),
+                .falloff = ((k / BENCH_SPLAT_RADII) & 1) ? SIM_SPLAT_FALLOFF_GAUSSIAN : SIM_SPLAT_FALLOFF_BOX,
+            };
+        }
+        return TRUE;
+    }
+
+    fx->m_x = mat2f_create(N, N);
+    fx->m_x0 = mat2f_create(N, N);
+    fx->m_vx = mat2f_create(N, N);
+    fx->m_vy = mat2f_create(N, N);
+    fx->m_p = mat2f_create(N, N);
+    fx->m_div = mat2f_create(N, N);
+    fx->spec = sim_spec_create(N);
+    fx->mask = sim_mask_create(N);
+    fx->px = (float*)malloc((size_t)N * N * sizeof(float));
+    fx->py = (float*)malloc((size_t)N * N * sizeof(float));
+    if (!fx->m_x || !fx->m_x0 || !fx->m_vx || !fx->m_vy || !fx->m_p || !fx->m_div || !fx->spec || !fx->mask || !fx->px || !fx->py) {
+        _bench_fixture_destroy(fx);
+        return FALSE;
+    }
+
+    // NOTE: A 3x3 grid of discs covering about 20% of the box, like a cylinder array.
+    uint8_t* const solid = (uint8_t*)calloc((size_t)N * N, sizeof(uint8_t));
+    if (!solid) {
+        _bench_fixture_destroy(fx);
+        return FALSE;
+    }
+    const float radius = 0.085f * (float)N;
+    for (int32_t y = 0; y < N; ++y) {
+        for (int32_t x = 0; x < N; ++x) {
+            const float
+                dx = fmodf((float)x, (float)N / 3.0f) - (float)N / 6.0f,
+                dy = fmodf((float)y, (float)N / 3.0f) - (float)N / 6.0f;
+            solid[y * N + x] = (dx * dx + dy * dy <= radius * radius);
+        }
+    }
+    const bool_t fl_compiled = sim_mask_compile(fx->mask, solid);
+    free(solid);
+    if (!fl_compiled) {
+        _bench_fixture_destroy(fx);
+        return FALSE;
+    }
+
+    _bench_fill(fx, fx->m_x, 0.0f, 255.0f);
+    _bench_fill(fx, fx->m_x0, 0.0f, 255.0f);
+    _bench_fill(fx, fx->m_vx, -v_max, v_max);
+    _bench_fill(fx, fx->m_vy, -v_max, v_max);
+    for (int32_t k = 0; k < N * N; ++k) {
+        fx->px[k] = 1.0f + (float)(N - 3) * _bench_rand(fx);
+        fx->py[k] = 1.0f + (float)(N - 3) * _bench_rand(fx);
+    }
+
+    if (kind == BENCH_FIXTURE_CHANNELS) {
+        for (int32_t c = 0; c < BENCH_CHANNELS; ++c) {
+            fx->m_c[c] = mat2f_create(N, N);
+            fx->m_c0[c] = mat2f_create(N, N);
+            if (!fx->m_c[c] || !fx->m_c0[c]) {
+                _bench_fixture_destroy(fx);
+                return FALSE;
+            }
+            _bench_fill(fx, fx->m_c0[c], 0.0f, 255.0f);
+        }
+    }
+
+    if (kind == BENCH_FIXTURE_REC) {
+        // NOTE: Smooth plumes rather than noise, like the density a recording sees.
+        for (int32_t y = 0; y < N; ++y) {
+            for (int32_t x = 0; x < N; ++x) {
+                *mat2f_at_coord(fx->m_x0, y, x) = 127.5f + 127.5f * sinf(0.05f * (float)x) * cosf(0.07f * (float)y);
+            }
+        }
+        sim_kern_advect(kt, pool, NULL, 0, fx->m_x, fx->m_x0, fx->m_vx, fx->m_vy, BENCH_DT, NULL);
+
+        snprintf(fx->rec_path, sizeof(fx->rec_path), "fluid-c-bench-%d.frc", N);
+        snprintf(fx->rec_write_path, sizeof(fx->rec_write_path), "fluid-c-bench-%d-write.frc", N);
+        if (!_bench_record(fx, fx->rec_path) || !(fx->rec_reader = rec_reader_create(fx->rec_path))) {
+            _bench_fixture_destroy(fx);
+            return FALSE;
+        }
+        if (!_bench_rec_verify(fx)) {
+            fprintf(stderr, "recording of %dx%d does not play back the recorded frames!\n", N, N);
+            _bench_fixture_destroy(fx);
+            return FALSE;
+        }
+    }
+
+    // NOTE: Same values as the row-major fixture, so the layouts are compared on the same flow.
+    if (kind == BENCH_FIXTURE_TILED &&
+        !(_bench_tile(&fx->m_x) && _bench_tile(&fx->m_x0) && _bench_tile(&fx->m_vx) && _bench_tile(&fx->m_vy)))
+    {
+        _bench_fixture_destroy(fx);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Kernels
+
+static void _bench_set_bounds(bench_fixture_t* fx)
+{
+    sim_kern_set_bounds(NULL, 1, fx->m_vx);
+}
+
+static void _bench_set_bounds_obstacles(bench_fixture_t* fx)
+{
+    sim_kern_set_bounds(fx->mask, 1, fx->m_vx);
+}
+
+static void _bench_gauss_seidel(bench_fixture_t* fx)
+{
+    const float a = BENCH_DT * BENCH_DIFF * (float)(fx->N - 2) * (float)(fx->N - 2);
+    sim_kern_solve_gauss_seidel(fx->kt, NULL, 0, fx->m_x, fx->m_x0, a, 1.0f + 4.0f * a, BENCH_SOLVE_ITER_SIZE);
+}
+
+static void _bench_gauss_seidel_unblocked(bench_fixture_t* fx)
+{
+    const float a = BENCH_DT * BENCH_DIFF * (float)(fx->N - 2) * (float)(fx->N - 2);
+    sim_kern_solve_gauss_seidel_blocked(fx->kt, NULL, 0, fx->m_x, fx->m_x0, a, 1.0f + 4.0f * a, BENCH_SOLVE_ITER_SIZE, 1);
+}
+
+static void _bench_gauss_seidel_tiled(bench_fixture_t* fx)
+{
+    const float a = BENCH_DT * BENCH_DIFF * (float)(fx->N - 2) * (float)(fx->N - 2);
+    sim_kern_solve_gauss_seidel_tiled(0, fx->m_x, fx->m_x0, a, 1.0f + 4.0f * a, BENCH_SOLVE_ITER_SIZE);
+}
+
+static void _bench_diffuse(bench_fixture_t* fx)
+{
+    sim_kern_diffuse(fx->kt, NULL, 0, fx->m_x, fx->m_x0, BENCH_DIFF, BENCH_DT, BENCH_SOLVE_ITER_SIZE);
+}
+
+static void _bench_project(bench_fixture_t* fx)
+{
+    sim_kern_project(fx->kt, fx->pool, NULL, fx->m_vx, fx->m_vy, fx->m_p, fx->m_div, BENCH_SOLVE_ITER_SIZE, NULL);
+}
+
+static void _bench_project_stats(bench_fixture_t* fx)
+{
+    sim_kern_stats_t stats;
+    sim_kern_project(fx->kt, fx->pool, NULL, fx->m_vx, fx->m_vy, fx->m_p, fx->m_div, BENCH_SOLVE_ITER_SIZE, &stats);
+}
+
+static void _bench_project_obstacles(bench_fixture_t* fx)
+{
+    sim_kern_project(fx->kt, fx->pool, fx->mask, fx->m_vx, fx->m_vy, fx->m_p, fx->m_div, BENCH_SOLVE_ITER_SIZE, NULL);
+}
+
+static void _bench_spectral_diffuse(bench_fixture_t* fx)
+{
+    sim_spec_diffuse(fx->spec, 0, fx->m_x, fx->m_x0, BENCH_DIFF, BENCH_DT);
+}
+
+static void _bench_spectral_project(bench_fixture_t* fx)
+{
+    sim_spec_project(fx->spec, fx->kt, fx->pool, fx->m_vx, fx->m_vy, fx->m_p, fx->m_div, NULL);
+}
+
+static void _bench_advect(bench_fixture_t* fx)
+{
+    sim_kern_advect(fx->kt, fx->pool, NULL, 0, fx->m_x, fx->m_x0, fx->m_vx, fx->m_vy, BENCH_DT, NULL);
+}
+
+static void _bench_advect_channels(bench_fixture_t* fx)
+{
+    sim_kern_advect_channels(fx->kt, fx->pool, NULL, 0, fx->m_c, fx->m_c0, BENCH_CHANNELS, fx->m_vx, fx->m_vy, BENCH_DT, NULL);
+}
+
+static void _bench_advect_tiled(bench_fixture_t* fx)
+{
+    sim_kern_advect_tiled(fx->pool, 0, fx->m_x, fx->m_x0, fx->m_vx, fx->m_vy, BENCH_DT);
+}
+
+static void _bench_trace(bench_fixture_t* fx)
+{
+    // NOTE: Particles random walk across repetitions, samples outside the interior are clamped.
+    const int32_t N = fx->N;
+    fx->kt->trace(fx->px, fx->py, N * N, mat2f_at_index(fx->m_vx, 0), mat2f_at_index(fx->m_vy, 0), N, BENCH_DT * (float)(N - 2));
+}
+
+static void _bench_fade_density(bench_fixture_t* fx)
+{
+    sim_kern_fade_density(fx->kt, fx->pool, fx->m_x, BENCH_FADE_STEP);
+}
+
+static void _bench_hsl2rgb(bench_fixture_t* fx)
+{
+    fx->kt->shade(fx->pixels, mat2f_at_index(fx->m_x0, 0), mat2f_get_size(fx->m_x0), FALSE);
+}
+
+static void _bench_pixel_transfer(void* ctx, int32_t row, int32_t col, pixel_t clr)
+{
+    const bench_fixture_t* const fx = (const bench_fixture_t*)ctx;
+    fx->pixels[row * fx->N + col] = clr;
+}
+
+static void _bench_render_density(bench_fixture_t* fx)
+{
+    sim_render_density(fx->sim, _bench_pixel_transfer, fx, FALSE);
+}
+
+static void _bench_render_density_scaled(bench_fixture_t* fx)
+{
+    sim_render_density_scaled(fx->sim, fx->scaled_pixels, BENCH_SCALED_COLS, BENCH_SCALED_ROWS, SIM_FILTER_CATMULL_ROM, FALSE);
+}
+
+static void _bench_splats(bench_fixture_t* fx)
+{
+    sim_add_splats(fx->sim, fx->splats, BENCH_SPLATS);
+}
+
+static void _bench_rec_write(bench_fixture_t* fx)
+{
+    _bench_record(fx, fx->rec_write_path);
+}
+
+static void _bench_rec_read(bench_fixture_t* fx)
+{
+    for (int32_t k = 0; k < BENCH_REC_FRAMES; ++k) {
+        rec_reader_read_frame(fx->rec_reader, k);
+    }
+}
+
+static void _bench_rec_seek(bench_fixture_t* fx)
+{
+    // NOTE: Strides through the frames, so most reads decode again from the preceding keyframe.
+    for (int32_t k = 0; k < BENCH_REC_FRAMES; ++k) {
+        rec_reader_read_frame(fx->rec_reader, (k * 5 + 3) % BENCH_REC_FRAMES);
+    }
+}
+
+// Traffic models, 4 bytes per float
+// NOTE: Solver models count one pass over the grid per sweep, so temporal blocking shows up as extra GB/s.
+
+static double _bench_set_bounds_bytes(double N) { return 4.0 * 2.0 * 4.0 * N; }
+static double _bench_set_bounds_cells(double N) { return 4.0 * N; }
+static double _bench_gauss_seidel_bytes(double N) { return BENCH_SOLVE_ITER_SIZE * (3.0 * 4.0 * N * N + _bench_set_bounds_bytes(N)); }
+static double _bench_gauss_seidel_cells(double N) { return BENCH_SOLVE_ITER_SIZE * N * N; }
+static double _bench_diffuse_bytes(double N) { return 2.0 * 4.0 * N * N + _bench_gauss_seidel_bytes(N); }
+static double _bench_diffuse_cells(double N) { return _bench_gauss_seidel_cells(N); }
+static double _bench_project_bytes(double N) { return (4.0 + 5.0) * 4.0 * N * N + _bench_gauss_seidel_bytes(N) + 4.0 * _bench_set_bounds_bytes(N); }
+static double _bench_project_stats_bytes(double N) { return _bench_project_bytes(N) + 4.0 * N * N; } // NOTE: The gradient also reads `div`, the wider pressure taps hit the cache.
+static double _bench_project_cells(double N) { return 2.0 * N * N + _bench_gauss_seidel_cells(N); }
+static double _bench_spectral_bytes(double N) { return 2.0 * 4.0 * N * N + 4.0 * 2.0 * 4.0 * N * N; } // copy, then 2 passes per 2-D transform
+static double _bench_spectral_project_bytes(double N) { return (4.0 + 5.0) * 4.0 * N * N + _bench_spectral_bytes(N) + 4.0 * _bench_set_bounds_bytes(N); }
+static double _bench_advect_bytes(double N) { return 4.0 * 4.0 * N * N + _bench_set_bounds_bytes(N); }
+static double _bench_advect_channels_bytes(double N) { return (2.0 + 2.0 * BENCH_CHANNELS) * 4.0 * N * N + BENCH_CHANNELS * _bench_set_bounds_bytes(N); }
+static double _bench_advect_channels_cells(double N) { return BENCH_CHANNELS * N * N; }
+static double _bench_trace_bytes(double N) { return 2.0 * 2.0 * 4.0 * N * N + 2.0 * 2.0 * 4.0 * 4.0 * N * N; } // positions in and out, 2 x 4 taps of both components
+static double _bench_field_bytes(double N) { return 2.0 * 4.0 * N * N; }
+static double _bench_field_cells(double N) { return N * N; }
+static double _bench_scaled_bytes(double N) { return 4.0 * N * N + 4.0 * BENCH_SCALED_COLS * BENCH_SCALED_ROWS; }
+static double _bench_scaled_cells(double N) { UNUSED_PARAM(N); return (double)BENCH_SCALED_COLS * BENCH_SCALED_ROWS; } // output pixels
+static double _bench_splats_cells(double N) { UNUSED_PARAM(N); return BENCH_SPLATS * 54.2; } // (2r)^2 box and pi r^2 disk supports over the radii, unclipped
+static double _bench_splats_bytes(double N) { return 3.0 * 2.0 * 4.0 * _bench_splats_cells(N); } // 3 fields read and written
+static double _bench_rec_write_bytes(double N) { return BENCH_REC_FRAMES * (4.0 + 1.0) * N * N; } // fields in, quantized frames
+static double _bench_rec_read_bytes(double N) { return BENCH_REC_FRAMES * N * N; } // decoded frames out
+static double _bench_rec_cells(double N) { return BENCH_REC_FRAMES * N * N; }
+
+static const bench_kernel_t g_bench_kernels[] = {
+    { "set_bounds",             BENCH_FIXTURE_FIELDS, _bench_set_bounds,             _bench_set_bounds_bytes,       _bench_set_bounds_cells   },
+    { "set_bounds_obstacles",   BENCH_FIXTURE_FIELDS, _bench_set_bounds_obstacles,   _bench_set_bounds_bytes,       _bench_set_bounds_cells   },
+    { "gauss_seidel",           BENCH_FIXTURE_FIELDS, _bench_gauss_seidel,           _bench_gauss_seidel_bytes,     _bench_gauss_seidel_cells },
+    { "gauss_seidel_unblocked", BENCH_FIXTURE_FIELDS, _bench_gauss_seidel_unblocked, _bench_gauss_seidel_bytes,     _bench_gauss_seidel_cells },
+    { "gauss_seidel_tiled",     BENCH_FIXTURE_TILED,  _bench_gauss_seidel_tiled,     _bench_gauss_seidel_bytes,     _bench_gauss_seidel_cells },
+    { "diffuse",                BENCH_FIXTURE_FIELDS, _bench_diffuse,                _bench_diffuse_bytes,          _bench_diffuse_cells      },
+    { "project",                BENCH_FIXTURE_FIELDS, _bench_project,                _bench_project_bytes,          _bench_project_cells      },
+    { "project_stats",          BENCH_FIXTURE_FIELDS, _bench_project_stats,          _bench_project_stats_bytes,    _bench_project_cells      },
+    { "project_obstacles",      BENCH_FIXTURE_FIELDS, _bench_project_obstacles,      _bench_project_bytes,          _bench_project_cells      },
+    { "spectral_diffuse",       BENCH_FIXTURE_FIELDS, _bench_spectral_diffuse,       _bench_spectral_bytes,         _bench_field_cells        },
+    { "spectral_project",       BENCH_FIXTURE_FIELDS, _bench_spectral_project,       _bench_spectral_project_bytes, _bench_field_cells        },
+    { "advect",                 BENCH_FIXTURE_FIELDS, _bench_advect,                 _bench_advect_bytes,           _bench_field_cells        },
+    { "advect_channels",        BENCH_FIXTURE_CHANNELS, _bench_advect_channels,      _bench_advect_channels_bytes,  _bench_advect_channels_cells },
+    { "advect_tiled",           BENCH_FIXTURE_TILED,  _bench_advect_tiled,           _bench_advect_bytes,           _bench_field_cells        },
+    { "trace",                  BENCH_FIXTURE_FIELDS, _bench_trace,                  _bench_trace_bytes,            _bench_field_cells        },
+    { "fade_density",           BENCH_FIXTURE_FIELDS, _bench_fade_density,           _bench_field_bytes,            _bench_field_cells        },
+    { "hsl2rgb",                BENCH_FIXTURE_FIELDS, _bench_hsl2rgb,                _bench_field_bytes,            _bench_field_cells        },
+    { "render_density",         BENCH_FIXTURE_SIM,    _bench_render_density,         _bench_field_bytes,            _bench_field_cells        },
+    { "render_density_scaled",  BENCH_FIXTURE_SIM,    _bench_render_density_scaled,  _bench_scaled_bytes,           _bench_scaled_cells       },
+    { "splats",                 BENCH_FIXTURE_SIM,    _bench_splats,                 _bench_splats_bytes,           _bench_splats_cells       },
+    { "rec_write",              BENCH_FIXTURE_REC,    _bench_rec_write,              _bench_rec_write_bytes,        _bench_rec_cells          },
+    { "rec_read",               BENCH_FIXTURE_REC,    _bench_rec_read,               _bench_rec_read_bytes,         _bench_rec_cells          },
+    { "rec_seek",               BENCH_FIXTURE_REC,    _bench_rec_seek,               _bench_rec_read_bytes,         _bench_rec_cells          },
+};
+
+static int _bench_cmp_f64(const void* a, const void* b)
+{
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static bool_t _bench_is_selected(const char* filter, const char* name)
+{
+    if (!filter) {
+        return TRUE;
+    }
+    const size_t len = strlen(name);
+    for (const char* p = filter; (p = strstr(p, name)); p += len) {
+        if ((p == filter || p[-1] == ',') && (p[len] == ',' || p[len] == '\0')) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static int32_t _bench_load_baseline(const char* path, bench_baseline_entry_t* entries, int32_t cap)
+{
+    FILE* const fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    // NOTE: Only understands the one-result-per-line layout written by `_bench_write_result()`.
+    int32_t count = 0;
+    char line[1024];
+    while (count < cap && fgets(line, sizeof(line), fp)) {
+        const char* const k = strstr(line, "\"kernel\":");
+        const char* const s = strstr(line, "\"size\":");
+        const char* const m = strstr(line, "\"median_ms\":");
+        if (!k || !s || !m) {
+            continue;
+        }
+        bench_baseline_entry_t* const e = &entries[count];
+        if (sscanf(k, "\"kernel\": \"%63[^\"]\"", e->kernel) == 1 &&
+            sscanf(s, "\"size\": %d", &e->size) == 1 &&
+            sscanf(m, "\"median_ms\": %lf", &e->median_ms) == 1)
+        {
+            ++count;
+        }
+    }
+    fclose(fp);
+    return count;
+}
+
+static const bench_baseline_entry_t* _bench_find_baseline(const bench_baseline_entry_t* entries, int32_t count, const char* kernel, int32_t size)
+{
+    for (int32_t i = 0; i < count; ++i) {
+        if (entries[i].size == size && !strcmp(entries[i].kernel, kernel)) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void _bench_print_usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --out <path>         write the results as JSON to <path> (default: stdout)\n"
+        "  --baseline <path>    compare against a previous result and flag slowdowns\n"
+        "  --threshold <pct>    slowdown of the median that counts as a regression (default: %.0f)\n"
+        "  --sizes <n,n,...>    grid sizes (default: 64,128,256,512,1024,2048,4096)\n"
+        "  --kernels <a,b,...>  only run the given kernels\n"
+        "  --isa <name>         kernel variant: scalar, sse4.2, avx2 or avx512 (default: best supported)\n"
+        "  --threads <n>        worker threads of the row loops and renders, 0 for one per cpu (default: 1)\n"
+        "  --warmup <n>         untimed calls before measuring, 0 estimates the repetitions from the first timed call (default: %d)\n"
+        "  --reps <min,max>     bounds of the timed repetitions (default: %d,%d)\n"
+        "  --budget-ms <ms>     target time of the timed repetitions per case (default: %.0f)\n"
+        "  --counters           add the ipc and the cache/TLB/branch misses of each case (Linux)\n"
+        "kernels:"
+        , prog
+        , BENCH_THRESHOLD_DEFAULT
+        , BENCH_WARMUP_DEFAULT
+        , BENCH_MIN_REPS_DEFAULT, BENCH_MAX_REPS_DEFAULT
+        , BENCH_BUDGET_MS_DEFAULT
+    );
+    for (size_t k = 0; k < sizeof(g_bench_kernels) / sizeof(g_bench_kernels[0]); ++k) {
+        fprintf(stderr, " %s", g_bench_kernels[k].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+static int32_t _bench_get_rep_count(const bench_opts_t* opts, double est_ms)
+{
+    return (est_ms > 0.0)
+        ? (int32_t)clamp(opts->budget_ms / est_ms, (double)opts->min_reps, (double)opts->max_reps)
+        : opts->max_reps;
+}
+
+static bool_t _bench_parse_opts(int argc, char* argv[], bench_opts_t* opts)
+{
+    static const int32_t default_sizes[] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+
+    memset(opts, 0, sizeof(*opts));
+    opts->threshold = BENCH_THRESHOLD_DEFAULT;
+    opts->warmup = BENCH_WARMUP_DEFAULT;
+    opts->min_reps = BENCH_MIN_REPS_DEFAULT;
+    opts->max_reps = BENCH_MAX_REPS_DEFAULT;
+    opts->budget_ms = BENCH_BUDGET_MS_DEFAULT;
+    opts->thread_count = 1;
+    opts->size_count = (int32_t)(sizeof(default_sizes) / sizeof(default_sizes[0]));
+    memcpy(opts->sizes, default_sizes, sizeof(default_sizes));
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            opts->out_path = argv[++i];
+        } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            opts->baseline_path = argv[++i];
+        } else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) {
+            opts->threshold = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--sizes") && i + 1 < argc) {
+            opts->size_count = 0;
+            for (char* p = argv[++i]; *p && opts->size_count < BENCH_MAX_SIZES; ) {
+                const int32_t n = (int32_t)strtol(p, &p, 10);
+                if (n < 10) {
+                    return FALSE;
+                }
+                opts->sizes[opts->size_count++] = n;
+                if (*p == ',') {
+                    ++p;
+                }
+            }
+        } else if (!strcmp(argv[i], "--isa") && i + 1 < argc) {
+            opts->isa = argv[++i];
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            opts->thread_count = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--kernels") && i + 1 < argc) {
+            opts->kernels = argv[++i];
+        } else if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+            const int32_t warmup = atoi(argv[++i]); // NOTE: Not inside `max()`, which evaluates its arguments twice.
+            opts->warmup = max(warmup, 0);
+        } else if (!strcmp(argv[i], "--reps") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d", &opts->min_reps, &opts->max_reps) < 1) {
+                return FALSE;
+            }
+            opts->min_reps = max(opts->min_reps, 1);
+            opts->max_reps = max(opts->max_reps, opts->min_reps);
+        } else if (!strcmp(argv[i], "--budget-ms") && i + 1 < argc) {
+            opts->budget_ms = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--counters")) {
+            opts->fl_counters = TRUE;
+        } else {
+            return FALSE;
+        }
+    }
+
+    return opts->size_count > 0;
+}
+
+int main(int argc, char* argv[]) {
+    bench_opts_t opts;
+    if (!_bench_parse_opts(argc, argv, &opts)) {
+        _bench_print_usage(argv[0]);
+        return 2;
+    }
+
+    const sim_kern_table_t* kt = sim_kern_get_default_table();
+    if (opts.isa) {
+        kt = NULL;
+        for (int32_t isa = 0; isa < SIM_ISA_COUNT && !kt; ++isa) {
+            if (!strcmp(opts.isa, sim_isa_get_name((sim_isa_e)isa))) {
+                kt = sim_kern_get_table((sim_isa_e)isa);
+            }
+        }
+        if (!kt) {
+            fprintf(stderr, "isa '%s' is not available!\n", opts.isa);
+            return 2;
+        }
+    }
+
+    static bench_baseline_entry_t baseline[BENCH_MAX_BASELINE];
+    int32_t baseline_count = 0;
+    if (opts.baseline_path) {
+        baseline_count = _bench_load_baseline(opts.baseline_path, baseline, BENCH_MAX_BASELINE);
+        if (baseline_count < 0) {
+            fprintf(stderr, "failed to read baseline '%s'!\n", opts.baseline_path);
+            return 2;
+        }
+    }
+
+    FILE* const out = opts.out_path ? fopen(opts.out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "failed to open '%s'!\n", opts.out_path);
+        return 2;
+    }
+
+    perf_obj_t perf = perf_create();
+    double* samples = (double*)malloc((size_t)opts.max_reps * sizeof(double));
+    pool_obj_t pool = (opts.thread_count != 1) ? pool_create(opts.thread_count) : NULL;
+    if (!perf || !samples || (opts.thread_count != 1 && !pool)) {
+        fprintf(stderr, "out of memory!\n");
+        return 2;
+    }
+
+    // NOTE: After the pool, so the counters cover its workers.
+    hwc_obj_t hwc = NULL;
+    if (opts.fl_counters) {
+        hwc = hwc_create();
+        if (!hwc) {
+            fprintf(stderr, "out of memory!\n");
+            return 2;
+        }
+        if (hwc_get_error(hwc)) {
+            fprintf(stderr, "hardware counters unavailable (%s)\n", hwc_get_error(hwc));
+            hwc_destroy(&hwc);
+        }
+    }
+
+    fprintf(out, "{\n  \"version\": 1,\n  \"isa\": \"%s\",\n  \"threads\": %d,\n  \"solve_iter_size\": %d,\n  \"threshold_pct\": %g,\n  \"results\": [\n"
+        , sim_isa_get_name(kt->isa)
+        , pool ? pool_get_worker_count(pool) : 1
+        , BENCH_SOLVE_ITER_SIZE
+        , opts.threshold
+    );
+
+    fprintf(stderr, "isa: %s, threads: %d\n", sim_isa_get_name(kt->isa), pool ? pool_get_worker_count(pool) : 1);
+
+    int32_t result_count = 0, regression_count = 0;
+    for (size_t k = 0; k < sizeof(g_bench_kernels) / sizeof(g_bench_kernels[0]); ++k) {
+        const bench_kernel_t* const kern = &g_bench_kernels[k];
+        if (!_bench_is_selected(opts.kernels, kern->name)) {
+            continue;
+        }
+
+        for (int32_t s = 0; s < opts.size_count; ++s) {
+            const int32_t N = opts.sizes[s];
+            bench_fixture_t fx;
+            if (!_bench_fixture_create(&fx, kt, pool, N, kern->fixture)) {
+                fprintf(stderr, "%-22s %5d  skipped (out of memory)\n", kern->name, N);
+                continue;
+            }
+
+            // Warm up caches, page in the fields and estimate the cost of one call. Without warm-up, the
+            // number of repetitions is estimated from the first timed one.
+            double est_ms = 0.0;
+            for (int32_t w = 0; w < opts.warmup; ++w) {
+                perf_begin(perf);
+                kern->fn(&fx);
+                perf_end(perf);
+                est_ms = perf_get_delta_ms(perf);
+            }
+
+            int32_t reps = _bench_get_rep_count(&opts, est_ms);
+            hwc_totals_t counters = { 0 };
+            if (hwc) {
+                hwc_begin(hwc);
+            }
+            for (int32_t r = 0; r < reps; ++r) {
+                perf_begin(perf);
+                kern->fn(&fx);
+                perf_end(perf);
+                samples[r] = perf_get_delta_ms(perf);
+                if (!r && !opts.warmup) {
+                    reps = _bench_get_rep_count(&opts, samples[0]);
+                }
+            }
+            if (hwc) {
+                hwc_end(hwc, &counters);
+            }
+            _bench_fixture_destroy(&fx);
+
+            qsort(samples, (size_t)reps, sizeof(double), _bench_cmp_f64);
+            const double
+                min_ms = samples[0],
+                median_ms = (reps & 1) ? samples[reps / 2] : 0.5 * (samples[reps / 2 - 1] + samples[reps / 2]),
+                p99_ms = samples[(int32_t)ceil(0.99 * reps) - 1],
+                median_s = max(median_ms, 1e-9) * 1e-3,
+                gbps = kern->bytes_fn(N) / median_s * 1e-9,
+                cells_per_s = kern->cells_fn(N) / median_s;
+
+            const bench_baseline_entry_t* const base = _bench_find_baseline(baseline, baseline_count, kern->name, N);
+            const double delta_pct = base ? 100.0 * (median_ms / base->median_ms - 1.0) : 0.0;
+            const bool_t fl_regression = base && delta_pct > opts.threshold;
+            regression_count += fl_regression;
+
+            fprintf(out, "%s    {\"kernel\": \"%s\", \"size\": %d, \"reps\": %d, \"min_ms\": %.6f, \"median_ms\": %.6f, \"p99_ms\": %.6f, \"gb_per_s\": %.4f, \"cells_per_s\": %.6e"
+                , result_count ? ",\n" : ""
+                , kern->name, N, reps
+                , min_ms, median_ms, p99_ms
+                , gbps, cells_per_s
+            );
+            if (base) {
+                fprintf(out, ", \"baseline_median_ms\": %.6f, \"delta_pct\": %.2f, \"regression\": %s", base->median_ms, delta_pct, fl_regression ? "true" : "false");
+            }
+            if (hwc) {
+                // NOTE: Per call, misses per 1000 instructions.
+                fprintf(out, ", \"cycles\": %.0f, \"instructions\": %.0f, \"ipc\": %.3f, \"l1d_mpki\": %.3f, \"llc_mpki\": %.3f, \"dtlb_mpki\": %.3f, \"branch_mpki\": %.3f"
+                    , (double)counters.values[HWC_CYCLES] / reps
+                    , (double)counters.values[HWC_INSTRUCTIONS] / reps
+                    , hwc_totals_get_ipc(&counters)
+                    , hwc_totals_get_mpki(&counters, HWC_L1D_MISSES)
+                    , hwc_totals_get_mpki(&counters, HWC_LLC_MISSES)
+                    , hwc_totals_get_mpki(&counters, HWC_DTLB_MISSES)
+                    , hwc_totals_get_mpki(&counters, HWC_BRANCH_MISSES)
+                );
+            }
+            fprintf(out, "}");
+            ++result_count;
+
+            fprintf(stderr, "%-22s %5d  reps %4d  min %10.4fms  median %10.4fms  p99 %10.4fms  %8.2f GB/s  %10.3e cells/s"
+                , kern->name, N, reps, min_ms, median_ms, p99_ms, gbps, cells_per_s
+            );
+            if (base) {
+                fprintf(stderr, "  %+7.2f%%%s", delta_pct, fl_regression ? "  SLOWER" : "");
+            }
+            if (hwc) {
+                fprintf(stderr, "  ipc %5.2f  l1d %6.2f  llc %6.2f  dtlb %6.2f  branch %6.2f /ki"
+                    , hwc_totals_get_ipc(&counters)
+                    , hwc_totals_get_mpki(&counters, HWC_L1D_MISSES)
+                    , hwc_totals_get_mpki(&counters, HWC_LLC_MISSES)
+                    , hwc_totals_get_mpki(&counters, HWC_DTLB_MISSES)
+                    , hwc_totals_get_mpki(&counters, HWC_BRANCH_MISSES)
+                );
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+    SAFE_FREE(samples);
+    hwc_destroy(&hwc);
+    pool_destroy(&pool);
+    perf_destroy(&perf);
+
+    if (regression_count) {
+        fprintf(stderr, "%d regression(s) above %g%%\n", regression_count, opts.threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -15,6 +15,10 @@ typedef _Bool bool_t;
 #  define FALSE 0
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define HAS_SSE2 1
+#endif
+
 #define DECL_OBJECT(X) typedef struct _ ## X * X;
 
 // `[[maybe_unused]]` feature(since C23) is currently unavailable, so we use the classic method.
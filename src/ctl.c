@@ -0,0 +1,585 @@
+﻿#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE // memfd_create, accept4
+#endif
+#include "ctl.h"
+#include "thread.h"
+#include "atomic.h"
+#include "misc.h"
+
+#if defined(__linux__)
+#  include <sys/eventfd.h>
+#  include <sys/mman.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <time.h>
+#  include <unistd.h>
+#endif
+
+#if defined(__linux__)
+
+#if !defined(F_SEAL_FUTURE_WRITE)
+#  define F_SEAL_FUTURE_WRITE 0x0010 // NOTE: Linux 5.1, older C libraries lack the name.
+#endif
+
+#define CTL_MSG_BUFF_SIZE (sizeof(ctl_msg_header_t) + CTL_MAX_BATCH * sizeof(ctl_cmd_t))
+#define CTL_SHM_ALIGN 64
+
+typedef struct {
+    ctl_cmd_t cmd;
+    int64_t recv_ns; // CLOCK_MONOTONIC
+} ctl_queued_t;
+
+typedef struct {
+    int fd; // -1 if the slot is free
+    bool_t fl_subscribed;
+    uint32_t used; // bytes of `buff` holding a partial message
+    uint8_t buff[CTL_MSG_BUFF_SIZE];
+} ctl_client_t;
+
+struct _ctl_obj_t {
+    struct sockaddr_un addr;
+    int listen_fd;
+    int wake_fd; // eventfd, wakes the server for new frames and for stopping
+    int cmd_fd; // eventfd, wakes `ctl_wait()` for queued commands
+    int shm_fd; // memfd of the frame ring, passed to subscribers
+    uint8_t* shm;
+    ctl_frame_info_t frame_info;
+    volatile int64_t latest_seq; // of the last published frame, only copied to the shared header (clients may write to their mapping)
+
+    ctl_queued_t queue[CTL_QUEUE_SIZE];
+    volatile int64_t head; // commands queued (written by the server only)
+    volatile int64_t tail; // commands drained (written by the simulation thread only)
+    volatile int64_t cmd_count;
+    volatile int64_t cmd_dropped_count;
+    volatile int64_t cmd_latency_max_ns;
+
+    volatile int64_t stats_lock; // odd while `stats` is written
+    ctl_stats_t stats;
+
+    volatile int32_t subscriber_count;
+    volatile int32_t client_count;
+    volatile int32_t fl_stop;
+
+    // Server thread state
+    ctl_client_t clients[CTL_MAX_CLIENTS];
+    int64_t noted_seq; // last frame announced to the subscribers
+    thread_obj_t server;
+};
+
+static inline int64_t _ctl_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline ctl_frame_slot_t* _ctl_get_slot(ctl_obj_t self, int64_t seq)
+{
+    const uint32_t slot = (uint32_t)(seq % CTL_FRAME_SLOTS);
+    return (ctl_frame_slot_t*)(self->shm + self->frame_info.slot_offset + (size_t)slot * self->frame_info.slot_size);
+}
+
+static bool_t _ctl_send(int fd, ctl_msg_e type, const void* payload, uint32_t size, int pass_fd, bool_t* pfl_full/* out */)
+{
+    // NOTE: One `sendmsg()` per message, never blocking: a client whose socket buffer is full
+    //       would stall every other client, a partial write ends its connection. `pfl_full` (may be
+    //       NULL) tells a message that was not sent at all because the buffer was full.
+    uint8_t buff[sizeof(ctl_msg_header_t) + 128];
+    assert(size <= sizeof(buff) - sizeof(ctl_msg_header_t));
+    const ctl_msg_header_t hdr = { .size = size, .type = (uint32_t)type };
+    memcpy(buff, &hdr, sizeof(hdr));
+    memcpy(buff + sizeof(hdr), payload, size);
+
+    struct iovec iov = { .iov_base = buff, .iov_len = sizeof(hdr) + size };
+    union {
+        struct cmsghdr align;
+        char data[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (pass_fd >= 0) {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.data;
+        msg.msg_controllen = sizeof(control.data);
+        struct cmsghdr* const cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &pass_fd, sizeof(int));
+    }
+    const ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (pfl_full) {
+        *pfl_full = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    return n == (ssize_t)iov.iov_len;
+}
+
+static void _ctl_client_close(ctl_obj_t self, ctl_client_t* client)
+{
+    if (client->fl_subscribed) {
+        atomic_add_i32(&self->subscriber_count, -1);
+    }
+    close(client->fd);
+    client->fd = -1;
+    client->fl_subscribed = FALSE;
+    client->used = 0;
+    atomic_add_i32(&self->client_count, -1);
+}
+
+static void _ctl_push_batch(ctl_obj_t self, const uint8_t* cmds, int32_t count)
+{
+    // NOTE: The whole batch is published by one store of `head`, commands past a full queue are dropped.
+    const int64_t head = self->head;
+    const int32_t free_count = (int32_t)(CTL_QUEUE_SIZE - (head - atomic_load_i64(&self->tail)));
+    const int32_t push_count = min(count, free_count);
+    const int64_t recv_ns = _ctl_now_ns();
+    for (int32_t k = 0; k < push_count; ++k) {
+        ctl_queued_t* const q = &self->queue[(head + k) & (CTL_QUEUE_SIZE - 1)];
+        memcpy(&q->cmd, cmds + (size_t)k * sizeof(ctl_cmd_t), sizeof(ctl_cmd_t));
+        q->recv_ns = recv_ns;
+    }
+    atomic_store_i64(&self->head, head + push_count);
+    if (push_count > 0) {
+        const uint64_t one = 1;
+        if (write(self->cmd_fd, &one, sizeof(one)) < 0) {
+            // NOTE: Only fails on overflow, `ctl_wait()` returns either way.
+        }
+    }
+    if (push_count < count) {
+        atomic_add_i64(&self->cmd_dropped_count, count - push_count);
+    }
+}
+
+static void _ctl_read_stats(ctl_obj_t self, ctl_stats_t* stats/* out */)
+{
+    for (;;) {
+        const int64_t lock = atomic_load_i64(&self->stats_lock);
+        if (lock & 1) {
+            atomic_pause();
+            continue;
+        }
+        memcpy(stats, &self->stats, sizeof(*stats));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (atomic_load_i64(&self->stats_lock) == lock) {
+            break;
+        }
+    }
+    stats->cmd_count = atomic_load_i64(&self->cmd_count);
+    stats->cmd_dropped_count = atomic_load_i64(&self->cmd_dropped_count);
+    stats->cmd_latency_max_ms = (double)atomic_load_i64(&self->cmd_latency_max_ns) * 1e-6;
+}
+
+static bool_t _ctl_handle(ctl_obj_t self, ctl_client_t* client, uint32_t type, const uint8_t* payload, uint32_t size)
+{
+    switch (type) {
+    case CTL_MSG_INJECT:
+        if (size % sizeof(ctl_cmd_t)) {
+            return FALSE;
+        }
+        _ctl_push_batch(self, payload, (int32_t)(size / sizeof(ctl_cmd_t)));
+        return TRUE;
+    case CTL_MSG_GET_STATS: {
+        ctl_stats_t stats;
+        _ctl_read_stats(self, &stats);
+        return _ctl_send(client->fd, CTL_MSG_STATS, &stats, sizeof(stats), -1, NULL);
+    }
+    case CTL_MSG_SUBSCRIBE:
+        if (!_ctl_send(client->fd, CTL_MSG_SUBSCRIBED, &self->frame_info, sizeof(self->frame_info), self->shm_fd, NULL)) {
+            return FALSE;
+        }
+        if (!client->fl_subscribed) {
+            client->fl_subscribed = TRUE;
+            atomic_add_i32(&self->subscriber_count, 1);
+        }
+        return TRUE;
+    case CTL_MSG_UNSUBSCRIBE:
+        if (client->fl_subscribed) {
+            client->fl_subscribed = FALSE;
+            atomic_add_i32(&self->subscriber_count, -1);
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static bool_t _ctl_client_read(ctl_obj_t self, ctl_client_t* client)
+{
+    const ssize_t n = recv(client->fd, client->buff + client->used, sizeof(client->buff) - client->used, MSG_DONTWAIT);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (n == 0) {
+        return FALSE;
+    }
+    client->used += (uint32_t)n;
+
+    uint32_t offset = 0;
+    while (client->used - offset >= sizeof(ctl_msg_header_t)) {
+        ctl_msg_header_t hdr;
+        memcpy(&hdr, client->buff + offset, sizeof(hdr));
+        if (hdr.size > sizeof(client->buff) - sizeof(hdr)) {
+            return FALSE;
+        }
+        if (client->used - offset < sizeof(hdr) + hdr.size) {
+            break;
+        }
+        if (!_ctl_handle(self, client, hdr.type, client->buff + offset + sizeof(hdr), hdr.size)) {
+            return FALSE;
+        }
+        offset += (uint32_t)sizeof(hdr) + hdr.size;
+    }
+    memmove(client->buff, client->buff + offset, client->used - offset);
+    client->used -= offset;
+    return TRUE;
+}
+
+static void _ctl_accept(ctl_obj_t self)
+{
+    const int fd = accept4(self->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    for (int32_t i = 0; i < CTL_MAX_CLIENTS; ++i) {
+        if (self->clients[i].fd < 0) {
+            self->clients[i].fd = fd;
+            atomic_add_i32(&self->client_count, 1);
+            return;
+        }
+    }
+    close(fd); // NOTE: Full.
+}
+
+static void _ctl_send_notes(ctl_obj_t self)
+{
+    const int64_t seq = atomic_load_i64(&self->latest_seq);
+    if (seq == self->noted_seq) {
+        return;
+    }
+    self->noted_seq = seq;
+
+    const ctl_frame_note_t note = { .seq = seq, .slot = (uint32_t)(seq % CTL_FRAME_SLOTS) };
+    for (int32_t i = 0; i < CTL_MAX_CLIENTS; ++i) {
+        ctl_client_t* const client = &self->clients[i];
+        bool_t fl_full;
+        if (client->fd >= 0 && client->fl_subscribed &&
+            !_ctl_send(client->fd, CTL_MSG_FRAME, &note, sizeof(note), -1, &fl_full) && !fl_full)
+        {
+            _ctl_client_close(self, client); // NOTE: A full socket only misses this note.
+        }
+    }
+}
+
+static void _ctl_server_main(void* ctx)
+{
+    const ctl_obj_t self = (ctl_obj_t)ctx;
+    struct pollfd fds[2 + CTL_MAX_CLIENTS];
+    int32_t fd_clients[2 + CTL_MAX_CLIENTS];
+
+    while (!atomic_load_i32(&self->fl_stop)) {
+        nfds_t nfds = 0;
+        fds[nfds++] = (struct pollfd) { .fd = self->wake_fd, .events = POLLIN };
+        fds[nfds++] = (struct pollfd) { .fd = self->listen_fd, .events = POLLIN };
+        for (int32_t i = 0; i < CTL_MAX_CLIENTS; ++i) {
+            if (self->clients[i].fd >= 0) {
+                fd_clients[nfds] = i;
+                fds[nfds++] = (struct pollfd) { .fd = self->clients[i].fd, .events = POLLIN };
+            }
+        }
+
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(self->wake_fd, &count, sizeof(count)) < 0) {
+                // NOTE: Nonblocking, a concurrent wake-up may have been consumed already.
+            }
+            _ctl_send_notes(self);
+        }
+        for (nfds_t k = 2; k < nfds; ++k) {
+            ctl_client_t* const client = &self->clients[fd_clients[k]];
+            if (client->fd >= 0 && (fds[k].revents & (POLLIN | POLLHUP | POLLERR)) && !_ctl_client_read(self, client)) {
+                _ctl_client_close(self, client);
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            _ctl_accept(self);
+        }
+    }
+}
+
+static bool_t _ctl_create_shm(ctl_obj_t self, int32_t max_cells)
+{
+    const size_t
+        slot_size = ((size_t)CTL_FRAME_DATA_OFFSET + (size_t)max_cells * sizeof(float) + CTL_SHM_ALIGN - 1) & ~(size_t)(CTL_SHM_ALIGN - 1),
+        size = CTL_SHM_ALIGN + CTL_FRAME_SLOTS * slot_size;
+    if (slot_size > UINT32_MAX) {
+        return FALSE;
+    }
+
+    self->shm_fd = memfd_create("fluid-c-frames", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (self->shm_fd < 0 || ftruncate(self->shm_fd, (off_t)size) < 0) {
+        return FALSE;
+    }
+    void* const shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, self->shm_fd, 0);
+    if (shm == MAP_FAILED) {
+        return FALSE;
+    }
+    self->shm = (uint8_t*)shm;
+
+    // NOTE: Subscribers get the same descriptor. Sealed, they can neither resize it under the server
+    //       (SIGBUS) nor map or write it for writing, only the mapping taken above stays writable.
+    if (fcntl(self->shm_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) < 0) {
+        return FALSE;
+    }
+    self->frame_info = (ctl_frame_info_t) {
+        .size = size,
+        .slot_count = CTL_FRAME_SLOTS,
+        .slot_size = (uint32_t)slot_size,
+        .slot_offset = CTL_SHM_ALIGN,
+        .max_cells = (uint32_t)max_cells,
+    };
+
+    ctl_shm_header_t* const hdr = (ctl_shm_header_t*)self->shm;
+    hdr->magic = CTL_SHM_MAGIC;
+    hdr->version = CTL_PROTOCOL_VERSION;
+    return TRUE;
+}
+
+ctl_obj_t ctl_create(const char* path, int32_t max_cells) {
+    assert(path);
+    assert(max_cells > 0);
+
+    ctl_obj_t newobj = (ctl_obj_t)calloc(1, sizeof(struct _ctl_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->listen_fd = newobj->wake_fd = newobj->cmd_fd = newobj->shm_fd = -1;
+    for (int32_t i = 0; i < CTL_MAX_CLIENTS; ++i) {
+        newobj->clients[i].fd = -1;
+    }
+
+    if (strlen(path) >= sizeof(newobj->addr.sun_path)) {
+        ctl_destroy(&newobj);
+        return NULL;
+    }
+    newobj->addr.sun_family = AF_UNIX;
+    strcpy(newobj->addr.sun_path, path);
+
+    // NOTE: A socket file left by a previous run would fail the bind, anything else at `path` is kept.
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    newobj->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (newobj->listen_fd < 0 ||
+        bind(newobj->listen_fd, (const struct sockaddr*)&newobj->addr, sizeof(newobj->addr)) < 0)
+    {
+        newobj->addr.sun_path[0] = '\0'; // NOTE: Not ours to remove.
+        ctl_destroy(&newobj);
+        return NULL;
+    }
+
+    newobj->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    newobj->cmd_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (listen(newobj->listen_fd, CTL_MAX_CLIENTS) < 0 ||
+        newobj->wake_fd < 0 ||
+        newobj->cmd_fd < 0 ||
+        !_ctl_create_shm(newobj, max_cells))
+    {
+        ctl_destroy(&newobj);
+        return NULL;
+    }
+
+    newobj->server = thread_create(_ctl_server_main, newobj);
+    if (!newobj->server) {
+        ctl_destroy(&newobj);
+        return NULL;
+    }
+
+    return newobj;
+}
+
+void ctl_destroy(ctl_obj_t* pself) {
+    if (pself && *pself) {
+        const ctl_obj_t self = *pself;
+        if (self->server) {
+            atomic_store_i32(&self->fl_stop, TRUE);
+            const uint64_t one = 1;
+            if (write(self->wake_fd, &one, sizeof(one)) < 0) {
+                // NOTE: The counter cannot overflow here, the server wakes up either way.
+            }
+            thread_destroy(&self->server);
+        }
+        for (int32_t i = 0; i < CTL_MAX_CLIENTS; ++i) {
+            if (self->clients[i].fd >= 0) {
+                close(self->clients[i].fd);
+            }
+        }
+        if (self->listen_fd >= 0) {
+            close(self->listen_fd);
+            if (self->addr.sun_path[0]) {
+                unlink(self->addr.sun_path);
+            }
+        }
+        if (self->shm) {
+            munmap(self->shm, self->frame_info.size);
+        }
+        if (self->shm_fd >= 0) {
+            close(self->shm_fd);
+        }
+        if (self->wake_fd >= 0) {
+            close(self->wake_fd);
+        }
+        if (self->cmd_fd >= 0) {
+            close(self->cmd_fd);
+        }
+        SAFE_FREE(*pself);
+    }
+}
+
+bool_t ctl_wait(ctl_obj_t self, uint32_t timeout_ms) {
+    assert(self);
+
+    // NOTE: The server signals after publishing a batch, so a batch queued after the check below
+    //       leaves the eventfd readable and the poll returns.
+    if (atomic_load_i64(&self->head) == self->tail) {
+        struct pollfd pfd = { .fd = self->cmd_fd, .events = POLLIN };
+        poll(&pfd, 1, (timeout_ms == UINT32_MAX) ? -1 : (int)min(timeout_ms, (uint32_t)INT32_MAX));
+    }
+    uint64_t count;
+    if (read(self->cmd_fd, &count, sizeof(count)) < 0) {
+        // NOTE: Nonblocking, nothing was signalled.
+    }
+    return atomic_load_i64(&self->head) != self->tail;
+}
+
+int32_t ctl_drain(ctl_obj_t self, ctl_cmd_fn_t fn, void* ctx) {
+    assert(self);
+    assert(fn);
+
+    const int64_t head = atomic_load_i64(&self->head), tail = self->tail;
+    if (head == tail) {
+        return 0;
+    }
+
+    const int64_t now_ns = _ctl_now_ns();
+    int64_t latency_max_ns = self->cmd_latency_max_ns;
+    for (int64_t t = tail; t < head; ++t) {
+        const ctl_queued_t* const q = &self->queue[t & (CTL_QUEUE_SIZE - 1)];
+        fn(ctx, &q->cmd);
+        latency_max_ns = max(latency_max_ns, now_ns - q->recv_ns);
+    }
+    atomic_store_i64(&self->tail, head);
+    atomic_store_i64(&self->cmd_latency_max_ns, latency_max_ns);
+    atomic_add_i64(&self->cmd_count, head - tail);
+    return (int32_t)(head - tail);
+}
+
+void ctl_publish_stats(ctl_obj_t self, const ctl_stats_t* stats) {
+    assert(self);
+    assert(stats);
+
+    const int64_t lock = self->stats_lock;
+    atomic_store_i64(&self->stats_lock, lock + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&self->stats, stats, sizeof(*stats));
+    atomic_store_i64(&self->stats_lock, lock + 2);
+}
+
+void ctl_publish_frame(ctl_obj_t self, const float* data, int32_t rows, int32_t cols, int64_t step) {
+    assert(self);
+    assert(data);
+
+    if (!atomic_load_i32(&self->subscriber_count) || (int64_t)rows * cols > self->frame_info.max_cells) {
+        return;
+    }
+
+    ctl_shm_header_t* const hdr = (ctl_shm_header_t*)self->shm;
+    const int64_t seq = self->latest_seq + 1;
+    ctl_frame_slot_t* const slot = _ctl_get_slot(self, seq);
+    const int64_t lock = slot->lock;
+    atomic_store_i64(&slot->lock, lock + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->seq = seq;
+    slot->step = step;
+    slot->rows = rows;
+    slot->cols = cols;
+    memcpy((uint8_t*)slot + CTL_FRAME_DATA_OFFSET, data, (size_t)rows * cols * sizeof(float));
+    atomic_store_i64(&slot->lock, lock + 2);
+    atomic_store_i64(&self->latest_seq, seq);
+    atomic_store_i64(&hdr->latest_seq, seq);
+
+    const uint64_t one = 1;
+    if (write(self->wake_fd, &one, sizeof(one)) < 0) {
+        // NOTE: Only fails if the server has not read the counter for 2^64 frames.
+    }
+}
+
+int32_t ctl_get_client_count(ctl_obj_t self) {
+    assert(self);
+    return atomic_load_i32(&self->client_count);
+}
+
+#else
+
+struct _ctl_obj_t {
+    int32_t unused;
+};
+
+ctl_obj_t ctl_create(const char* path, int32_t max_cells) {
+    UNUSED_PARAM(path);
+    UNUSED_PARAM(max_cells);
+    return NULL; // NOTE: Unix domain sockets, memfd and eventfd are Linux only here.
+}
+
+void ctl_destroy(ctl_obj_t* pself) {
+    if (pself && *pself) {
+        SAFE_FREE(*pself);
+    }
+}
+
+bool_t ctl_wait(ctl_obj_t self, uint32_t timeout_ms) {
+    UNUSED_PARAM(self);
+    UNUSED_PARAM(timeout_ms);
+    return FALSE;
+}
+
+int32_t ctl_drain(ctl_obj_t self, ctl_cmd_fn_t fn, void* ctx) {
+    UNUSED_PARAM(self);
+    UNUSED_PARAM(fn);
+    UNUSED_PARAM(ctx);
+    return 0;
+}
+
+void ctl_publish_stats(ctl_obj_t self, const ctl_stats_t* stats) {
+    UNUSED_PARAM(self);
+    UNUSED_PARAM(stats);
+}
+
+void ctl_publish_frame(ctl_obj_t self, const float* data, int32_t rows, int32_t cols, int64_t step) {
+    UNUSED_PARAM(self);
+    UNUSED_PARAM(data);
+    UNUSED_PARAM(rows);
+    UNUSED_PARAM(cols);
+    UNUSED_PARAM(step);
+}
+
+int32_t ctl_get_client_count(ctl_obj_t self) {
+    UNUSED_PARAM(self);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,113 @@
+﻿#pragma once
+#include "common.h"
+
+// Local control and telemetry server (Linux).
+// A background thread accepts clients on a Unix domain stream socket and speaks a compact binary
+// protocol: every message is a `ctl_msg_header_t` followed by `size` bytes of payload, native
+// endian (the peer runs on the same host).
+//
+//   CTL_MSG_INJECT       client  `ctl_cmd_t[n]`, queued as one batch, no reply
+//   CTL_MSG_GET_STATS    client  -> CTL_MSG_STATS `ctl_stats_t` as last published
+//   CTL_MSG_SUBSCRIBE    client  -> CTL_MSG_SUBSCRIBED `ctl_frame_info_t`, with the frame memory fd
+//                                   attached (SCM_RIGHTS), then a CTL_MSG_FRAME `ctl_frame_note_t`
+//                                   for every published frame
+//   CTL_MSG_UNSUBSCRIBE  client  stops the notes
+//
+// Commands travel from the server thread to the simulation thread through a lock-free
+// single-producer/single-consumer ring, a message being published with one store. The simulation
+// thread drains it with `ctl_drain()` before every step, so a command takes effect at the next step
+// boundary. Frames are not copied through the socket: `ctl_publish_frame()` writes the density into
+// a shared memory ring of `CTL_FRAME_SLOTS` slots, frame `seq` into slot `seq % CTL_FRAME_SLOTS`.
+// A slot is a `ctl_frame_slot_t` followed by the row-major density, its `lock` is odd while it is
+// written: a reader copies the frame and keeps it if `lock` was even and unchanged around the copy.
+// A note only wakes the client, a client that lags misses notes (and frames), never gets torn ones.
+// Malformed messages close the connection.
+
+#define CTL_PROTOCOL_VERSION 1
+#define CTL_SHM_MAGIC        0x4c544346u // "FCTL"
+#define CTL_QUEUE_SIZE       4096 // queued commands, a power of two
+#define CTL_FRAME_SLOTS      4
+#define CTL_MAX_CLIENTS      16
+#define CTL_MAX_BATCH        256 // commands per CTL_MSG_INJECT
+
+DECL_OBJECT(ctl_obj_t);
+
+typedef enum {
+    CTL_MSG_INJECT = 1,
+    CTL_MSG_GET_STATS,
+    CTL_MSG_STATS,
+    CTL_MSG_SUBSCRIBE,
+    CTL_MSG_SUBSCRIBED,
+    CTL_MSG_UNSUBSCRIBE,
+    CTL_MSG_FRAME,
+} ctl_msg_e;
+
+typedef enum {
+    CTL_CMD_ADD_DENSITY,    // x, y, v0: amount
+    CTL_CMD_ADD_FORCE,      // x, y, v0: fx, v1: fy
+    CTL_CMD_SET_DIFFUSION,  // v0: diffusion rate
+    CTL_CMD_SET_VISCOSITY,  // v0: viscosity
+    CTL_CMD_PAINT_OBSTACLE, // x, y, v0: radius, v1: 1 solid, 0 fluid
+    CTL_CMD_CLEAR_OBSTACLES,
+} ctl_cmd_e;
+
+typedef struct {
+    uint32_t size; // of the payload
+    uint32_t type; // `ctl_msg_e`
+} ctl_msg_header_t;
+
+typedef struct {
+    uint32_t type; // `ctl_cmd_e`
+    int32_t x, y; // cell of the simulation grid
+    float v0, v1;
+} ctl_cmd_t;
+
+typedef struct {
+    int64_t step;
+    int32_t rows, cols;
+    float diff, visc;
+    double frame_ms, step_ms; // of the last frame
+    double frame_p50_ms, frame_p99_ms; // of the last stats interval
+    int64_t cmd_count; // commands applied, filled in by the server
+    int64_t cmd_dropped_count; // commands dropped on a full queue
+    double cmd_latency_max_ms; // from receipt to the step boundary that applied it
+} ctl_stats_t;
+
+typedef struct {
+    uint64_t size; // bytes to map
+    uint32_t slot_count;
+    uint32_t slot_size; // bytes per slot, `ctl_frame_slot_t` included
+    uint32_t slot_offset; // of the first slot
+    uint32_t max_cells; // density floats per slot
+} ctl_frame_info_t;
+
+typedef struct {
+    uint32_t magic; // `CTL_SHM_MAGIC`
+    uint32_t version; // `CTL_PROTOCOL_VERSION`
+    volatile int64_t latest_seq; // newest complete frame, 0 before the first
+} ctl_shm_header_t;
+
+typedef struct {
+    volatile int64_t lock; // odd while the slot is written
+    int64_t seq; // from 1
+    int64_t step;
+    int32_t rows, cols;
+} ctl_frame_slot_t; // NOTE: The density follows at `CTL_FRAME_DATA_OFFSET` from the slot.
+
+#define CTL_FRAME_DATA_OFFSET 64
+
+typedef struct {
+    int64_t seq;
+    uint32_t slot;
+    uint32_t reserved;
+} ctl_frame_note_t;
+
+typedef void(*ctl_cmd_fn_t)(void* ctx, const ctl_cmd_t* cmd);
+
+ctl_obj_t ctl_create(const char* path, int32_t max_cells); // NOTE: Listens on `path`, replacing a stale socket file. `max_cells` bounds the published frames. NULL on failure or on other platforms.
+void ctl_destroy(ctl_obj_t*); // NOTE: Disconnects the clients and removes the socket file.
+bool_t ctl_wait(ctl_obj_t, uint32_t timeout_ms); // NOTE: Blocks until commands are queued or `timeout_ms` passes (UINT32_MAX for none). TRUE if commands are queued.
+int32_t ctl_drain(ctl_obj_t, ctl_cmd_fn_t fn, void* ctx); // NOTE: Calls `fn` for every queued command in order, on the calling (simulation) thread. Returns the count.
+void ctl_publish_stats(ctl_obj_t, const ctl_stats_t* stats);
+void ctl_publish_frame(ctl_obj_t, const float* data, int32_t rows, int32_t cols, int64_t step); // NOTE: Skipped without subscribers or above `max_cells`.
+int32_t ctl_get_client_count(ctl_obj_t);
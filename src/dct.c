@@ -0,0 +1,491 @@
+﻿#include "dct.h"
+#include <math.h>
+
+#define DCT_PI 3.14159265358979323846
+#define DCT_HALF (DCT_LANES / 2) // complex lanes, each carries two real lines
+#define DCT_MAX_RADIX 16 // FFT lengths with a larger prime factor go through Bluestein
+#define DCT_MAX_STAGES 32
+
+typedef struct {
+    int32_t size;
+    int32_t stage_count;
+    int32_t radices[DCT_MAX_STAGES];
+    float* twiddle_re; // e^(-2 pi i t / size), `size` entries
+    float* twiddle_im;
+} dct_fft_t;
+
+struct _dct_obj_t {
+    int32_t n;
+    dct_fft_t fft; // length `n`, or the Bluestein convolution length if `n` has a large prime factor
+    float* chirp_re; // e^(-pi i k^2 / n), Bluestein only
+    float* chirp_im;
+    float* chirp_fft_re; // FFT of the conjugate chirp filter, scaled by 1 / fft.size, Bluestein only
+    float* chirp_fft_im;
+    float* shift_re; // e^(-pi i k / (2n)), the DCT-II post-twiddle
+    float* shift_im;
+    float* line_re; // `n * DCT_HALF` interleaved complex lanes
+    float* line_im;
+    float* conv_re; // `fft.size * DCT_HALF`, Bluestein only
+    float* conv_im;
+    float* work_re; // `fft.size * DCT_HALF`, the other half of the FFT ping-pong
+    float* work_im;
+};
+
+// Splits `size` into FFT stages, radix 4 first, then 2 and odd primes up to `max_radix`.
+// Returns the number of stages, 0 if a larger prime factor remains.
+static int32_t _dct_factor(int32_t size, int32_t max_radix, int32_t* radices)
+{
+    int32_t count = 0;
+    while (size % 4 == 0 && count < DCT_MAX_STAGES) {
+        radices[count++] = 4;
+        size /= 4;
+    }
+    for (int32_t p = 2; p <= max_radix && size > 1 && count < DCT_MAX_STAGES; ++p) {
+        while (size % p == 0 && count < DCT_MAX_STAGES) {
+            radices[count++] = p;
+            size /= p;
+        }
+    }
+    return (size == 1) ? count : 0;
+}
+
+static bool_t _dct_fft_init(dct_fft_t* fft, int32_t size)
+{
+    fft->size = size;
+    fft->stage_count = _dct_factor(size, DCT_MAX_RADIX, fft->radices);
+    fft->twiddle_re = (float*)malloc((size_t)size * sizeof(float));
+    fft->twiddle_im = (float*)malloc((size_t)size * sizeof(float));
+    if (!fft->twiddle_re || !fft->twiddle_im || (size > 1 && !fft->stage_count)) {
+        return FALSE;
+    }
+
+    for (int32_t t = 0; t < size; ++t) {
+        const double phi = -2.0 * DCT_PI * t / size;
+        fft->twiddle_re[t] = (float)cos(phi);
+        fft->twiddle_im[t] = (float)sin(phi);
+    }
+    return TRUE;
+}
+
+static void _dct_fft_free(dct_fft_t* fft)
+{
+    SAFE_FREE(fft->twiddle_re);
+    SAFE_FREE(fft->twiddle_im);
+}
+
+// Butterflies on one group of `DCT_HALF` complex lanes. `restrict` lets the lane loops vectorize
+// without runtime overlap checks, the stages never read and write the same buffer.
+
+static inline void _dct_twiddle(
+    const float* restrict s_re,
+    const float* restrict s_im,
+    const float w_re,
+    const float w_im,
+    float* restrict d_re/* out */,
+    float* restrict d_im/* out */)
+{
+    for (int32_t l = 0; l < DCT_HALF; ++l) {
+        d_re[l] = s_re[l] * w_re - s_im[l] * w_im;
+        d_im[l] = s_re[l] * w_im + s_im[l] * w_re;
+    }
+}
+
+static inline void _dct_twiddle_acc(
+    const float* restrict s_re,
+    const float* restrict s_im,
+    const float w_re,
+    const float w_im,
+    float* restrict d_re/* inout */,
+    float* restrict d_im/* inout */)
+{
+    for (int32_t l = 0; l < DCT_HALF; ++l) {
+        d_re[l] += s_re[l] * w_re - s_im[l] * w_im;
+        d_im[l] += s_re[l] * w_im + s_im[l] * w_re;
+    }
+}
+
+static inline void _dct_bfly2(
+    const float* restrict s0_re, const float* restrict s0_im,
+    const float* restrict s1_re, const float* restrict s1_im,
+    const float w1_re, const float w1_im,
+    float* restrict d0_re, float* restrict d0_im,
+    float* restrict d1_re, float* restrict d1_im)
+{
+    for (int32_t l = 0; l < DCT_HALF; ++l) {
+        const float
+            t1_re = s1_re[l] * w1_re - s1_im[l] * w1_im,
+            t1_im = s1_re[l] * w1_im + s1_im[l] * w1_re;
+        d0_re[l] = s0_re[l] + t1_re;
+        d0_im[l] = s0_im[l] + t1_im;
+        d1_re[l] = s0_re[l] - t1_re;
+        d1_im[l] = s0_im[l] - t1_im;
+    }
+}
+
+static inline void _dct_bfly4(
+    const float* restrict s0_re, const float* restrict s0_im,
+    const float* restrict s1_re, const float* restrict s1_im,
+    const float* restrict s2_re, const float* restrict s2_im,
+    const float* restrict s3_re, const float* restrict s3_im,
+    const float* w_re, const float* w_im, // w[1..3]
+    float* restrict d0_re, float* restrict d0_im,
+    float* restrict d1_re, float* restrict d1_im,
+    float* restrict d2_re, float* restrict d2_im,
+    float* restrict d3_re, float* restrict d3_im)
+{
+    const float
+        w1_re = w_re[1], w1_im = w_im[1],
+        w2_re = w_re[2], w2_im = w_im[2],
+        w3_re = w_re[3], w3_im = w_im[3];
+    for (int32_t l = 0; l < DCT_HALF; ++l) {
+        const float
+            t1_re = s1_re[l] * w1_re - s1_im[l] * w1_im, t1_im = s1_re[l] * w1_im + s1_im[l] * w1_re,
+            t2_re = s2_re[l] * w2_re - s2_im[l] * w2_im, t2_im = s2_re[l] * w2_im + s2_im[l] * w2_re,
+            t3_re = s3_re[l] * w3_re - s3_im[l] * w3_im, t3_im = s3_re[l] * w3_im + s3_im[l] * w3_re,
+            a0_re = s0_re[l] + t2_re, a0_im = s0_im[l] + t2_im,
+            a1_re = s0_re[l] - t2_re, a1_im = s0_im[l] - t2_im,
+            a2_re = t1_re + t3_re, a2_im = t1_im + t3_im,
+            a3_re = t1_im - t3_im, a3_im = t3_re - t1_re; // -i * (t1 - t3)
+        d0_re[l] = a0_re + a2_re;
+        d0_im[l] = a0_im + a2_im;
+        d1_re[l] = a1_re + a3_re;
+        d1_im[l] = a1_im + a3_im;
+        d2_re[l] = a0_re - a2_re;
+        d2_im[l] = a0_im - a2_im;
+        d3_re[l] = a1_re - a3_re;
+        d3_im[l] = a1_im - a3_im;
+    }
+}
+
+// One Stockham stage of radix `p` on interleaved lanes, `Ns` is the length of the sub-transforms
+// done so far. Input `j = b * Ns + k` goes to output `b * Ns * p + k`, so the result is in natural
+// order after the last stage, no bit reversal needed.
+static void _dct_fft_stage(
+    const dct_fft_t* fft,
+    const int32_t p,
+    const int32_t Ns,
+    const float* x_re,
+    const float* x_im,
+    float* y_re/* out */,
+    float* y_im/* out */)
+{
+    const int32_t M = fft->size, m = M / p, tw_step = M / (Ns * p), root_step = M / p;
+    const int32_t is = m * DCT_HALF, os = Ns * DCT_HALF; // strides between the inputs / outputs of a butterfly
+    float t_re[DCT_MAX_RADIX][DCT_HALF], t_im[DCT_MAX_RADIX][DCT_HALF];
+
+    for (int32_t k = 0; k < Ns; ++k) {
+        float w_re[DCT_MAX_RADIX], w_im[DCT_MAX_RADIX];
+        for (int32_t r = 0; r < p; ++r) {
+            w_re[r] = fft->twiddle_re[r * k * tw_step]; // NOTE: < M, as k < Ns and r < p
+            w_im[r] = fft->twiddle_im[r * k * tw_step];
+        }
+
+        for (int32_t j = k; j < m; j += Ns) {
+            const float* const a_re = x_re + j * DCT_HALF, * const a_im = x_im + j * DCT_HALF;
+            float* const b_re = y_re + ((j - k) * p + k) * DCT_HALF, * const b_im = y_im + ((j - k) * p + k) * DCT_HALF;
+
+            if (p == 2) {
+                _dct_bfly2(
+                    a_re, a_im, a_re + is, a_im + is,
+                    w_re[1], w_im[1],
+                    b_re, b_im, b_re + os, b_im + os
+                );
+            } else if (p == 4) {
+                _dct_bfly4(
+                    a_re, a_im, a_re + is, a_im + is, a_re + 2 * is, a_im + 2 * is, a_re + 3 * is, a_im + 3 * is,
+                    w_re, w_im,
+                    b_re, b_im, b_re + os, b_im + os, b_re + 2 * os, b_im + 2 * os, b_re + 3 * os, b_im + 3 * os
+                );
+            } else {
+                for (int32_t r = 0; r < p; ++r) {
+                    _dct_twiddle(a_re + r * is, a_im + r * is, w_re[r], w_im[r], t_re[r], t_im[r]);
+                }
+                // Plain DFT of length p, the p-th roots of unity are every `root_step`-th twiddle.
+                for (int32_t q = 0; q < p; ++q) {
+                    float* const bq_re = b_re + q * os, * const bq_im = b_im + q * os;
+                    memcpy(bq_re, t_re[0], sizeof(t_re[0]));
+                    memcpy(bq_im, t_im[0], sizeof(t_im[0]));
+                    for (int32_t r = 1; r < p; ++r) {
+                        const int32_t t = ((q * r) % p) * root_step;
+                        _dct_twiddle_acc(t_re[r], t_im[r], fft->twiddle_re[t], fft->twiddle_im[t], bq_re, bq_im);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// In-place forward FFT of `fft->size` interleaved lanes, unnormalized. `tmp` is clobbered.
+static void _dct_fft(
+    const dct_fft_t* fft,
+    float* re/* inout */,
+    float* im/* inout */,
+    float* tmp_re,
+    float* tmp_im)
+{
+    float* x_re = re, * x_im = im, * y_re = tmp_re, * y_im = tmp_im;
+    int32_t Ns = 1;
+    for (int32_t s = 0; s < fft->stage_count; ++s) {
+        const int32_t p = fft->radices[s];
+        _dct_fft_stage(fft, p, Ns, x_re, x_im, y_re, y_im);
+        Ns *= p;
+
+        float* const t_re = x_re, * const t_im = x_im;
+        x_re = y_re;
+        x_im = y_im;
+        y_re = t_re;
+        y_im = t_im;
+    }
+
+    if (x_re != re) {
+        memcpy(re, x_re, (size_t)fft->size * DCT_HALF * sizeof(float));
+        memcpy(im, x_im, (size_t)fft->size * DCT_HALF * sizeof(float));
+    }
+}
+
+// In-place forward DFT of length `n` of `line_re/im`, unnormalized.
+static void _dct_dft(dct_obj_t self)
+{
+    float* const re = self->line_re, * const im = self->line_im;
+    if (!self->chirp_re) {
+        _dct_fft(&self->fft, re, im, self->work_re, self->work_im);
+        return;
+    }
+
+    // Bluestein: X[k] = c[k] * sum_j (v[j] * c[j]) * conj(c[k - j]), with c[k] = e^(-pi i k^2 / n),
+    // evaluated as a circular convolution of length `fft.size`. The inverse FFT of the convolution
+    // is a forward one between two conjugations.
+    const int32_t n = self->n, M = self->fft.size;
+    float* const w_re = self->conv_re, * const w_im = self->conv_im;
+    for (int32_t k = 0; k < n; ++k) {
+        const float c_re = self->chirp_re[k], c_im = self->chirp_im[k];
+        for (int32_t l = 0; l < DCT_HALF; ++l) {
+            const int32_t o = k * DCT_HALF + l;
+            w_re[o] = re[o] * c_re - im[o] * c_im;
+            w_im[o] = re[o] * c_im + im[o] * c_re;
+        }
+    }
+    memset(w_re + n * DCT_HALF, 0, (size_t)(M - n) * DCT_HALF * sizeof(float));
+    memset(w_im + n * DCT_HALF, 0, (size_t)(M - n) * DCT_HALF * sizeof(float));
+
+    _dct_fft(&self->fft, w_re, w_im, self->work_re, self->work_im);
+    for (int32_t k = 0; k < M; ++k) {
+        const float c_re = self->chirp_fft_re[k], c_im = self->chirp_fft_im[k];
+        for (int32_t l = 0; l < DCT_HALF; ++l) {
+            const int32_t o = k * DCT_HALF + l;
+            const float t_re = w_re[o] * c_re - w_im[o] * c_im;
+            w_im[o] = -(w_re[o] * c_im + w_im[o] * c_re);
+            w_re[o] = t_re;
+        }
+    }
+    _dct_fft(&self->fft, w_re, w_im, self->work_re, self->work_im);
+
+    for (int32_t k = 0; k < n; ++k) {
+        const float c_re = self->chirp_re[k], c_im = self->chirp_im[k];
+        for (int32_t l = 0; l < DCT_HALF; ++l) {
+            const int32_t o = k * DCT_HALF + l;
+            re[o] = w_re[o] * c_re + w_im[o] * c_im;
+            im[o] = w_re[o] * c_im - w_im[o] * c_re;
+        }
+    }
+}
+
+dct_obj_t dct_create(int32_t n) {
+    if (n <= 0) {
+        return NULL;
+    }
+
+    dct_obj_t newobj = (dct_obj_t)calloc(1, sizeof(struct _dct_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    // NOTE: The Bluestein length only needs to be >= 2n - 1, the first one made of radices 2, 3 and 5 is taken.
+    int32_t radices[DCT_MAX_STAGES];
+    const bool_t is_direct = n == 1 || _dct_factor(n, DCT_MAX_RADIX, radices) > 0;
+    int32_t M = n;
+    if (!is_direct) {
+        M = 2 * n - 1;
+        while (!_dct_factor(M, 5, radices)) {
+            ++M;
+        }
+    }
+
+    newobj->n = n;
+    newobj->shift_re = (float*)malloc((size_t)n * sizeof(float));
+    newobj->shift_im = (float*)malloc((size_t)n * sizeof(float));
+    newobj->line_re = (float*)malloc((size_t)n * DCT_HALF * sizeof(float));
+    newobj->line_im = (float*)malloc((size_t)n * DCT_HALF * sizeof(float));
+    newobj->work_re = (float*)malloc((size_t)M * DCT_HALF * sizeof(float));
+    newobj->work_im = (float*)malloc((size_t)M * DCT_HALF * sizeof(float));
+    if (
+        !_dct_fft_init(&newobj->fft, M) ||
+        !newobj->shift_re ||
+        !newobj->shift_im ||
+        !newobj->line_re ||
+        !newobj->line_im ||
+        !newobj->work_re ||
+        !newobj->work_im
+        )
+    {
+        dct_destroy(&newobj);
+        return NULL;
+    }
+
+    for (int32_t k = 0; k < n; ++k) {
+        const double phi = -DCT_PI * k / (2.0 * n);
+        newobj->shift_re[k] = (float)cos(phi);
+        newobj->shift_im[k] = (float)sin(phi);
+    }
+
+    if (!is_direct) {
+        newobj->chirp_re = (float*)malloc((size_t)n * sizeof(float));
+        newobj->chirp_im = (float*)malloc((size_t)n * sizeof(float));
+        newobj->chirp_fft_re = (float*)malloc((size_t)M * sizeof(float));
+        newobj->chirp_fft_im = (float*)malloc((size_t)M * sizeof(float));
+        newobj->conv_re = (float*)calloc((size_t)M * DCT_HALF, sizeof(float));
+        newobj->conv_im = (float*)calloc((size_t)M * DCT_HALF, sizeof(float));
+        if (
+            !newobj->chirp_re ||
+            !newobj->chirp_im ||
+            !newobj->chirp_fft_re ||
+            !newobj->chirp_fft_im ||
+            !newobj->conv_re ||
+            !newobj->conv_im
+            )
+        {
+            dct_destroy(&newobj);
+            return NULL;
+        }
+
+        // NOTE: The filter is transformed with the same lane-interleaved FFT, in lane 0.
+        float* const f_re = newobj->conv_re, * const f_im = newobj->conv_im;
+        for (int32_t k = 0; k < n; ++k) {
+            // NOTE: k^2 is reduced mod 2n first, the phase is periodic in it and stays accurate for large `n`.
+            const int64_t k2 = ((int64_t)k * k) % (2 * (int64_t)n);
+            const double phi = -DCT_PI * (double)k2 / n;
+            newobj->chirp_re[k] = (float)cos(phi);
+            newobj->chirp_im[k] = (float)sin(phi);
+
+            f_re[k * DCT_HALF] = newobj->chirp_re[k];
+            f_im[k * DCT_HALF] = -newobj->chirp_im[k];
+            if (k) {
+                f_re[(M - k) * DCT_HALF] = newobj->chirp_re[k];
+                f_im[(M - k) * DCT_HALF] = -newobj->chirp_im[k];
+            }
+        }
+        _dct_fft(&newobj->fft, f_re, f_im, newobj->work_re, newobj->work_im);
+
+        const float scale = 1.0f / (float)M; // the normalization of the inverse FFT, folded in
+        for (int32_t k = 0; k < M; ++k) {
+            newobj->chirp_fft_re[k] = f_re[k * DCT_HALF] * scale;
+            newobj->chirp_fft_im[k] = f_im[k * DCT_HALF] * scale;
+        }
+    }
+
+    return newobj;
+}
+
+void dct_destroy(dct_obj_t* pself) {
+    if (pself && *pself) {
+        _dct_fft_free(&(*pself)->fft);
+        SAFE_FREE((*pself)->chirp_re);
+        SAFE_FREE((*pself)->chirp_im);
+        SAFE_FREE((*pself)->chirp_fft_re);
+        SAFE_FREE((*pself)->chirp_fft_im);
+        SAFE_FREE((*pself)->shift_re);
+        SAFE_FREE((*pself)->shift_im);
+        SAFE_FREE((*pself)->line_re);
+        SAFE_FREE((*pself)->line_im);
+        SAFE_FREE((*pself)->conv_re);
+        SAFE_FREE((*pself)->conv_im);
+        SAFE_FREE((*pself)->work_re);
+        SAFE_FREE((*pself)->work_im);
+        SAFE_FREE(*pself);
+    }
+}
+
+int32_t dct_get_size(dct_obj_t self) {
+    assert(self);
+    return self->n;
+}
+
+void dct_forward(dct_obj_t self, float* x/* inout */, bool_t odd) {
+    assert(self);
+    assert(x);
+
+    // Makhoul: even samples ascending then odd samples descending, one complex DFT of length `n`,
+    // and X[k] = Re(e^(-pi i k / (2n)) * V[k]). Line `l` goes to the real part of complex lane `l`,
+    // line `l + DCT_HALF` to the imaginary part, and the two spectra are split by symmetry.
+    const int32_t n = self->n;
+    float* const re = self->line_re, * const im = self->line_im;
+    for (int32_t j = 0; j < n; ++j) {
+        const float s = (odd && (j & 1)) ? -1.0f : 1.0f;
+        const int32_t k = (j & 1) ? n - 1 - (j >> 1) : (j >> 1);
+        const float* const src = x + j * DCT_LANES;
+        for (int32_t l = 0; l < DCT_HALF; ++l) {
+            re[k * DCT_HALF + l] = s * src[l];
+            im[k * DCT_HALF + l] = s * src[DCT_HALF + l];
+        }
+    }
+
+    _dct_dft(self);
+
+    for (int32_t k = 0; k < n; ++k) {
+        // A = (V[k] + conj(V[n - k])) / 2 and B = (V[k] - conj(V[n - k])) / 2i
+        const int32_t nk = k ? n - k : 0;
+        const float w_re = 0.5f * self->shift_re[k], w_im = 0.5f * self->shift_im[k];
+        const float* const p_re = re + k * DCT_HALF, * const p_im = im + k * DCT_HALF;
+        const float* const q_re = re + nk * DCT_HALF, * const q_im = im + nk * DCT_HALF;
+        float* const dst = x + k * DCT_LANES;
+        for (int32_t l = 0; l < DCT_HALF; ++l) {
+            const float
+                a_re = p_re[l] + q_re[l],
+                a_im = p_im[l] - q_im[l],
+                b_re = p_im[l] + q_im[l],
+                b_im = q_re[l] - p_re[l];
+            dst[l] = a_re * w_re - a_im * w_im;
+            dst[DCT_HALF + l] = b_re * w_re - b_im * w_im;
+        }
+    }
+}
+
+void dct_inverse(dct_obj_t self, float* x/* inout */, bool_t odd) {
+    assert(self);
+    assert(x);
+
+    // Undo the post-twiddle of each line, V[k] = (X[k] - i X[n - k]) * e^(pi i k / (2n)) with X[n] = 0,
+    // pack the pair as Va + i Vb, then v = IDFT(V), computed as conj(DFT(conj(V))) / n:
+    // both lines are real, so line `l` comes out in the real part and line `l + DCT_HALF` in the imaginary one.
+    const int32_t n = self->n;
+    float* const re = self->line_re, * const im = self->line_im;
+    for (int32_t k = 0; k < n; ++k) {
+        const float w_re = self->shift_re[k], w_im = self->shift_im[k];
+        const float* const p = x + k * DCT_LANES;
+        const float* const q = k ? x + (n - k) * DCT_LANES : NULL;
+        for (int32_t l = 0; l < DCT_HALF; ++l) {
+            const float
+                pa = p[l], pb = p[DCT_HALF + l],
+                qa = q ? q[l] : 0.0f, qb = q ? q[DCT_HALF + l] : 0.0f,
+                a_re = pa * w_re - qa * w_im,
+                a_im = -(pa * w_im + qa * w_re),
+                b_re = pb * w_re - qb * w_im,
+                b_im = -(pb * w_im + qb * w_re);
+            re[k * DCT_HALF + l] = a_re - b_im;
+            im[k * DCT_HALF + l] = -(a_im + b_re);
+        }
+    }
+
+    _dct_dft(self);
+
+    const float scale = 1.0f / (float)n;
+    for (int32_t j = 0; j < n; ++j) {
+        const float s = (odd && (j & 1)) ? -scale : scale;
+        const int32_t k = (j & 1) ? n - 1 - (j >> 1) : (j >> 1);
+        float* const dst = x + j * DCT_LANES;
+        for (int32_t l = 0; l < DCT_HALF; ++l) {
+            dst[l] = s * re[k * DCT_HALF + l];
+            dst[DCT_HALF + l] = -s * im[k * DCT_HALF + l];
+        }
+    }
+}
@@ -0,0 +1,26 @@
+﻿#pragma once
+#include "common.h"
+
+// Real-to-real transforms of a fixed length `n`, computed through a complex FFT of length `n`
+// (mixed radix if the prime factors of `n` are small, Bluestein's chirp-z otherwise). Twiddles are
+// precomputed by `dct_create()`, the object also owns the work buffers, so it must not be shared
+// between threads.
+//
+// Lines are transformed `DCT_LANES` at a time, interleaved: element `j` of line `l` is at
+// `x[j * DCT_LANES + l]`. Every butterfly then runs across the lanes, which the compiler
+// vectorizes, and pairs of real lines share one complex FFT.
+//
+// `dct_forward()` is the unnormalized DCT-II, X[k] = sum_j x[j] * cos(pi * k * (2j + 1) / (2n)),
+// and `dct_inverse()` is its exact inverse. With `odd` set, the input of the forward transform is
+// multiplied by (-1)^j first (and the output of the inverse afterwards), which turns the DCT-II into
+// a DST-II with its spectrum reversed: the basis then has an odd reflection at both ends.
+
+#define DCT_LANES 32
+
+DECL_OBJECT(dct_obj_t);
+
+dct_obj_t dct_create(int32_t n);
+void dct_destroy(dct_obj_t*);
+int32_t dct_get_size(dct_obj_t);
+void dct_forward(dct_obj_t, float* x/* inout */, bool_t odd); // NOTE: `x` holds `n * DCT_LANES` interleaved floats.
+void dct_inverse(dct_obj_t, float* x/* inout */, bool_t odd);
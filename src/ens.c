@@ -0,0 +1,186 @@
+﻿#include "ens.h"
+#include "pool.h"
+#include "perf.h"
+#include "misc.h"
+#include <math.h>
+
+typedef struct {
+    sim_scratch_obj_t scratch;
+    perf_obj_t perf;
+} ens_worker_t;
+
+struct _ens_obj_t {
+    int32_t member_count;
+    sim_obj_t* members;
+    ens_metrics_t* metrics;
+
+    pool_obj_t pool;
+    ens_worker_t* workers;
+
+    ens_inject_fn_t cb_inject;
+    void* cb_inject_ctx;
+    int32_t curr_step_count;
+};
+
+static void _ens_update_metrics(sim_obj_t sim, ens_metrics_t* metrics)
+{
+    // NOTE: Over the fluid cells, the border and solid cells only hold boundary values. Summed in double,
+    //       a float sum over a large box loses the small contributions.
+    const int32_t rows = sim_get_rows(sim), cols = sim_get_cols(sim);
+    const float* const d = sim_get_field_data(sim, SIM_FIELD_DENSITY);
+    const float* const vx = sim_get_field_data(sim, SIM_FIELD_VX);
+    const float* const vy = sim_get_field_data(sim, SIM_FIELD_VY);
+    const uint8_t* const solid = sim_has_obstacles(sim) ? sim_get_obstacles(sim) : NULL;
+
+    double mass = 0.0, energy = 0.0;
+    float max_v2 = 0.0f;
+    for (int32_t j = 1; j < rows-1; ++j) {
+        for (int32_t i = j * cols + 1; i < (j + 1) * cols - 1; ++i) {
+            if (solid && solid[i]) {
+                continue;
+            }
+            const float v2 = vx[i] * vx[i] + vy[i] * vy[i];
+            mass += d[i];
+            energy += v2;
+            max_v2 = max(max_v2, v2);
+        }
+    }
+
+    metrics->mass = mass;
+    metrics->kinetic_energy = 0.5 * energy;
+    metrics->max_velocity = sqrtf(max_v2);
+}
+
+static void _ens_step_member(void* ctx, int32_t worker_idx, int32_t member_idx)
+{
+    const ens_obj_t self = (ens_obj_t)ctx;
+    const ens_worker_t* const worker = &self->workers[worker_idx];
+    const sim_obj_t sim = self->members[member_idx];
+    ens_metrics_t* const metrics = &self->metrics[member_idx];
+
+    perf_begin(worker->perf);
+    for (int32_t k = 0; k < self->curr_step_count; ++k) {
+        if (self->cb_inject) {
+            self->cb_inject(self->cb_inject_ctx, member_idx, sim, metrics->step_count);
+        }
+        sim_update_with_scratch(sim, worker->scratch);
+        ++metrics->step_count;
+    }
+    perf_end(worker->perf);
+
+    metrics->step_time_ms += perf_get_delta_ms(worker->perf);
+    _ens_update_metrics(sim, metrics);
+}
+
+ens_obj_t ens_create(int32_t member_count, int32_t box_size, int32_t worker_count) {
+    if (member_count <= 0) {
+        return NULL;
+    }
+
+    ens_obj_t newobj = (ens_obj_t)calloc(1, sizeof(struct _ens_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->member_count = member_count;
+    newobj->members = (sim_obj_t*)calloc(member_count, sizeof(sim_obj_t));
+    newobj->metrics = (ens_metrics_t*)calloc(member_count, sizeof(ens_metrics_t));
+    if (!newobj->members || !newobj->metrics) {
+        ens_destroy(&newobj);
+        return NULL;
+    }
+
+    for (int32_t i = 0; i < member_count; ++i) {
+        newobj->members[i] = sim_create_shared(box_size);
+        if (!newobj->members[i]) {
+            ens_destroy(&newobj);
+            return NULL;
+        }
+    }
+
+    newobj->pool = pool_create(worker_count);
+    if (!newobj->pool) {
+        ens_destroy(&newobj);
+        return NULL;
+    }
+
+    const int32_t pool_worker_count = pool_get_worker_count(newobj->pool);
+    newobj->workers = (ens_worker_t*)calloc(pool_worker_count, sizeof(ens_worker_t));
+    if (!newobj->workers) {
+        ens_destroy(&newobj);
+        return NULL;
+    }
+
+    for (int32_t i = 0; i < pool_worker_count; ++i) {
+        newobj->workers[i].scratch = sim_scratch_create(box_size);
+        newobj->workers[i].perf = perf_create();
+        if (!newobj->workers[i].scratch || !newobj->workers[i].perf) {
+            ens_destroy(&newobj);
+            return NULL;
+        }
+    }
+
+    return newobj;
+}
+
+void ens_destroy(ens_obj_t* pself) {
+    if (pself && *pself) {
+        const ens_obj_t self = *pself;
+        if (self->workers) {
+            for (int32_t i = 0; i < pool_get_worker_count(self->pool); ++i) {
+                perf_destroy(&self->workers[i].perf);
+                sim_scratch_destroy(&self->workers[i].scratch);
+            }
+        }
+        pool_destroy(&self->pool);
+        if (self->members) {
+            for (int32_t i = 0; i < self->member_count; ++i) {
+                sim_destroy(&self->members[i]);
+            }
+        }
+        SAFE_FREE(self->workers);
+        SAFE_FREE(self->metrics);
+        SAFE_FREE(self->members);
+        SAFE_FREE(*pself);
+    }
+}
+
+int32_t ens_get_member_count(ens_obj_t self) {
+    assert(self);
+    return self->member_count;
+}
+
+int32_t ens_get_worker_count(ens_obj_t self) {
+    assert(self);
+    return pool_get_worker_count(self->pool);
+}
+
+sim_obj_t ens_get_member(ens_obj_t self, int32_t member_idx) {
+    assert(self);
+    assert(0 <= member_idx && member_idx < self->member_count);
+    return self->members[member_idx];
+}
+
+void ens_set_inject_cb(ens_obj_t self, ens_inject_fn_t cb, void* ctx) {
+    assert(self);
+    self->cb_inject = cb;
+    self->cb_inject_ctx = ctx;
+}
+
+void ens_step(ens_obj_t self, int32_t step_count) {
+    assert(self);
+    if (step_count <= 0) {
+        return;
+    }
+
+    // NOTE: One task per member runs all of its steps back to back, so a small grid stays
+    //       in the worker's cache for the whole call and members never wait on each other.
+    self->curr_step_count = step_count;
+    pool_run(self->pool, _ens_step_member, self, self->member_count);
+}
+
+const ens_metrics_t* ens_get_metrics(ens_obj_t self, int32_t member_idx) {
+    assert(self);
+    assert(0 <= member_idx && member_idx < self->member_count);
+    return &self->metrics[member_idx];
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+﻿#pragma once
+#include "common.h"
+#include "sim.h"
+
+// Ensemble of independent simulations stepped together on a worker pool.
+// Members do not own solver scratch, each worker lends its own to whichever member it steps.
+
+DECL_OBJECT(ens_obj_t);
+
+typedef struct {
+    double mass; // total density over the fluid cells
+    double kinetic_energy; // 0.5 * sum(vx^2 + vy^2) over the fluid cells
+    float max_velocity; // max |v| over the fluid cells
+    int64_t step_count;
+    double step_time_ms; // accumulated time spent stepping this member
+} ens_metrics_t;
+
+typedef void(*ens_inject_fn_t)(void* ctx, int32_t member_idx, sim_obj_t sim, int64_t step);
+
+ens_obj_t ens_create(int32_t member_count, int32_t box_size, int32_t worker_count); // NOTE: `worker_count` 0 uses the number of cpus.
+void ens_destroy(ens_obj_t*);
+int32_t ens_get_member_count(ens_obj_t);
+int32_t ens_get_worker_count(ens_obj_t);
+sim_obj_t ens_get_member(ens_obj_t, int32_t member_idx);
+void ens_set_inject_cb(ens_obj_t, ens_inject_fn_t cb, void* ctx); // NOTE: Called on a worker thread before every step of a member.
+void ens_step(ens_obj_t, int32_t step_count);
+const ens_metrics_t* ens_get_metrics(ens_obj_t, int32_t member_idx);
\ No newline at end of file
@@ -0,0 +1,143 @@
+﻿#include "gov.h"
+#include "misc.h"
+
+struct _gov_obj_t {
+    gov_config_t config;
+    gov_state_t state;
+    int32_t hold; // frames since the last change
+    bool_t fl_primed; // averages hold at least one frame
+    bool_t fl_iter_fixed; // the sweeps are not governed
+};
+
+gov_obj_t gov_create(const gov_config_t* config, int32_t solve_iter_size, float render_scale) {
+    assert(config);
+    assert(config->target_ms > 0.0);
+    assert(1 <= config->min_solve_iter_size && config->min_solve_iter_size <= config->max_solve_iter_size);
+    assert(0.0f < config->min_render_scale && config->min_render_scale <= config->max_render_scale && config->max_render_scale <= 1.0f);
+
+    gov_obj_t newobj = (gov_obj_t)calloc(1, sizeof(struct _gov_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->config = *config;
+    newobj->state.solve_iter_size = clamp(solve_iter_size, config->min_solve_iter_size, config->max_solve_iter_size);
+    newobj->state.render_scale = clamp(render_scale, config->min_render_scale, config->max_render_scale);
+    return newobj;
+}
+
+void gov_destroy(gov_obj_t* pself) {
+    if (pself && *pself) {
+        SAFE_FREE(*pself);
+    }
+}
+
+const gov_config_t* gov_get_config(gov_obj_t self) {
+    assert(self);
+    return &self->config;
+}
+
+const gov_state_t* gov_get_state(gov_obj_t self) {
+    assert(self);
+    return &self->state;
+}
+
+void gov_set_solve_iter_size(gov_obj_t self, int32_t solve_iter_size, bool_t fixed) {
+    assert(self);
+    self->fl_iter_fixed = fixed;
+    self->state.solve_iter_size = fixed ? solve_iter_size : clamp(solve_iter_size, self->config.min_solve_iter_size, self->config.max_solve_iter_size);
+}
+
+static bool_t _gov_degrade(gov_obj_t self)
+{
+    const gov_config_t* const cfg = &self->config;
+    gov_state_t* const st = &self->state;
+
+    // NOTE: Cut the larger of the two costs first, the other one if it is already at its bound.
+    const bool_t
+        can_iter = !self->fl_iter_fixed && st->solve_iter_size > cfg->min_solve_iter_size,
+        can_scale = st->render_scale > cfg->min_render_scale;
+    if (can_scale && (!can_iter || st->render_ms >= st->step_ms)) {
+        st->render_scale = max(st->render_scale * GOV_SCALE_FACTOR, cfg->min_render_scale);
+        st->render_ms *= GOV_SCALE_FACTOR * GOV_SCALE_FACTOR;
+        return TRUE;
+    }
+    if (can_iter) {
+        const int32_t iter_size = max(st->solve_iter_size - max(st->solve_iter_size / 4, 1), cfg->min_solve_iter_size);
+        st->step_ms *= (double)iter_size / (double)st->solve_iter_size;
+        st->solve_iter_size = iter_size;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static bool_t _gov_upgrade(gov_obj_t self)
+{
+    const gov_config_t* const cfg = &self->config;
+    gov_state_t* const st = &self->state;
+
+    // NOTE: The step and render costs are predicted as if they were all proportional to their knob,
+    //       an overestimate, so an upgrade that fits is unlikely to be taken back.
+    const double budget_ms = GOV_HIGH_FRACTION * cfg->target_ms;
+    const double other_ms = max(st->frame_ms - st->step_ms - st->render_ms, 0.0);
+
+    if (!self->fl_iter_fixed && st->solve_iter_size < cfg->max_solve_iter_size) {
+        const int32_t iter_size = st->solve_iter_size + 1;
+        const double step_ms = st->step_ms * (double)iter_size / (double)st->solve_iter_size;
+        if (other_ms + step_ms + st->render_ms < budget_ms) {
+            st->step_ms = step_ms;
+            st->frame_ms = other_ms + step_ms + st->render_ms;
+            st->solve_iter_size = iter_size;
+            return TRUE;
+        }
+    }
+
+    if (st->render_scale < cfg->max_render_scale) {
+        const float render_scale = min(st->render_scale / GOV_SCALE_FACTOR, cfg->max_render_scale);
+        const double ratio = (double)(render_scale / st->render_scale);
+        const double render_ms = st->render_ms * ratio * ratio;
+        if (other_ms + st->step_ms + render_ms < budget_ms) {
+            st->render_ms = render_ms;
+            st->frame_ms = other_ms + st->step_ms + render_ms;
+            st->render_scale = render_scale;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+bool_t gov_update(gov_obj_t self, double frame_ms, double step_ms, double render_ms) {
+    assert(self);
+
+    gov_state_t* const st = &self->state;
+    if (!self->fl_primed) {
+        st->frame_ms = frame_ms;
+        st->step_ms = step_ms;
+        st->render_ms = render_ms;
+        self->fl_primed = TRUE;
+    } else {
+        st->frame_ms = GOV_SMOOTHING * st->frame_ms + (1.0 - GOV_SMOOTHING) * frame_ms;
+        st->step_ms = GOV_SMOOTHING * st->step_ms + (1.0 - GOV_SMOOTHING) * step_ms;
+        st->render_ms = GOV_SMOOTHING * st->render_ms + (1.0 - GOV_SMOOTHING) * render_ms;
+    }
+    ++self->hold;
+
+    bool_t fl_changed = FALSE;
+    if (st->frame_ms > GOV_HIGH_FRACTION * self->config.target_ms) {
+        const double before_ms = st->step_ms + st->render_ms;
+        if (self->hold >= GOV_DEGRADE_HOLD && _gov_degrade(self)) {
+            // NOTE: The averages are moved to the predicted costs, so the old frames do not trigger another cut.
+            st->frame_ms = max(st->frame_ms - (before_ms - st->step_ms - st->render_ms), 0.0);
+            ++st->degrade_count;
+            fl_changed = TRUE;
+        }
+    } else if (self->hold >= GOV_UPGRADE_HOLD && _gov_upgrade(self)) {
+        ++st->upgrade_count;
+        fl_changed = TRUE;
+    }
+
+    if (fl_changed) {
+        self->hold = 0;
+    }
+    return fl_changed;
+}
@@ -0,0 +1,38 @@
+﻿#pragma once
+#include "common.h"
+
+// Frame budget governor.
+// Fed the step and render time of every frame, it trades quality for time to hold a target frame
+// time: the Gauss-Seidel sweeps of a solve and the resolution of filtered renders, within the
+// configured bounds. The frame costs are smoothed, and the governor only degrades above
+// `GOV_HIGH_FRACTION` of the target and only upgrades when the predicted cost of the upgrade stays
+// below it, so decisions settle instead of oscillating. It degrades after a few frames and
+// upgrades after a longer hold, so the frame rate drops briefly at worst while quality comes back slowly.
+
+#define GOV_HIGH_FRACTION      0.90 // of the target, degrade above
+#define GOV_SMOOTHING          0.8  // weight of the previous average, per frame
+#define GOV_DEGRADE_HOLD       4    // [frames] between a change and the next degradation
+#define GOV_UPGRADE_HOLD       60   // [frames] between a change and the next upgrade
+#define GOV_SCALE_FACTOR       0.85f // per render scale change, about 28% of the pixels
+
+DECL_OBJECT(gov_obj_t);
+
+typedef struct {
+    double target_ms; // frame budget, e.g. 16.6 for 60 Hz
+    int32_t min_solve_iter_size, max_solve_iter_size;
+    float min_render_scale, max_render_scale; // fraction of the output resolution, (0, 1]
+} gov_config_t;
+
+typedef struct {
+    int32_t solve_iter_size;
+    float render_scale;
+    double frame_ms, step_ms, render_ms; // smoothed
+    int64_t degrade_count, upgrade_count;
+} gov_state_t;
+
+gov_obj_t gov_create(const gov_config_t* config, int32_t solve_iter_size, float render_scale); // NOTE: Starts from the given decisions, clamped to the bounds.
+void gov_destroy(gov_obj_t*);
+const gov_config_t* gov_get_config(gov_obj_t);
+const gov_state_t* gov_get_state(gov_obj_t);
+void gov_set_solve_iter_size(gov_obj_t, int32_t solve_iter_size, bool_t fixed); // NOTE: Syncs the sweeps with the sim before an update. `fixed` keeps them as they are, e.g. when they have no effect or a replay sets them, and only the render scale is governed.
+bool_t gov_update(gov_obj_t, double frame_ms, double step_ms, double render_ms); // NOTE: Once per frame, TRUE if a decision changed.
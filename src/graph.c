@@ -0,0 +1,187 @@
+﻿#include "graph.h"
+#include "thread.h"
+#include "atomic.h"
+#include "misc.h"
+
+#define GRAPH_SPIN_COUNT 64 // pauses before a worker with nothing to run yields its cpu
+
+typedef struct {
+    graph_task_fn_t fn;
+    void* ctx;
+    uint64_t successors; // bit `i` set if task `i` depends on this one
+    int32_t dependency_count;
+} graph_task_t;
+
+struct _graph_obj_t {
+    graph_task_t tasks[GRAPH_MAX_TASKS];
+    int32_t task_count;
+
+    // Current run
+    pool_obj_t pool;
+    volatile int32_t pending[GRAPH_MAX_TASKS]; // dependencies not done yet
+    volatile int32_t ready[GRAPH_MAX_TASKS]; // task indices in the order they got ready, -1 until published
+    volatile int32_t ready_head, ready_tail;
+    volatile int32_t done_count;
+};
+
+static inline int32_t _graph_get_lsb(uint64_t v)
+{
+    assert(v);
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (int32_t)idx;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static inline void _graph_push(graph_obj_t self, int32_t task_idx)
+{
+    // NOTE: Every task gets ready exactly once per run, so the list never wraps.
+    const int32_t slot = atomic_add_i32(&self->ready_tail, 1);
+    atomic_store_i32(&self->ready[slot], task_idx);
+}
+
+static inline int32_t _graph_pop(graph_obj_t self)
+{
+    for (;;) {
+        const int32_t head = atomic_load_i32(&self->ready_head);
+        if (head >= atomic_load_i32(&self->ready_tail)) {
+            return -1;
+        }
+        if (atomic_cas_i32(&self->ready_head, head, head + 1)) {
+            int32_t task_idx;
+            while ((task_idx = atomic_load_i32(&self->ready[head])) < 0) {
+                atomic_pause(); // NOTE: The slot is claimed, its index is about to be stored.
+            }
+            return task_idx;
+        }
+    }
+}
+
+static void _graph_worker(void* ctx, int32_t worker_idx, int32_t task_idx)
+{
+    UNUSED_PARAM(worker_idx);
+    UNUSED_PARAM(task_idx);
+
+    const graph_obj_t self = (graph_obj_t)ctx;
+    int32_t spin_count = 0;
+    while (atomic_load_i32(&self->done_count) < self->task_count) {
+        const int32_t idx = _graph_pop(self);
+        if (idx < 0) {
+            if (pool_help(self->pool)) { // NOTE: Helps with the ranges the running tasks split.
+                spin_count = 0;
+            } else if (++spin_count < GRAPH_SPIN_COUNT) {
+                atomic_pause();
+            } else {
+                thread_sleep_ms(0);
+            }
+            continue;
+        }
+        spin_count = 0;
+
+        const graph_task_t* const task = &self->tasks[idx];
+        task->fn(task->ctx);
+        for (uint64_t succ = task->successors; succ; succ &= succ - 1) {
+            const int32_t succ_idx = _graph_get_lsb(succ);
+            if (atomic_add_i32(&self->pending[succ_idx], -1) == 1) {
+                _graph_push(self, succ_idx);
+            }
+        }
+        atomic_add_i32(&self->done_count, 1);
+    }
+}
+
+graph_obj_t graph_create(void) {
+    return (graph_obj_t)calloc(1, sizeof(struct _graph_obj_t));
+}
+
+void graph_destroy(graph_obj_t* pself) {
+    if (pself && *pself) {
+        SAFE_FREE(*pself);
+    }
+}
+
+int32_t graph_get_task_count(graph_obj_t self) {
+    assert(self);
+    return self->task_count;
+}
+
+int32_t graph_add_task(graph_obj_t self, graph_task_fn_t fn, void* ctx) {
+    assert(self);
+    assert(fn);
+
+    if (self->task_count >= GRAPH_MAX_TASKS) {
+        return -1;
+    }
+    graph_task_t* const task = &self->tasks[self->task_count];
+    task->fn = fn;
+    task->ctx = ctx;
+    task->successors = 0;
+    task->dependency_count = 0;
+    return self->task_count++;
+}
+
+void graph_add_dependency(graph_obj_t self, int32_t task_idx, int32_t dependency_idx) {
+    assert(self);
+    assert(0 <= dependency_idx && dependency_idx < task_idx && task_idx < self->task_count);
+
+    const uint64_t bit = 1ull << task_idx;
+    graph_task_t* const dependency = &self->tasks[dependency_idx];
+    if (!(dependency->successors & bit)) {
+        dependency->successors |= bit;
+        ++self->tasks[task_idx].dependency_count;
+    }
+}
+
+int32_t graph_get_width(graph_obj_t self) {
+    assert(self);
+
+    // NOTE: Tasks of the same depth (longest dependency chain from a root) never depend on each other,
+    //       so the largest such level can always run at once.
+    int32_t depth[GRAPH_MAX_TASKS] = { 0 };
+    int32_t level_sizes[GRAPH_MAX_TASKS] = { 0 };
+    int32_t width = 0;
+    for (int32_t i = 0; i < self->task_count; ++i) {
+        for (int32_t k = 0; k < i; ++k) {
+            if (self->tasks[k].successors & (1ull << i)) {
+                depth[i] = max(depth[i], depth[k] + 1);
+            }
+        }
+        const int32_t level_size = ++level_sizes[depth[i]]; // NOTE: Not inside `max()`, which evaluates its arguments twice.
+        width = max(width, level_size);
+    }
+    return width;
+}
+
+void graph_run(graph_obj_t self, pool_obj_t pool) {
+    assert(self);
+
+    const int32_t task_count = self->task_count;
+    const int32_t width = graph_get_width(self);
+    const int32_t worker_count = pool ? min(pool_get_worker_count(pool), width) : 1;
+    if (worker_count <= 1) {
+        for (int32_t i = 0; i < task_count; ++i) {
+            self->tasks[i].fn(self->tasks[i].ctx);
+        }
+        return;
+    }
+
+    self->pool = pool;
+    self->ready_head = self->ready_tail = 0;
+    self->done_count = 0;
+    for (int32_t i = 0; i < task_count; ++i) {
+        self->pending[i] = self->tasks[i].dependency_count;
+        self->ready[i] = -1;
+    }
+    for (int32_t i = 0; i < task_count; ++i) {
+        if (!self->tasks[i].dependency_count) {
+            _graph_push(self, i);
+        }
+    }
+
+    // NOTE: One pool task per worker that can be busy at once, each keeps taking ready tasks until the
+    //       whole graph is done. The other workers only wake up for the ranges the tasks split.
+    pool_run(pool, _graph_worker, self, worker_count);
+}
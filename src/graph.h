@@ -0,0 +1,23 @@
+﻿#pragma once
+#include "common.h"
+#include "pool.h"
+
+// Small static task graph: tasks run once every `graph_run()`, each after all of its dependencies.
+// Dependencies must be added before the task (a task can only depend on earlier ones), so the
+// insertion order is a valid serial order. The edges are kept as successor bitmasks in the object,
+// a run does not allocate: workers take ready tasks from a lock-free list and release their
+// successors when done, so independent tasks run concurrently.
+
+#define GRAPH_MAX_TASKS 64
+
+DECL_OBJECT(graph_obj_t);
+
+typedef void(*graph_task_fn_t)(void* ctx);
+
+graph_obj_t graph_create(void);
+void graph_destroy(graph_obj_t*);
+int32_t graph_get_task_count(graph_obj_t);
+int32_t graph_add_task(graph_obj_t, graph_task_fn_t fn, void* ctx); // NOTE: Returns the task index, -1 if full.
+void graph_add_dependency(graph_obj_t, int32_t task_idx, int32_t dependency_idx); // NOTE: `dependency_idx` must be an earlier task.
+int32_t graph_get_width(graph_obj_t); // NOTE: Most tasks of one dependency level, the number of workers worth using.
+void graph_run(graph_obj_t, pool_obj_t pool); // NOTE: Blocks until all tasks are done. NULL `pool` runs them in insertion order on the calling thread.
@@ -0,0 +1,125 @@
+﻿#include "hist.h"
+#include "atomic.h"
+#include "misc.h"
+
+#define HIST_MAX_US_BITS 32 // values are clamped below 2^32 us
+#define HIST_BUCKET_COUNT ((HIST_MAX_US_BITS - HIST_SUB_BUCKET_BITS + 1) * HIST_SUB_BUCKETS)
+
+struct _hist_obj_t {
+    volatile int64_t counts[HIST_BUCKET_COUNT];
+    volatile int64_t sum_us;
+    volatile int64_t min_us; // INT64_MAX if empty
+    volatile int64_t max_us;
+    int64_t snapshot[HIST_BUCKET_COUNT]; // reader scratch
+};
+
+static inline int32_t _hist_get_msb(uint64_t v)
+{
+    assert(v);
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return (int32_t)idx;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+static inline int32_t _hist_get_bucket(int64_t us)
+{
+    // NOTE: Linear below `2 * HIST_SUB_BUCKETS`, then `HIST_SUB_BUCKETS` buckets per power of two.
+    if (us < 2 * HIST_SUB_BUCKETS) {
+        return (int32_t)us;
+    }
+    const int32_t shift = _hist_get_msb((uint64_t)us) - HIST_SUB_BUCKET_BITS;
+    return (shift + 1) * HIST_SUB_BUCKETS + (int32_t)((us >> shift) - HIST_SUB_BUCKETS);
+}
+
+static inline int64_t _hist_get_bucket_upper_us(int32_t idx)
+{
+    if (idx < 2 * HIST_SUB_BUCKETS) {
+        return idx;
+    }
+    const int32_t shift = idx / HIST_SUB_BUCKETS - 1;
+    return ((((int64_t)(idx % HIST_SUB_BUCKETS) + HIST_SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+hist_obj_t hist_create(void) {
+    hist_obj_t newobj = (hist_obj_t)calloc(1, sizeof(struct _hist_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->min_us = INT64_MAX;
+    return newobj;
+}
+
+void hist_destroy(hist_obj_t* pself) {
+    if (pself && *pself) {
+        SAFE_FREE(*pself);
+    }
+}
+
+void hist_record(hist_obj_t self, double ms) {
+    assert(self);
+
+    const int64_t us = (int64_t)clamp(ms * 1000.0 + 0.5, 0.0, (double)((1ull << HIST_MAX_US_BITS) - 1));
+    atomic_add_i64(&self->counts[_hist_get_bucket(us)], 1);
+    atomic_add_i64(&self->sum_us, us);
+
+    int64_t curr = atomic_load_i64(&self->min_us);
+    while (us < curr && !atomic_cas_i64(&self->min_us, curr, us)) {
+        curr = atomic_load_i64(&self->min_us);
+    }
+    curr = atomic_load_i64(&self->max_us);
+    while (us > curr && !atomic_cas_i64(&self->max_us, curr, us)) {
+        curr = atomic_load_i64(&self->max_us);
+    }
+}
+
+void hist_read(hist_obj_t self, hist_summary_t* psummary, bool_t fl_reset) {
+    assert(self);
+    assert(psummary);
+
+    memset(psummary, 0, sizeof(*psummary));
+
+    int64_t count = 0;
+    for (int32_t i = 0; i < HIST_BUCKET_COUNT; ++i) {
+        const int64_t n = atomic_load_i64(&self->counts[i]);
+        if (n && fl_reset) {
+            atomic_add_i64(&self->counts[i], -n);
+        }
+        self->snapshot[i] = n;
+        count += n;
+    }
+
+    int64_t sum_us = atomic_load_i64(&self->sum_us);
+    int64_t min_us = atomic_load_i64(&self->min_us);
+    int64_t max_us = atomic_load_i64(&self->max_us);
+    if (fl_reset) {
+        // NOTE: A sample recorded while resetting may be left out of the next min/max, never out of the counts.
+        atomic_add_i64(&self->sum_us, -sum_us);
+        atomic_store_i64(&self->min_us, INT64_MAX);
+        atomic_store_i64(&self->max_us, 0);
+    }
+
+    if (!count) {
+        return;
+    }
+
+    psummary->count = count;
+    psummary->mean_ms = (double)sum_us / (double)count * 1e-3;
+    psummary->min_ms = (double)min(min_us, max_us) * 1e-3;
+    psummary->max_ms = (double)max_us * 1e-3;
+
+    const double ranks[4] = { 0.5, 0.9, 0.99, 0.999 };
+    double* const outs[4] = { &psummary->p50_ms, &psummary->p90_ms, &psummary->p99_ms, &psummary->p999_ms };
+    int64_t seen = 0;
+    int32_t k = 0;
+    for (int32_t i = 0; i < HIST_BUCKET_COUNT && k < 4; ++i) {
+        seen += self->snapshot[i];
+        while (k < 4 && (double)seen >= ranks[k] * (double)count) {
+            *outs[k++] = (double)min(_hist_get_bucket_upper_us(i), max_us) * 1e-3;
+        }
+    }
+}
@@ -0,0 +1,25 @@
+﻿#pragma once
+#include "common.h"
+
+// Log-linear (HDR-style) histogram of durations, for tail latencies.
+// Every power of two of microseconds is split into `HIST_SUB_BUCKETS` linear buckets, so any
+// recorded value, and any percentile, is known within 1/`HIST_SUB_BUCKETS` of itself, from 1us
+// up to about an hour (larger values are clamped). The buckets are a fixed array: recording is
+// one atomic increment, never allocates, and may run concurrently with a reader on another thread.
+// Reading with reset subtracts what was read, so samples recorded meanwhile are kept.
+
+#define HIST_SUB_BUCKET_BITS 6
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BUCKET_BITS)
+
+DECL_OBJECT(hist_obj_t);
+
+typedef struct {
+    int64_t count;
+    double mean_ms, min_ms, max_ms;
+    double p50_ms, p90_ms, p99_ms, p999_ms; // NOTE: Upper bound of the bucket, at most `max_ms`.
+} hist_summary_t;
+
+hist_obj_t hist_create(void);
+void hist_destroy(hist_obj_t*);
+void hist_record(hist_obj_t, double ms);
+void hist_read(hist_obj_t, hist_summary_t* psummary/* out */, bool_t fl_reset); // NOTE: One reader at a time. All zero if nothing was recorded.
@@ -0,0 +1,274 @@
+﻿#include "hwc.h"
+#include "misc.h"
+
+#if defined(__linux__)
+#  include <linux/perf_event.h>
+#  include <sys/syscall.h>
+#  include <sys/types.h>
+#  include <dirent.h>
+#  include <errno.h>
+#  include <unistd.h>
+#endif
+
+#define HWC_ERROR_SIZE 128
+
+typedef struct {
+    int fds[HWC_COUNTER_COUNT]; // NOTE: The first opened is the group leader.
+} hwc_group_t;
+
+struct _hwc_obj_t {
+    uint32_t mask; // counters opened on every thread
+    int32_t counter_count; // bits of `mask`, values per group read
+    hwc_group_t* groups;
+    int32_t group_count;
+    uint64_t begin[HWC_COUNTER_COUNT]; // summed over the groups
+    char error[HWC_ERROR_SIZE];
+};
+
+static const char* const s_hwc_counter_names[HWC_COUNTER_COUNT] = {
+    "cycles",
+    "instructions",
+    "l1d-misses",
+    "llc-misses",
+    "dtlb-misses",
+    "branch-misses",
+};
+
+#if defined(__linux__)
+
+#define HWC_CACHE_READ_MISS(CACHE) \
+    ((CACHE) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} s_hwc_events[HWC_COUNTER_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, HWC_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HW_CACHE, HWC_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+static int _hwc_open(hwc_counter_e counter, pid_t tid, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = s_hwc_events[counter].type;
+    attr.config = s_hwc_events[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1; // NOTE: Allowed with the default `perf_event_paranoid` of 2.
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, tid, -1, group_fd, 0);
+}
+
+static void _hwc_close_group(hwc_group_t* pgroup)
+{
+    for (int32_t k = 0; k < HWC_COUNTER_COUNT; ++k) {
+        if (pgroup->fds[k] >= 0) {
+            close(pgroup->fds[k]);
+            pgroup->fds[k] = -1;
+        }
+    }
+}
+
+static bool_t _hwc_open_group(hwc_obj_t self, pid_t tid, hwc_group_t* pgroup/* out */)
+{
+    // NOTE: On the first thread, tries every counter and keeps those that open,
+    //       the other threads must open the same set, or are left out.
+    const bool_t fl_probe = (self->group_count == 0);
+    int leader_fd = -1;
+    int first_errno = 0;
+    for (int32_t k = 0; k < HWC_COUNTER_COUNT; ++k) {
+        pgroup->fds[k] = -1;
+        if (!fl_probe && !(self->mask & (1u << k))) {
+            continue;
+        }
+        pgroup->fds[k] = _hwc_open((hwc_counter_e)k, tid, leader_fd);
+        if (pgroup->fds[k] < 0) {
+            if (!fl_probe) {
+                _hwc_close_group(pgroup);
+                return FALSE;
+            }
+            if (!first_errno) {
+                first_errno = errno;
+            }
+            continue;
+        }
+        if (leader_fd < 0) {
+            leader_fd = pgroup->fds[k];
+        }
+        if (fl_probe) {
+            self->mask |= (1u << k);
+            self->counter_count++;
+        }
+    }
+    if (leader_fd < 0) {
+        snprintf(self->error, sizeof(self->error), "perf_event_open: %s", strerror(first_errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static int32_t _hwc_list_threads(pid_t** ptids/* out */)
+{
+    *ptids = NULL;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) {
+        return 0;
+    }
+    int32_t count = 0, capacity = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        const pid_t tid = (pid_t)atoi(ent->d_name);
+        if (tid <= 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            pid_t* tids = (pid_t*)realloc(*ptids, capacity * sizeof(pid_t));
+            if (!tids) {
+                break;
+            }
+            *ptids = tids;
+        }
+        (*ptids)[count++] = tid;
+    }
+    closedir(dir);
+    return count;
+}
+
+static void _hwc_read(hwc_obj_t self, uint64_t values[HWC_COUNTER_COUNT]/* out */)
+{
+    memset(values, 0, HWC_COUNTER_COUNT * sizeof(uint64_t));
+    uint64_t buf[3 + HWC_COUNTER_COUNT]; // nr, time_enabled, time_running, values
+    for (int32_t g = 0; g < self->group_count; ++g) {
+        const hwc_group_t* pgroup = &self->groups[g];
+        int leader_fd = -1;
+        for (int32_t k = 0; k < HWC_COUNTER_COUNT && leader_fd < 0; ++k) {
+            leader_fd = pgroup->fds[k];
+        }
+        const ssize_t len = read(leader_fd, buf, sizeof(buf));
+        if (len < (ssize_t)(3 * sizeof(uint64_t)) || buf[0] != (uint64_t)self->counter_count || !buf[2]) {
+            continue;
+        }
+        // NOTE: Scales by the fraction of the time the group was on the pmu.
+        const double scale = (double)buf[1] / (double)buf[2];
+        int32_t idx = 3;
+        for (int32_t k = 0; k < HWC_COUNTER_COUNT; ++k) {
+            if (self->mask & (1u << k)) {
+                values[k] += (uint64_t)((double)buf[idx++] * scale);
+            }
+        }
+    }
+}
+
+#endif // defined(__linux__)
+
+hwc_obj_t hwc_create(void) {
+    hwc_obj_t newobj = (hwc_obj_t)calloc(1, sizeof(struct _hwc_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+#if defined(__linux__)
+    pid_t* tids;
+    const int32_t thread_count = _hwc_list_threads(&tids);
+    if (!thread_count) {
+        snprintf(newobj->error, sizeof(newobj->error), "cannot list the threads");
+        return newobj;
+    }
+    newobj->groups = (hwc_group_t*)calloc(thread_count, sizeof(hwc_group_t));
+    if (!newobj->groups) {
+        free(tids);
+        hwc_destroy(&newobj);
+        return NULL;
+    }
+    for (int32_t t = 0; t < thread_count; ++t) {
+        if (_hwc_open_group(newobj, tids[t], &newobj->groups[newobj->group_count])) {
+            newobj->group_count++;
+        }
+        else if (!newobj->group_count) {
+            break; // NOTE: Nothing opened on the first thread, the others would fail alike.
+        }
+    }
+    free(tids);
+    if (newobj->group_count) {
+        newobj->error[0] = '\0';
+    }
+#else
+    snprintf(newobj->error, sizeof(newobj->error), "not supported on this platform");
+#endif
+
+    return newobj;
+}
+
+void hwc_destroy(hwc_obj_t* pself) {
+    if (pself && *pself) {
+#if defined(__linux__)
+        for (int32_t g = 0; g < (*pself)->group_count; ++g) {
+            _hwc_close_group(&(*pself)->groups[g]);
+        }
+#endif
+        SAFE_FREE((*pself)->groups);
+        SAFE_FREE(*pself);
+    }
+}
+
+uint32_t hwc_get_counter_mask(hwc_obj_t self) {
+    assert(self);
+    return self->group_count ? self->mask : 0;
+}
+
+const char* hwc_get_error(hwc_obj_t self) {
+    assert(self);
+    return self->group_count ? NULL : self->error;
+}
+
+int32_t hwc_get_thread_count(hwc_obj_t self) {
+    assert(self);
+    return self->group_count;
+}
+
+void hwc_begin(hwc_obj_t self) {
+    assert(self);
+#if defined(__linux__)
+    if (self->group_count) {
+        _hwc_read(self, self->begin);
+    }
+#endif
+}
+
+void hwc_end(hwc_obj_t self, hwc_totals_t* ptotals/* inout */) {
+    assert(self && ptotals);
+#if defined(__linux__)
+    if (self->group_count) {
+        uint64_t end[HWC_COUNTER_COUNT];
+        _hwc_read(self, end);
+        for (int32_t k = 0; k < HWC_COUNTER_COUNT; ++k) {
+            // NOTE: Scaled values may step back slightly when multiplexed.
+            ptotals->values[k] += (end[k] > self->begin[k]) ? end[k] - self->begin[k] : 0;
+        }
+        memcpy(self->begin, end, sizeof(end));
+    }
+#endif
+    ptotals->section_count++;
+}
+
+const char* hwc_counter_get_name(hwc_counter_e counter) {
+    return (counter >= 0 && counter < HWC_COUNTER_COUNT) ? s_hwc_counter_names[counter] : "unknown";
+}
+
+double hwc_totals_get_ipc(const hwc_totals_t* ptotals) {
+    assert(ptotals);
+    const uint64_t cycles = ptotals->values[HWC_CYCLES];
+    return cycles ? (double)ptotals->values[HWC_INSTRUCTIONS] / (double)cycles : 0.0;
+}
+
+double hwc_totals_get_mpki(const hwc_totals_t* ptotals, hwc_counter_e counter) {
+    assert(ptotals && counter >= 0 && counter < HWC_COUNTER_COUNT);
+    const uint64_t instructions = ptotals->values[HWC_INSTRUCTIONS];
+    return instructions ? 1000.0 * (double)ptotals->values[counter] / (double)instructions : 0.0;
+}
@@ -0,0 +1,38 @@
+﻿#pragma once
+#include "common.h"
+
+// Hardware performance counters (Linux `perf_event_open`).
+// One counter group per thread of the process, opened at creation: the threads started later
+// (e.g. by `sim_set_worker_count()`) are not counted, so create it once the workers are running.
+// The groups count in user space all the time, a section reads them at its begin and end and adds
+// the difference, summed over the threads, to the given totals. Counters the cpu, kernel or
+// hypervisor does not expose are left out; in containers and VMs that is often all of them, then
+// every section adds nothing and `hwc_get_counter_mask()` is 0. Other platforms have no counters.
+
+typedef enum {
+    HWC_CYCLES,
+    HWC_INSTRUCTIONS,
+    HWC_L1D_MISSES,    // L1 data cache read misses
+    HWC_LLC_MISSES,    // last level cache misses
+    HWC_DTLB_MISSES,   // data TLB read misses
+    HWC_BRANCH_MISSES,
+    HWC_COUNTER_COUNT,
+} hwc_counter_e;
+
+DECL_OBJECT(hwc_obj_t);
+
+typedef struct {
+    uint64_t values[HWC_COUNTER_COUNT]; // NOTE: Scaled up when the kernel multiplexed the counters.
+    int64_t section_count;
+} hwc_totals_t;
+
+hwc_obj_t hwc_create(void); // NOTE: NULL if out of memory only, unavailable counters are not an error.
+void hwc_destroy(hwc_obj_t*);
+uint32_t hwc_get_counter_mask(hwc_obj_t); // NOTE: Bit `1 << counter` for every counter that is counted.
+const char* hwc_get_error(hwc_obj_t); // NOTE: Why no counter could be opened, NULL if any is counted.
+int32_t hwc_get_thread_count(hwc_obj_t);
+void hwc_begin(hwc_obj_t);
+void hwc_end(hwc_obj_t, hwc_totals_t* ptotals/* inout */); // NOTE: Also begins the next section, back-to-back sections need no `hwc_begin()`.
+const char* hwc_counter_get_name(hwc_counter_e counter);
+double hwc_totals_get_ipc(const hwc_totals_t* ptotals); // NOTE: Instructions per cycle, 0 if not counted.
+double hwc_totals_get_mpki(const hwc_totals_t* ptotals, hwc_counter_e counter); // NOTE: Events per 1000 instructions, 0 if not counted.
@@ -0,0 +1,325 @@
+﻿#include "journal.h"
+
+#define JOURNAL_MAGIC    "FLJR"
+#define JOURNAL_VERSION  2 // adds the solver, obstacle, sweep, resize and velocity grid events
+#define JOURNAL_VERSION_MIN 1 // density, force, diffusion and viscosity events only, still replayed
+#define JOURNAL_END_MARK 0xff
+
+struct _journal_obj_t {
+    journal_info_t info;
+
+    // Writer
+    FILE* fp;
+    int64_t last_step;
+    bool_t fl_ended;
+
+    // Reader
+    journal_event_t* events;
+    int64_t event_count;
+    int64_t cursor;
+    int64_t step_count;
+};
+
+static inline void _journal_put_varint(FILE* fp, uint64_t v)
+{
+    uint8_t buff[10];
+    int32_t n = 0;
+    do {
+        buff[n] = (uint8_t)(v & 0x7f);
+        v >>= 7;
+        if (v) {
+            buff[n] |= 0x80;
+        }
+        ++n;
+    } while (v);
+    fwrite(buff, 1, n, fp);
+}
+
+static inline void _journal_put_i32(FILE* fp, int32_t v)
+{
+    _journal_put_varint(fp, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31)); // zigzag
+}
+
+static inline void _journal_put_f32(FILE* fp, float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    const uint8_t buff[4] = { (uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24) };
+    fwrite(buff, 1, sizeof(buff), fp);
+}
+
+static inline bool_t _journal_get_varint(const uint8_t** pp, const uint8_t* end, uint64_t* out)
+{
+    uint64_t v = 0;
+    for (int32_t shift = 0; shift < 64; shift += 7) {
+        if (*pp >= end) {
+            return FALSE;
+        }
+        const uint8_t b = *(*pp)++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static inline bool_t _journal_get_i32(const uint8_t** pp, const uint8_t* end, int32_t* out)
+{
+    uint64_t v;
+    if (!_journal_get_varint(pp, end, &v)) {
+        return FALSE;
+    }
+    *out = (int32_t)((uint32_t)(v >> 1) ^ (0u - (uint32_t)(v & 1)));
+    return TRUE;
+}
+
+static inline bool_t _journal_get_f32(const uint8_t** pp, const uint8_t* end, float* out)
+{
+    if (end - *pp < 4) {
+        return FALSE;
+    }
+    const uint8_t* const p = *pp;
+    const uint32_t bits = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    memcpy(out, &bits, sizeof(bits));
+    *pp += 4;
+    return TRUE;
+}
+
+static bool_t _journal_parse(journal_obj_t self, const uint8_t* p, const uint8_t* end)
+{
+    if (end - p < 5 || memcmp(p, JOURNAL_MAGIC, 4) != 0 || p[4] < JOURNAL_VERSION_MIN || p[4] > JOURNAL_VERSION) {
+        return FALSE;
+    }
+    const uint8_t version = p[4];
+    p += 5;
+
+    uint64_t rows, cols;
+    if (!_journal_get_varint(&p, end, &rows) ||
+        !_journal_get_varint(&p, end, &cols) ||
+        !_journal_get_f32(&p, end, &self->info.dt) ||
+        !_journal_get_f32(&p, end, &self->info.diff) ||
+        !_journal_get_f32(&p, end, &self->info.visc) ||
+        !_journal_get_f32(&p, end, &self->info.fade_step))
+    {
+        return FALSE;
+    }
+    self->info.rows = (int32_t)rows;
+    self->info.cols = (int32_t)cols;
+
+    int64_t event_cap = 0, step = 0;
+    for (;;) {
+        uint64_t step_delta;
+        if (!_journal_get_varint(&p, end, &step_delta) || p >= end) {
+            return FALSE; // NOTE: Truncated journal (missing end mark).
+        }
+        step += (int64_t)step_delta;
+
+        const uint8_t type = *p++;
+        if (type == JOURNAL_END_MARK) {
+            self->step_count = step;
+            return TRUE;
+        }
+        if (version == 1 && type > JOURNAL_EVENT_SET_VISCOSITY) {
+            return FALSE;
+        }
+
+        journal_event_t ev = { .step = step, .type = (journal_event_e)type };
+        bool_t ok;
+        switch (type) {
+        case JOURNAL_EVENT_ADD_DENSITY:
+            ok = _journal_get_i32(&p, end, &ev.x) && _journal_get_i32(&p, end, &ev.y) && _journal_get_f32(&p, end, &ev.v0);
+            break;
+        case JOURNAL_EVENT_ADD_FORCE:
+            ok = _journal_get_i32(&p, end, &ev.x) && _journal_get_i32(&p, end, &ev.y) && _journal_get_f32(&p, end, &ev.v0) && _journal_get_f32(&p, end, &ev.v1);
+            break;
+        case JOURNAL_EVENT_SET_DIFFUSION:
+        case JOURNAL_EVENT_SET_VISCOSITY:
+            ok = _journal_get_f32(&p, end, &ev.v0);
+            break;
+        case JOURNAL_EVENT_SET_SOLVER:
+        case JOURNAL_EVENT_SET_SOLVE_ITER:
+        case JOURNAL_EVENT_RESIZE:
+        case JOURNAL_EVENT_SET_VELOCITY_COARSENING:
+            ok = _journal_get_i32(&p, end, &ev.x);
+            break;
+        case JOURNAL_EVENT_PAINT_OBSTACLE:
+            ok = _journal_get_i32(&p, end, &ev.x) && _journal_get_i32(&p, end, &ev.y) && _journal_get_f32(&p, end, &ev.v0) && _journal_get_f32(&p, end, &ev.v1);
+            break;
+        case JOURNAL_EVENT_CLEAR_OBSTACLES:
+            ok = TRUE;
+            break;
+        default:
+            ok = FALSE;
+            break;
+        }
+        if (!ok) {
+            return FALSE;
+        }
+
+        if (self->event_count == event_cap) {
+            event_cap = event_cap ? event_cap * 2 : 1024;
+            journal_event_t* const new_events = (journal_event_t*)realloc(self->events, (size_t)event_cap * sizeof(journal_event_t));
+            if (!new_events) {
+                return FALSE;
+            }
+            self->events = new_events;
+        }
+        self->events[self->event_count++] = ev;
+    }
+}
+
+journal_obj_t journal_create_writer(const char* path, const journal_info_t* info) {
+    assert(path);
+    assert(info);
+
+    journal_obj_t newobj = (journal_obj_t)calloc(1, sizeof(struct _journal_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->info = *info;
+    newobj->fp = fopen(path, "wb");
+    if (!newobj->fp) {
+        journal_destroy(&newobj);
+        return NULL;
+    }
+
+    fwrite(JOURNAL_MAGIC, 1, 4, newobj->fp);
+    fputc(JOURNAL_VERSION, newobj->fp);
+    _journal_put_varint(newobj->fp, (uint64_t)info->rows);
+    _journal_put_varint(newobj->fp, (uint64_t)info->cols);
+    _journal_put_f32(newobj->fp, info->dt);
+    _journal_put_f32(newobj->fp, info->diff);
+    _journal_put_f32(newobj->fp, info->visc);
+    _journal_put_f32(newobj->fp, info->fade_step);
+
+    return newobj;
+}
+
+journal_obj_t journal_create_reader(const char* path) {
+    assert(path);
+
+    journal_obj_t newobj = (journal_obj_t)calloc(1, sizeof(struct _journal_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    FILE* const fp = fopen(path, "rb");
+    if (!fp) {
+        journal_destroy(&newobj);
+        return NULL;
+    }
+
+    uint8_t* buff = NULL;
+    long sz = -1;
+    if (fseek(fp, 0, SEEK_END) == 0 && (sz = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buff = (uint8_t*)malloc((size_t)sz);
+        if (buff && fread(buff, 1, (size_t)sz, fp) != (size_t)sz) {
+            SAFE_FREE(buff);
+        }
+    }
+    fclose(fp);
+
+    const bool_t ok = buff && _journal_parse(newobj, buff, buff + sz);
+    SAFE_FREE(buff);
+    if (!ok) {
+        journal_destroy(&newobj);
+        return NULL;
+    }
+
+    return newobj;
+}
+
+void journal_destroy(journal_obj_t* pself) {
+    if (pself && *pself) {
+        if ((*pself)->fp) {
+            if (!(*pself)->fl_ended) {
+                journal_end(*pself, (*pself)->last_step + 1);
+            }
+            fclose((*pself)->fp);
+            (*pself)->fp = NULL;
+        }
+        SAFE_FREE((*pself)->events);
+        SAFE_FREE(*pself);
+    }
+}
+
+const journal_info_t* journal_get_info(journal_obj_t self) {
+    assert(self);
+    return &self->info;
+}
+
+bool_t journal_write(journal_obj_t self, const journal_event_t* ev) {
+    assert(self && self->fp && !self->fl_ended);
+    assert(ev && ev->step >= self->last_step);
+
+    FILE* const fp = self->fp;
+    _journal_put_varint(fp, (uint64_t)(ev->step - self->last_step));
+    fputc((int)ev->type, fp);
+    switch (ev->type) {
+    case JOURNAL_EVENT_ADD_DENSITY:
+        _journal_put_i32(fp, ev->x);
+        _journal_put_i32(fp, ev->y);
+        _journal_put_f32(fp, ev->v0);
+        break;
+    case JOURNAL_EVENT_ADD_FORCE:
+        _journal_put_i32(fp, ev->x);
+        _journal_put_i32(fp, ev->y);
+        _journal_put_f32(fp, ev->v0);
+        _journal_put_f32(fp, ev->v1);
+        break;
+    case JOURNAL_EVENT_SET_DIFFUSION:
+    case JOURNAL_EVENT_SET_VISCOSITY:
+        _journal_put_f32(fp, ev->v0);
+        break;
+    case JOURNAL_EVENT_SET_SOLVER:
+    case JOURNAL_EVENT_SET_SOLVE_ITER:
+    case JOURNAL_EVENT_RESIZE:
+    case JOURNAL_EVENT_SET_VELOCITY_COARSENING:
+        _journal_put_i32(fp, ev->x);
+        break;
+    case JOURNAL_EVENT_PAINT_OBSTACLE:
+        _journal_put_i32(fp, ev->x);
+        _journal_put_i32(fp, ev->y);
+        _journal_put_f32(fp, ev->v0);
+        _journal_put_f32(fp, ev->v1);
+        break;
+    case JOURNAL_EVENT_CLEAR_OBSTACLES:
+        break;
+    }
+    self->last_step = ev->step;
+
+    return !ferror(fp);
+}
+
+void journal_end(journal_obj_t self, int64_t step_count) {
+    assert(self && self->fp && !self->fl_ended);
+    assert(step_count >= self->last_step);
+    _journal_put_varint(self->fp, (uint64_t)(step_count - self->last_step));
+    fputc(JOURNAL_END_MARK, self->fp);
+    fflush(self->fp);
+    self->last_step = step_count;
+    self->fl_ended = TRUE;
+}
+
+int64_t journal_get_step_count(journal_obj_t self) {
+    assert(self);
+    return self->step_count;
+}
+
+int64_t journal_get_event_count(journal_obj_t self) {
+    assert(self);
+    return self->event_count;
+}
+
+bool_t journal_next(journal_obj_t self, int64_t step, journal_event_t* ev) {
+    assert(self);
+    assert(ev);
+    if (self->cursor >= self->event_count || self->events[self->cursor].step != step) {
+        return FALSE;
+    }
+    *ev = self->events[self->cursor++];
+    return TRUE;
+}
\ No newline at end of file
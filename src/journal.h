@@ -0,0 +1,46 @@
+﻿#pragma once
+#include "common.h"
+
+// Input event journal.
+// Records every per-step injection applied to the simulation, tagged with the index of the
+// step it precedes, into a compact binary log (varint step deltas, zigzag coordinates and raw
+// floats), so the exact same interactive workload can be replayed step by step later.
+
+DECL_OBJECT(journal_obj_t);
+
+typedef enum {
+    JOURNAL_EVENT_ADD_DENSITY,   // x, y, v0: amount
+    JOURNAL_EVENT_ADD_FORCE,     // x, y, v0: fx, v1: fy
+    JOURNAL_EVENT_SET_DIFFUSION, // v0: diffusion rate
+    JOURNAL_EVENT_SET_VISCOSITY, // v0: viscosity
+    JOURNAL_EVENT_SET_SOLVER,    // x: solver (`sim_solver_e`)
+    JOURNAL_EVENT_PAINT_OBSTACLE, // x, y, v0: radius, v1: 1 solid, 0 fluid
+    JOURNAL_EVENT_CLEAR_OBSTACLES,
+    JOURNAL_EVENT_SET_SOLVE_ITER, // x: Gauss-Seidel sweeps per solve
+    JOURNAL_EVENT_RESIZE,        // x: box size, later events are in cells of the new box
+    JOURNAL_EVENT_SET_VELOCITY_COARSENING, // x: density cells per velocity cell along an axis
+} journal_event_e;
+
+typedef struct {
+    int64_t step;
+    journal_event_e type;
+    int32_t x, y;
+    float v0, v1;
+} journal_event_t;
+
+typedef struct {
+    int32_t rows, cols;
+    float dt;
+    float diff, visc;
+    float fade_step;
+} journal_info_t;
+
+journal_obj_t journal_create_writer(const char* path, const journal_info_t* info);
+journal_obj_t journal_create_reader(const char* path);
+void journal_destroy(journal_obj_t*); // NOTE: Writers are finalized with the last written step if `journal_end()` was not called.
+const journal_info_t* journal_get_info(journal_obj_t);
+bool_t journal_write(journal_obj_t, const journal_event_t* ev); // NOTE: Events must be written in non-decreasing step order.
+void journal_end(journal_obj_t, int64_t step_count);
+int64_t journal_get_step_count(journal_obj_t);
+int64_t journal_get_event_count(journal_obj_t);
+bool_t journal_next(journal_obj_t, int64_t step, journal_event_t* ev); // NOTE: Pops the next event if it belongs to `step`.
\ No newline at end of file
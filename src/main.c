@@ -1,7 +1,7 @@
 ﻿#include "app.h"
 
-int main() {
-    app_obj_t app = app_create();
+int main(int argc, char* argv[]) {
+    app_obj_t app = app_create(argc, argv);
     if (app) {
         app_run(app);
         app_destroy(&app);
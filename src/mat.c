@@ -3,10 +3,14 @@
 
 struct _mat2f_obj_t {
     int32_t rows, cols, size;
+    mat2f_layout_e layout;
+    int32_t tile_cols; // tiled: tiles per row of tiles
+    int32_t capacity;
     float* data_f32;
 };
 
-mat2f_obj_t mat2f_create(int32_t rows, int32_t cols) {
+static mat2f_obj_t _mat2f_create(int32_t rows, int32_t cols, mat2f_layout_e layout)
+{
     mat2f_obj_t newobj = (mat2f_obj_t)calloc(1, sizeof(struct _mat2f_obj_t));
     if (!newobj) {
         return NULL;
@@ -15,7 +19,14 @@ mat2f_obj_t mat2f_create(int32_t rows, int32_t cols) {
     newobj->rows = rows;
     newobj->cols = cols;
     newobj->size = rows * cols;
-    newobj->data_f32 = (float*)calloc(newobj->size, sizeof(float));
+    newobj->layout = layout;
+    newobj->capacity = newobj->size;
+    if (layout == MAT2F_LAYOUT_TILED) {
+        const int32_t tile_rows = (rows + MAT2F_TILE_MASK) >> MAT2F_TILE_SHIFT;
+        newobj->tile_cols = (cols + MAT2F_TILE_MASK) >> MAT2F_TILE_SHIFT;
+        newobj->capacity = (tile_rows * newobj->tile_cols) << (2 * MAT2F_TILE_SHIFT);
+    }
+    newobj->data_f32 = (float*)calloc(newobj->capacity, sizeof(float));
     if (!newobj->data_f32) {
         mat2f_destroy(&newobj);
         return NULL;
@@ -24,6 +35,14 @@ mat2f_obj_t mat2f_create(int32_t rows, int32_t cols) {
     return newobj;
 }
 
+mat2f_obj_t mat2f_create(int32_t rows, int32_t cols) {
+    return _mat2f_create(rows, cols, MAT2F_LAYOUT_ROW_MAJOR);
+}
+
+mat2f_obj_t mat2f_create_tiled(int32_t rows, int32_t cols) {
+    return _mat2f_create(rows, cols, MAT2F_LAYOUT_TILED);
+}
+
 void mat2f_destroy(mat2f_obj_t* pself) {
     if (pself && *pself) {
         SAFE_FREE((*pself)->data_f32);
@@ -46,6 +65,21 @@ int32_t mat2f_get_size(mat2f_obj_t self) {
     return self->size;
 }
 
+int32_t mat2f_get_capacity(mat2f_obj_t self) {
+    assert(self);
+    return self->capacity;
+}
+
+mat2f_layout_e mat2f_get_layout(mat2f_obj_t self) {
+    assert(self);
+    return self->layout;
+}
+
+int32_t mat2f_get_tile_cols(mat2f_obj_t self) {
+    assert(self);
+    return self->tile_cols;
+}
+
 bool_t mat2f_is_empty(mat2f_obj_t self) {
     assert(self);
     return !self->size;
@@ -55,12 +89,35 @@ bool_t mat2f_is_shape_eq(mat2f_obj_t self, mat2f_obj_t other) {
     assert(self);
     return 
         self->cols == other->cols &&
-        self->rows == other->rows;
+        self->rows == other->rows &&
+        self->layout == other->layout;
+}
+
+void mat2f_copy(mat2f_obj_t self, mat2f_obj_t src) {
+    assert(self);
+    assert(mat2f_is_shape_eq(self, src));
+    memcpy(self->data_f32, src->data_f32, (size_t)self->capacity * sizeof(float));
+}
+
+void mat2f_convert(mat2f_obj_t self, mat2f_obj_t src) {
+    assert(self);
+    assert(self->rows == src->rows && self->cols == src->cols);
+    if (self->layout == src->layout) {
+        mat2f_copy(self, src);
+        return;
+    }
+
+    // NOTE: One direction is always row-major, walk it sequentially.
+    for (int32_t row = 0; row < self->rows; ++row) {
+        for (int32_t col = 0; col < self->cols; ++col) {
+            *mat2f_at_coord(self, row, col) = *mat2f_at_coord(src, row, col);
+        }
+    }
 }
 
 float* mat2f_at_index(mat2f_obj_t self, int32_t idx) {
     assert(self);
-    assert(0 <= idx && idx < self->size);
+    assert(0 <= idx && idx < self->capacity);
     return self->data_f32 + idx;
 }
 
@@ -69,7 +126,9 @@ float* mat2f_at_coord(mat2f_obj_t self, int32_t row, int32_t col) {
     const int32_t 
         rows = self->rows, 
         cols = self->cols,
-        idx = (clamp(row, 0, rows - 1) * cols) + clamp(col, 0, cols - 1);
-    assert(0 <= idx && idx < self->size);
+        r = clamp(row, 0, rows - 1),
+        c = clamp(col, 0, cols - 1),
+        idx = (self->layout == MAT2F_LAYOUT_TILED) ? mat2f_get_tiled_index(self->tile_cols, r, c) : (r * cols) + c;
+    assert(0 <= idx && idx < self->capacity);
     return self->data_f32 + idx;
 }
\ No newline at end of file
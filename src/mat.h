@@ -1,14 +1,41 @@
 ﻿#pragma once
 #include "common.h"
 
+// A matrix of floats, row-major by default.
+//
+// The tiled layout stores `MAT2F_TILE_SIZE`² tiles one after the other (tiles in row-major order,
+// cells row-major inside a tile), so cells a few rows apart share pages and cache lines instead of
+// being a whole row apart. Its storage is padded to whole tiles, `mat2f_at_index()` indexes the
+// storage and `mat2f_at_coord()` maps a cell of either layout.
+
+#define MAT2F_TILE_SHIFT 4
+#define MAT2F_TILE_SIZE (1 << MAT2F_TILE_SHIFT) // rows and columns of a tile, 1 KiB of floats
+#define MAT2F_TILE_MASK (MAT2F_TILE_SIZE - 1)
+
+typedef enum {
+    MAT2F_LAYOUT_ROW_MAJOR,
+    MAT2F_LAYOUT_TILED,
+} mat2f_layout_e;
+
 DECL_OBJECT(mat2f_obj_t);
 
 mat2f_obj_t mat2f_create(int32_t rows, int32_t cols);
+mat2f_obj_t mat2f_create_tiled(int32_t rows, int32_t cols);
 void mat2f_destroy(mat2f_obj_t*);
 int32_t mat2f_get_rows(mat2f_obj_t);
 int32_t mat2f_get_cols(mat2f_obj_t);
 int32_t mat2f_get_size(mat2f_obj_t);
+int32_t mat2f_get_capacity(mat2f_obj_t); // NOTE: Floats of storage, `size` padded to whole tiles in the tiled layout.
+mat2f_layout_e mat2f_get_layout(mat2f_obj_t);
+int32_t mat2f_get_tile_cols(mat2f_obj_t); // NOTE: Tiles per row of tiles, 0 for row-major.
 bool_t mat2f_is_empty(mat2f_obj_t);
-bool_t mat2f_is_shape_eq(mat2f_obj_t, mat2f_obj_t other);
+bool_t mat2f_is_shape_eq(mat2f_obj_t, mat2f_obj_t other); // NOTE: Same rows, cols and layout.
+void mat2f_copy(mat2f_obj_t, mat2f_obj_t src);
+void mat2f_convert(mat2f_obj_t, mat2f_obj_t src); // NOTE: Copies `src` of the same rows and cols but any layout.
 float* mat2f_at_index(mat2f_obj_t, int32_t idx);
-float* mat2f_at_coord(mat2f_obj_t, int32_t row, int32_t col);
\ No newline at end of file
+float* mat2f_at_coord(mat2f_obj_t, int32_t row, int32_t col);
+
+static inline int32_t mat2f_get_tiled_index(int32_t tile_cols, int32_t row, int32_t col) {
+    const int32_t tile = (row >> MAT2F_TILE_SHIFT) * tile_cols + (col >> MAT2F_TILE_SHIFT);
+    return (tile << (2 * MAT2F_TILE_SHIFT)) + ((row & MAT2F_TILE_MASK) << MAT2F_TILE_SHIFT) + (col & MAT2F_TILE_MASK);
+}
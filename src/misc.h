@@ -1,6 +1,14 @@
 ﻿#pragma once
 #include <stdint.h>
 
+// NOTE: `Windows.h` defines these unless `NOMINMAX` is set.
+#if !defined(min)
+#  define min(A, B) (((A) < (B)) ? (A) : (B))
+#endif
+#if !defined(max)
+#  define max(A, B) (((A) > (B)) ? (A) : (B))
+#endif
+
 #define __DECL_CLAMP_FUNC(TYPE, SUFFIX) \
     TYPE clamp_##SUFFIX(TYPE v, TYPE lo, TYPE hi);
 
@@ -1,10 +1,19 @@
 ﻿#include "perf.h"
 #include "misc.h"
-#include <Windows.h>
+
+#if defined(_WIN32)
+#  include <Windows.h>
+#else
+#  include <time.h>
+#endif
 
 struct _perf_obj_t {
+#if defined(_WIN32)
     LARGE_INTEGER freq; // timer frequency
     LARGE_INTEGER tp_begin, tp_end;
+#else
+    struct timespec tp_begin, tp_end; // CLOCK_MONOTONIC
+#endif
 };
 
 perf_obj_t perf_create() {
@@ -13,10 +22,12 @@ perf_obj_t perf_create() {
         return NULL;
     }
 
+#if defined(_WIN32)
     if (!QueryPerformanceFrequency(&newobj->freq)) {
         perf_destroy(&newobj);
         return NULL;
     }
+#endif
 
     return newobj;
 }
@@ -29,15 +40,24 @@ void perf_destroy(perf_obj_t* pself) {
 
 void perf_begin(perf_obj_t self) {
     assert(self);
+#if defined(_WIN32)
     QueryPerformanceCounter(&self->tp_begin);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &self->tp_begin);
+#endif
 }
 
 void perf_end(perf_obj_t self) {
     assert(self);
+#if defined(_WIN32)
     QueryPerformanceCounter(&self->tp_end);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &self->tp_end);
+#endif
 }
 
 double perf_get_delta_ms(perf_obj_t self) {
+#if defined(_WIN32)
     assert(self->tp_end.QuadPart >= self->tp_begin.QuadPart);
 
     double delta = (double)(self->tp_end.QuadPart - self->tp_begin.QuadPart);
@@ -54,4 +74,11 @@ double perf_get_delta_ms(perf_obj_t self) {
     delta /= (double)self->freq.QuadPart;
 
     return delta;
+#else
+    const double delta =
+        (double)(self->tp_end.tv_sec - self->tp_begin.tv_sec) * 1000.0 +
+        (double)(self->tp_end.tv_nsec - self->tp_begin.tv_nsec) * 1e-6;
+    assert(delta >= 0.0);
+    return delta;
+#endif
 }
\ No newline at end of file
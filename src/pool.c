@@ -0,0 +1,291 @@
+﻿#include "pool.h"
+#include "thread.h"
+#include "atomic.h"
+#include "misc.h"
+
+#define POOL_MAX_JOBS    8 // ranges in flight at once, nested ones included
+#define POOL_SPIN_COUNT 64 // pauses before a waiting thread yields its cpu
+
+#if defined(_MSC_VER)
+#  define POOL_THREAD_LOCAL __declspec(thread)
+#else
+#  define POOL_THREAD_LOCAL __thread
+#endif
+
+typedef enum {
+    POOL_JOB_FREE,
+    POOL_JOB_CLAIMED, // being set up by its submitter
+    POOL_JOB_ACTIVE,
+    POOL_JOB_CLOSING, // done, waiting for the helpers to let go
+} pool_job_state_e;
+
+typedef struct {
+    pool_obj_t pool;
+    int32_t worker_idx;
+    thread_obj_t thread;
+} pool_worker_t;
+
+typedef struct {
+    volatile int32_t state;
+    volatile int32_t user_count; // helpers looking at the job, the slot is only reused once they left
+    pool_range_fn_t fn;
+    void* ctx;
+    int32_t begin, end, grain;
+    volatile int32_t remaining; // chunks not done yet
+    volatile int64_t* shares; // `worker_count` chunk ranges, `begin | end << 32`
+} pool_job_t;
+
+struct _pool_obj_t {
+    int32_t worker_count;
+    pool_worker_t* workers; // [1, worker_count), worker 0 is an outside caller
+    thread_sem_obj_t sem_wake;
+    volatile int32_t fl_shutdown;
+
+    pool_job_t jobs[POOL_MAX_JOBS];
+    int64_t* shares; // `POOL_MAX_JOBS * worker_count`
+};
+
+typedef struct {
+    pool_task_fn_t fn;
+    void* ctx;
+} pool_run_ctx_t;
+
+static POOL_THREAD_LOCAL const pool_worker_t* s_curr_worker; // NOTE: A thread works for one pool at most.
+
+static inline int32_t _pool_get_worker_idx(pool_obj_t self)
+{
+    const pool_worker_t* const worker = s_curr_worker;
+    return (worker && worker->pool == self) ? worker->worker_idx : 0;
+}
+
+static inline int64_t _pool_pack(int32_t lo, int32_t hi)
+{
+    return (int64_t)((uint64_t)(uint32_t)lo | ((uint64_t)(uint32_t)hi << 32));
+}
+
+static inline void _pool_unpack(int64_t v, int32_t* plo, int32_t* phi)
+{
+    *plo = (int32_t)(uint32_t)(uint64_t)v;
+    *phi = (int32_t)(uint32_t)((uint64_t)v >> 32);
+}
+
+// NOTE: A share only ever shrinks, from the front by its owner and from the back by thieves,
+//       so a compare-and-swap never mistakes a stale value for the current one.
+static int32_t _pool_take_chunk(pool_job_t* job, int32_t worker_count, int32_t worker_idx)
+{
+    for (int32_t k = 0; k < worker_count; ++k) {
+        volatile int64_t* const share = &job->shares[(worker_idx + k) % worker_count];
+        for (;;) {
+            const int64_t v = atomic_load_i64(share);
+            int32_t lo, hi;
+            _pool_unpack(v, &lo, &hi);
+            if (lo >= hi) {
+                break;
+            }
+            if (k == 0) {
+                if (atomic_cas_i64(share, v, _pool_pack(lo + 1, hi))) {
+                    return lo;
+                }
+            } else {
+                if (atomic_cas_i64(share, v, _pool_pack(lo, hi - 1))) {
+                    return hi - 1;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+static bool_t _pool_drain(pool_obj_t self, pool_job_t* job, int32_t worker_idx)
+{
+    bool_t fl_ran = FALSE;
+    for (;;) {
+        const int32_t chunk = _pool_take_chunk(job, self->worker_count, worker_idx);
+        if (chunk < 0) {
+            return fl_ran;
+        }
+        const int32_t begin = job->begin + chunk * job->grain;
+        job->fn(job->ctx, worker_idx, begin, min(begin + job->grain, job->end));
+        atomic_add_i32(&job->remaining, -1);
+        fl_ran = TRUE;
+    }
+}
+
+static void _pool_wait(volatile int32_t* p, int32_t v)
+{
+    int32_t spin_count = 0;
+    while (atomic_load_i32(p) != v) {
+        if (++spin_count < POOL_SPIN_COUNT) {
+            atomic_pause();
+        } else {
+            thread_sleep_ms(0);
+        }
+    }
+}
+
+static void _pool_worker_main(void* arg)
+{
+    const pool_worker_t* const worker = (const pool_worker_t*)arg;
+    const pool_obj_t self = worker->pool;
+    s_curr_worker = worker;
+    for (;;) {
+        thread_sem_wait(self->sem_wake);
+        if (atomic_load_i32(&self->fl_shutdown)) {
+            break;
+        }
+        while (pool_help(self)) {
+        }
+    }
+}
+
+static void _pool_run_range(void* ctx, int32_t worker_idx, int32_t begin, int32_t end)
+{
+    const pool_run_ctx_t* const run = (const pool_run_ctx_t*)ctx;
+    for (int32_t i = begin; i < end; ++i) {
+        run->fn(run->ctx, worker_idx, i);
+    }
+}
+
+pool_obj_t pool_create(int32_t worker_count) {
+    if (worker_count <= 0) {
+        worker_count = thread_get_cpu_count();
+    }
+
+    pool_obj_t newobj = (pool_obj_t)calloc(1, sizeof(struct _pool_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->worker_count = worker_count;
+    newobj->workers = (pool_worker_t*)calloc(worker_count, sizeof(pool_worker_t));
+    newobj->shares = (int64_t*)calloc((size_t)POOL_MAX_JOBS * worker_count, sizeof(int64_t));
+    newobj->sem_wake = thread_sem_create(0);
+    if (!newobj->workers || !newobj->shares || !newobj->sem_wake) {
+        pool_destroy(&newobj);
+        return NULL;
+    }
+
+    for (int32_t i = 0; i < POOL_MAX_JOBS; ++i) {
+        newobj->jobs[i].shares = newobj->shares + (size_t)i * worker_count;
+    }
+
+    for (int32_t i = 1; i < worker_count; ++i) {
+        pool_worker_t* const worker = &newobj->workers[i];
+        worker->pool = newobj;
+        worker->worker_idx = i;
+        worker->thread = thread_create(_pool_worker_main, worker);
+        if (!worker->thread) {
+            pool_destroy(&newobj);
+            return NULL;
+        }
+    }
+
+    return newobj;
+}
+
+void pool_destroy(pool_obj_t* pself) {
+    if (pself && *pself) {
+        const pool_obj_t self = *pself;
+        if (self->workers) {
+            int32_t thread_count = 0;
+            for (int32_t i = 1; i < self->worker_count; ++i) {
+                thread_count += !!self->workers[i].thread;
+            }
+            atomic_store_i32(&self->fl_shutdown, TRUE);
+            if (thread_count) {
+                thread_sem_post(self->sem_wake, thread_count);
+            }
+            for (int32_t i = 1; i < self->worker_count; ++i) {
+                thread_destroy(&self->workers[i].thread);
+            }
+        }
+        thread_sem_destroy(&self->sem_wake);
+        SAFE_FREE(self->shares);
+        SAFE_FREE(self->workers);
+        SAFE_FREE(*pself);
+    }
+}
+
+int32_t pool_get_worker_count(pool_obj_t self) {
+    assert(self);
+    return self->worker_count;
+}
+
+void pool_run(pool_obj_t self, pool_task_fn_t fn, void* ctx, int32_t task_count) {
+    assert(self);
+    assert(fn);
+
+    pool_run_ctx_t run = { fn, ctx };
+    pool_parallel_for(self, _pool_run_range, &run, 0, task_count, 1);
+}
+
+void pool_parallel_for(pool_obj_t self, pool_range_fn_t fn, void* ctx, int32_t begin, int32_t end, int32_t grain) {
+    assert(fn);
+    assert(grain > 0);
+
+    if (begin >= end) {
+        return;
+    }
+
+    const int32_t worker_idx = self ? _pool_get_worker_idx(self) : 0;
+    const int32_t chunk_count = (int32_t)(((int64_t)end - begin + grain - 1) / grain);
+
+    // NOTE: A single chunk or a single worker runs inline, without waking anyone up.
+    if (!self || self->worker_count == 1 || chunk_count == 1) {
+        fn(ctx, worker_idx, begin, end);
+        return;
+    }
+
+    pool_job_t* job = NULL;
+    for (int32_t i = 0; i < POOL_MAX_JOBS && !job; ++i) {
+        if (atomic_cas_i32(&self->jobs[i].state, POOL_JOB_FREE, POOL_JOB_CLAIMED)) {
+            job = &self->jobs[i];
+        }
+    }
+    if (!job) {
+        fn(ctx, worker_idx, begin, end); // NOTE: Nested too deep, no slot left.
+        return;
+    }
+
+    const int32_t worker_count = self->worker_count;
+    job->fn = fn;
+    job->ctx = ctx;
+    job->begin = begin;
+    job->end = end;
+    job->grain = grain;
+    atomic_store_i32(&job->remaining, chunk_count);
+    for (int32_t w = 0; w < worker_count; ++w) {
+        const int32_t
+            lo = (int32_t)((int64_t)chunk_count * w / worker_count),
+            hi = (int32_t)((int64_t)chunk_count * (w + 1) / worker_count);
+        atomic_store_i64(&job->shares[w], _pool_pack(lo, hi));
+    }
+    atomic_store_i32(&job->state, POOL_JOB_ACTIVE);
+    thread_sem_post(self->sem_wake, min(worker_count, chunk_count) - 1);
+
+    _pool_drain(self, job, worker_idx);
+    _pool_wait(&job->remaining, 0);
+
+    atomic_store_i32(&job->state, POOL_JOB_CLOSING);
+    _pool_wait(&job->user_count, 0);
+    atomic_store_i32(&job->state, POOL_JOB_FREE);
+}
+
+bool_t pool_help(pool_obj_t self) {
+    assert(self);
+
+    const int32_t worker_idx = _pool_get_worker_idx(self);
+    bool_t fl_ran = FALSE;
+    for (int32_t i = 0; i < POOL_MAX_JOBS; ++i) {
+        pool_job_t* const job = &self->jobs[i];
+        if (atomic_load_i32(&job->state) != POOL_JOB_ACTIVE) {
+            continue;
+        }
+        atomic_add_i32(&job->user_count, 1);
+        if (atomic_load_i32(&job->state) == POOL_JOB_ACTIVE) { // NOTE: Checked again, the slot may have been reused meanwhile.
+            fl_ran |= _pool_drain(self, job, worker_idx);
+        }
+        atomic_add_i32(&job->user_count, -1);
+    }
+    return fl_ran;
+}
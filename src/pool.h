@@ -0,0 +1,20 @@
+﻿#pragma once
+#include "common.h"
+
+// Work-stealing thread pool. Work is submitted as a range split into chunks of `grain` items. Every
+// worker starts on its own contiguous share of the chunks, taking them from the front, and once it
+// runs out, steals single chunks from the back of the other shares. A range with one chunk, or a pool
+// with one worker, runs inline without touching the other threads. Ranges may be submitted from
+// within a task, the submitting worker takes part in its range while idle workers help.
+
+DECL_OBJECT(pool_obj_t);
+
+typedef void(*pool_task_fn_t)(void* ctx, int32_t worker_idx, int32_t task_idx);
+typedef void(*pool_range_fn_t)(void* ctx, int32_t worker_idx, int32_t begin, int32_t end);
+
+pool_obj_t pool_create(int32_t worker_count); // NOTE: `worker_count` includes the calling thread, 0 uses the number of cpus.
+void pool_destroy(pool_obj_t*);
+int32_t pool_get_worker_count(pool_obj_t);
+void pool_run(pool_obj_t, pool_task_fn_t fn, void* ctx, int32_t task_count); // NOTE: Blocks until all tasks are done. A caller outside of the pool runs tasks as worker 0.
+void pool_parallel_for(pool_obj_t, pool_range_fn_t fn, void* ctx, int32_t begin, int32_t end, int32_t grain); // NOTE: Same as `pool_run()` over chunks of [begin, end). NULL `pool` runs `fn` once inline.
+bool_t pool_help(pool_obj_t); // NOTE: Runs pending chunks of any range, for threads waiting on other work. FALSE if there were none.
@@ -0,0 +1,673 @@
+﻿#include "rec.h"
+#include "thread.h"
+#include "atomic.h"
+
+#if defined(HAS_SSE2)
+#  include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#  include <io.h>
+#  define REC_FSEEK(FP, OFF) _fseeki64((FP), (__int64)(OFF), SEEK_SET)
+#  define REC_FTRUNCATE(FP, OFF) _chsize_s(_fileno(FP), (__int64)(OFF))
+#else
+#  include <unistd.h>
+#  define REC_FSEEK(FP, OFF) fseeko((FP), (off_t)(OFF), SEEK_SET)
+#  define REC_FTRUNCATE(FP, OFF) ftruncate(fileno(FP), (off_t)(OFF))
+#endif
+
+#define REC_MAGIC_HEADER  "FLRC"
+#define REC_MAGIC_FOOTER  "FLRI"
+#define REC_VERSION       1
+
+#define REC_HEADER_SIZE   24 // magic, version, rows, cols, keyframe interval, reserved
+#define REC_FOOTER_SIZE   16 // index offset, frame count, magic
+#define REC_RECORD_SIZE   8  // per-frame: payload size, flags
+#define REC_INDEX_SIZE    16 // per-frame: offset, payload size, flags
+
+#define REC_FRAME_KEY     (1u << 0) // payload is a full frame, otherwise a delta against the previous frame
+#define REC_FRAME_RAW     (1u << 1) // payload is stored uncompressed
+
+#define REC_LZ_HASH_BITS  14
+#define REC_LZ_MIN_MATCH  4
+#define REC_LZ_MAX_OFFSET 65535
+
+typedef struct {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t flags;
+} rec_index_entry_t;
+
+struct _rec_obj_t {
+    FILE* fp;
+    int32_t rows, cols, frame_size;
+    int32_t ring_size, keyframe_interval;
+
+    uint8_t* ring_buff;
+    volatile int64_t head; // number of frames pushed (written by producer only)
+    volatile int64_t tail; // number of frames consumed (written by writer only)
+    volatile int64_t dropped_count;
+    volatile int64_t bytes_written;
+    thread_sem_obj_t sem_ready; // posted once per pushed frame, plus a final post to stop
+
+    // Writer thread state
+    uint8_t* prev_frame;
+    uint8_t* delta_buff;
+    uint8_t* comp_buff;
+    int32_t* hash_tab;
+    rec_index_entry_t* index;
+    int64_t index_len, index_cap;
+    uint64_t file_offset;
+    bool_t fl_io_error;
+
+    thread_obj_t writer;
+};
+
+struct _rec_reader_obj_t {
+    FILE* fp;
+    int32_t rows, cols, frame_size;
+    int32_t frame_count;
+    rec_index_entry_t* index;
+    uint8_t* frame;
+    uint8_t* delta_buff;
+    uint8_t* comp_buff;
+    size_t comp_buff_sz;
+    int32_t curr_frame_idx;
+};
+
+static inline size_t _rec_lz_bound(size_t n)
+{
+    return n + (n / 255) + 16;
+}
+
+static inline void _rec_put_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v); p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void _rec_put_u64(uint8_t* p, uint64_t v)
+{
+    _rec_put_u32(p, (uint32_t)v);
+    _rec_put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint32_t _rec_get_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t _rec_get_u64(const uint8_t* p)
+{
+    return (uint64_t)_rec_get_u32(p) | ((uint64_t)_rec_get_u32(p + 4) << 32);
+}
+
+static inline uint32_t _rec_read_u32_unaligned(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline size_t _rec_lz_put_length(uint8_t* dst, size_t len)
+{
+    size_t op = 0;
+    while (len >= 255) {
+        dst[op++] = 255;
+        len -= 255;
+    }
+    dst[op++] = (uint8_t)len;
+    return op;
+}
+
+//
+// Byte-oriented LZ77 in the spirit of LZ4. Each sequence is:
+//   token(literal length:4 | match length - 4:4) [length ext] literals offset(16-bit LE) [length ext]
+// The last sequence carries literals only. Long zero runs produced by the delta stage
+// collapse to a handful of bytes through overlapping offset-1 matches.
+//
+static size_t _rec_lz_compress(const uint8_t* src, size_t n, uint8_t* dst, int32_t* hash_tab)
+{
+    memset(hash_tab, 0, sizeof(int32_t) << REC_LZ_HASH_BITS);
+
+    size_t ip = 0, anchor = 0, op = 0;
+    while (n >= REC_LZ_MIN_MATCH && ip <= n - REC_LZ_MIN_MATCH) {
+        const uint32_t seq = _rec_read_u32_unaligned(src + ip);
+        const uint32_t h = (seq * 2654435761u) >> (32 - REC_LZ_HASH_BITS);
+        const int64_t ref = (int64_t)hash_tab[h] - 1;
+        hash_tab[h] = (int32_t)ip + 1;
+
+        if (ref < 0 || (int64_t)ip - ref > REC_LZ_MAX_OFFSET || _rec_read_u32_unaligned(src + ref) != seq) {
+            ip += 1 + ((ip - anchor) >> 6); // skip faster through incompressible regions
+            continue;
+        }
+
+        size_t match_len = REC_LZ_MIN_MATCH;
+        while (ip + match_len < n && src[(size_t)ref + match_len] == src[ip + match_len]) {
+            ++match_len;
+        }
+
+        const size_t lit_len = ip - anchor;
+        uint8_t* const token = dst + op++;
+        *token = (uint8_t)(((lit_len >= 15) ? 15 : lit_len) << 4);
+        if (lit_len >= 15) {
+            op += _rec_lz_put_length(dst + op, lit_len - 15);
+        }
+        memcpy(dst + op, src + anchor, lit_len);
+        op += lit_len;
+
+        const size_t offset = ip - (size_t)ref;
+        dst[op++] = (uint8_t)(offset);
+        dst[op++] = (uint8_t)(offset >> 8);
+
+        const size_t ml = match_len - REC_LZ_MIN_MATCH;
+        *token |= (uint8_t)((ml >= 15) ? 15 : ml);
+        if (ml >= 15) {
+            op += _rec_lz_put_length(dst + op, ml - 15);
+        }
+
+        ip += match_len;
+        anchor = ip;
+    }
+
+    // Last literals
+    const size_t lit_len = n - anchor;
+    dst[op++] = (uint8_t)(((lit_len >= 15) ? 15 : lit_len) << 4);
+    if (lit_len >= 15) {
+        op += _rec_lz_put_length(dst + op, lit_len - 15);
+    }
+    memcpy(dst + op, src + anchor, lit_len);
+    op += lit_len;
+
+    return op;
+}
+
+static bool_t _rec_lz_decompress(const uint8_t* src, size_t n, uint8_t* dst, size_t dst_n)
+{
+    size_t ip = 0, op = 0;
+    while (ip < n) {
+        const uint8_t token = src[ip++];
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= n) {
+                    return FALSE;
+                }
+                b = src[ip++];
+                lit_len += b;
+            } while (b == 255);
+        }
+        if (ip + lit_len > n || op + lit_len > dst_n) {
+            return FALSE;
+        }
+        memcpy(dst + op, src + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip >= n) {
+            break; // last sequence
+        }
+
+        if (ip + 2 > n) {
+            return FALSE;
+        }
+        const size_t offset = (size_t)src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        if (!offset || offset > op) {
+            return FALSE;
+        }
+
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= n) {
+                    return FALSE;
+                }
+                b = src[ip++];
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += REC_LZ_MIN_MATCH;
+        if (op + match_len > dst_n) {
+            return FALSE;
+        }
+
+        const uint8_t* ref = dst + op - offset;
+        for (size_t i = 0; i < match_len; ++i) { // NOTE: may overlap
+            dst[op + i] = ref[i];
+        }
+        op += match_len;
+    }
+    return op == dst_n;
+}
+
+static inline void _rec_quantize(uint8_t* dst, const float* src, int32_t n)
+{
+    int32_t i = 0;
+#if defined(HAS_SSE2)
+    const __m128 lo = _mm_setzero_ps();
+    const __m128 hi = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f); // NOTE: Truncating `x + 0.5` like the scalar tail, `_mm_cvtps_epi32()` would round half to even.
+    for (; i + 16 <= n; i += 16) {
+        const __m128i q0 = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i +  0), lo), hi), half));
+        const __m128i q1 = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i +  4), lo), hi), half));
+        const __m128i q2 = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i +  8), lo), hi), half));
+        const __m128i q3 = _mm_cvttps_epi32(_mm_add_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 12), lo), hi), half));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, q3)));
+    }
+#endif
+    for (; i < n; ++i) {
+        const float d = src[i];
+        dst[i] = (uint8_t)(((d > 0.0f) ? ((d < 255.0f) ? d : 255.0f) : 0.0f) + 0.5f);
+    }
+}
+
+static bool_t _rec_write_header(FILE* fp, int32_t rows, int32_t cols, int32_t keyframe_interval)
+{
+    uint8_t buff[REC_HEADER_SIZE] = { 0 };
+    memcpy(buff, REC_MAGIC_HEADER, 4);
+    _rec_put_u32(buff + 4, REC_VERSION);
+    _rec_put_u32(buff + 8, (uint32_t)rows);
+    _rec_put_u32(buff + 12, (uint32_t)cols);
+    _rec_put_u32(buff + 16, (uint32_t)keyframe_interval);
+    return fwrite(buff, 1, sizeof(buff), fp) == sizeof(buff);
+}
+
+static void _rec_write_frame(rec_obj_t self, const uint8_t* frame)
+{
+    const size_t n = (size_t)self->frame_size;
+    const bool_t is_key = (self->index_len % self->keyframe_interval) == 0;
+
+    const uint8_t* src = frame;
+    if (!is_key) {
+        const uint8_t* const prev = self->prev_frame;
+        uint8_t* const delta = self->delta_buff;
+        for (size_t i = 0; i < n; ++i) {
+            delta[i] = (uint8_t)(frame[i] - prev[i]);
+        }
+        src = delta;
+    }
+
+    uint32_t flags = is_key ? REC_FRAME_KEY : 0;
+    size_t payload_sz = _rec_lz_compress(src, n, self->comp_buff, self->hash_tab);
+    const uint8_t* payload = self->comp_buff;
+    if (payload_sz >= n) {
+        payload = src;
+        payload_sz = n;
+        flags |= REC_FRAME_RAW;
+    }
+
+    if (self->index_len == self->index_cap) {
+        const int64_t new_cap = self->index_cap ? self->index_cap * 2 : 1024;
+        rec_index_entry_t* const new_index = (rec_index_entry_t*)realloc(self->index, (size_t)new_cap * sizeof(rec_index_entry_t));
+        if (!new_index) {
+            self->fl_io_error = TRUE;
+            return;
+        }
+        self->index = new_index;
+        self->index_cap = new_cap;
+    }
+
+    uint8_t record[REC_RECORD_SIZE];
+    _rec_put_u32(record, (uint32_t)payload_sz);
+    _rec_put_u32(record + 4, flags);
+    if (fwrite(record, 1, sizeof(record), self->fp) != sizeof(record) ||
+        fwrite(payload, 1, payload_sz, self->fp) != payload_sz)
+    {
+        self->fl_io_error = TRUE;
+        return;
+    }
+
+    self->index[self->index_len++] = (rec_index_entry_t) {
+        .offset = self->file_offset,
+        .size = (uint32_t)payload_sz,
+        .flags = flags,
+    };
+    self->file_offset += REC_RECORD_SIZE + payload_sz;
+    atomic_add_i64(&self->bytes_written, (int64_t)(REC_RECORD_SIZE + payload_sz));
+
+    memcpy(self->prev_frame, frame, n);
+}
+
+static void _rec_write_index(rec_obj_t self)
+{
+    // NOTE: Goes right after the last complete frame, so after an I/O error it replaces whatever part
+    //       of the failed record reached the file and the frames before it stay readable.
+    clearerr(self->fp);
+    if (REC_FSEEK(self->fp, self->file_offset) != 0) {
+        self->fl_io_error = TRUE;
+        return;
+    }
+
+    // NOTE: Every entry is encoded over its own slot, the index is not used afterwards.
+    assert(sizeof(rec_index_entry_t) == REC_INDEX_SIZE);
+    uint8_t* const entries = (uint8_t*)self->index;
+    for (int64_t i = 0; i < self->index_len; ++i) {
+        const rec_index_entry_t entry = self->index[i];
+        _rec_put_u64(entries + i * REC_INDEX_SIZE, entry.offset);
+        _rec_put_u32(entries + i * REC_INDEX_SIZE + 8, entry.size);
+        _rec_put_u32(entries + i * REC_INDEX_SIZE + 12, entry.flags);
+    }
+    const size_t entries_sz = (size_t)self->index_len * REC_INDEX_SIZE;
+    if (entries_sz && fwrite(entries, 1, entries_sz, self->fp) != entries_sz) {
+        self->fl_io_error = TRUE;
+        return;
+    }
+
+    uint8_t footer[REC_FOOTER_SIZE];
+    _rec_put_u64(footer, self->file_offset);
+    _rec_put_u32(footer + 8, (uint32_t)self->index_len);
+    memcpy(footer + 12, REC_MAGIC_FOOTER, 4);
+    if (fwrite(footer, 1, sizeof(footer), self->fp) != sizeof(footer) ||
+        REC_FTRUNCATE(self->fp, self->file_offset + (uint64_t)self->index_len * REC_INDEX_SIZE + REC_FOOTER_SIZE) != 0)
+    {
+        self->fl_io_error = TRUE;
+    }
+}
+
+static void _rec_writer_main(void* ctx)
+{
+    const rec_obj_t self = (rec_obj_t)ctx;
+    assert(self);
+
+    for (;;) {
+        thread_sem_wait(self->sem_ready);
+        const int64_t tail = self->tail;
+        if (tail == atomic_load_i64(&self->head)) {
+            break; // NOTE: Every frame has its own post, so an empty ring here is the stop post of `rec_destroy()`.
+        }
+
+        if (!self->fl_io_error) {
+            _rec_write_frame(self, self->ring_buff + (size_t)(tail % self->ring_size) * (size_t)self->frame_size);
+        }
+        atomic_store_i64(&self->tail, tail + 1);
+    }
+
+    _rec_write_index(self);
+}
+
+rec_obj_t rec_create(const char* path, int32_t rows, int32_t cols, int32_t ring_size, int32_t keyframe_interval) {
+    assert(path);
+    if (rows <= 0 || cols <= 0 || ring_size < 2 || keyframe_interval < 1) {
+        return NULL;
+    }
+
+    rec_obj_t newobj = (rec_obj_t)calloc(1, sizeof(struct _rec_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->rows = rows;
+    newobj->cols = cols;
+    newobj->frame_size = rows * cols;
+    newobj->ring_size = ring_size;
+    newobj->keyframe_interval = keyframe_interval;
+
+    const size_t frame_size = (size_t)newobj->frame_size;
+    newobj->ring_buff = (uint8_t*)malloc(frame_size * (size_t)ring_size);
+    newobj->prev_frame = (uint8_t*)calloc(frame_size, 1);
+    newobj->delta_buff = (uint8_t*)malloc(frame_size);
+    newobj->comp_buff = (uint8_t*)malloc(_rec_lz_bound(frame_size));
+    newobj->hash_tab = (int32_t*)malloc(sizeof(int32_t) << REC_LZ_HASH_BITS);
+    newobj->sem_ready = thread_sem_create(0);
+    if (
+        !newobj->ring_buff ||
+        !newobj->prev_frame ||
+        !newobj->delta_buff ||
+        !newobj->comp_buff ||
+        !newobj->hash_tab ||
+        !newobj->sem_ready
+        )
+    {
+        rec_destroy(&newobj);
+        return NULL;
+    }
+
+    newobj->fp = fopen(path, "wb");
+    if (!newobj->fp) {
+        rec_destroy(&newobj);
+        return NULL;
+    }
+    setvbuf(newobj->fp, NULL, _IONBF, 0); // NOTE: A write that fails must fail in `fwrite()`, not in a later flush, so that `file_offset` only counts what reached the file.
+
+    if (!_rec_write_header(newobj->fp, rows, cols, keyframe_interval)) {
+        rec_destroy(&newobj);
+        return NULL;
+    }
+    newobj->file_offset = REC_HEADER_SIZE;
+
+    newobj->writer = thread_create(_rec_writer_main, newobj);
+    if (!newobj->writer) {
+        rec_destroy(&newobj);
+        return NULL;
+    }
+
+    return newobj;
+}
+
+void rec_destroy(rec_obj_t* pself) {
+    if (pself && *pself) {
+        if ((*pself)->writer) {
+            thread_sem_post((*pself)->sem_ready, 1);
+            thread_destroy(&(*pself)->writer);
+        }
+        thread_sem_destroy(&(*pself)->sem_ready);
+        if ((*pself)->fp) {
+            fclose((*pself)->fp);
+            (*pself)->fp = NULL;
+        }
+        SAFE_FREE((*pself)->index);
+        SAFE_FREE((*pself)->hash_tab);
+        SAFE_FREE((*pself)->comp_buff);
+        SAFE_FREE((*pself)->delta_buff);
+        SAFE_FREE((*pself)->prev_frame);
+        SAFE_FREE((*pself)->ring_buff);
+        SAFE_FREE(*pself);
+    }
+}
+
+bool_t rec_push_frame(rec_obj_t self, const float* data) {
+    assert(self);
+    assert(data);
+
+    const int64_t head = self->head;
+    if (head - atomic_load_i64(&self->tail) >= self->ring_size) {
+        atomic_add_i64(&self->dropped_count, 1);
+        return FALSE;
+    }
+
+    _rec_quantize(
+        self->ring_buff + (size_t)(head % self->ring_size) * (size_t)self->frame_size,
+        data,
+        self->frame_size
+    );
+
+    atomic_store_i64(&self->head, head + 1);
+    thread_sem_post(self->sem_ready, 1);
+    return TRUE;
+}
+
+int64_t rec_get_frame_count(rec_obj_t self) {
+    assert(self);
+    return atomic_load_i64(&self->head);
+}
+
+int64_t rec_get_dropped_count(rec_obj_t self) {
+    assert(self);
+    return atomic_load_i64(&self->dropped_count);
+}
+
+int64_t rec_get_bytes_written(rec_obj_t self) {
+    assert(self);
+    return atomic_load_i64(&self->bytes_written);
+}
+
+static bool_t _rec_reader_decode_frame(rec_reader_obj_t self, int32_t frame_idx)
+{
+    const rec_index_entry_t* const entry = &self->index[frame_idx];
+    if (entry->size > self->comp_buff_sz) {
+        return FALSE;
+    }
+
+    if (REC_FSEEK(self->fp, entry->offset + REC_RECORD_SIZE) != 0 ||
+        fread(self->comp_buff, 1, entry->size, self->fp) != entry->size)
+    {
+        return FALSE;
+    }
+
+    const size_t n = (size_t)self->frame_size;
+    uint8_t* const dst = (entry->flags & REC_FRAME_KEY) ? self->frame : self->delta_buff;
+    if (entry->flags & REC_FRAME_RAW) {
+        if (entry->size != n) {
+            return FALSE;
+        }
+        memcpy(dst, self->comp_buff, n);
+    } else if (!_rec_lz_decompress(self->comp_buff, entry->size, dst, n)) {
+        return FALSE;
+    }
+
+    if (!(entry->flags & REC_FRAME_KEY)) {
+        uint8_t* const frame = self->frame;
+        const uint8_t* const delta = self->delta_buff;
+        for (size_t i = 0; i < n; ++i) {
+            frame[i] = (uint8_t)(frame[i] + delta[i]);
+        }
+    }
+
+    return TRUE;
+}
+
+rec_reader_obj_t rec_reader_create(const char* path) {
+    assert(path);
+
+    rec_reader_obj_t newobj = (rec_reader_obj_t)calloc(1, sizeof(struct _rec_reader_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+    newobj->curr_frame_idx = -1;
+
+    newobj->fp = fopen(path, "rb");
+    if (!newobj->fp) {
+        rec_reader_destroy(&newobj);
+        return NULL;
+    }
+
+    uint8_t header[REC_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), newobj->fp) != sizeof(header) ||
+        memcmp(header, REC_MAGIC_HEADER, 4) != 0 ||
+        _rec_get_u32(header + 4) != REC_VERSION)
+    {
+        rec_reader_destroy(&newobj);
+        return NULL;
+    }
+    newobj->rows = (int32_t)_rec_get_u32(header + 8);
+    newobj->cols = (int32_t)_rec_get_u32(header + 12);
+    if (newobj->rows <= 0 || newobj->cols <= 0) {
+        rec_reader_destroy(&newobj);
+        return NULL;
+    }
+    newobj->frame_size = newobj->rows * newobj->cols;
+
+    uint8_t footer[REC_FOOTER_SIZE];
+    if (fseek(newobj->fp, -REC_FOOTER_SIZE, SEEK_END) != 0 ||
+        fread(footer, 1, sizeof(footer), newobj->fp) != sizeof(footer) ||
+        memcmp(footer + 12, REC_MAGIC_FOOTER, 4) != 0)
+    {
+        rec_reader_destroy(&newobj); // NOTE: Recording was not closed properly.
+        return NULL;
+    }
+    const uint64_t index_offset = _rec_get_u64(footer);
+    newobj->frame_count = (int32_t)_rec_get_u32(footer + 8);
+
+    newobj->index = (rec_index_entry_t*)calloc((size_t)newobj->frame_count + 1, sizeof(rec_index_entry_t));
+    if (!newobj->index || REC_FSEEK(newobj->fp, index_offset) != 0) {
+        rec_reader_destroy(&newobj);
+        return NULL;
+    }
+
+    uint8_t entry[REC_INDEX_SIZE];
+    for (int32_t i = 0; i < newobj->frame_count; ++i) {
+        if (fread(entry, 1, sizeof(entry), newobj->fp) != sizeof(entry)) {
+            rec_reader_destroy(&newobj);
+            return NULL;
+        }
+        newobj->index[i].offset = _rec_get_u64(entry);
+        newobj->index[i].size = _rec_get_u32(entry + 8);
+        newobj->index[i].flags = _rec_get_u32(entry + 12);
+    }
+
+    const size_t frame_size = (size_t)newobj->frame_size;
+    newobj->comp_buff_sz = _rec_lz_bound(frame_size);
+    newobj->frame = (uint8_t*)calloc(frame_size, 1);
+    newobj->delta_buff = (uint8_t*)malloc(frame_size);
+    newobj->comp_buff = (uint8_t*)malloc(newobj->comp_buff_sz);
+    if (!newobj->frame || !newobj->delta_buff || !newobj->comp_buff) {
+        rec_reader_destroy(&newobj);
+        return NULL;
+    }
+
+    return newobj;
+}
+
+void rec_reader_destroy(rec_reader_obj_t* pself) {
+    if (pself && *pself) {
+        if ((*pself)->fp) {
+            fclose((*pself)->fp);
+            (*pself)->fp = NULL;
+        }
+        SAFE_FREE((*pself)->comp_buff);
+        SAFE_FREE((*pself)->delta_buff);
+        SAFE_FREE((*pself)->frame);
+        SAFE_FREE((*pself)->index);
+        SAFE_FREE(*pself);
+    }
+}
+
+int32_t rec_reader_get_rows(rec_reader_obj_t self) {
+    assert(self);
+    return self->rows;
+}
+
+int32_t rec_reader_get_cols(rec_reader_obj_t self) {
+    assert(self);
+    return self->cols;
+}
+
+int32_t rec_reader_get_frame_count(rec_reader_obj_t self) {
+    assert(self);
+    return self->frame_count;
+}
+
+const uint8_t* rec_reader_read_frame(rec_reader_obj_t self, int32_t frame_idx) {
+    assert(self);
+    if (frame_idx < 0 || frame_idx >= self->frame_count) {
+        return NULL;
+    }
+
+    if (frame_idx == self->curr_frame_idx) {
+        return self->frame;
+    }
+
+    // Find the nearest keyframe at or before the target.
+    int32_t start_idx = frame_idx;
+    while (start_idx > 0 && !(self->index[start_idx].flags & REC_FRAME_KEY)) {
+        --start_idx;
+    }
+
+    // Continue from the current frame when it lies between that keyframe and the target (sequential playback).
+    if (self->curr_frame_idx >= start_idx && self->curr_frame_idx < frame_idx) {
+        start_idx = self->curr_frame_idx + 1;
+    }
+
+    for (int32_t i = start_idx; i <= frame_idx; ++i) {
+        if (!_rec_reader_decode_frame(self, i)) {
+            self->curr_frame_idx = -1;
+            return NULL;
+        }
+        self->curr_frame_idx = i;
+    }
+
+    return self->frame;
+}
\ No newline at end of file
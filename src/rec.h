@@ -0,0 +1,29 @@
+﻿#pragma once
+#include "common.h"
+
+// Density frame recorder.
+// Frames are quantized to 8 bits on the caller's thread, handed over through a lock-free
+// single-producer/single-consumer ring and compressed by a background writer thread
+// (temporal delta against the previous frame + LZ stage) into a seekable container:
+//
+//   [header] [frame 0] [frame 1] ... [frame index] [footer]
+//
+// Every `keyframe_interval`-th frame is stored without delta so that the reader can
+// seek to any frame by decoding from the nearest preceding keyframe.
+
+DECL_OBJECT(rec_obj_t);
+DECL_OBJECT(rec_reader_obj_t);
+
+rec_obj_t rec_create(const char* path, int32_t rows, int32_t cols, int32_t ring_size, int32_t keyframe_interval);
+void rec_destroy(rec_obj_t*); // NOTE: Drains pending frames and writes the frame index before closing the file. After an I/O error, the index covers the frames written before it.
+bool_t rec_push_frame(rec_obj_t, const float* data); // NOTE: Never blocks. Returns `FALSE` if the ring is full and the frame was dropped.
+int64_t rec_get_frame_count(rec_obj_t);
+int64_t rec_get_dropped_count(rec_obj_t);
+int64_t rec_get_bytes_written(rec_obj_t);
+
+rec_reader_obj_t rec_reader_create(const char* path);
+void rec_reader_destroy(rec_reader_obj_t*);
+int32_t rec_reader_get_rows(rec_reader_obj_t);
+int32_t rec_reader_get_cols(rec_reader_obj_t);
+int32_t rec_reader_get_frame_count(rec_reader_obj_t);
+const uint8_t* rec_reader_read_frame(rec_reader_obj_t, int32_t frame_idx); // NOTE: Returned buffer is owned by the reader and valid until the next call.
\ No newline at end of file
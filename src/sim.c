@@ -1,422 +1,980 @@
 ﻿#include "sim.h"
+#include "sim_kern.h"
+#include "sim_spec.h"
+#include "sim_mask.h"
+#include "graph.h"
+#include "pool.h"
+#include "thread.h"
 #include "mat.h"
 #include "misc.h"
 #include <math.h>
 
+#if defined(HAS_SSE2)
+#  include <emmintrin.h>
+#endif
+
+#define SIM_SPLAT_BAND_ROWS 16 // rows per bin used by the batched splat rasterizer
+#define SIM_RESIZE_SOLVE_ITER 40 // Gauss-Seidel sweeps of the projection after a resize, a one-off
+#define SIM_OBSTACLE_PIXEL ((pixel_t) { .a = 0xff, .r = 0x70, .g = 0x70, .b = 0x78 })
+
+typedef struct {
+    int32_t r0, r1, c0, c1; // clipped support, inclusive
+    int32_t wx_offset; // offset of the horizontal weights in the scratch buffer
+    float cy, inv_r2;
+} sim_splat_span_t;
+
+typedef enum {
+    SIM_LANE_DENSITY,
+    SIM_LANE_VX, // also the projections
+    SIM_LANE_VY,
+    SIM_LANE_COUNT,
+} sim_lane_e; // fields solved concurrently, each with its own spectral solver scratch
+
+struct _sim_scratch_obj_t {
+    mat2f_obj_t m_vx0; // prev x-velocity
+    mat2f_obj_t m_vy0; // prev y-velocity
+    mat2f_obj_t m_d0; // prev density
+    mat2f_obj_t m_p; // pressure of the projections
+    mat2f_obj_t m_div; // divergence of the projections
+    sim_spec_obj_t spec[SIM_LANE_COUNT]; // transform plans of the spectral solver
+    mat2f_obj_t m_c0[SIM_MAX_CHANNELS]; // prev of the scalar channels past the density, from index 1
+    int32_t channel_count; // reserved, the density included
+};
+
+typedef struct {
+    int32_t factor; // requested fine cells per coarse cell, the coarse interior is rounded to whole cells
+    mat2f_obj_t m_vx; // velocity, solved on the coarse grid
+    mat2f_obj_t m_vy;
+    mat2f_obj_t m_vx_base; // fine velocity as last upsampled, injected forces are the difference to it
+    mat2f_obj_t m_vy_base;
+    sim_scratch_obj_t scratch; // of the coarse grid, its density field is unused
+    uint8_t* solid; // coarse cells covering any solid fine cell
+    sim_mask_obj_t mask; // compiled `solid`
+    int32_t* first; // first fine cell of every coarse cell along an axis, `first[Nc - 1]` ends the interior
+    int32_t* tap; // coarse cell before every fine cell along an axis, for the bilinear upsampling
+    float* t; // and the weight of the one after it
+} sim_coarse_t; // velocity grid coarser than the density grid
+
+typedef struct {
+    const sim_kern_table_t* kt;
+    pool_obj_t pool; // splits the row loops of the stages, NULL runs them on the calling thread
+    sim_mask_obj_t mask; // NULL for an open box
+    sim_mask_obj_t vel_mask; // of the velocity grid, `mask` unless it is coarse
+    sim_spec_obj_t spec[SIM_LANE_COUNT]; // NULL solves with Gauss-Seidel
+    mat2f_obj_t m_vx, m_vy; // velocity of the velocity grid
+    mat2f_obj_t m_vx0, m_vy0;
+    mat2f_obj_t m_p, m_div;
+    mat2f_obj_t m_dvx, m_dvy; // velocity the density is advected with, of the density grid
+    mat2f_obj_t m_c[SIM_MAX_CHANNELS], m_c0[SIM_MAX_CHANNELS]; // scalar channels, the density first
+    float c_diff[SIM_MAX_CHANNELS];
+    int32_t channel_count;
+    float dt, visc;
+    int32_t solve_iter_size;
+    sim_kern_stats_t* advect_stats; // out: of the density advection
+    sim_kern_stats_t* project_stats; // out: of the last projection, NULL skips them
+} sim_step_t; // arguments of the step tasks, set before every run of the step graph
+
+typedef struct {
+    sim_obj_t self;
+    sim_pixel_transfer_fn_t cb; // `sim_render_density()`
+    void* cb_ctx;
+    pixel_t* fb; // `sim_render_density_scaled()`
+    int32_t cols, rows;
+    sim_filter_e filter;
+    bool_t grayscale;
+    bool_t has_obstacles;
+} sim_render_job_t; // arguments of the render row loops
+
 struct _sim_obj_t {
 	float dt; // time step
 	float diff; // diffusion rate of the fluid
 	float visc; // viscosity of the fluid
     int32_t solve_iter_size; // solve iteration size
-    mat2f_obj_t m_vx0, m_vx; // prev, curr x-velocity
-    mat2f_obj_t m_vy0, m_vy; // prev, curr y-velocity
-    mat2f_obj_t m_d0,  m_d; // prev, curr density
+    mat2f_obj_t m_vx; // curr x-velocity
+    mat2f_obj_t m_vy; // curr y-velocity
+    mat2f_obj_t m_d; // curr density
+    mat2f_obj_t m_c[SIM_MAX_CHANNELS]; // curr scalar channels past the density, from index 1
+    float c_diff[SIM_MAX_CHANNELS]; // diffusion rates of `m_c`, the density has `diff`
+    int32_t channel_count; // the density included
+    sim_scratch_obj_t scratch; // NOTE: The prev fields only carry data within a step, so they can be shared between sims. NULL if not owned.
+    const sim_kern_table_t* kern; // kernel variants for the isa in use
+    sim_solver_e solver;
+    uint8_t* solid; // obstacle cells, row-major
+    uint8_t* solid_back; // edited copy of `solid`, swapped in once it compiled
+    sim_mask_obj_t mask; // compiled `solid`
+    sim_coarse_t* coarse; // NULL unless the velocity is solved on a coarser grid
+    sim_kern_stats_t advect_stats; // of the last step
+    sim_kern_stats_t project_stats; // of the last step, 0 unless `fl_stats`
+    bool_t fl_stats; // take the projection stats
+
+    sim_step_t step;
+    graph_obj_t step_graph; // stages of a step and their dependencies
+    pool_obj_t pool; // runs independent stages concurrently, NULL steps on the calling thread
+
+    float* render_col; // one column of density per worker, gathered for `sim_render_density()`
+    pixel_t* render_px; // one row of pixels per worker
+
+    struct {
+        float* row; // `N + 3` per worker, vertically filtered row, padded for the horizontal taps
+        size_t row_cap;
+        float* dens; // one output row of filtered density per worker
+        size_t dens_cap;
+        int32_t* idx; // first horizontal tap per output column
+        size_t idx_cap;
+        int32_t* nearest; // nearest cell per output column, for the obstacles
+        size_t nearest_cap;
+        float* w; // horizontal weights, 4 planes of `cols`
+        size_t w_cap;
+    } scaled_scratch;
+
+    struct {
+        sim_splat_span_t* spans;
+        size_t spans_cap;
+        float* wx;
+        size_t wx_cap;
+        int32_t* bins;
+        size_t bins_cap;
+        int32_t* band_offs;
+        size_t band_offs_cap;
+    } splat_scratch;
 };
 
-static inline pixel_t _sim_hsl2rgb(
-    float H/* ∈ [0, 360] */,
-    float S/* ∈ [0, 1] */,
-    float L/* ∈ [0, 1] */)
-{
-    float R, G, B;/* ∈ [0, 1] */
-    float P, Q, T, fract;
-
-    (H == 360.0f) ? (H = 0.0f) : (H /= 60.0f);
-    fract = H - floorf(H);
-
-    P = L * (1.0f - S);
-    Q = L * (1.0f - S * fract);
-    T = L * (1.0f - S * (1.0f - fract));
-
-    if (0.0f <= H && H < 1.0f) {
-        R = L, G = T, B = P;
-    } else if (1.0f <= H && H < 2.0f) {
-        R = Q, G = L, B = P;
-    } else if (2.0f <= H && H < 3.0f) {
-        R = P, G = L, B = T;
-    } else if (3.0f <= H && H < 4.0f) {
-        R = P, G = Q, B = L;
-    } else if (4.0f <= H && H < 5.0f) {
-        R = T, G = P, B = L;
-    } else if (5.0f <= H && H < 6.0f) {
-        R = L, G = P, B = Q;
-    } else {
-        R = 0.0f, G = 0.0f, B = 0.0f;
+static bool_t _sim_reserve(void** pbuff, size_t* pcap, size_t count, size_t elem_sz)
+{
+    if (*pcap >= count) {
+        return TRUE;
+    }
+    const size_t new_cap = max(count, *pcap * 2);
+    void* const new_buff = realloc(*pbuff, new_cap * elem_sz);
+    if (!new_buff) {
+        return FALSE;
     }
+    *pbuff = new_buff;
+    *pcap = new_cap;
+    return TRUE;
+}
 
-    return (pixel_t) { 
-        .a = 0xff,
-        .r = (uint8_t)roundf(R * 255.0f),
-        .g = (uint8_t)roundf(G * 255.0f),
-        .b = (uint8_t)roundf(B * 255.0f),
-    };
+static inline void _sim_axpy(
+    float* y/* inout */,
+    const float* x,
+    const float a,
+    const int32_t n)
+{
+    int32_t i = 0;
+#if defined(HAS_SSE2)
+    const __m128 va = _mm_set1_ps(a);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] += a * x[i];
+    }
 }
 
-static inline void _sim_set_bounds(
+static inline void _sim_diffuse(
+    const sim_kern_table_t* kt,
+    const sim_mask_obj_t mask,
+    const sim_spec_obj_t spec,
     const int32_t b,
-    const mat2f_obj_t m_x/* inout */)
+    const mat2f_obj_t m_x/* inout */,
+    const mat2f_obj_t m_x0,
+    const float diff,
+    const float dt,
+    const int32_t solve_iter_size)
 {
-    assert(!mat2f_is_empty(m_x) 
-        && mat2f_get_rows(m_x) == mat2f_get_cols(m_x)
-    );
+    if (spec) {
+        sim_spec_diffuse(spec, b, m_x, m_x0, diff, dt);
+    } else {
+        sim_kern_diffuse(kt, mask, b, m_x, m_x0, diff, dt, solve_iter_size);
+    }
+}
+
+static inline void _sim_project(
+    const sim_kern_table_t* kt,
+    const pool_obj_t pool,
+    const sim_mask_obj_t mask,
+    const sim_spec_obj_t spec,
+    const mat2f_obj_t m_vx/* inout */,
+    const mat2f_obj_t m_vy/* inout */,
+    const mat2f_obj_t m_p/* inout */,
+    const mat2f_obj_t m_div/* inout */,
+    const int32_t solve_iter_size,
+    sim_kern_stats_t* stats/* out */)
+{
+    if (spec) {
+        sim_spec_project(spec, kt, pool, m_vx, m_vy, m_p, m_div, stats);
+    } else {
+        sim_kern_project(kt, pool, mask, m_vx, m_vy, m_p, m_div, solve_iter_size, stats);
+    }
+}
+
+// NOTE: The stages of a step. Density and velocity only meet at the density advection, which reads
+//       the velocity of the previous step, and the projections have their own scratch fields, so the
+//       density and each velocity component are diffused concurrently, and the density advection
+//       overlaps the first projection. Every stage writes the same values as a serial step.
+//       The scalar channels are stepped with the density: their Gauss-Seidel solves are independent
+//       and spread over the workers, and one advection pass backtraces once for all of them.
 
-    const int32_t N = mat2f_get_rows(m_x);
+static void _sim_diffuse_channels(void* ctx, int32_t worker_idx, int32_t c_begin, int32_t c_end)
+{
+    UNUSED_PARAM(worker_idx);
 
-    for (int32_t j = 1; j <= N; ++j) {
-        *mat2f_at_coord(m_x, j, 0) = b == 1 ? -(*mat2f_at_coord(m_x, j, 1)) : (*mat2f_at_coord(m_x, j, 1));
-        *mat2f_at_coord(m_x, j, N-1) = b == 1 ? -(*mat2f_at_coord(m_x, j, N-2)) : (*mat2f_at_coord(m_x, j, N-2));
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    for (int32_t c = c_begin; c < c_end; ++c) {
+        _sim_diffuse(st->kt, st->mask, st->spec[SIM_LANE_DENSITY], 0, st->m_c0[c], st->m_c[c], st->c_diff[c], st->dt, st->solve_iter_size);
     }
+}
 
-    for (int32_t i = 1; i <= N; ++i) {
-        *mat2f_at_coord(m_x, 0, i) = b == 2 ? -(*mat2f_at_coord(m_x, 1, i)) : (*mat2f_at_coord(m_x, 1, i));
-        *mat2f_at_coord(m_x, N-1, i) = b == 2 ? -(*mat2f_at_coord(m_x, N-2, i)) : (*mat2f_at_coord(m_x, N-2, i));
+static void _sim_task_diffuse_density(void* ctx)
+{
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    // NOTE: The spectral solver has one scratch per lane, its channels take turns.
+    pool_parallel_for(st->spec[SIM_LANE_DENSITY] ? NULL : st->pool, _sim_diffuse_channels, ctx, 0, st->channel_count, 1);
+}
+
+static void _sim_task_advect_density(void* ctx)
+{
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    if (st->channel_count == 1) {
+        sim_kern_advect(st->kt, st->pool, st->mask, 0, st->m_c[0], st->m_c0[0], st->m_dvx, st->m_dvy, st->dt, st->advect_stats);
+    } else {
+        sim_kern_advect_channels(st->kt, st->pool, st->mask, 0, st->m_c, st->m_c0, st->channel_count, st->m_dvx, st->m_dvy, st->dt, st->advect_stats);
     }
+}
+
+static void _sim_task_diffuse_vx(void* ctx)
+{
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    _sim_diffuse(st->kt, st->vel_mask, st->spec[SIM_LANE_VX], 1, st->m_vx0, st->m_vx, st->visc, st->dt, st->solve_iter_size);
+}
+
+static void _sim_task_diffuse_vy(void* ctx)
+{
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    _sim_diffuse(st->kt, st->vel_mask, st->spec[SIM_LANE_VY], 2, st->m_vy0, st->m_vy, st->visc, st->dt, st->solve_iter_size);
+}
 
-    *mat2f_at_coord(m_x, 0, 0) = 0.5f * (
-        (*mat2f_at_coord(m_x, 0, 1)) +
-        (*mat2f_at_coord(m_x, 1, 0))
-    );
+static void _sim_task_project_diffused(void* ctx)
+{
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    _sim_project(st->kt, st->pool, st->vel_mask, st->spec[SIM_LANE_VX], st->m_vx0, st->m_vy0, st->m_p, st->m_div, st->solve_iter_size, NULL);
+}
 
-    *mat2f_at_coord(m_x, N-1, 0) = 0.5f * (
-        (*mat2f_at_coord(m_x, N-1, 1)) +
-        (*mat2f_at_coord(m_x, N-2, 0))
-    );
+static void _sim_task_advect_vx(void* ctx)
+{
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    sim_kern_advect(st->kt, st->pool, st->vel_mask, 1, st->m_vx, st->m_vx0, st->m_vx0, st->m_vy0, st->dt, NULL);
+}
 
-    *mat2f_at_coord(m_x, 0, N-1) = 0.5f * (
-        (*mat2f_at_coord(m_x, 0, N-2)) +
-        (*mat2f_at_coord(m_x,  1, N-1))
-    );
+static void _sim_task_advect_vy(void* ctx)
+{
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    sim_kern_advect(st->kt, st->pool, st->vel_mask, 2, st->m_vy, st->m_vy0, st->m_vx0, st->m_vy0, st->dt, NULL);
+}
 
-    *mat2f_at_coord(m_x, N-1, N-1) = 0.5f * (
-        (*mat2f_at_coord(m_x, N-1, N-2)) +
-        (*mat2f_at_coord(m_x, N-2, N-1))
-    );
+static void _sim_task_project_advected(void* ctx)
+{
+    const sim_step_t* const st = (const sim_step_t*)ctx;
+    _sim_project(st->kt, st->pool, st->vel_mask, st->spec[SIM_LANE_VX], st->m_vx, st->m_vy, st->m_p, st->m_div, st->solve_iter_size, st->project_stats);
 }
 
-static inline void _sim_solve_gauss_seidel(
-    const int32_t b,
-    const mat2f_obj_t m_x/* inout */,
-    const mat2f_obj_t m_x0,
-    const float a,
-    const float c,
-    const int32_t iter_size)
-{
-    assert(!mat2f_is_empty(m_x) 
-        && mat2f_get_rows(m_x) == mat2f_get_cols(m_x)
-        && mat2f_is_shape_eq(m_x, m_x0)
-    );
-
-    const int32_t N = mat2f_get_rows(m_x);
-
-    const float c_recip = 1.0f / c;
-    for (int32_t k = 0; k < iter_size; ++k) {
-        for (int32_t j = 1; j <= N; ++j) {
-            for (int32_t i = 1; i <= N; ++i) {
-                *mat2f_at_coord(m_x, j, i) = c_recip * (
-                    (*mat2f_at_coord(m_x0, j, i)) + a * (
-                        (*mat2f_at_coord(m_x, j, i-1)) +
-                        (*mat2f_at_coord(m_x, j, i+1)) +
-                        (*mat2f_at_coord(m_x, j-1, i)) +
-                        (*mat2f_at_coord(m_x, j+1, i))
-                    )
-                );
-            }
-        }
-        _sim_set_bounds(b, m_x);
+static bool_t _sim_build_step_graph(graph_obj_t graph, sim_step_t* step)
+{
+    const int32_t
+        diffuse_d = graph_add_task(graph, _sim_task_diffuse_density, step),
+        diffuse_vx = graph_add_task(graph, _sim_task_diffuse_vx, step),
+        diffuse_vy = graph_add_task(graph, _sim_task_diffuse_vy, step),
+        advect_d = graph_add_task(graph, _sim_task_advect_density, step), // reads d0, vx, vy
+        project_diffused = graph_add_task(graph, _sim_task_project_diffused, step), // vx0, vy0, p, div
+        advect_vx = graph_add_task(graph, _sim_task_advect_vx, step), // writes vx from vx0, vy0
+        advect_vy = graph_add_task(graph, _sim_task_advect_vy, step), // writes vy from vx0, vy0
+        project_advected = graph_add_task(graph, _sim_task_project_advected, step); // vx, vy, p, div
+    if (project_advected < 0) {
+        return FALSE;
     }
+
+    graph_add_dependency(graph, advect_d, diffuse_d);
+    graph_add_dependency(graph, project_diffused, diffuse_vx);
+    graph_add_dependency(graph, project_diffused, diffuse_vy);
+    graph_add_dependency(graph, advect_vx, project_diffused);
+    graph_add_dependency(graph, advect_vx, advect_d); // NOTE: Overwrites the velocity the density is advected with.
+    graph_add_dependency(graph, advect_vy, project_diffused);
+    graph_add_dependency(graph, advect_vy, advect_d);
+    graph_add_dependency(graph, project_advected, advect_vx);
+    graph_add_dependency(graph, project_advected, advect_vy);
+    return TRUE;
 }
 
-static inline void _sim_diffuse(
-    const int32_t b,
-    const mat2f_obj_t m_x/* inout */,
-    const mat2f_obj_t m_x0,
-    const float diff,
-    const float dt,
-    const int32_t solve_iter_size)
+static sim_obj_t _sim_create(int32_t box_size, bool_t owns_scratch)
 {
-    assert(!mat2f_is_empty(m_x) 
-        && mat2f_get_rows(m_x) == mat2f_get_cols(m_x)
-        && mat2f_is_shape_eq(m_x, m_x0)
-    );
+    if (box_size < 10) {
+        return NULL;
+    }
 
-    const int32_t N = mat2f_get_rows(m_x);
+    sim_obj_t newobj = (sim_obj_t)calloc(1, sizeof(struct _sim_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
 
-    const float 
-        a = dt * diff * (N-2) * (N-2), 
-        c = 1 + 4 * a;
+    newobj->dt = 0.35f;
+    newobj->diff = 0.0f;
+    newobj->visc = 1e-06f;
+    newobj->solve_iter_size = 12; // 20
+    newobj->channel_count = 1;
+    newobj->kern = sim_kern_get_default_table();
 
-    _sim_solve_gauss_seidel(
-        b, 
-        m_x, m_x0, 
-        a, 
-        c, 
-        solve_iter_size
-    );
+    const int32_t rows = box_size, cols = box_size;
+    newobj->m_vx = mat2f_create(rows, cols);
+    newobj->m_vy = mat2f_create(rows, cols);
+    newobj->m_d = mat2f_create(rows, cols);
+    newobj->render_col = (float*)malloc((size_t)rows * sizeof(float));
+    newobj->render_px = (pixel_t*)malloc((size_t)cols * sizeof(pixel_t));
+    newobj->solid = (uint8_t*)calloc((size_t)rows * cols, sizeof(uint8_t));
+    newobj->solid_back = (uint8_t*)calloc((size_t)rows * cols, sizeof(uint8_t));
+    newobj->mask = sim_mask_create(box_size);
+    newobj->step_graph = graph_create();
+    
+    if (
+        !newobj->m_vx ||
+        !newobj->m_vy ||
+        !newobj->m_d ||
+        !newobj->render_col ||
+        !newobj->render_px ||
+        !newobj->solid ||
+        !newobj->solid_back ||
+        !newobj->mask ||
+        !newobj->step_graph ||
+        !_sim_build_step_graph(newobj->step_graph, &newobj->step)
+        )
+    {
+        sim_destroy(&newobj);
+        return NULL;
+    }
+
+    if (owns_scratch) {
+        newobj->scratch = sim_scratch_create(box_size);
+        if (!newobj->scratch) {
+            sim_destroy(&newobj);
+            return NULL;
+        }
+    }
+
+    return newobj;
 }
 
-static inline void _sim_project(
-    const mat2f_obj_t m_vx/* inout */,
-    const mat2f_obj_t m_vy/* inout */,
-    const mat2f_obj_t m_p/* inout */,
-    const mat2f_obj_t m_div/* inout */,
-    const int32_t solve_iter_size)
+static void _sim_clear_gaps(sim_mask_obj_t mask, int32_t N, float* const* fields, int32_t field_count)
 {
-    assert(!mat2f_is_empty(m_vx)
-        && mat2f_get_rows(m_vx) == mat2f_get_cols(m_vx)
-        && mat2f_is_shape_eq(m_vx, m_vy)
-        && mat2f_is_shape_eq(m_vx, m_p)
-        && mat2f_is_shape_eq(m_vx, m_div)
-    );
+    for (int32_t j = 1; j < N-1; ++j) {
+        int32_t span_count;
+        const sim_mask_span_t* const spans = sim_mask_get_row_spans(mask, j, &span_count);
+        for (int32_t n = 0; n <= span_count; ++n) {
+            const int32_t
+                i_begin = n ? spans[n - 1].i_end : 1,
+                i_end = (n < span_count) ? spans[n].i_begin : N-1;
+            if (i_begin < i_end) {
+                for (int32_t f = 0; f < field_count; ++f) {
+                    memset(fields[f] + j * N + i_begin, 0, (size_t)(i_end - i_begin) * sizeof(float));
+                }
+            }
+        }
+    }
+}
 
-    const int32_t N = mat2f_get_rows(m_vx);
-    const float N_f32 = (float)N;
-    const float N_f32_recip = 1.0f / N_f32;
+static inline mat2f_obj_t _sim_get_channel(sim_obj_t self, int32_t channel)
+{
+    assert(channel >= 0 && channel < self->channel_count);
+    return channel ? self->m_c[channel] : self->m_d;
+}
 
-    for (int32_t j = 1; j <= N; ++j) {
-        for (int32_t i = 1; i <= N; ++i) {
-            *mat2f_at_coord(m_div, j, i) = -0.5f * N_f32_recip * (
-                (*mat2f_at_coord(m_vx, j, i+1)) -
-                (*mat2f_at_coord(m_vx, j, i-1)) +
-                (*mat2f_at_coord(m_vy, j+1, i)) -
-                (*mat2f_at_coord(m_vy, j-1, i))
-            );
-            
-            *mat2f_at_coord(m_p, j, i) = 0;
-        }
+static void _sim_clear_solids(sim_obj_t self)
+{
+    // NOTE: Injection may have touched solid cells, the gaps between the fluid runs of a row are cleared,
+    //       the boundary cells among them are rewritten by the first kernels of the step.
+    float* fields[2 + SIM_MAX_CHANNELS] = {
+        mat2f_at_index(self->m_vx, 0),
+        mat2f_at_index(self->m_vy, 0),
+    };
+    for (int32_t c = 0; c < self->channel_count; ++c) {
+        fields[2 + c] = mat2f_at_index(_sim_get_channel(self, c), 0);
     }
+    _sim_clear_gaps(self->mask, mat2f_get_rows(self->m_d), fields, 2 + self->channel_count);
+}
 
-    _sim_set_bounds(0, m_div);
-    _sim_set_bounds(0, m_p);
-    _sim_solve_gauss_seidel(
-        0, 
-        m_p, m_div, 
-        1, 
-        4, 
-        solve_iter_size
-    );
+static void _sim_coarse_destroy(sim_coarse_t** pcoarse)
+{
+    if (pcoarse && *pcoarse) {
+        mat2f_destroy(&(*pcoarse)->m_vx);
+        mat2f_destroy(&(*pcoarse)->m_vy);
+        mat2f_destroy(&(*pcoarse)->m_vx_base);
+        mat2f_destroy(&(*pcoarse)->m_vy_base);
+        sim_scratch_destroy(&(*pcoarse)->scratch);
+        SAFE_FREE((*pcoarse)->solid);
+        sim_mask_destroy(&(*pcoarse)->mask);
+        SAFE_FREE((*pcoarse)->first);
+        SAFE_FREE((*pcoarse)->tap);
+        SAFE_FREE((*pcoarse)->t);
+        SAFE_FREE(*pcoarse);
+    }
+}
 
-    for (int32_t j = 1; j <= N; ++j) {
-        for (int32_t i = 1; i <= N; ++i) {
-            *mat2f_at_coord(m_vx, j, i) -= 0.5f * N_f32 * (*mat2f_at_coord(m_p, j, i+1) - *mat2f_at_coord(m_p, j, i-1));
-            *mat2f_at_coord(m_vy, j, i) -= 0.5f * N_f32 * (*mat2f_at_coord(m_p, j+1, i) - *mat2f_at_coord(m_p, j-1, i));
+static bool_t _sim_coarse_compile(sim_coarse_t* coarse, const uint8_t* solid, int32_t N)
+{
+    // NOTE: A coarse cell is solid if any of its fine cells is, so no wall gets thinner than a coarse cell.
+    const int32_t Nc = mat2f_get_rows(coarse->m_vx);
+    memset(coarse->solid, 0, (size_t)Nc * Nc);
+    for (int32_t J = 1; J < Nc-1; ++J) {
+        for (int32_t j = coarse->first[J]; j < coarse->first[J + 1]; ++j) {
+            for (int32_t I = 1; I < Nc-1; ++I) {
+                for (int32_t i = coarse->first[I]; i < coarse->first[I + 1]; ++i) {
+                    coarse->solid[J * Nc + I] |= solid[j * N + i];
+                }
+            }
         }
     }
-    _sim_set_bounds(1, m_vx);
-    _sim_set_bounds(2, m_vy);
+    return sim_mask_compile(coarse->mask, coarse->solid);
 }
 
-static inline void _sim_advect(
-    const int32_t b,
-    const mat2f_obj_t m_d/* inout */,
-    const mat2f_obj_t m_d0,
-    const mat2f_obj_t m_vx,
-    const mat2f_obj_t m_vy,
-    const float dt)
-{
-    assert(!mat2f_is_empty(m_d) 
-        && mat2f_get_rows(m_d) == mat2f_get_cols(m_d)
-        && mat2f_is_shape_eq(m_d, m_d0)
-        && mat2f_is_shape_eq(m_d, m_vx)
-        && mat2f_is_shape_eq(m_d, m_vy)
-    );
-
-    const int32_t N = mat2f_get_rows(m_d);
+static void _sim_restrict_rows(void* ctx, int32_t worker_idx, int32_t J_begin, int32_t J_end)
+{
+    UNUSED_PARAM(worker_idx);
+    const sim_obj_t self = (const sim_obj_t)ctx;
+    const sim_coarse_t* const coarse = self->coarse;
+    const int32_t N = mat2f_get_rows(self->m_vx), Nc = mat2f_get_rows(coarse->m_vx);
     const float
-        dt_x = dt * (N-2),
-        dt_y = dt * (N-2),
-        N_f32 = (float)N;
+        * const vx = mat2f_at_index(self->m_vx, 0),
+        * const vy = mat2f_at_index(self->m_vy, 0),
+        * const vx_base = mat2f_at_index(coarse->m_vx_base, 0),
+        * const vy_base = mat2f_at_index(coarse->m_vy_base, 0);
+    float
+        * const cvx = mat2f_at_index(coarse->m_vx, 0),
+        * const cvy = mat2f_at_index(coarse->m_vy, 0);
+
+    // NOTE: What was injected into the fine velocity since the last upsampling is averaged over the
+    //       fine cells of every coarse cell, which keeps the momentum of a force.
+    for (int32_t J = J_begin; J < J_end; ++J) {
+        const int32_t j_begin = coarse->first[J], j_end = coarse->first[J + 1];
+        for (int32_t I = 1; I < Nc-1; ++I) {
+            const int32_t i_begin = coarse->first[I], i_end = coarse->first[I + 1];
+            float dx = 0.0f, dy = 0.0f;
+            for (int32_t j = j_begin; j < j_end; ++j) {
+                for (int32_t i = i_begin; i < i_end; ++i) {
+                    dx += vx[j * N + i] - vx_base[j * N + i];
+                    dy += vy[j * N + i] - vy_base[j * N + i];
+                }
+            }
+            const float inv_count = 1.0f / (float)((j_end - j_begin) * (i_end - i_begin));
+            cvx[J * Nc + I] += dx * inv_count;
+            cvy[J * Nc + I] += dy * inv_count;
+        }
+    }
+}
 
-    for (int32_t j = 1; j <= N; ++j) {
-        for (int32_t i = 1; i <= N; ++i) {
+static void _sim_upsample_rows(void* ctx, int32_t worker_idx, int32_t row_begin, int32_t row_end)
+{
+    UNUSED_PARAM(worker_idx);
+    const sim_obj_t self = (const sim_obj_t)ctx;
+    const sim_coarse_t* const coarse = self->coarse;
+    const int32_t N = mat2f_get_rows(self->m_vx), Nc = mat2f_get_rows(coarse->m_vx);
+    const float
+        * const cvx = mat2f_at_index(coarse->m_vx, 0),
+        * const cvy = mat2f_at_index(coarse->m_vy, 0);
+    float
+        * const vx = mat2f_at_index(self->m_vx, 0),
+        * const vy = mat2f_at_index(self->m_vy, 0),
+        * const vx_base = mat2f_at_index(coarse->m_vx_base, 0),
+        * const vy_base = mat2f_at_index(coarse->m_vy_base, 0);
+    const bool_t has_obstacles = sim_mask_get_solid_count(self->mask) > 0;
+
+    // NOTE: Bilinear between the coarse cell centers, the border of the coarse grid holds the boundary
+    //       values, so the fine cells next to a wall blend towards them. Solid fine cells stay 0.
+    for (int32_t j = row_begin; j < row_end; ++j) {
+        const float ty = coarse->t[j];
+        const float
+            * const vx0 = cvx + coarse->tap[j] * Nc, * const vx1 = vx0 + Nc,
+            * const vy0 = cvy + coarse->tap[j] * Nc, * const vy1 = vy0 + Nc;
+        for (int32_t i = 1; i < N-1; ++i) {
+            const int32_t I = coarse->tap[i];
+            const float tx = coarse->t[i];
             const float
-                x = clamp((float)i - (dt_x * (*mat2f_at_coord(m_vx, j, i))), 0.5f, N_f32 + 0.5f),
-                y = clamp((float)j - (dt_y * (*mat2f_at_coord(m_vy, j, i))), 0.5f, N_f32 + 0.5f);
+                x0 = vx0[I] + (vx0[I + 1] - vx0[I]) * tx,
+                x1 = vx1[I] + (vx1[I + 1] - vx1[I]) * tx,
+                y0 = vy0[I] + (vy0[I + 1] - vy0[I]) * tx,
+                y1 = vy1[I] + (vy1[I + 1] - vy1[I]) * tx;
+            const bool_t fluid = !has_obstacles || !self->solid[j * N + i];
+            vx[j * N + i] = vx_base[j * N + i] = fluid ? x0 + (x1 - x0) * ty : 0.0f;
+            vy[j * N + i] = vy_base[j * N + i] = fluid ? y0 + (y1 - y0) * ty : 0.0f;
+        }
+    }
+}
 
-            const float
-                i0 = floorf(x),
-                i1 = 1.0f + i0,
-                j0 = floorf(y),
-                j1 = 1.0f + j0;
+static void _sim_coarse_restrict(sim_obj_t self)
+{
+    sim_coarse_t* const coarse = self->coarse;
+    const int32_t Nc = mat2f_get_rows(coarse->m_vx);
+    pool_parallel_for(self->pool, _sim_restrict_rows, self, 1, Nc-1, sim_kern_get_row_grain(Nc));
+
+    const sim_mask_obj_t mask = sim_mask_get_solid_count(coarse->mask) ? coarse->mask : NULL;
+    if (mask) {
+        float* const fields[2] = {
+            mat2f_at_index(coarse->m_vx, 0),
+            mat2f_at_index(coarse->m_vy, 0),
+        };
+        _sim_clear_gaps(mask, Nc, fields, 2);
+    }
+    sim_kern_set_bounds(mask, 1, coarse->m_vx);
+    sim_kern_set_bounds(mask, 2, coarse->m_vy);
+}
 
-            const float 
-                s1 = x - i0,
-                s0 = 1.0f - s1,
-                t1 = y - j0,
-                t0 = 1.0f - t1;
+static void _sim_coarse_upsample(sim_obj_t self)
+{
+    const int32_t N = mat2f_get_rows(self->m_vx);
+    const sim_mask_obj_t mask = sim_mask_get_solid_count(self->mask) ? self->mask : NULL;
+    pool_parallel_for(self->pool, _sim_upsample_rows, self, 1, N-1, sim_kern_get_row_grain(N));
+    sim_kern_set_bounds(mask, 1, self->m_vx);
+    sim_kern_set_bounds(mask, 2, self->m_vy);
+}
+
+static sim_coarse_t* _sim_coarse_create(sim_obj_t self, int32_t factor)
+{
+    const int32_t
+        N = mat2f_get_rows(self->m_d),
+        Nc = (N - 2 + factor / 2) / factor + 2;
+    if (Nc < 10) {
+        return NULL;
+    }
+
+    sim_coarse_t* coarse = (sim_coarse_t*)calloc(1, sizeof(sim_coarse_t));
+    if (!coarse) {
+        return NULL;
+    }
+    coarse->factor = factor;
+    coarse->m_vx = mat2f_create(Nc, Nc);
+    coarse->m_vy = mat2f_create(Nc, Nc);
+    coarse->m_vx_base = mat2f_create(N, N);
+    coarse->m_vy_base = mat2f_create(N, N);
+    coarse->scratch = sim_scratch_create(Nc);
+    coarse->solid = (uint8_t*)calloc((size_t)Nc * Nc, sizeof(uint8_t));
+    coarse->mask = sim_mask_create(Nc);
+    coarse->first = (int32_t*)malloc((size_t)Nc * sizeof(int32_t));
+    coarse->tap = (int32_t*)malloc((size_t)N * sizeof(int32_t));
+    coarse->t = (float*)malloc((size_t)N * sizeof(float));
+    if (
+        !coarse->m_vx ||
+        !coarse->m_vy ||
+        !coarse->m_vx_base ||
+        !coarse->m_vy_base ||
+        !coarse->scratch ||
+        !coarse->solid ||
+        !coarse->mask ||
+        !coarse->first ||
+        !coarse->tap ||
+        !coarse->t
+        )
+    {
+        _sim_coarse_destroy(&coarse);
+        return NULL;
+    }
 
-            const int32_t 
-                i0_i32 = (int32_t)i0, 
-                i1_i32 = (int32_t)i1,
-                j0_i32 = (int32_t)j0,
-                j1_i32 = (int32_t)j1;
-            
-            *mat2f_at_coord(m_d, j, i) =
-                s0 * (t0 * (*mat2f_at_coord(m_d0, j0_i32, i0_i32)) + t1 * (*mat2f_at_coord(m_d0, j1_i32, i0_i32))) +
-                s1 * (t0 * (*mat2f_at_coord(m_d0, j0_i32, i1_i32)) + t1 * (*mat2f_at_coord(m_d0, j1_i32, i1_i32)));
+    // NOTE: The interiors of both grids cover the box, fine cell `i` belongs to the coarse cell its
+    //       center falls into, and is upsampled from the coarse cells around its center.
+    const float scale = (float)(Nc - 2) / (float)(N - 2);
+    for (int32_t I = 0, i = 1; I < Nc; ++I) {
+        while (i < N-1 && 1 + (int32_t)(((int64_t)(2 * i - 1) * (Nc - 2)) / (2 * (N - 2))) < I) {
+            ++i;
         }
+        coarse->first[I] = (I < Nc-1) ? i : N-1;
+    }
+    coarse->first[0] = 0;
+    for (int32_t i = 0; i < N; ++i) {
+        const float x = 0.5f + ((float)i - 0.5f) * scale;
+        const int32_t i0 = clamp((int32_t)floorf(x), 0, Nc - 2);
+        coarse->tap[i] = i0;
+        coarse->t[i] = clamp(x - (float)i0, 0.0f, 1.0f);
     }
 
-    _sim_set_bounds(b, m_d);
+    if (sim_has_obstacles(self) && !_sim_coarse_compile(coarse, self->solid, N)) {
+        _sim_coarse_destroy(&coarse);
+        return NULL;
+    }
+    return coarse;
 }
 
-static inline void _sim_step_velocity(
-    const mat2f_obj_t m_vx/* inout */,
-    const mat2f_obj_t m_vy/* inout */,
-    const mat2f_obj_t m_vx0/* inout */,
-    const mat2f_obj_t m_vy0/* inout */,
-    const float visc, 
-    const float dt,
-    const int32_t solve_iter_size)
+static void _sim_coarse_attach(sim_obj_t self, sim_coarse_t* coarse)
 {
-    assert(!mat2f_is_empty(m_vx)
-        && mat2f_get_rows(m_vx) == mat2f_get_cols(m_vx)
-        && mat2f_is_shape_eq(m_vx, m_vy)
-        && mat2f_is_shape_eq(m_vx, m_vx0)
-        && mat2f_is_shape_eq(m_vx, m_vy0)
-    );
-
-    _sim_diffuse(
-        1, 
-        m_vx0, m_vx, // swapped
-        visc, 
-        dt, 
-        solve_iter_size
-    );
-
-    _sim_diffuse(
-        2,
-        m_vy0, m_vy, // swapped
-        visc, 
-        dt, 
-        solve_iter_size
-    );
-
-    _sim_project(
-        m_vx0, m_vy0,
-        m_vx, 
-        m_vy,
-        solve_iter_size
-    );
-
-    _sim_advect(
-        1, 
-        m_vx, m_vx0, 
-        m_vx0, m_vy0, 
-        dt
-    );
-
-    _sim_advect(
-        2, 
-        m_vy, m_vy0, 
-        m_vx0, m_vy0, 
-        dt
-    );
-
-    _sim_project(
-        m_vx, m_vy, 
-        m_vx0, 
-        m_vy0, 
-        solve_iter_size
-    );
-}
-
-static inline void _sim_step_density(
-    const mat2f_obj_t m_d/* inout */,
-    const mat2f_obj_t m_d0/* inout */,
-    const mat2f_obj_t m_vx,
-    const mat2f_obj_t m_vy,
-    const float diff,
-    const float dt,
-    const int32_t solve_iter_size)
+    // NOTE: Starts from the average of the fine velocity, restricted against a zero base, the base then
+    //       matches the fine velocity so nothing counts as injected.
+    _sim_coarse_destroy(&self->coarse);
+    self->coarse = coarse;
+    _sim_coarse_restrict(self);
+    mat2f_copy(coarse->m_vx_base, self->m_vx);
+    mat2f_copy(coarse->m_vy_base, self->m_vy);
+}
+
+static bool_t _sim_commit_obstacles(sim_obj_t self)
 {
-    assert(!mat2f_is_empty(m_d)
-        && mat2f_get_rows(m_d) == mat2f_get_cols(m_d)
-        && mat2f_is_shape_eq(m_d, m_d0)
-        && mat2f_is_shape_eq(m_d, m_vx)
-        && mat2f_is_shape_eq(m_d, m_vy)
-    );
+    // NOTE: `solid_back` holds the edited mask, it only replaces `solid` once the lists compiled.
+    if (!sim_mask_compile(self->mask, self->solid_back)) {
+        memcpy(self->solid_back, self->solid, (size_t)mat2f_get_size(self->m_d));
+        return FALSE;
+    }
+    uint8_t* const tmp = self->solid;
+    self->solid = self->solid_back;
+    self->solid_back = tmp;
+    memcpy(self->solid_back, self->solid, (size_t)mat2f_get_size(self->m_d));
+    if (self->coarse) {
+        return _sim_coarse_compile(self->coarse, self->solid, mat2f_get_rows(self->m_d)); // NOTE: FALSE keeps the previous coarse lists.
+    }
+    return TRUE;
+}
 
-    _sim_diffuse(
-        0, 
-        m_d0, m_d, // swapped
-        diff, 
-        dt, 
-        solve_iter_size
-    );
+static inline float _sim_resample_coord(int32_t k, float scale, int32_t M)
+{
+    // NOTE: Maps cell `k` of the new box onto the old one, aligning the interiors (the border is a wall
+    //       rewritten by the boundary conditions), then clamps to the interior of the old box.
+    return clamp(0.5f + ((float)k - 0.5f) * scale, 1.0f, (float)(M - 2));
+}
 
-    _sim_advect(
-        0, 
-        m_d, m_d0, 
-        m_vx, m_vy, 
-        dt
-    );
+static void _sim_resample_bilinear(mat2f_obj_t m_dst/* out */, mat2f_obj_t m_src)
+{
+    const int32_t
+        N = mat2f_get_cols(m_dst),
+        M = mat2f_get_cols(m_src);
+    const float scale = (float)(M - 2) / (float)(N - 2);
+    const float* const src = mat2f_at_index(m_src, 0);
+    float* const dst = mat2f_at_index(m_dst, 0);
+
+    for (int32_t j = 1; j < N-1; ++j) {
+        const float y = _sim_resample_coord(j, scale, M);
+        const int32_t j0 = min((int32_t)y, M - 3);
+        const float ty = y - (float)j0;
+        const float* const row0 = src + j0 * M;
+        const float* const row1 = row0 + M;
+        for (int32_t i = 1; i < N-1; ++i) {
+            const float x = _sim_resample_coord(i, scale, M);
+            const int32_t i0 = min((int32_t)x, M - 3);
+            const float tx = x - (float)i0;
+            const float
+                top = row0[i0] + (row0[i0 + 1] - row0[i0]) * tx,
+                bottom = row1[i0] + (row1[i0 + 1] - row1[i0]) * tx;
+            dst[j * N + i] = top + (bottom - top) * ty;
+        }
+    }
 }
 
-static inline void _sim_fade_density(
-    const mat2f_obj_t m_d/* inout */,
-    const float step)
+static void _sim_resample_nearest(uint8_t* dst/* out */, int32_t N, const uint8_t* src, int32_t M)
 {
-    assert(!mat2f_is_empty(m_d) 
-        && mat2f_get_rows(m_d) == mat2f_get_cols(m_d)
-    );
+    const float scale = (float)(M - 2) / (float)(N - 2);
+    for (int32_t j = 1; j < N-1; ++j) {
+        const int32_t sj = (int32_t)(_sim_resample_coord(j, scale, M) + 0.5f);
+        for (int32_t i = 1; i < N-1; ++i) {
+            const int32_t si = (int32_t)(_sim_resample_coord(i, scale, M) + 0.5f);
+            dst[j * N + i] = src[sj * M + si];
+        }
+    }
+}
 
-    for (int32_t i = 0; i < mat2f_get_size(m_d); ++i) {
-        float* const pd = mat2f_at_index(m_d, i);
-        *pd = max(*pd - step, 0.0f);
+static void _sim_swap_storage(sim_obj_t self, sim_obj_t other)
+{
+    // NOTE: Exchanges everything sized by the box, the rest (parameters, pool, step graph) stays.
+#define SIM_SWAP_MEMBER(NAME) do { \
+        void* const tmp = (void*)self->NAME; \
+        self->NAME = other->NAME; \
+        other->NAME = tmp; \
+    } while (0)
+
+    SIM_SWAP_MEMBER(m_vx);
+    SIM_SWAP_MEMBER(m_vy);
+    SIM_SWAP_MEMBER(m_d);
+    for (int32_t c = 1; c < SIM_MAX_CHANNELS; ++c) {
+        SIM_SWAP_MEMBER(m_c[c]);
+    }
+    SIM_SWAP_MEMBER(scratch);
+    SIM_SWAP_MEMBER(solid);
+    SIM_SWAP_MEMBER(solid_back);
+    SIM_SWAP_MEMBER(mask);
+    SIM_SWAP_MEMBER(render_col);
+    SIM_SWAP_MEMBER(render_px);
+
+#undef SIM_SWAP_MEMBER
+}
+
+static void _sim_update(sim_obj_t self, sim_scratch_obj_t scratch)
+{
+    assert(self);
+    assert(scratch);
+    assert(mat2f_is_shape_eq(self->m_d, scratch->m_d0));
+    assert(scratch->channel_count >= self->channel_count);
+
+    const float
+        dt = self->dt,
+        visc = self->visc;
+
+    const int32_t
+        solve_iter_size = self->solve_iter_size;
+
+    const sim_mask_obj_t
+        mask = sim_mask_get_solid_count(self->mask) ? self->mask : NULL;
+
+    const bool_t
+        spectral = self->solver == SIM_SOLVER_SPECTRAL && !mask; // NOTE: The transforms only know the open box.
+
+    if (mask) {
+        _sim_clear_solids(self);
+    }
+
+    // NOTE: With a coarse velocity grid, the velocity stages run on it (with its own scratch and
+    //       obstacles) and the density is advected with the fine velocity, upsampled after every step.
+    sim_coarse_t* const coarse = self->coarse;
+    const sim_scratch_obj_t vel_scratch = coarse ? coarse->scratch : scratch;
+    if (coarse) {
+        _sim_coarse_restrict(self);
+    }
+
+    sim_step_t* const st = &self->step;
+    st->kt = self->kern;
+    st->pool = self->pool;
+    st->mask = mask;
+    st->vel_mask = coarse ? (mask ? coarse->mask : NULL) : mask; // NOTE: Coarse cells are solid wherever fine ones are.
+    st->spec[SIM_LANE_DENSITY] = spectral ? scratch->spec[SIM_LANE_DENSITY] : NULL;
+    st->spec[SIM_LANE_VX] = spectral ? vel_scratch->spec[SIM_LANE_VX] : NULL;
+    st->spec[SIM_LANE_VY] = spectral ? vel_scratch->spec[SIM_LANE_VY] : NULL;
+    st->m_vx = coarse ? coarse->m_vx : self->m_vx;
+    st->m_vy = coarse ? coarse->m_vy : self->m_vy;
+    st->m_vx0 = vel_scratch->m_vx0;
+    st->m_vy0 = vel_scratch->m_vy0;
+    st->m_p = vel_scratch->m_p;
+    st->m_div = vel_scratch->m_div;
+    st->m_dvx = self->m_vx;
+    st->m_dvy = self->m_vy;
+    st->m_c[0] = self->m_d;
+    st->m_c0[0] = scratch->m_d0;
+    st->c_diff[0] = self->diff;
+    for (int32_t c = 1; c < self->channel_count; ++c) {
+        st->m_c[c] = self->m_c[c];
+        st->m_c0[c] = scratch->m_c0[c];
+        st->c_diff[c] = self->c_diff[c];
+    }
+    st->channel_count = self->channel_count;
+    st->dt = dt;
+    st->visc = visc;
+    st->solve_iter_size = solve_iter_size;
+    st->advect_stats = &self->advect_stats;
+    st->project_stats = self->fl_stats ? &self->project_stats : NULL;
+
+    graph_run(self->step_graph, self->pool);
+
+    if (coarse) {
+        _sim_coarse_upsample(self);
     }
 }
 
 sim_obj_t sim_create(int32_t box_size) {
-    if (box_size < 10) {
-        return NULL;
+    return _sim_create(box_size, TRUE);
+}
+
+sim_obj_t sim_create_shared(int32_t box_size) {
+    return _sim_create(box_size, FALSE);
+}
+
+void sim_destroy(sim_obj_t* pself) {
+    if (pself && *pself) {
+        pool_destroy(&(*pself)->pool);
+        graph_destroy(&(*pself)->step_graph);
+        sim_scratch_destroy(&(*pself)->scratch);
+        _sim_coarse_destroy(&(*pself)->coarse);
+        mat2f_destroy(&(*pself)->m_vx);
+        mat2f_destroy(&(*pself)->m_vy);
+        mat2f_destroy(&(*pself)->m_d);
+        for (int32_t c = 1; c < SIM_MAX_CHANNELS; ++c) {
+            mat2f_destroy(&(*pself)->m_c[c]);
+        }
+        SAFE_FREE((*pself)->splat_scratch.spans);
+        SAFE_FREE((*pself)->splat_scratch.wx);
+        SAFE_FREE((*pself)->splat_scratch.bins);
+        SAFE_FREE((*pself)->splat_scratch.band_offs);
+        SAFE_FREE((*pself)->render_col);
+        SAFE_FREE((*pself)->render_px);
+        SAFE_FREE((*pself)->scaled_scratch.row);
+        SAFE_FREE((*pself)->scaled_scratch.dens);
+        SAFE_FREE((*pself)->scaled_scratch.idx);
+        SAFE_FREE((*pself)->scaled_scratch.nearest);
+        SAFE_FREE((*pself)->scaled_scratch.w);
+        SAFE_FREE((*pself)->solid);
+        SAFE_FREE((*pself)->solid_back);
+        sim_mask_destroy(&(*pself)->mask);
+        SAFE_FREE(*pself);
     }
+}
 
-    sim_obj_t newobj = (sim_obj_t)calloc(1, sizeof(struct _sim_obj_t));
+sim_scratch_obj_t sim_scratch_create(int32_t box_size) {
+    sim_scratch_obj_t newobj = (sim_scratch_obj_t)calloc(1, sizeof(struct _sim_scratch_obj_t));
     if (!newobj) {
         return NULL;
     }
 
-    newobj->dt = 0.35f;
-    newobj->diff = 0.0f;
-    newobj->visc = 1e-06f;
-    newobj->solve_iter_size = 12; // 20
-
     const int32_t rows = box_size, cols = box_size;
     newobj->m_vx0 = mat2f_create(rows, cols);
-    newobj->m_vx = mat2f_create(rows, cols);
     newobj->m_vy0 = mat2f_create(rows, cols);
-    newobj->m_vy = mat2f_create(rows, cols);
     newobj->m_d0 = mat2f_create(rows, cols);
-    newobj->m_d = mat2f_create(rows, cols);
-    
+    newobj->m_p = mat2f_create(rows, cols);
+    newobj->m_div = mat2f_create(rows, cols);
+    newobj->channel_count = 1;
     if (
         !newobj->m_vx0 ||
-        !newobj->m_vx ||
         !newobj->m_vy0 ||
-        !newobj->m_vy ||
         !newobj->m_d0 ||
-        !newobj->m_d
+        !newobj->m_p ||
+        !newobj->m_div
         )
     {
-        sim_destroy(&newobj);
+        sim_scratch_destroy(&newobj);
         return NULL;
     }
 
+    for (int32_t i = 0; i < SIM_LANE_COUNT; ++i) {
+        newobj->spec[i] = sim_spec_create(box_size);
+        if (!newobj->spec[i]) {
+            sim_scratch_destroy(&newobj);
+            return NULL;
+        }
+    }
+
     return newobj;
 }
 
-void sim_destroy(sim_obj_t* pself) {
+void sim_scratch_destroy(sim_scratch_obj_t* pself) {
     if (pself && *pself) {
         mat2f_destroy(&(*pself)->m_vx0);
         mat2f_destroy(&(*pself)->m_vy0);
-        mat2f_destroy(&(*pself)->m_vx);
-        mat2f_destroy(&(*pself)->m_vy);
-        mat2f_destroy(&(*pself)->m_d);
         mat2f_destroy(&(*pself)->m_d0);
+        mat2f_destroy(&(*pself)->m_p);
+        mat2f_destroy(&(*pself)->m_div);
+        for (int32_t i = 0; i < SIM_LANE_COUNT; ++i) {
+            sim_spec_destroy(&(*pself)->spec[i]);
+        }
+        for (int32_t c = 1; c < SIM_MAX_CHANNELS; ++c) {
+            mat2f_destroy(&(*pself)->m_c0[c]);
+        }
         SAFE_FREE(*pself);
     }
 }
 
+bool_t sim_scratch_reserve_channels(sim_scratch_obj_t self, int32_t count) {
+    assert(self);
+    assert(count > 0 && count <= SIM_MAX_CHANNELS);
+
+    const int32_t N = mat2f_get_rows(self->m_d0);
+    for (; self->channel_count < count; ++self->channel_count) {
+        self->m_c0[self->channel_count] = mat2f_create(N, N);
+        if (!self->m_c0[self->channel_count]) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+int32_t sim_get_rows(sim_obj_t self) {
+    assert(self);
+    return mat2f_get_rows(self->m_d);
+}
+
+int32_t sim_get_cols(sim_obj_t self) {
+    assert(self);
+    return mat2f_get_cols(self->m_d);
+}
+
+bool_t sim_resize(sim_obj_t self, int32_t box_size) {
+    assert(self);
+
+    const int32_t M = mat2f_get_cols(self->m_d), N = box_size;
+    if (N == M) {
+        return TRUE;
+    }
+
+    // NOTE: Everything is resampled into a new allocation first, the sim is only touched once nothing
+    //       can fail anymore. A shared sim gets a temporary scratch for the projection.
+    sim_obj_t newobj = _sim_create(N, TRUE);
+    if (!newobj) {
+        return FALSE;
+    }
+
+    const size_t render_size = (size_t)sim_get_worker_count(self) * N;
+    SAFE_FREE(newobj->render_col);
+    SAFE_FREE(newobj->render_px);
+    newobj->render_col = (float*)malloc(render_size * sizeof(float));
+    newobj->render_px = (pixel_t*)malloc(render_size * sizeof(pixel_t));
+    if (!newobj->render_col || !newobj->render_px) {
+        sim_destroy(&newobj);
+        return FALSE;
+    }
+
+    if (sim_has_obstacles(self)) {
+        _sim_resample_nearest(newobj->solid_back, N, self->solid, M);
+        if (!_sim_commit_obstacles(newobj)) {
+            sim_destroy(&newobj);
+            return FALSE;
+        }
+    }
+
+    if (!sim_set_channel_count(newobj, self->channel_count)) {
+        sim_destroy(&newobj);
+        return FALSE;
+    }
+    for (int32_t c = 0; c < self->channel_count; ++c) {
+        _sim_resample_bilinear(_sim_get_channel(newobj, c), _sim_get_channel(self, c));
+    }
+    _sim_resample_bilinear(newobj->m_vx, self->m_vx);
+    _sim_resample_bilinear(newobj->m_vy, self->m_vy);
+
+    // NOTE: Interpolation does not keep the velocity divergence-free, it is projected again, exactly by
+    //       the transforms in an open box. The velocity is in box units, so it needs no rescaling.
+    const sim_mask_obj_t mask = sim_mask_get_solid_count(newobj->mask) ? newobj->mask : NULL;
+    if (mask) {
+        _sim_clear_solids(newobj);
+    }
+    for (int32_t c = 0; c < self->channel_count; ++c) {
+        sim_kern_set_bounds(mask, 0, _sim_get_channel(newobj, c));
+    }
+    sim_kern_set_bounds(mask, 1, newobj->m_vx);
+    sim_kern_set_bounds(mask, 2, newobj->m_vy);
+    const sim_scratch_obj_t scratch = newobj->scratch;
+    _sim_project(self->kern, self->pool, mask, mask ? NULL : scratch->spec[SIM_LANE_VX],
+        newobj->m_vx, newobj->m_vy, scratch->m_p, scratch->m_div, max(self->solve_iter_size, SIM_RESIZE_SOLVE_ITER), NULL);
+
+    // NOTE: The coarse velocity grid is rebuilt for the new box and attached once the storage is
+    //       exchanged, so it starts from the resampled velocity.
+    sim_coarse_t* coarse = NULL;
+    if (self->coarse) {
+        coarse = _sim_coarse_create(newobj, self->coarse->factor);
+        if (!coarse) {
+            sim_destroy(&newobj);
+            return FALSE;
+        }
+    }
+
+    if (!self->scratch) {
+        sim_scratch_destroy(&newobj->scratch);
+    }
+    _sim_swap_storage(self, newobj);
+    sim_destroy(&newobj);
+
+    if (coarse) {
+        _sim_coarse_attach(self, coarse);
+    }
+    return TRUE;
+}
+
+const float* sim_get_field_data(sim_obj_t self, sim_field_e field) {
+    assert(self);
+    switch (field) {
+    case SIM_FIELD_DENSITY: return mat2f_at_index(self->m_d, 0);
+    case SIM_FIELD_VX: return mat2f_at_index(self->m_vx, 0);
+    case SIM_FIELD_VY: return mat2f_at_index(self->m_vy, 0);
+    }
+    return NULL;
+}
+
 float sim_get_time_step(sim_obj_t self) {
     assert(self);
     return self->dt;
@@ -447,6 +1005,245 @@ void sim_set_viscosity(sim_obj_t self , float visc) {
     self->visc = visc;
 }
 
+sim_isa_e sim_get_isa(sim_obj_t self) {
+    assert(self);
+    return self->kern->isa;
+}
+
+bool_t sim_set_isa(sim_obj_t self, sim_isa_e isa) {
+    assert(self);
+    const sim_kern_table_t* const kt = sim_kern_get_table(isa);
+    if (!kt) {
+        return FALSE;
+    }
+    self->kern = kt;
+    return TRUE;
+}
+
+int32_t sim_get_worker_count(sim_obj_t self) {
+    assert(self);
+    return self->pool ? pool_get_worker_count(self->pool) : 1;
+}
+
+pool_obj_t sim_get_pool(sim_obj_t self) {
+    assert(self);
+    return self->pool;
+}
+
+bool_t sim_set_worker_count(sim_obj_t self, int32_t worker_count) {
+    assert(self);
+
+    if (worker_count <= 0) {
+        worker_count = thread_get_cpu_count();
+    }
+    if (worker_count == sim_get_worker_count(self)) {
+        return TRUE;
+    }
+
+    // NOTE: Every worker renders into its own scratch row.
+    const size_t size = (size_t)worker_count * mat2f_get_cols(self->m_d);
+    float* render_col = (float*)malloc(size * sizeof(float));
+    pixel_t* render_px = (pixel_t*)malloc(size * sizeof(pixel_t));
+    pool_obj_t pool = (worker_count > 1) ? pool_create(worker_count) : NULL;
+    if (!render_col || !render_px || (worker_count > 1 && !pool)) {
+        SAFE_FREE(render_col);
+        SAFE_FREE(render_px);
+        pool_destroy(&pool);
+        return FALSE;
+    }
+
+    pool_destroy(&self->pool);
+    self->pool = pool;
+    SAFE_FREE(self->render_col);
+    SAFE_FREE(self->render_px);
+    self->render_col = render_col;
+    self->render_px = render_px;
+    return TRUE;
+}
+
+sim_solver_e sim_get_solver(sim_obj_t self) {
+    assert(self);
+    return self->solver;
+}
+
+void sim_set_solver(sim_obj_t self, sim_solver_e solver) {
+    assert(self);
+    assert(0 <= solver && solver < SIM_SOLVER_COUNT);
+    self->solver = solver;
+}
+
+int32_t sim_get_solve_iter_size(sim_obj_t self) {
+    assert(self);
+    return self->solve_iter_size;
+}
+
+void sim_set_solve_iter_size(sim_obj_t self, int32_t iter_size) {
+    assert(self);
+    assert(iter_size >= 1);
+    self->solve_iter_size = iter_size;
+}
+
+int32_t sim_get_velocity_coarsening(sim_obj_t self) {
+    assert(self);
+    return self->coarse ? self->coarse->factor : 1;
+}
+
+int32_t sim_get_velocity_cols(sim_obj_t self) {
+    assert(self);
+    return mat2f_get_cols(self->coarse ? self->coarse->m_vx : self->m_vx);
+}
+
+bool_t sim_set_velocity_coarsening(sim_obj_t self, int32_t factor) {
+    assert(self);
+    if (factor == sim_get_velocity_coarsening(self)) {
+        return TRUE;
+    }
+    if (factor <= 1) {
+        _sim_coarse_destroy(&self->coarse); // NOTE: The fine velocity already holds the upsampled field.
+        return TRUE;
+    }
+
+    sim_coarse_t* const coarse = _sim_coarse_create(self, factor);
+    if (!coarse) {
+        return FALSE;
+    }
+    _sim_coarse_attach(self, coarse);
+    return TRUE;
+}
+
+int32_t sim_get_channel_count(sim_obj_t self) {
+    assert(self);
+    return self->channel_count;
+}
+
+bool_t sim_set_channel_count(sim_obj_t self, int32_t count) {
+    assert(self);
+    if (count < 1 || count > SIM_MAX_CHANNELS) {
+        return FALSE;
+    }
+    if (self->scratch && !sim_scratch_reserve_channels(self->scratch, count)) {
+        return FALSE;
+    }
+
+    const int32_t N = mat2f_get_rows(self->m_d);
+    for (int32_t c = self->channel_count; c < count; ++c) {
+        assert(!self->m_c[c]);
+        self->m_c[c] = mat2f_create(N, N);
+        if (!self->m_c[c]) {
+            for (; c >= self->channel_count; --c) {
+                mat2f_destroy(&self->m_c[c]);
+            }
+            return FALSE;
+        }
+        self->c_diff[c] = 0.0f;
+    }
+    for (int32_t c = count; c < self->channel_count; ++c) {
+        mat2f_destroy(&self->m_c[c]);
+    }
+    self->channel_count = count;
+    return TRUE;
+}
+
+const float* sim_get_channel_data(sim_obj_t self, int32_t channel) {
+    assert(self);
+    return mat2f_at_index(_sim_get_channel(self, channel), 0);
+}
+
+float sim_get_channel_diffusion(sim_obj_t self, int32_t channel) {
+    assert(self);
+    assert(channel >= 0 && channel < self->channel_count);
+    return channel ? self->c_diff[channel] : self->diff;
+}
+
+void sim_set_channel_diffusion(sim_obj_t self, int32_t channel, float diff) {
+    assert(self);
+    assert(channel >= 0 && channel < self->channel_count);
+    if (channel) {
+        self->c_diff[channel] = diff;
+    } else {
+        self->diff = diff;
+    }
+}
+
+void sim_add_channel(sim_obj_t self, int32_t channel, int32_t x, int32_t y, float step) {
+    assert(self);
+    *mat2f_at_coord(_sim_get_channel(self, channel), y, x) += step;
+}
+
+void sim_fade_channel(sim_obj_t self, int32_t channel, float step) {
+    assert(self);
+    sim_kern_fade_density(self->kern, self->pool, _sim_get_channel(self, channel), step);
+}
+
+const char* sim_solver_get_name(sim_solver_e solver) {
+    switch (solver) {
+    case SIM_SOLVER_GAUSS_SEIDEL: return "gauss-seidel";
+    case SIM_SOLVER_SPECTRAL: return "spectral";
+    default: return "unknown";
+    }
+}
+
+const char* sim_filter_get_name(sim_filter_e filter) {
+    switch (filter) {
+    case SIM_FILTER_NEAREST: return "nearest";
+    case SIM_FILTER_BILINEAR: return "bilinear";
+    case SIM_FILTER_CATMULL_ROM: return "catmull-rom";
+    default: return "unknown";
+    }
+}
+
+const char* sim_isa_get_name(sim_isa_e isa) {
+    switch (isa) {
+    case SIM_ISA_SCALAR: return "scalar";
+    case SIM_ISA_SSE42: return "sse4.2";
+    case SIM_ISA_AVX2: return "avx2";
+    case SIM_ISA_AVX512: return "avx512";
+    default: return "unknown";
+    }
+}
+
+bool_t sim_set_obstacles(sim_obj_t self, const uint8_t* solid) {
+    assert(self);
+    const int32_t size = mat2f_get_size(self->m_d);
+    for (int32_t i = 0; i < size; ++i) {
+        self->solid_back[i] = solid && solid[i];
+    }
+    return _sim_commit_obstacles(self);
+}
+
+bool_t sim_paint_obstacle(sim_obj_t self, int32_t x, int32_t y, float radius, bool_t solid) {
+    assert(self);
+    const int32_t
+        rows = mat2f_get_rows(self->m_d),
+        cols = mat2f_get_cols(self->m_d),
+        r = (int32_t)max(radius, 0.0f),
+        r0 = max(y - r, 0),
+        r1 = min(y + r, rows - 1),
+        c0 = max(x - r, 0),
+        c1 = min(x + r, cols - 1);
+    const float r2 = radius * radius;
+
+    for (int32_t row = r0; row <= r1; ++row) {
+        for (int32_t col = c0; col <= c1; ++col) {
+            const float dx = (float)(col - x), dy = (float)(row - y);
+            if (dx * dx + dy * dy <= r2) {
+                self->solid_back[row * cols + col] = solid ? 1 : 0;
+            }
+        }
+    }
+    return _sim_commit_obstacles(self);
+}
+
+const uint8_t* sim_get_obstacles(sim_obj_t self) {
+    assert(self);
+    return self->solid;
+}
+
+bool_t sim_has_obstacles(sim_obj_t self) {
+    assert(self);
+    return sim_mask_get_solid_count(self->mask) > 0;
+}
+
 void sim_add_force(sim_obj_t self, int32_t x, int32_t y, float fx, float fy) {
     assert(self);
     *mat2f_at_coord(self->m_vx, y, x) += fx;
@@ -458,61 +1255,384 @@ void sim_add_density(sim_obj_t self, int32_t x, int32_t y, float step) {
     *mat2f_at_coord(self->m_d, y, x) += step;
 }
 
+static inline int32_t _sim_splat_coord(float v, int32_t size)
+{
+    // NOTE: Clamped to one past either edge before the conversion, which is undefined out of the int32_t range.
+    return (int32_t)min(max(v, -1.0f), (float)size);
+}
+
+bool_t sim_add_splats(sim_obj_t self, const sim_splat_t* splats, int32_t count) {
+    assert(self);
+    assert(splats || !count);
+
+    for (int32_t k = 0; k < count; ++k) {
+        const sim_splat_t* const sp = &splats[k];
+        if (!isfinite(sp->x) || !isfinite(sp->y) || !isfinite(sp->radius) ||
+            !isfinite(sp->density) || !isfinite(sp->fx) || !isfinite(sp->fy))
+        {
+            return FALSE;
+        }
+    }
+
+    const int32_t
+        rows = mat2f_get_rows(self->m_d),
+        cols = mat2f_get_cols(self->m_d),
+        band_count = (rows + SIM_SPLAT_BAND_ROWS - 1) / SIM_SPLAT_BAND_ROWS;
+
+    if (!_sim_reserve((void**)&self->splat_scratch.spans, &self->splat_scratch.spans_cap, (size_t)count, sizeof(sim_splat_span_t)) ||
+        !_sim_reserve((void**)&self->splat_scratch.band_offs, &self->splat_scratch.band_offs_cap, (size_t)band_count + 1, sizeof(int32_t)))
+    {
+        return FALSE;
+    }
+
+    sim_splat_span_t* const spans = self->splat_scratch.spans;
+    int32_t* const band_offs = self->splat_scratch.band_offs;
+
+    // Clip the support of each splat and size the scratch buffers.
+    size_t wx_total = 0, bin_total = 0;
+    for (int32_t k = 0; k < count; ++k) {
+        const sim_splat_t* const sp = &splats[k];
+        sim_splat_span_t* const span = &spans[k];
+        const float r = max(sp->radius, 0.0f);
+
+        int32_t
+            c0 = _sim_splat_coord(ceilf(sp->x - r), cols),
+            c1 = _sim_splat_coord(floorf(sp->x + r), cols),
+            r0 = _sim_splat_coord(ceilf(sp->y - r), rows),
+            r1 = _sim_splat_coord(floorf(sp->y + r), rows);
+        if (c0 > c1) {
+            c0 = c1 = _sim_splat_coord(floorf(sp->x + 0.5f), cols);
+        }
+        if (r0 > r1) {
+            r0 = r1 = _sim_splat_coord(floorf(sp->y + 0.5f), rows);
+        }
+
+        span->c0 = max(c0, 0);
+        span->c1 = min(c1, cols - 1);
+        span->r0 = max(r0, 0);
+        span->r1 = min(r1, rows - 1);
+        span->cy = sp->y;
+        span->inv_r2 = (r > 0.0f) ? 1.0f / (r * r) : 0.0f;
+        if (span->c0 > span->c1 || span->r0 > span->r1) {
+            continue; // fully outside
+        }
+
+        span->wx_offset = (int32_t)wx_total;
+        wx_total += (size_t)(span->c1 - span->c0 + 1);
+        bin_total += (size_t)(span->r1 / SIM_SPLAT_BAND_ROWS - span->r0 / SIM_SPLAT_BAND_ROWS + 1);
+    }
+
+    if (!_sim_reserve((void**)&self->splat_scratch.wx, &self->splat_scratch.wx_cap, wx_total, sizeof(float)) ||
+        !_sim_reserve((void**)&self->splat_scratch.bins, &self->splat_scratch.bins_cap, bin_total, sizeof(int32_t)))
+    {
+        return FALSE;
+    }
+
+    float* const wx = self->splat_scratch.wx;
+    int32_t* const bins = self->splat_scratch.bins;
+
+    // Precompute the separable horizontal weights and bin splats by row band (counting sort).
+    memset(band_offs, 0, ((size_t)band_count + 1) * sizeof(int32_t));
+    for (int32_t k = 0; k < count; ++k) {
+        const sim_splat_span_t* const span = &spans[k];
+        if (span->c0 > span->c1 || span->r0 > span->r1) {
+            continue;
+        }
+
+        float* const w = wx + span->wx_offset;
+        for (int32_t c = span->c0; c <= span->c1; ++c) {
+            const float dx = (float)c - splats[k].x;
+            w[c - span->c0] = (splats[k].falloff == SIM_SPLAT_FALLOFF_GAUSSIAN) ? expf(-2.0f * dx * dx * span->inv_r2) : 1.0f;
+        }
+
+        for (int32_t b = span->r0 / SIM_SPLAT_BAND_ROWS; b <= span->r1 / SIM_SPLAT_BAND_ROWS; ++b) {
+            ++band_offs[b + 1];
+        }
+    }
+    for (int32_t b = 0; b < band_count; ++b) {
+        band_offs[b + 1] += band_offs[b];
+    }
+    for (int32_t k = 0; k < count; ++k) {
+        const sim_splat_span_t* const span = &spans[k];
+        if (span->c0 > span->c1 || span->r0 > span->r1) {
+            continue;
+        }
+        for (int32_t b = span->r0 / SIM_SPLAT_BAND_ROWS; b <= span->r1 / SIM_SPLAT_BAND_ROWS; ++b) {
+            bins[band_offs[b]++] = k; // NOTE: afterwards `band_offs[b]` holds the end of band `b`.
+        }
+    }
+
+    // Rasterize band by band, so the touched rows of all three fields stay in cache.
+    for (int32_t b = 0; b < band_count; ++b) {
+        const int32_t
+            bin_begin = b ? band_offs[b - 1] : 0,
+            bin_end = band_offs[b],
+            row_begin = b * SIM_SPLAT_BAND_ROWS,
+            row_end = min(row_begin + SIM_SPLAT_BAND_ROWS, rows);
+
+        for (int32_t n = bin_begin; n < bin_end; ++n) {
+            const int32_t k = bins[n];
+            const sim_splat_span_t* const span = &spans[k];
+            const sim_splat_t* const sp = &splats[k];
+            const int32_t j_end = min(span->r1 + 1, row_end);
+
+            for (int32_t j = max(span->r0, row_begin); j < j_end; ++j) {
+                float* const d_row = mat2f_at_coord(self->m_d, j, 0);
+                float* const vx_row = mat2f_at_coord(self->m_vx, j, 0);
+                float* const vy_row = mat2f_at_coord(self->m_vy, j, 0);
+                const float dy = (float)j - span->cy;
+                const float wy = (sp->falloff == SIM_SPLAT_FALLOFF_GAUSSIAN) ? expf(-2.0f * dy * dy * span->inv_r2) : 1.0f;
+                int32_t c0 = span->c0, c1 = span->c1;
+                if (sp->falloff == SIM_SPLAT_FALLOFF_GAUSSIAN && span->inv_r2 > 0.0f) {
+                    // NOTE: Clipped to the chord of the disk on this row, the weights stay separable.
+                    const float r = sp->radius, hw = sqrtf(max(r * r - dy * dy, 0.0f));
+                    c0 = max(c0, _sim_splat_coord(ceilf(sp->x - hw), cols));
+                    c1 = min(c1, _sim_splat_coord(floorf(sp->x + hw), cols));
+                    if (c0 > c1) {
+                        continue;
+                    }
+                }
+                const float* const w = wx + span->wx_offset + (c0 - span->c0);
+                const int32_t n_cols = c1 - c0 + 1;
+
+                if (sp->density != 0.0f) {
+                    _sim_axpy(d_row + c0, w, sp->density * wy, n_cols);
+                }
+                if (sp->fx != 0.0f) {
+                    _sim_axpy(vx_row + c0, w, sp->fx * wy, n_cols);
+                }
+                if (sp->fy != 0.0f) {
+                    _sim_axpy(vy_row + c0, w, sp->fy * wy, n_cols);
+                }
+            }
+        }
+    }
+
+    return TRUE;
+}
+
 void sim_fade_density(sim_obj_t self, float step) {
     assert(self);
-    _sim_fade_density(self->m_d, step);
+    sim_kern_fade_density(self->kern, self->pool, self->m_d, step);
+}
+
+static inline int32_t _sim_filter_tap(int32_t N, int32_t out_size, int32_t k, float* pt/* out */)
+{
+    // NOTE: Pixel centers are mapped onto the box, cell `i` is centered at `i`.
+    const float u = clamp(((float)k + 0.5f) * (float)N / (float)out_size - 0.5f, 0.0f, (float)(N - 1));
+    const float u0 = floorf(u);
+    *pt = u - u0;
+    return (int32_t)u0;
+}
+
+static inline void _sim_filter_weights(sim_filter_e filter, float t, float* w/* out */, int32_t stride)
+{
+    // Taps at -1, 0, +1, +2 from the cell left of (above) the sample.
+    switch (filter) {
+    case SIM_FILTER_NEAREST:
+        w[0] = 0.0f;
+        w[stride] = (t < 0.5f) ? 1.0f : 0.0f;
+        w[2 * stride] = (t < 0.5f) ? 0.0f : 1.0f;
+        w[3 * stride] = 0.0f;
+        break;
+    case SIM_FILTER_BILINEAR:
+        w[0] = 0.0f;
+        w[stride] = 1.0f - t;
+        w[2 * stride] = t;
+        w[3 * stride] = 0.0f;
+        break;
+    case SIM_FILTER_CATMULL_ROM: {
+        const float t2 = t * t, t3 = t2 * t;
+        w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+        w[stride] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+        w[2 * stride] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+        w[3 * stride] = 0.5f * (t3 - t2);
+        break;
+    }
+    default:
+        assert(!"unknown filter");
+        break;
+    }
+}
+
+static void _sim_render_rows(void* ctx, int32_t worker_idx, int32_t row_begin, int32_t row_end)
+{
+    const sim_render_job_t* const job = (const sim_render_job_t*)ctx;
+    const sim_obj_t self = job->self;
+    const int32_t cols = mat2f_get_cols(self->m_d);
+    const float* const d = mat2f_at_index(self->m_d, 0);
+    float* const render_col = self->render_col + (size_t)worker_idx * cols;
+    pixel_t* const render_px = self->render_px + (size_t)worker_idx * cols;
+    for (int32_t row = row_begin; row < row_end; ++row) {
+        // NOTE: Output row `row` shows density column `row`.
+        for (int32_t col = 0; col < cols; ++col) {
+            render_col[col] = d[col * cols + row];
+        }
+        self->kern->shade(render_px, render_col, cols, job->grayscale);
+        if (job->has_obstacles) {
+            for (int32_t col = 0; col < cols; ++col) {
+                if (self->solid[col * cols + row]) {
+                    render_px[col] = SIM_OBSTACLE_PIXEL;
+                }
+            }
+        }
+        for (int32_t col = 0; col < cols; ++col) {
+            job->cb(job->cb_ctx, row, col, render_px[col]);
+        }
+    }
+}
+
+static void _sim_render_scaled_rows(void* ctx, int32_t worker_idx, int32_t y_begin, int32_t y_end)
+{
+    const sim_render_job_t* const job = (const sim_render_job_t*)ctx;
+    const sim_obj_t self = job->self;
+    const int32_t N = mat2f_get_cols(self->m_d), cols = job->cols;
+    float* const row = self->scaled_scratch.row + (size_t)worker_idx * (N + 3);
+    float* const dens = self->scaled_scratch.dens + (size_t)worker_idx * cols;
+    const int32_t* const idx = self->scaled_scratch.idx;
+    const int32_t* const nearest = self->scaled_scratch.nearest;
+    const float* const w = self->scaled_scratch.w;
+
+    // NOTE: Separable, each output row filters 4 density rows into one padded row (contiguous),
+    //       then gathers 4 taps of it per output column, and shades it like `sim_render_density()`.
+    const float* const d = mat2f_at_index(self->m_d, 0);
+    for (int32_t y = y_begin; y < y_end; ++y) {
+        float t, wy[4];
+        const int32_t j0 = _sim_filter_tap(N, job->rows, y, &t);
+        _sim_filter_weights(job->filter, t, wy, 1);
+        self->kern->filter_rows(row + 1,
+            d + max(j0 - 1, 0) * N,
+            d + j0 * N,
+            d + min(j0 + 1, N - 1) * N,
+            d + min(j0 + 2, N - 1) * N,
+            wy,
+            N
+        );
+        row[0] = row[1];
+        row[N + 1] = row[N + 2] = row[N];
+
+        self->kern->filter_cols(dens, row, idx, w, cols);
+        if (job->filter == SIM_FILTER_CATMULL_ROM) {
+            for (int32_t x = 0; x < cols; ++x) {
+                dens[x] = max(dens[x], 0.0f);
+            }
+        }
+
+        pixel_t* const out = job->fb + (size_t)y * cols;
+        self->kern->shade(out, dens, cols, job->grayscale);
+        if (job->has_obstacles) {
+            const uint8_t* const solid = self->solid + (j0 + (t >= 0.5f)) * N;
+            for (int32_t x = 0; x < cols; ++x) {
+                if (solid[nearest[x]]) {
+                    out[x] = SIM_OBSTACLE_PIXEL;
+                }
+            }
+        }
+    }
 }
 
 void sim_render_density(sim_obj_t self, sim_pixel_transfer_fn_t cb, void* ctx, bool_t grayscale) {
     assert(self);
     assert(cb);
-    float const h_offset = 235.0f;
-    const mat2f_obj_t m_d = self->m_d;
-    for (int32_t row = 0; row < mat2f_get_rows(m_d); ++row) {
-        for (int32_t col = 0; col < mat2f_get_cols(m_d); ++col) {
-            const float d = *mat2f_at_coord(m_d, col, row);
-            cb(ctx, row, col,
-                _sim_hsl2rgb(
-                    (float)((int32_t)(h_offset + d) % 361),
-                    grayscale ? 0.0f : 0.7f,
-                    min(d, grayscale ? 200.0f : 255.0f) * (1.0f / 255.0f)
-                ));
-        }
+    const int32_t rows = mat2f_get_rows(self->m_d);
+    sim_render_job_t job = {
+        .self = self,
+        .cb = cb,
+        .cb_ctx = ctx,
+        .grayscale = grayscale,
+        .has_obstacles = sim_has_obstacles(self),
+    };
+    pool_parallel_for(self->pool, _sim_render_rows, &job, 0, rows, sim_kern_get_row_grain(rows));
+}
+
+bool_t sim_render_density_scaled(sim_obj_t self, pixel_t* fb, int32_t cols, int32_t rows, sim_filter_e filter, bool_t grayscale) {
+    assert(self);
+    assert(fb && cols > 0 && rows > 0);
+    assert(0 <= filter && filter < SIM_FILTER_COUNT);
+
+    const int32_t N = mat2f_get_cols(self->m_d);
+    const size_t worker_count = (size_t)sim_get_worker_count(self);
+    if (!_sim_reserve((void**)&self->scaled_scratch.row, &self->scaled_scratch.row_cap, ((size_t)N + 3) * worker_count, sizeof(float)) ||
+        !_sim_reserve((void**)&self->scaled_scratch.dens, &self->scaled_scratch.dens_cap, (size_t)cols * worker_count, sizeof(float)) ||
+        !_sim_reserve((void**)&self->scaled_scratch.idx, &self->scaled_scratch.idx_cap, (size_t)cols, sizeof(int32_t)) ||
+        !_sim_reserve((void**)&self->scaled_scratch.nearest, &self->scaled_scratch.nearest_cap, (size_t)cols, sizeof(int32_t)) ||
+        !_sim_reserve((void**)&self->scaled_scratch.w, &self->scaled_scratch.w_cap, 4 * (size_t)cols, sizeof(float)))
+    {
+        return FALSE;
+    }
+
+    int32_t* const idx = self->scaled_scratch.idx;
+    int32_t* const nearest = self->scaled_scratch.nearest;
+    float* const w = self->scaled_scratch.w;
+
+    // Horizontal taps are the same for every output row.
+    for (int32_t x = 0; x < cols; ++x) {
+        float t;
+        const int32_t i0 = _sim_filter_tap(N, cols, x, &t);
+        idx[x] = i0; // NOTE: Tap -1 of cell `i0` is `row[i0]`, the filtered row starts at `row + 1`.
+        nearest[x] = i0 + (t >= 0.5f);
+        _sim_filter_weights(filter, t, w + x, cols);
     }
+
+    sim_render_job_t job = {
+        .self = self,
+        .fb = fb,
+        .cols = cols,
+        .rows = rows,
+        .filter = filter,
+        .grayscale = grayscale,
+        .has_obstacles = sim_has_obstacles(self),
+    };
+    pool_parallel_for(self->pool, _sim_render_scaled_rows, &job, 0, rows, sim_kern_get_row_grain(cols));
+
+    return TRUE;
 }
 
 void sim_update(sim_obj_t self) {
     assert(self);
+    assert(self->scratch); // NOTE: Sims created by `sim_create_shared()` must use `sim_update_with_scratch()`.
+    _sim_update(self, self->scratch);
+}
 
-    const float
-        dt = self->dt,
-        diff = self->diff,
-        visc = self->visc;
+void sim_update_with_scratch(sim_obj_t self, sim_scratch_obj_t scratch) {
+    assert(self);
+    _sim_update(self, scratch);
+}
 
-    const int32_t
-        solve_iter_size = self->solve_iter_size;
+void sim_get_peaks(sim_obj_t self, sim_peaks_t* peaks/* out */) {
+    assert(self);
+    assert(peaks);
+    peaks->speed = self->advect_stats.v_max * self->dt * (float)(mat2f_get_rows(self->m_d) - 2); // NOTE: The scale of the backtrace.
+    peaks->density = self->advect_stats.d_max;
+}
+
+bool_t sim_get_stats_enabled(sim_obj_t self) {
+    assert(self);
+    return self->fl_stats;
+}
+
+void sim_set_stats_enabled(sim_obj_t self, bool_t enabled) {
+    assert(self);
+    self->fl_stats = enabled;
+    if (!enabled) {
+        memset(&self->project_stats, 0, sizeof(self->project_stats));
+    }
+}
 
-    const mat2f_obj_t
-        m_vx0 = self->m_vx0,
-        m_vx = self->m_vx,
-        m_vy = self->m_vy,
-        m_vy0 = self->m_vy0,
-        m_d = self->m_d,
-        m_d0 = self->m_d0;
-
-    _sim_step_density(
-        m_d, m_d0,
-        m_vx, m_vy, 
-        diff, 
-        dt, 
-        solve_iter_size
-    );
-
-    _sim_step_velocity(
-        m_vx, m_vy, 
-        m_vx0, m_vy0, 
-        visc, 
-        dt, 
-        solve_iter_size
-    );
-}
\ No newline at end of file
+void sim_get_stats(sim_obj_t self, sim_stats_t* stats/* out */) {
+    assert(self);
+    assert(stats);
+
+    // NOTE: Velocities scale to cells per step like the backtrace. The divergence kernel leaves
+    //       `-(d vx/dx + d vy/dy) / (N (N-2))` in grid units, times `dt` it is the relative change
+    //       of a cell's area over one step.
+    const float
+        h = self->dt * (float)(mat2f_get_rows(self->m_d) - 2),
+        N = (float)sim_get_velocity_cols(self),
+        div_scale = self->dt * N * (N - 2.0f);
+    stats->mass = self->advect_stats.d_sum;
+    stats->energy = 0.5 * self->advect_stats.v2_sum * (double)h * (double)h;
+    stats->speed = self->advect_stats.v_max * h;
+    stats->divergence = self->project_stats.div_max * div_scale;
+    stats->residual = self->project_stats.res_max * div_scale;
+}
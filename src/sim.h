@@ -1,21 +1,119 @@
 ﻿#pragma once
 #include "common.h"
 #include "pixel.h"
+#include "pool.h"
+
+#define SIM_MAX_CHANNELS 8 // scalar fields of a sim, the density included
 
 DECL_OBJECT(sim_obj_t);
+DECL_OBJECT(sim_scratch_obj_t);
+
+typedef enum {
+    SIM_FIELD_DENSITY,
+    SIM_FIELD_VX,
+    SIM_FIELD_VY,
+} sim_field_e;
+
+typedef enum {
+    SIM_ISA_SCALAR,
+    SIM_ISA_SSE42,
+    SIM_ISA_AVX2,
+    SIM_ISA_AVX512,
+    SIM_ISA_COUNT,
+} sim_isa_e;
+
+typedef enum {
+    SIM_SOLVER_GAUSS_SEIDEL, // fixed number of sweeps, approximate
+    SIM_SOLVER_SPECTRAL, // exact, by fast cosine/sine transforms, open box only (Gauss-Seidel with obstacles)
+    SIM_SOLVER_COUNT,
+} sim_solver_e;
+
+typedef enum {
+    SIM_FILTER_NEAREST, // cell blocks, like `sim_render_density()`
+    SIM_FILTER_BILINEAR,
+    SIM_FILTER_CATMULL_ROM, // bicubic, sharper, overshoot below 0 is clamped
+    SIM_FILTER_COUNT,
+} sim_filter_e;
+
+typedef enum {
+    SIM_SPLAT_FALLOFF_BOX,      // constant weight over the square support
+    SIM_SPLAT_FALLOFF_GAUSSIAN, // exp(-2 * d^2 / radius^2), truncated at the radius (disk support)
+} sim_splat_falloff_e;
+
+typedef struct {
+    float x, y; // center in cell coordinates (x: column, y: row)
+    float radius; // in cells, 0 touches the nearest cell only
+    float density; // density added at the center
+    float fx, fy; // force added at the center
+    sim_splat_falloff_e falloff;
+} sim_splat_t;
+
+typedef struct {
+    float speed; // largest velocity component, in cells per step
+    float density; // largest value of the scalar channels, at least 0
+} sim_peaks_t;
+
+typedef struct {
+    double mass; // sum of the density over the fluid cells
+    double energy; // kinetic, half the sum of |velocity|^2 over the fluid cells, velocity in cells per step
+    float speed; // largest velocity component, in cells per step
+    float divergence; // largest |divergence| the projection left, as relative change of a cell's area per step
+    float residual; // largest |residual| of the pressure solve, in the units of `divergence`
+} sim_stats_t;
 
 typedef void(*sim_pixel_transfer_fn_t)(void* ctx, int32_t row, int32_t col, pixel_t clr);
 
 sim_obj_t sim_create(int32_t box_size);
+sim_obj_t sim_create_shared(int32_t box_size); // NOTE: Does not own solver scratch, must be stepped with `sim_update_with_scratch()`.
 void sim_destroy(sim_obj_t*);
+sim_scratch_obj_t sim_scratch_create(int32_t box_size);
+void sim_scratch_destroy(sim_scratch_obj_t*);
+bool_t sim_scratch_reserve_channels(sim_scratch_obj_t, int32_t count); // NOTE: A scratch steps sims of up to `count` channels (1 when created). FALSE if out of memory.
+int32_t sim_get_rows(sim_obj_t);
+int32_t sim_get_cols(sim_obj_t);
+bool_t sim_resize(sim_obj_t, int32_t box_size); // NOTE: Resamples the density, velocity and obstacles onto the new box, the velocity is projected again. A shared sim needs a scratch of the new size. FALSE if `box_size` is below 10, the velocity grid of `sim_set_velocity_coarsening()` would be below 10 cells, or out of memory, the sim is unchanged.
+const float* sim_get_field_data(sim_obj_t, sim_field_e field); // NOTE: Row-major `rows * cols` elements, owned by the `sim` object.
 float sim_get_time_step(sim_obj_t);
 void sim_set_time_step(sim_obj_t, float dt);
 float sim_get_diffusion(sim_obj_t);
 void sim_set_diffusion(sim_obj_t, float diff);
 float sim_get_viscosity(sim_obj_t);
 void sim_set_viscosity(sim_obj_t, float visc);
+sim_isa_e sim_get_isa(sim_obj_t);
+bool_t sim_set_isa(sim_obj_t, sim_isa_e isa); // NOTE: FALSE if `isa` is not compiled in or not supported by the cpu.
+const char* sim_isa_get_name(sim_isa_e isa);
+int32_t sim_get_worker_count(sim_obj_t);
+pool_obj_t sim_get_pool(sim_obj_t); // NOTE: Workers of the sim for work between its steps, NULL with one worker. Replaced by `sim_set_worker_count()`.
+bool_t sim_set_worker_count(sim_obj_t, int32_t worker_count); // NOTE: Threads stepping and rendering, 1 (default) runs on the calling thread, 0 uses the number of cpus. FALSE if out of memory.
+sim_solver_e sim_get_solver(sim_obj_t);
+void sim_set_solver(sim_obj_t, sim_solver_e solver);
+int32_t sim_get_solve_iter_size(sim_obj_t);
+void sim_set_solve_iter_size(sim_obj_t, int32_t iter_size); // NOTE: Gauss-Seidel sweeps per solve, 12 by default.
+int32_t sim_get_velocity_coarsening(sim_obj_t);
+bool_t sim_set_velocity_coarsening(sim_obj_t, int32_t factor); // NOTE: Solves the velocity on a grid `factor` times coarser than the density (1, default, for the same grid), the fields stay on the density grid. FALSE if the coarse grid would be below 10 cells or out of memory.
+int32_t sim_get_velocity_cols(sim_obj_t); // NOTE: Of the grid the velocity is solved on.
+int32_t sim_get_channel_count(sim_obj_t);
+bool_t sim_set_channel_count(sim_obj_t, int32_t count); // NOTE: Passive scalars (dye, temperature, ...) advected and diffused with the density in one batch, the density is channel 0 (1, default, for the density only). Added channels start at zero. A shared sim needs a scratch with as many channels. FALSE if `count` is not in [1, SIM_MAX_CHANNELS] or out of memory.
+const float* sim_get_channel_data(sim_obj_t, int32_t channel); // NOTE: Row-major `rows * cols` elements, channel 0 is `SIM_FIELD_DENSITY`.
+float sim_get_channel_diffusion(sim_obj_t, int32_t channel);
+void sim_set_channel_diffusion(sim_obj_t, int32_t channel, float diff); // NOTE: Channel 0 is `sim_set_diffusion()`, added channels start at 0.
+void sim_add_channel(sim_obj_t, int32_t channel, int32_t x, int32_t y, float step);
+void sim_fade_channel(sim_obj_t, int32_t channel, float step);
+const char* sim_solver_get_name(sim_solver_e solver);
+bool_t sim_set_obstacles(sim_obj_t, const uint8_t* solid); // NOTE: Row-major `rows * cols` bytes, nonzero is solid, NULL clears. The box border is always a wall. FALSE if out of memory.
+bool_t sim_paint_obstacle(sim_obj_t, int32_t x, int32_t y, float radius, bool_t solid); // NOTE: Sets the cells within `radius` of (x, y).
+const uint8_t* sim_get_obstacles(sim_obj_t); // NOTE: Row-major `rows * cols` bytes, 1 for solid.
+bool_t sim_has_obstacles(sim_obj_t);
 void sim_add_force(sim_obj_t, int32_t x, int32_t y, float fx, float fy);
 void sim_add_density(sim_obj_t, int32_t x, int32_t y, float step);
+bool_t sim_add_splats(sim_obj_t, const sim_splat_t* splats, int32_t count); // NOTE: FALSE if out of memory or a splat is not finite, nothing is added then. Not recorded by the input journal, callers that replay must journal the splats themselves.
 void sim_fade_density(sim_obj_t, float step);
-void sim_render_density(sim_obj_t, sim_pixel_transfer_fn_t cb, void* ctx, bool_t grayscale);
-void sim_update(sim_obj_t);
\ No newline at end of file
+void sim_render_density(sim_obj_t, sim_pixel_transfer_fn_t cb, void* ctx, bool_t grayscale); // NOTE: With several workers, `cb` is called concurrently for different rows.
+bool_t sim_render_density_scaled(sim_obj_t, pixel_t* fb/* out */, int32_t cols, int32_t rows, sim_filter_e filter, bool_t grayscale); // NOTE: Row-major `rows * cols` image of the whole box at any resolution (x: column, y: row). FALSE if out of memory.
+const char* sim_filter_get_name(sim_filter_e filter);
+void sim_update(sim_obj_t);
+void sim_update_with_scratch(sim_obj_t, sim_scratch_obj_t scratch);
+void sim_get_peaks(sim_obj_t, sim_peaks_t* peaks/* out */); // NOTE: Of the last step, taken by its scalar advection: the velocity the scalars were moved with and the scalars it left in the fluid cells. Sources added since are not included, 0 before the first step.
+bool_t sim_get_stats_enabled(sim_obj_t);
+void sim_set_stats_enabled(sim_obj_t, bool_t enabled); // NOTE: Also takes `divergence` and `residual` of `sim_stats_t`, in the gradient of the last projection of a step, which then reads the pressure twice more. Off by default.
+void sim_get_stats(sim_obj_t, sim_stats_t* stats/* out */); // NOTE: Of the last step. `mass`, `energy` and `speed` are taken by its scalar advection like `sim_get_peaks()`, the others are 0 unless enabled. With several workers the sums may differ in the last bits between runs.
@@ -0,0 +1,1292 @@
+﻿#include "sim_kern.h"
+#include "misc.h"
+#include "atomic.h"
+
+#if defined(SIM_KERN_X86)
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+extern const sim_kern_table_t g_sim_kern_table_sse42;
+extern const sim_kern_table_t g_sim_kern_table_avx2;
+extern const sim_kern_table_t g_sim_kern_table_avx512;
+#endif
+
+// Scalar reference kernels
+
+static void _sim_kern_gs_row_scalar(
+    float* row/* inout */,
+    const float* up,
+    const float* dn,
+    const float* src,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const float a,
+    const float c_recip)
+{
+    // NOTE: The left neighbour is split off the sum and resolved 4 cells at a time, like the prefix
+    //       scan of the SIMD variants (zero-filled lanes included), so every variant rounds the same way.
+    const float ac = a * c_recip, ac2 = ac * ac, ac3 = ac2 * ac, ac4 = ac2 * ac2;
+    for (int32_t i0 = i_begin; i0 < i_end; i0 += SIM_KERN_GS_CHUNK) {
+        const int32_t n = min(SIM_KERN_GS_CHUNK, i_end - i0);
+        float t[4];
+        float left = row[i0 - 1];
+        int32_t k = 0;
+        for (; k + 4 <= n; k += 4) {
+            for (int32_t m = 0; m < 4; ++m) {
+                const int32_t i = i0 + k + m;
+                t[m] = c_recip * (src[i] + a * ((row[i+1] + up[i]) + dn[i]));
+            }
+            const float
+                s0 = t[0] + ac * 0.0f,
+                s1 = t[1] + ac * t[0],
+                s2 = t[2] + ac * t[1],
+                s3 = t[3] + ac * t[2];
+            row[i0 + k + 0] = (s0 + ac2 * 0.0f) + ac * left;
+            row[i0 + k + 1] = (s1 + ac2 * 0.0f) + ac2 * left;
+            row[i0 + k + 2] = (s2 + ac2 * s0) + ac3 * left;
+            row[i0 + k + 3] = (s3 + ac2 * s1) + ac4 * left;
+            left = row[i0 + k + 3];
+        }
+        for (; k < n; ++k) {
+            const int32_t i = i0 + k;
+            left = c_recip * (src[i] + a * ((row[i+1] + up[i]) + dn[i])) + ac * left;
+            row[i] = left;
+        }
+    }
+}
+
+static void _sim_kern_advect_scalar(
+    float* d,
+    const float* d0,
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const float dt,
+    sim_kern_stats_t* stats/* inout */)
+{
+    const float
+        dt_x = dt * (N-2),
+        dt_y = dt * (N-2),
+        N_f32 = (float)N;
+
+    float v_max = stats->v_max, d_max = stats->d_max, d_sum = 0, v2_sum = 0;
+    for (int32_t i = i_begin; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        const float
+            x = clamp((float)i - (dt_x * vx[idx]), 0.5f, N_f32 + 0.5f),
+            y = clamp((float)j - (dt_y * vy[idx]), 0.5f, N_f32 + 0.5f);
+        v_max = max(v_max, max(fabsf(vx[idx]), fabsf(vy[idx])));
+        v2_sum += vx[idx] * vx[idx] + vy[idx] * vy[idx];
+
+        const float
+            i0 = floorf(x),
+            j0 = floorf(y);
+
+        const float
+            s1 = x - i0,
+            s0 = 1.0f - s1,
+            t1 = y - j0,
+            t0 = 1.0f - t1;
+
+        // NOTE: The sample point may lie up to 1.5 cells past the last row/column, clamp like `mat2f_at_coord()`.
+        const int32_t
+            i0_i32 = min((int32_t)i0, N-1),
+            i1_i32 = min((int32_t)i0 + 1, N-1),
+            j0_i32 = min((int32_t)j0, N-1) * N,
+            j1_i32 = min((int32_t)j0 + 1, N-1) * N;
+
+        d[idx] =
+            s0 * (t0 * d0[j0_i32 + i0_i32] + t1 * d0[j1_i32 + i0_i32]) +
+            s1 * (t0 * d0[j0_i32 + i1_i32] + t1 * d0[j1_i32 + i1_i32]);
+        d_max = max(d_max, d[idx]);
+        d_sum += d[idx];
+    }
+    stats->v_max = v_max;
+    stats->d_max = d_max;
+    stats->d_sum += d_sum;
+    stats->v2_sum += v2_sum;
+}
+
+static void _sim_kern_advect_channels_scalar(
+    float* const* d,
+    const float* const* d0,
+    const int32_t count,
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const float dt,
+    sim_kern_stats_t* stats/* inout */)
+{
+    const float
+        dt_x = dt * (N-2),
+        dt_y = dt * (N-2),
+        N_f32 = (float)N;
+
+    float v_max = stats->v_max, d_max = stats->d_max, d_sum = 0, v2_sum = 0;
+    for (int32_t i = i_begin; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        const float
+            x = clamp((float)i - (dt_x * vx[idx]), 0.5f, N_f32 + 0.5f),
+            y = clamp((float)j - (dt_y * vy[idx]), 0.5f, N_f32 + 0.5f);
+        v_max = max(v_max, max(fabsf(vx[idx]), fabsf(vy[idx])));
+        v2_sum += vx[idx] * vx[idx] + vy[idx] * vy[idx];
+
+        const float
+            i0 = floorf(x),
+            j0 = floorf(y);
+
+        const float
+            s1 = x - i0,
+            s0 = 1.0f - s1,
+            t1 = y - j0,
+            t0 = 1.0f - t1;
+
+        const int32_t
+            i0_i32 = min((int32_t)i0, N-1),
+            i1_i32 = min((int32_t)i0 + 1, N-1),
+            j0_i32 = min((int32_t)j0, N-1) * N,
+            j1_i32 = min((int32_t)j0 + 1, N-1) * N;
+
+        for (int32_t c = 0; c < count; ++c) {
+            const float* const src = d0[c];
+            d[c][idx] =
+                s0 * (t0 * src[j0_i32 + i0_i32] + t1 * src[j1_i32 + i0_i32]) +
+                s1 * (t0 * src[j0_i32 + i1_i32] + t1 * src[j1_i32 + i1_i32]);
+            d_max = max(d_max, d[c][idx]);
+        }
+        d_sum += d[0][idx];
+    }
+    stats->v_max = v_max;
+    stats->d_max = d_max;
+    stats->d_sum += d_sum;
+    stats->v2_sum += v2_sum;
+}
+
+static void _sim_kern_divergence_scalar(
+    float* div,
+    float* p,
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end)
+{
+    const float coef = -0.5f * (1.0f / (float)N);
+    for (int32_t i = i_begin; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        div[idx] = coef * (vx[idx+1] - vx[idx-1] + vy[idx+N] - vy[idx-N]);
+        p[idx] = 0;
+    }
+}
+
+static void _sim_kern_gradient_scalar(
+    float* vx/* inout */,
+    float* vy/* inout */,
+    const float* p,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end)
+{
+    const float coef = 0.5f * (float)N;
+    for (int32_t i = i_begin; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        vx[idx] -= coef * (p[idx+1] - p[idx-1]);
+        vy[idx] -= coef * (p[idx+N] - p[idx-N]);
+    }
+}
+
+// NOTE: The residual is that of the system `sim_kern_project()` solves. The divergence the gradient
+//       leaves at a cell follows from `p` and `div` alone once its four neighbours were moved by it:
+//       the central difference divergence of the central difference gradient is the wide Laplacian.
+static void _sim_kern_gradient_stats_scalar(
+    float* vx/* inout */,
+    float* vy/* inout */,
+    const float* p,
+    const float* div,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const int32_t k_begin,
+    sim_kern_stats_t* stats/* inout */)
+{
+    const float coef = 0.5f * (float)N;
+    float div_max = stats->div_max, res_max = stats->res_max;
+    for (int32_t i = i_begin; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        vx[idx] -= coef * (p[idx+1] - p[idx-1]);
+        vy[idx] -= coef * (p[idx+N] - p[idx-N]);
+        res_max = max(res_max, fabsf(div[idx] + ((p[idx-1] + p[idx+1]) + (p[idx-N] + p[idx+N])) - 4.0f * p[idx]));
+        if (i >= k_begin) {
+            div_max = max(div_max, fabsf(div[idx] + 0.25f * (((p[idx-2] + p[idx+2]) + (p[idx-2*N] + p[idx+2*N])) - 4.0f * p[idx])));
+        }
+    }
+    stats->div_max = div_max;
+    stats->res_max = res_max;
+}
+
+static inline void _sim_kern_sample_scalar(
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    float x,
+    float y,
+    float* pu/* out */,
+    float* pv/* out */)
+{
+    // NOTE: Clamped to the centers of the border cells, so all four taps are inside the grid.
+    x = clamp(x, 0.5f, (float)N - 1.5f);
+    y = clamp(y, 0.5f, (float)N - 1.5f);
+
+    const float
+        i0 = floorf(x),
+        j0 = floorf(y);
+
+    const float
+        s1 = x - i0,
+        s0 = 1.0f - s1,
+        t1 = y - j0,
+        t0 = 1.0f - t1;
+
+    const int32_t idx = (int32_t)j0 * N + (int32_t)i0;
+    *pu = s0 * (t0 * vx[idx] + t1 * vx[idx+N]) + s1 * (t0 * vx[idx+1] + t1 * vx[idx+N+1]);
+    *pv = s0 * (t0 * vy[idx] + t1 * vy[idx+N]) + s1 * (t0 * vy[idx+1] + t1 * vy[idx+N+1]);
+}
+
+static void _sim_kern_trace_scalar(
+    float* px/* inout */,
+    float* py/* inout */,
+    const int32_t count,
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    const float h)
+{
+    const float h_half = 0.5f * h;
+    for (int32_t k = 0; k < count; ++k) {
+        float u, v;
+        _sim_kern_sample_scalar(vx, vy, N, px[k], py[k], &u, &v);
+        _sim_kern_sample_scalar(vx, vy, N, px[k] + h_half * u, py[k] + h_half * v, &u, &v);
+        px[k] += h * u;
+        py[k] += h * v;
+    }
+}
+
+static void _sim_kern_filter_rows_scalar(
+    float* dst,
+    const float* r0,
+    const float* r1,
+    const float* r2,
+    const float* r3,
+    const float* w,
+    const int32_t count)
+{
+    for (int32_t k = 0; k < count; ++k) {
+        dst[k] = w[0] * r0[k] + w[1] * r1[k] + w[2] * r2[k] + w[3] * r3[k];
+    }
+}
+
+static void _sim_kern_filter_cols_scalar(
+    float* dst,
+    const float* src,
+    const int32_t* idx,
+    const float* w,
+    const int32_t count)
+{
+    for (int32_t k = 0; k < count; ++k) {
+        const float* const s = src + idx[k];
+        dst[k] = w[k] * s[0] + w[count + k] * s[1] + w[2 * count + k] * s[2] + w[3 * count + k] * s[3];
+    }
+}
+
+static void _sim_kern_fade_scalar(
+    float* d/* inout */,
+    const int32_t size,
+    const float step)
+{
+    for (int32_t i = 0; i < size; ++i) {
+        d[i] = max(d[i] - step, 0.0f);
+    }
+}
+
+static void _sim_kern_shade_scalar(
+    pixel_t* out,
+    const float* d,
+    const int32_t count,
+    const bool_t grayscale)
+{
+    float const h_offset = 235.0f;
+    for (int32_t i = 0; i < count; ++i) {
+        out[i] = sim_kern_hsl2rgb(
+            (float)((int32_t)(h_offset + d[i]) % 361),
+            grayscale ? 0.0f : 0.7f,
+            min(d[i], grayscale ? 200.0f : 255.0f) * (1.0f / 255.0f)
+        );
+    }
+}
+
+static const sim_kern_table_t g_sim_kern_table_scalar = {
+    .isa = SIM_ISA_SCALAR,
+    .gs_row = _sim_kern_gs_row_scalar,
+    .advect = _sim_kern_advect_scalar,
+    .advect_channels = _sim_kern_advect_channels_scalar,
+    .divergence = _sim_kern_divergence_scalar,
+    .gradient = _sim_kern_gradient_scalar,
+    .gradient_stats = _sim_kern_gradient_stats_scalar,
+    .trace = _sim_kern_trace_scalar,
+    .filter_rows = _sim_kern_filter_rows_scalar,
+    .filter_cols = _sim_kern_filter_cols_scalar,
+    .fade = _sim_kern_fade_scalar,
+    .shade = _sim_kern_shade_scalar,
+};
+
+// Dispatch
+
+static sim_isa_e _sim_kern_detect_isa(void)
+{
+#if defined(SIM_KERN_X86)
+    uint32_t r[4];
+#  if defined(_MSC_VER)
+#    define SIM_KERN_CPUID(LEAF, SUBLEAF) __cpuidex((int*)r, (LEAF), (SUBLEAF))
+#  else
+#    define SIM_KERN_CPUID(LEAF, SUBLEAF) __cpuid_count((LEAF), (SUBLEAF), r[0], r[1], r[2], r[3])
+#  endif
+
+    SIM_KERN_CPUID(0, 0);
+    const uint32_t max_leaf = r[0];
+    if (max_leaf < 1) {
+        return SIM_ISA_SCALAR;
+    }
+
+    SIM_KERN_CPUID(1, 0);
+    const uint32_t leaf1_ecx = r[2];
+    if (!(leaf1_ecx & (1u << 20))) { // SSE4.2
+        return SIM_ISA_SCALAR;
+    }
+
+    // NOTE: AVX state must also be enabled by the OS (OSXSAVE + XCR0), not just supported by the cpu.
+    uint64_t xcr0 = 0;
+    if (leaf1_ecx & (1u << 27)) {
+#  if defined(_MSC_VER)
+        xcr0 = _xgetbv(0);
+#  else
+        uint32_t lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = ((uint64_t)hi << 32) | lo;
+#  endif
+    }
+
+    uint32_t leaf7_ebx = 0;
+    if (max_leaf >= 7) {
+        SIM_KERN_CPUID(7, 0);
+        leaf7_ebx = r[1];
+    }
+#  undef SIM_KERN_CPUID
+
+    const bool_t
+        has_avx = (leaf1_ecx & (1u << 28)) && (xcr0 & 0x6) == 0x6,
+        has_avx2 = has_avx && (leaf1_ecx & (1u << 12)) && (leaf7_ebx & (1u << 5)), // + FMA
+        has_avx512 = has_avx2 && (leaf7_ebx & (1u << 16)) && (xcr0 & 0xe6) == 0xe6;
+
+    return has_avx512 ? SIM_ISA_AVX512 : has_avx2 ? SIM_ISA_AVX2 : SIM_ISA_SSE42;
+#else
+    return SIM_ISA_SCALAR;
+#endif
+}
+
+const sim_kern_table_t* sim_kern_get_table(sim_isa_e isa) {
+    static sim_isa_e s_best_isa = SIM_ISA_COUNT; // NOTE: Benign race, every thread computes the same value.
+    if (s_best_isa == SIM_ISA_COUNT) {
+        s_best_isa = _sim_kern_detect_isa();
+    }
+    if ((int32_t)isa < 0 || isa > s_best_isa) {
+        return NULL;
+    }
+
+    switch (isa) {
+    case SIM_ISA_SCALAR: return &g_sim_kern_table_scalar;
+#if defined(SIM_KERN_X86)
+    case SIM_ISA_SSE42: return &g_sim_kern_table_sse42;
+    case SIM_ISA_AVX2: return &g_sim_kern_table_avx2;
+    case SIM_ISA_AVX512: return &g_sim_kern_table_avx512;
+#endif
+    default: return NULL;
+    }
+}
+
+const sim_kern_table_t* sim_kern_get_default_table(void) {
+    const char* const env = getenv("FLUID_SIM_ISA");
+    if (env && *env) {
+        for (int32_t isa = 0; isa < SIM_ISA_COUNT; ++isa) {
+            if (!strcmp(env, sim_isa_get_name((sim_isa_e)isa))) {
+                const sim_kern_table_t* const kt = sim_kern_get_table((sim_isa_e)isa);
+                if (kt) {
+                    return kt;
+                }
+                break;
+            }
+        }
+        fprintf(stderr, "FLUID_SIM_ISA=%s is not available, using the best supported isa.\n", env);
+    }
+
+    for (int32_t isa = SIM_ISA_COUNT - 1; isa > SIM_ISA_SCALAR; --isa) {
+        const sim_kern_table_t* const kt = sim_kern_get_table((sim_isa_e)isa);
+        if (kt) {
+            return kt;
+        }
+    }
+    return &g_sim_kern_table_scalar;
+}
+
+// Field-level kernels
+
+static inline const sim_mask_span_t* _sim_kern_get_row_spans(
+    const sim_mask_obj_t mask,
+    const int32_t N,
+    const int32_t j,
+    sim_mask_span_t* open/* out */,
+    int32_t* pcount/* out */)
+{
+    if (mask) {
+        return sim_mask_get_row_spans(mask, j, pcount);
+    }
+    open->i_begin = 1;
+    open->i_end = N-1;
+    *pcount = 1;
+    return open;
+}
+
+static inline void _sim_kern_apply_mask_bounds(
+    const sim_mask_bnd_t* bnds,
+    const int32_t count,
+    const int32_t b,
+    float* x/* inout */)
+{
+    for (int32_t k = 0; k < count; ++k) {
+        const sim_mask_bnd_t* const e = &bnds[k];
+        const float* const w = e->w[b];
+        const float* const s = x + e->idx;
+        x[e->idx] = (w[0] * s[e->off[0]] + w[1] * s[e->off[1]]) + (w[2] * s[e->off[2]] + w[3] * s[e->off[3]]);
+    }
+}
+
+static inline void _sim_kern_set_row_edges(float* row/* inout */, const int32_t N, const float sx)
+{
+    row[0] = sx * row[1];
+    row[N-1] = sx * row[N-2];
+}
+
+static inline void _sim_kern_set_edge_row(float* edge/* out */, const float* row, const int32_t N, const float sy)
+{
+    for (int32_t i = 1; i < N-1; ++i) {
+        edge[i] = sy * row[i];
+    }
+}
+
+static inline void _sim_kern_set_corners(float* x/* inout */, const int32_t N)
+{
+    x[0] = 0.5f * (x[1] + x[N]);
+    x[(N-1)*N] = 0.5f * (x[(N-1)*N + 1] + x[(N-2)*N]);
+    x[N-1] = 0.5f * (x[N-2] + x[N + N-1]);
+    x[(N-1)*N + N-1] = 0.5f * (x[(N-1)*N + N-2] + x[(N-2)*N + N-1]);
+}
+
+static inline void _sim_kern_set_edge_rows(float* x/* inout */, const int32_t N, const float sy)
+{
+    _sim_kern_set_edge_row(x, x + N, N, sy);
+    _sim_kern_set_edge_row(x + (N-1) * N, x + (N-2) * N, N, sy);
+    _sim_kern_set_corners(x, N);
+}
+
+// NOTE: Mirror signs of the edge columns and rows for `b`, multiplying by -1 is exact like a negation.
+static inline float _sim_kern_get_sign_x(const int32_t b) { return (b == 1) ? -1.0f : 1.0f; }
+static inline float _sim_kern_get_sign_y(const int32_t b) { return (b == 2) ? -1.0f : 1.0f; }
+
+void sim_kern_set_bounds(
+    const sim_mask_obj_t mask,
+    const int32_t b,
+    const mat2f_obj_t m_x/* inout */)
+{
+    assert(!mat2f_is_empty(m_x) 
+        && mat2f_get_rows(m_x) == mat2f_get_cols(m_x)
+    );
+
+    const int32_t N = mat2f_get_rows(m_x);
+    float* const x = mat2f_at_index(m_x, 0);
+
+    // NOTE: Obstacles first, the box edges may copy a solid cell next to them.
+    if (mask) {
+        int32_t bnd_count;
+        const sim_mask_bnd_t* const bnds = sim_mask_get_bounds(mask, &bnd_count);
+        _sim_kern_apply_mask_bounds(bnds, bnd_count, b, x);
+    }
+
+    const float sx = _sim_kern_get_sign_x(b);
+    for (int32_t j = 1; j < N-1; ++j) {
+        _sim_kern_set_row_edges(x + j * N, N, sx);
+    }
+    _sim_kern_set_edge_rows(x, N, _sim_kern_get_sign_y(b));
+}
+
+static inline void _sim_kern_set_row_bounds(
+    const sim_mask_obj_t mask,
+    const int32_t b,
+    float* x/* inout */,
+    const int32_t N,
+    const int32_t j)
+{
+    // NOTE: The edges `sim_kern_set_bounds()` derives from interior row `j`, after the solid cells of
+    //       row `j`. Corners are never read by the stencil, so they are left to the end of the solve.
+    if (mask) {
+        int32_t bnd_count;
+        const sim_mask_bnd_t* const bnds = sim_mask_get_row_bounds(mask, j, &bnd_count);
+        _sim_kern_apply_mask_bounds(bnds, bnd_count, b, x);
+    }
+
+    float* const row = x + j * N;
+    _sim_kern_set_row_edges(row, N, _sim_kern_get_sign_x(b));
+
+    if (j == 1 || j == N-2) {
+        _sim_kern_set_edge_row((j == 1) ? x : x + (N-1) * N, row, N, _sim_kern_get_sign_y(b));
+    }
+}
+
+int32_t sim_kern_get_gs_block_depth(int32_t N, int32_t iter_size) {
+    // A block keeps about `3 * depth + 1` rows of `x` and `x0` in flight, see below.
+    const int32_t depth = (SIM_KERN_GS_BLOCK_BYTES / (int32_t)(N * sizeof(float)) - 1) / 3;
+    return clamp(depth, 1, max(iter_size, 1));
+}
+
+void sim_kern_solve_gauss_seidel_blocked(
+    const sim_kern_table_t* kt,
+    const sim_mask_obj_t mask,
+    const int32_t b,
+    const mat2f_obj_t m_x/* inout */,
+    const mat2f_obj_t m_x0,
+    const float a,
+    const float c,
+    const int32_t iter_size,
+    const int32_t block_depth)
+{
+    assert(kt);
+    assert(block_depth >= 1);
+    assert(!mat2f_is_empty(m_x) 
+        && mat2f_get_rows(m_x) == mat2f_get_cols(m_x)
+        && mat2f_is_shape_eq(m_x, m_x0)
+    );
+
+    const int32_t N = mat2f_get_rows(m_x);
+    float* const x = mat2f_at_index(m_x, 0);
+    const float* const x0 = mat2f_at_index(m_x0, 0);
+    const float c_recip = 1.0f / c;
+
+    // Temporal blocking: `depth` sweeps advance together as a wavefront, sweep `m` trailing
+    // sweep `m - 1` by `lag` rows. Row `j` of sweep `m` reads row `j - 1` of sweep `m` and row
+    // `j + 1` of sweep `m - 1`, so a lag of 2 rows gives exactly the values of sweeping one by one,
+    // while each row is loaded once per block instead of once per sweep. The solid cells of a row
+    // only read its direct neighbours, so they are updated right after it without breaking this.
+    const int32_t lag = 2;
+    for (int32_t k = 0; k < iter_size; k += block_depth) {
+        const int32_t depth = min(block_depth, iter_size - k);
+        for (int32_t s = 1; s < N-1 + (depth - 1) * lag; ++s) {
+            for (int32_t m = 0; m < depth; ++m) {
+                const int32_t j = s - m * lag;
+                if (j < 1) {
+                    break;
+                }
+                if (j > N-2) {
+                    continue;
+                }
+                float* const row = x + j * N;
+                sim_mask_span_t open;
+                int32_t span_count;
+                const sim_mask_span_t* const spans = _sim_kern_get_row_spans(mask, N, j, &open, &span_count);
+                for (int32_t n = 0; n < span_count; ++n) {
+                    kt->gs_row(row, row - N, row + N, x0 + j * N, spans[n].i_begin, spans[n].i_end, a, c_recip);
+                }
+                _sim_kern_set_row_bounds(mask, b, x, N, j);
+            }
+        }
+    }
+
+    _sim_kern_set_corners(x, N);
+}
+
+void sim_kern_solve_gauss_seidel(
+    const sim_kern_table_t* kt,
+    const sim_mask_obj_t mask,
+    const int32_t b,
+    const mat2f_obj_t m_x/* inout */,
+    const mat2f_obj_t m_x0,
+    const float a,
+    const float c,
+    const int32_t iter_size)
+{
+    sim_kern_solve_gauss_seidel_blocked(
+        kt,
+        mask,
+        b,
+        m_x, m_x0,
+        a,
+        c,
+        iter_size,
+        sim_kern_get_gs_block_depth(mat2f_get_rows(m_x), iter_size)
+    );
+}
+
+void sim_kern_diffuse(
+    const sim_kern_table_t* kt,
+    const sim_mask_obj_t mask,
+    const int32_t b,
+    const mat2f_obj_t m_x/* inout */,
+    const mat2f_obj_t m_x0,
+    const float diff,
+    const float dt,
+    const int32_t solve_iter_size)
+{
+    assert(!mat2f_is_empty(m_x) 
+        && mat2f_get_rows(m_x) == mat2f_get_cols(m_x)
+        && mat2f_is_shape_eq(m_x, m_x0)
+    );
+
+    const int32_t N = mat2f_get_rows(m_x);
+
+    const float 
+        a = dt * diff * (N-2) * (N-2), 
+        c = 1 + 4 * a;
+
+    mat2f_copy(m_x, m_x0); // NOTE: Start from the source field, so the result does not depend on stale scratch contents.
+    if (a == 0.0f) {
+        // NOTE: Every sweep would rewrite the source values, only the bounds are left.
+        sim_kern_set_bounds(mask, b, m_x);
+        return;
+    }
+    sim_kern_solve_gauss_seidel(
+        kt,
+        mask,
+        b, 
+        m_x, m_x0, 
+        a, 
+        c, 
+        solve_iter_size
+    );
+}
+
+typedef struct {
+    const sim_kern_table_t* kt;
+    sim_mask_obj_t mask;
+    int32_t N;
+    int32_t b; // advect: boundary of `out0`
+    float* out0; // advect: d, divergence: div, gradient: vx
+    float* out1; // divergence: p, gradient: vy
+    const float* in0; // advect: d0, gradient: p
+    const float* in1; // gradient: div, with stats
+    const float* vx;
+    const float* vy;
+    float dt;
+    float step; // fade
+    int32_t count; // advect channels
+    float* outs[SIM_MAX_CHANNELS];
+    const float* ins[SIM_MAX_CHANNELS];
+    volatile int32_t max_bits[4]; // `sim_kern_stats_t` of all chunks, as bits: v_max, d_max, div_max, res_max
+    volatile int64_t sum_bits[2]; // d_sum, v2_sum
+} sim_kern_rows_job_t; // arguments of a row loop split over a pool
+
+// NOTE: The maxima are never negative, so their bits order like their values and the chunks of a
+//       loop can merge them with an integer compare-and-swap, once per chunk. The sums are added
+//       the same way, so with several workers their last bits depend on the order of the chunks.
+static void _sim_kern_merge_max(volatile int32_t* bits/* inout */, float value)
+{
+    int32_t new_bits;
+    memcpy(&new_bits, &value, sizeof(new_bits));
+    for (int32_t old_bits = atomic_load_i32(bits); new_bits > old_bits; old_bits = atomic_load_i32(bits)) {
+        if (atomic_cas_i32(bits, old_bits, new_bits)) {
+            break;
+        }
+    }
+}
+
+static void _sim_kern_merge_sum(volatile int64_t* bits/* inout */, double value)
+{
+    for (;;) {
+        const int64_t old_bits = atomic_load_i64(bits);
+        double sum;
+        int64_t new_bits;
+        memcpy(&sum, &old_bits, sizeof(sum));
+        sum += value;
+        memcpy(&new_bits, &sum, sizeof(new_bits));
+        if (atomic_cas_i64(bits, old_bits, new_bits)) {
+            break;
+        }
+    }
+}
+
+static void _sim_kern_merge_stats(sim_kern_rows_job_t* job, const sim_kern_stats_t* stats)
+{
+    _sim_kern_merge_max(&job->max_bits[0], stats->v_max);
+    _sim_kern_merge_max(&job->max_bits[1], stats->d_max);
+    _sim_kern_merge_max(&job->max_bits[2], stats->div_max);
+    _sim_kern_merge_max(&job->max_bits[3], stats->res_max);
+    _sim_kern_merge_sum(&job->sum_bits[0], stats->d_sum);
+    _sim_kern_merge_sum(&job->sum_bits[1], stats->v2_sum);
+}
+
+static void _sim_kern_get_stats(const sim_kern_rows_job_t* job, sim_kern_stats_t* stats/* out */)
+{
+    memcpy(&stats->v_max, (const int32_t*)&job->max_bits[0], sizeof(float));
+    memcpy(&stats->d_max, (const int32_t*)&job->max_bits[1], sizeof(float));
+    memcpy(&stats->div_max, (const int32_t*)&job->max_bits[2], sizeof(float));
+    memcpy(&stats->res_max, (const int32_t*)&job->max_bits[3], sizeof(float));
+    memcpy(&stats->d_sum, (const int64_t*)&job->sum_bits[0], sizeof(double));
+    memcpy(&stats->v2_sum, (const int64_t*)&job->sum_bits[1], sizeof(double));
+}
+
+// NOTE: In the open box the row loops set the edge columns of each row while it is still in cache,
+//       leaving only the contiguous edge rows to `_sim_kern_finish_bounds()`. Obstacle bounds read
+//       the rows above and below, so with a mask the whole pass runs after the loop.
+static void _sim_kern_finish_bounds(
+    const sim_mask_obj_t mask,
+    const int32_t b,
+    const mat2f_obj_t m_x/* inout */)
+{
+    if (mask) {
+        sim_kern_set_bounds(mask, b, m_x);
+        return;
+    }
+    _sim_kern_set_edge_rows(mat2f_at_index(m_x, 0), mat2f_get_rows(m_x), _sim_kern_get_sign_y(b));
+}
+
+static void _sim_kern_divergence_rows(void* ctx, int32_t worker_idx, int32_t j_begin, int32_t j_end)
+{
+    UNUSED_PARAM(worker_idx);
+
+    const sim_kern_rows_job_t* const job = (const sim_kern_rows_job_t*)ctx;
+    for (int32_t j = j_begin; j < j_end; ++j) {
+        sim_mask_span_t open;
+        int32_t span_count;
+        const sim_mask_span_t* const spans = _sim_kern_get_row_spans(job->mask, job->N, j, &open, &span_count);
+        for (int32_t n = 0; n < span_count; ++n) {
+            job->kt->divergence(job->out0, job->out1, job->vx, job->vy, job->N, j, spans[n].i_begin, spans[n].i_end);
+        }
+        if (!job->mask) {
+            _sim_kern_set_row_edges(job->out0 + j * job->N, job->N, 1.0f);
+            _sim_kern_set_row_edges(job->out1 + j * job->N, job->N, 1.0f);
+        }
+    }
+}
+
+static void _sim_kern_gradient_rows(void* ctx, int32_t worker_idx, int32_t j_begin, int32_t j_end)
+{
+    UNUSED_PARAM(worker_idx);
+
+    const sim_kern_rows_job_t* const job = (const sim_kern_rows_job_t*)ctx;
+    for (int32_t j = j_begin; j < j_end; ++j) {
+        sim_mask_span_t open;
+        int32_t span_count;
+        const sim_mask_span_t* const spans = _sim_kern_get_row_spans(job->mask, job->N, j, &open, &span_count);
+        for (int32_t n = 0; n < span_count; ++n) {
+            job->kt->gradient(job->out0, job->out1, job->in0, job->N, j, spans[n].i_begin, spans[n].i_end);
+        }
+        if (!job->mask) {
+            _sim_kern_set_row_edges(job->out0 + j * job->N, job->N, _sim_kern_get_sign_x(1));
+            _sim_kern_set_row_edges(job->out1 + j * job->N, job->N, _sim_kern_get_sign_x(2));
+        }
+    }
+}
+
+// NOTE: Only the cells whose four neighbours are fluid, inside the spans of row `j` narrowed by one
+//       and inside those of rows `j-1` and `j+1`, get the divergence. A span is split into runs at
+//       the starts of these cells, so the kernel measures each run from its `k_begin` to its end.
+static void _sim_kern_gradient_stats_rows(void* ctx, int32_t worker_idx, int32_t j_begin, int32_t j_end)
+{
+    UNUSED_PARAM(worker_idx);
+
+    sim_kern_rows_job_t* const job = (sim_kern_rows_job_t*)ctx;
+    const int32_t N = job->N;
+    sim_kern_stats_t stats = { 0 };
+    for (int32_t j = j_begin; j < j_end; ++j) {
+        sim_mask_span_t open, open_up, open_dn;
+        int32_t span_count, up_count = 0, dn_count = 0;
+        const sim_mask_span_t* const spans = _sim_kern_get_row_spans(job->mask, N, j, &open, &span_count);
+        const sim_mask_span_t* up = NULL;
+        const sim_mask_span_t* dn = NULL;
+        if (j >= 2 && j < N-2) {
+            up = _sim_kern_get_row_spans(job->mask, N, j-1, &open_up, &up_count);
+            dn = _sim_kern_get_row_spans(job->mask, N, j+1, &open_dn, &dn_count);
+        }
+
+        int32_t u = 0, d = 0;
+        for (int32_t n = 0; n < span_count; ++n) {
+            int32_t i = spans[n].i_begin;
+            for (int32_t lo = spans[n].i_begin + 1, hi = spans[n].i_end - 1; lo < hi;) {
+                while (u < up_count && up[u].i_end <= lo) {
+                    ++u;
+                }
+                while (d < dn_count && dn[d].i_end <= lo) {
+                    ++d;
+                }
+                if (u == up_count || d == dn_count) {
+                    break;
+                }
+                const int32_t
+                    k_begin = max(lo, max(up[u].i_begin, dn[d].i_begin)),
+                    k_end = min(hi, min(up[u].i_end, dn[d].i_end));
+                if (k_begin < k_end) {
+                    job->kt->gradient_stats(job->out0, job->out1, job->in0, job->in1, N, j, i, k_end, k_begin, &stats);
+                    i = k_end;
+                }
+                lo = max(k_begin, k_end);
+            }
+            job->kt->gradient_stats(job->out0, job->out1, job->in0, job->in1, N, j, i, spans[n].i_end, spans[n].i_end, &stats);
+        }
+        if (!job->mask) {
+            _sim_kern_set_row_edges(job->out0 + j * N, N, _sim_kern_get_sign_x(1));
+            _sim_kern_set_row_edges(job->out1 + j * N, N, _sim_kern_get_sign_x(2));
+        }
+    }
+    _sim_kern_merge_stats(job, &stats);
+}
+
+static void _sim_kern_advect_rows(void* ctx, int32_t worker_idx, int32_t j_begin, int32_t j_end)
+{
+    UNUSED_PARAM(worker_idx);
+
+    sim_kern_rows_job_t* const job = (sim_kern_rows_job_t*)ctx;
+    sim_kern_stats_t stats = { 0 };
+    for (int32_t j = j_begin; j < j_end; ++j) {
+        sim_mask_span_t open;
+        int32_t span_count;
+        const sim_mask_span_t* const spans = _sim_kern_get_row_spans(job->mask, job->N, j, &open, &span_count);
+        for (int32_t n = 0; n < span_count; ++n) {
+            job->kt->advect(job->out0, job->in0, job->vx, job->vy, job->N, j, spans[n].i_begin, spans[n].i_end, job->dt, &stats);
+        }
+        if (!job->mask) {
+            _sim_kern_set_row_edges(job->out0 + j * job->N, job->N, _sim_kern_get_sign_x(job->b));
+        }
+    }
+    _sim_kern_merge_stats(job, &stats);
+}
+
+static void _sim_kern_advect_channel_rows(void* ctx, int32_t worker_idx, int32_t j_begin, int32_t j_end)
+{
+    UNUSED_PARAM(worker_idx);
+
+    sim_kern_rows_job_t* const job = (sim_kern_rows_job_t*)ctx;
+    sim_kern_stats_t stats = { 0 };
+    for (int32_t j = j_begin; j < j_end; ++j) {
+        sim_mask_span_t open;
+        int32_t span_count;
+        const sim_mask_span_t* const spans = _sim_kern_get_row_spans(job->mask, job->N, j, &open, &span_count);
+        for (int32_t n = 0; n < span_count; ++n) {
+            job->kt->advect_channels(job->outs, job->ins, job->count, job->vx, job->vy, job->N, j, spans[n].i_begin, spans[n].i_end, job->dt, &stats);
+        }
+        if (!job->mask) {
+            for (int32_t c = 0; c < job->count; ++c) {
+                _sim_kern_set_row_edges(job->outs[c] + j * job->N, job->N, _sim_kern_get_sign_x(job->b));
+            }
+        }
+    }
+    _sim_kern_merge_stats(job, &stats);
+}
+
+static void _sim_kern_fade_cells(void* ctx, int32_t worker_idx, int32_t begin, int32_t end)
+{
+    UNUSED_PARAM(worker_idx);
+
+    const sim_kern_rows_job_t* const job = (const sim_kern_rows_job_t*)ctx;
+    job->kt->fade(job->out0 + begin, end - begin, job->step);
+}
+
+int32_t sim_kern_get_row_grain(int32_t N) {
+    return max(SIM_KERN_CHUNK_CELLS / max(N, 1), 1);
+}
+
+void sim_kern_divergence(
+    const sim_kern_table_t* kt,
+    const pool_obj_t pool,
+    const sim_mask_obj_t mask,
+    const mat2f_obj_t m_div/* inout */,
+    const mat2f_obj_t m_p/* inout */,
+    const mat2f_obj_t m_vx,
+    const mat2f_obj_t m_vy)
+{
+    assert(kt);
+    assert(!mat2f_is_empty(m_div)
+        && mat2f_get_rows(m_div) == mat2f_get_cols(m_div)
+        && mat2f_is_shape_eq(m_div, m_p)
+        && mat2f_is_shape_eq(m_div, m_vx)
+        && mat2f_is_shape_eq(m_div, m_vy)
+    );
+
+    const int32_t N = mat2f_get_rows(m_div);
+    sim_kern_rows_job_t job = {
+        .kt = kt,
+        .mask = mask,
+        .N = N,
+        .out0 = mat2f_at_index(m_div, 0),
+        .out1 = mat2f_at_index(m_p, 0),
+        .vx = mat2f_at_index(m_vx, 0),
+        .vy = mat2f_at_index(m_vy, 0),
+    };
+    pool_parallel_for(pool, _sim_kern_divergence_rows, &job, 1, N-1, sim_kern_get_row_grain(N));
+
+    _sim_kern_finish_bounds(mask, 0, m_div);
+    _sim_kern_finish_bounds(mask, 0, m_p);
+}
+
+void sim_kern_gradient(
+    const sim_kern_table_t* kt,
+    const pool_obj_t pool,
+    const sim_mask_obj_t mask,
+    const mat2f_obj_t m_vx/* inout */,
+    const mat2f_obj_t m_vy/* inout */,
+    const mat2f_obj_t m_p,
+    const mat2f_obj_t m_div,
+    sim_kern_stats_t* stats/* out */)
+{
+    assert(kt);
+    assert(!mat2f_is_empty(m_vx)
+        && mat2f_get_rows(m_vx) == mat2f_get_cols(m_vx)
+        && mat2f_is_shape_eq(m_vx, m_vy)
+        && mat2f_is_shape_eq(m_vx, m_p)
+    );
+    assert(!stats || mat2f_is_shape_eq(m_vx, m_div));
+
+    const int32_t N = mat2f_get_rows(m_vx);
+    sim_kern_rows_job_t job = {
+        .kt = kt,
+        .mask = mask,
+        .N = N,
+        .out0 = mat2f_at_index(m_vx, 0),
+        .out1 = mat2f_at_index(m_vy, 0),
+        .in0 = mat2f_at_index(m_p, 0),
+    };
+    if (stats) {
+        job.in1 = mat2f_at_index(m_div, 0);
+        pool_parallel_for(pool, _sim_kern_gradient_stats_rows, &job, 1, N-1, sim_kern_get_row_grain(N));
+        _sim_kern_get_stats(&job, stats);
+    } else {
+        pool_parallel_for(pool, _sim_kern_gradient_rows, &job, 1, N-1, sim_kern_get_row_grain(N));
+    }
+
+    _sim_kern_finish_bounds(mask, 1, m_vx);
+    _sim_kern_finish_bounds(mask, 2, m_vy);
+}
+
+void sim_kern_project(
+    const sim_kern_table_t* kt,
+    const pool_obj_t pool,
+    const sim_mask_obj_t mask,
+    const mat2f_obj_t m_vx/* inout */,
+    const mat2f_obj_t m_vy/* inout */,
+    const mat2f_obj_t m_p/* inout */,
+    const mat2f_obj_t m_div/* inout */,
+    const int32_t solve_iter_size,
+    sim_kern_stats_t* stats/* out */)
+{
+    assert(kt);
+    assert(!mat2f_is_empty(m_vx)
+        && mat2f_get_rows(m_vx) == mat2f_get_cols(m_vx)
+        && mat2f_is_shape_eq(m_vx, m_vy)
+        && mat2f_is_shape_eq(m_vx, m_p)
+        && mat2f_is_shape_eq(m_vx, m_div)
+    );
+
+    sim_kern_divergence(kt, pool, mask, m_div, m_p, m_vx, m_vy);
+    sim_kern_solve_gauss_seidel(
+        kt,
+        mask,
+        0, 
+        m_p, m_div, 
+        1, 
+        4, 
+        solve_iter_size
+    );
+
+    sim_kern_gradient(kt, pool, mask, m_vx, m_vy, m_p, m_div, stats);
+}
+
+void sim_kern_advect(
+    const sim_kern_table_t* kt,
+    const pool_obj_t pool,
+    const sim_mask_obj_t mask,
+    const int32_t b,
+    const mat2f_obj_t m_d/* inout */,
+    const mat2f_obj_t m_d0,
+    const mat2f_obj_t m_vx,
+    const mat2f_obj_t m_vy,
+    const float dt,
+    sim_kern_stats_t* stats/* out */)
+{
+    assert(kt);
+    assert(!mat2f_is_empty(m_d) 
+        && mat2f_get_rows(m_d) == mat2f_get_cols(m_d)
+        && mat2f_is_shape_eq(m_d, m_d0)
+        && mat2f_is_shape_eq(m_d, m_vx)
+        && mat2f_is_shape_eq(m_d, m_vy)
+    );
+
+    const int32_t N = mat2f_get_rows(m_d);
+    sim_kern_rows_job_t job = {
+        .kt = kt,
+        .mask = mask,
+        .N = N,
+        .b = b,
+        .out0 = mat2f_at_index(m_d, 0),
+        .in0 = mat2f_at_index(m_d0, 0),
+        .vx = mat2f_at_index(m_vx, 0),
+        .vy = mat2f_at_index(m_vy, 0),
+        .dt = dt,
+    };
+    pool_parallel_for(pool, _sim_kern_advect_rows, &job, 1, N-1, sim_kern_get_row_grain(N));
+    if (stats) {
+        _sim_kern_get_stats(&job, stats);
+    }
+
+    _sim_kern_finish_bounds(mask, b, m_d);
+}
+
+void sim_kern_advect_channels(
+    const sim_kern_table_t* kt,
+    const pool_obj_t pool,
+    const sim_mask_obj_t mask,
+    const int32_t b,
+    const mat2f_obj_t* m_d/* inout */,
+    const mat2f_obj_t* m_d0,
+    const int32_t count,
+    const mat2f_obj_t m_vx,
+    const mat2f_obj_t m_vy,
+    const float dt,
+    sim_kern_stats_t* stats/* out */)
+{
+    assert(kt);
+    assert(count > 0 && count <= SIM_MAX_CHANNELS);
+    assert(!mat2f_is_empty(m_vx)
+        && mat2f_get_rows(m_vx) == mat2f_get_cols(m_vx)
+        && mat2f_is_shape_eq(m_vx, m_vy)
+    );
+
+    const int32_t N = mat2f_get_rows(m_vx);
+    sim_kern_rows_job_t job = {
+        .kt = kt,
+        .mask = mask,
+        .N = N,
+        .b = b,
+        .vx = mat2f_at_index(m_vx, 0),
+        .vy = mat2f_at_index(m_vy, 0),
+        .dt = dt,
+        .count = count,
+    };
+    for (int32_t c = 0; c < count; ++c) {
+        assert(mat2f_is_shape_eq(m_d[c], m_vx) && mat2f_is_shape_eq(m_d0[c], m_vx));
+        job.outs[c] = mat2f_at_index(m_d[c], 0);
+        job.ins[c] = mat2f_at_index(m_d0[c], 0);
+    }
+    pool_parallel_for(pool, _sim_kern_advect_channel_rows, &job, 1, N-1, sim_kern_get_row_grain(N));
+    if (stats) {
+        _sim_kern_get_stats(&job, stats);
+    }
+
+    for (int32_t c = 0; c < count; ++c) {
+        _sim_kern_finish_bounds(mask, b, m_d[c]);
+    }
+}
+
+void sim_kern_fade_density(
+    const sim_kern_table_t* kt,
+    const pool_obj_t pool,
+    const mat2f_obj_t m_d/* inout */,
+    const float step)
+{
+    assert(kt);
+    assert(!mat2f_is_empty(m_d) 
+        && mat2f_get_rows(m_d) == mat2f_get_cols(m_d)
+    );
+
+    sim_kern_rows_job_t job = {
+        .kt = kt,
+        .out0 = mat2f_at_index(m_d, 0),
+        .step = step,
+    };
+    pool_parallel_for(pool, _sim_kern_fade_cells, &job, 0, mat2f_get_size(m_d), SIM_KERN_CHUNK_CELLS);
+}
+
+// Tiled layout
+
+static inline float* _sim_kern_tiled_at(float* x, const int32_t tile_cols, const int32_t j, const int32_t i)
+{
+    return x + mat2f_get_tiled_index(tile_cols, j, i);
+}
+
+void sim_kern_set_bounds_tiled(
+    const int32_t b,
+    const mat2f_obj_t m_x/* inout */)
+{
+    assert(!mat2f_is_empty(m_x)
+        && mat2f_get_rows(m_x) == mat2f_get_cols(m_x)
+        && mat2f_get_layout(m_x) == MAT2F_LAYOUT_TILED
+    );
+
+    const int32_t N = mat2f_get_rows(m_x), tc = mat2f_get_tile_cols(m_x);
+    float* const x = mat2f_at_index(m_x, 0);
+
+    for (int32_t j = 1; j < N; ++j) {
+        const float l = *_sim_kern_tiled_at(x, tc, j, 1), r = *_sim_kern_tiled_at(x, tc, j, N-2);
+        *_sim_kern_tiled_at(x, tc, j, 0) = b == 1 ? -l : l;
+        *_sim_kern_tiled_at(x, tc, j, N-1) = b == 1 ? -r : r;
+    }
+
+    for (int32_t i = 1; i < N; ++i) {
+        const float t = *_sim_kern_tiled_at(x, tc, 1, i), d = *_sim_kern_tiled_at(x, tc, N-2, i);
+        *_sim_kern_tiled_at(x, tc, 0, i) = b == 2 ? -t : t;
+        *_sim_kern_tiled_at(x, tc, N-1, i) = b == 2 ? -d : d;
+    }
+
+    *_sim_kern_tiled_at(x, tc, 0, 0) = 0.5f * (*_sim_kern_tiled_at(x, tc, 0, 1) + *_sim_kern_tiled_at(x, tc, 1, 0));
+    *_sim_kern_tiled_at(x, tc, N-1, 0) = 0.5f * (*_sim_kern_tiled_at(x, tc, N-1, 1) + *_sim_kern_tiled_at(x, tc, N-2, 0));
+    *_sim_kern_tiled_at(x, tc, 0, N-1) = 0.5f * (*_sim_kern_tiled_at(x, tc, 0, N-2) + *_sim_kern_tiled_at(x, tc, 1, N-1));
+    *_sim_kern_tiled_at(x, tc, N-1, N-1) = 0.5f * (*_sim_kern_tiled_at(x, tc, N-1, N-2) + *_sim_kern_tiled_at(x, tc, N-2, N-1));
+}
+
+void sim_kern_solve_gauss_seidel_tiled(
+    const int32_t b,
+    const mat2f_obj_t m_x/* inout */,
+    const mat2f_obj_t m_x0,
+    const float a,
+    const float c,
+    const int32_t iter_size)
+{
+    assert(!mat2f_is_empty(m_x)
+        && mat2f_get_rows(m_x) == mat2f_get_cols(m_x)
+        && mat2f_get_layout(m_x) == MAT2F_LAYOUT_TILED
+        && mat2f_is_shape_eq(m_x, m_x0)
+    );
+
+    const int32_t N = mat2f_get_rows(m_x), tc = mat2f_get_tile_cols(m_x);
+    float* const x = mat2f_at_index(m_x, 0);
+    const float* const x0 = mat2f_at_index(m_x0, 0);
+    const float c_recip = 1.0f / c, ac = a * c_recip;
+
+    // NOTE: Tiles are swept in row-major order, rows top to bottom inside a tile. A cell then still
+    //       sees its new up and left neighbours and its old right and down ones, like a row-major
+    //       sweep. The edges are only read by the next sweep, so they are rewritten once per sweep.
+    for (int32_t k = 0; k < iter_size; ++k) {
+        for (int32_t tj = 0; tj < N; tj += MAT2F_TILE_SIZE) {
+            for (int32_t ti = 0; ti < N; ti += MAT2F_TILE_SIZE) {
+                const int32_t
+                    j_begin = max(tj, 1), j_end = min(tj + MAT2F_TILE_SIZE, N-1),
+                    i_begin = max(ti, 1), i_end = min(ti + MAT2F_TILE_SIZE, N-1);
+                for (int32_t j = j_begin; j < j_end; ++j) {
+                    // NOTE: Rows of the tile and of its neighbours are contiguous runs of `MAT2F_TILE_SIZE`
+                    //       cells, only the right neighbour of the last column lies in the next tile.
+                    float* const row = _sim_kern_tiled_at(x, tc, j, ti);
+                    const float
+                        * const up = _sim_kern_tiled_at(x, tc, j-1, ti),
+                        * const dn = _sim_kern_tiled_at(x, tc, j+1, ti),
+                        * const src = x0 + (row - x);
+                    const float right_edge = *_sim_kern_tiled_at(x, tc, j, ti + MAT2F_TILE_SIZE - 1 < N-1 ? ti + MAT2F_TILE_SIZE : N-1);
+                    float left = *_sim_kern_tiled_at(x, tc, j, i_begin - 1);
+                    for (int32_t i = i_begin - ti; i < i_end - ti; ++i) {
+                        const float right = (i < MAT2F_TILE_SIZE - 1) ? row[i+1] : right_edge;
+                        left = c_recip * (src[i] + a * ((right + up[i]) + dn[i])) + ac * left;
+                        row[i] = left;
+                    }
+                }
+            }
+        }
+        sim_kern_set_bounds_tiled(b, m_x);
+    }
+}
+
+static void _sim_kern_advect_tiles(void* ctx, int32_t worker_idx, int32_t tj_begin, int32_t tj_end)
+{
+    UNUSED_PARAM(worker_idx);
+
+    const sim_kern_rows_job_t* const job = (const sim_kern_rows_job_t*)ctx;
+    const int32_t N = job->N, tc = (N + MAT2F_TILE_MASK) >> MAT2F_TILE_SHIFT;
+    const float
+        dt_x = job->dt * (N-2),
+        dt_y = job->dt * (N-2),
+        N_f32 = (float)N;
+
+    // NOTE: Same arithmetic as `_sim_kern_advect_scalar()`, only the indexing differs.
+    for (int32_t tj = tj_begin; tj < tj_end; ++tj) {
+        for (int32_t ti = 0; ti < tc; ++ti) {
+            const int32_t
+                j_begin = max(tj * MAT2F_TILE_SIZE, 1), j_end = min((tj + 1) * MAT2F_TILE_SIZE, N-1),
+                i_begin = max(ti * MAT2F_TILE_SIZE, 1), i_end = min((ti + 1) * MAT2F_TILE_SIZE, N-1);
+            for (int32_t j = j_begin; j < j_end; ++j) {
+                const int32_t row_idx = mat2f_get_tiled_index(tc, j, 0) + (ti << (2 * MAT2F_TILE_SHIFT)) - ti * MAT2F_TILE_SIZE;
+                for (int32_t i = i_begin; i < i_end; ++i) {
+                    const int32_t idx = row_idx + i;
+                    const float
+                        x = clamp((float)i - (dt_x * job->vx[idx]), 0.5f, N_f32 + 0.5f),
+                        y = clamp((float)j - (dt_y * job->vy[idx]), 0.5f, N_f32 + 0.5f);
+
+                    const float
+                        i0 = floorf(x),
+                        j0 = floorf(y);
+
+                    const float
+                        s1 = x - i0,
+                        s0 = 1.0f - s1,
+                        t1 = y - j0,
+                        t0 = 1.0f - t1;
+
+                    const int32_t
+                        i0_i32 = min((int32_t)i0, N-1),
+                        i1_i32 = min((int32_t)i0 + 1, N-1),
+                        j0_i32 = min((int32_t)j0, N-1),
+                        j1_i32 = min((int32_t)j0 + 1, N-1);
+
+                    const float* const d0 = job->in0;
+                    job->out0[idx] =
+                        s0 * (t0 * d0[mat2f_get_tiled_index(tc, j0_i32, i0_i32)] + t1 * d0[mat2f_get_tiled_index(tc, j1_i32, i0_i32)]) +
+                        s1 * (t0 * d0[mat2f_get_tiled_index(tc, j0_i32, i1_i32)] + t1 * d0[mat2f_get_tiled_index(tc, j1_i32, i1_i32)]);
+                }
+            }
+        }
+    }
+}
+
+void sim_kern_advect_tiled(
+    const pool_obj_t pool,
+    const int32_t b,
+    const mat2f_obj_t m_d/* inout */,
+    const mat2f_obj_t m_d0,
+    const mat2f_obj_t m_vx,
+    const mat2f_obj_t m_vy,
+    const float dt)
+{
+    assert(!mat2f_is_empty(m_d)
+        && mat2f_get_rows(m_d) == mat2f_get_cols(m_d)
+        && mat2f_get_layout(m_d) == MAT2F_LAYOUT_TILED
+        && mat2f_is_shape_eq(m_d, m_d0)
+        && mat2f_is_shape_eq(m_d, m_vx)
+        && mat2f_is_shape_eq(m_d, m_vy)
+    );
+
+    const int32_t N = mat2f_get_rows(m_d);
+    sim_kern_rows_job_t job = {
+        .N = N,
+        .out0 = mat2f_at_index(m_d, 0),
+        .in0 = mat2f_at_index(m_d0, 0),
+        .vx = mat2f_at_index(m_vx, 0),
+        .vy = mat2f_at_index(m_vy, 0),
+        .dt = dt,
+    };
+    const int32_t tile_grain = max(sim_kern_get_row_grain(N) / MAT2F_TILE_SIZE, 1);
+    pool_parallel_for(pool, _sim_kern_advect_tiles, &job, 0, mat2f_get_tile_cols(m_d), tile_grain);
+
+    sim_kern_set_bounds_tiled(b, m_d);
+}
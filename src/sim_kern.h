@@ -0,0 +1,121 @@
+﻿#pragma once
+#include "common.h"
+#include "mat.h"
+#include "pixel.h"
+#include "sim.h"
+#include "sim_mask.h"
+#include "pool.h"
+#include <math.h>
+
+// Solver kernels of `sim`, kept apart so they can be benchmarked in isolation.
+// `b` selects the boundary condition: 0 for scalar fields, 1 for x-velocity, 2 for y-velocity.
+//
+// The hot loops go through a table of raw-pointer kernels with one variant per instruction set,
+// picked at runtime from cpuid. Row kernels only touch the interior cells `[1, N-2]`, the border
+// is rewritten by `sim_kern_set_bounds()` afterwards. All variants produce bit-identical fields,
+// so a journal replays the same on every host.
+//
+// With an obstacle `mask` the row kernels are called once per fluid run of a row and skip solid
+// cells, whose boundary values are rewritten from the compiled lists of `sim_mask`. A NULL `mask`
+// is the open box.
+//
+// Boundaries are set by the loops that write a field rather than by an extra pass: the GS sweep
+// rewrites the edges of each row right after it, and in the open box the parallel row loops do
+// the same for their rows, leaving only the contiguous top and bottom edges and the corners.
+//
+// The row loops outside of the solver (advection, divergence, gradient, fade) are split into chunks
+// of about `SIM_KERN_CHUNK_CELLS` cells over the workers of `pool`, a NULL `pool` or a grid of one
+// chunk runs on the calling thread. Rows are independent, so the result does not depend on the split.
+//
+// The `_tiled` kernels take fields of the tiled layout of `mat2f` and walk them tile by tile, so the
+// bilinear taps of a backtrace stay within a few tiles. They are scalar and only know the open box,
+// they exist to compare the locality of the layouts. The tiled advection computes exactly the values
+// of `sim_kern_advect()`, the tiled solver keeps the order of a lexicographic sweep but resolves the
+// left neighbour one cell at a time, so it matches `sim_kern_solve_gauss_seidel()` up to rounding.
+
+#define SIM_KERN_GS_CHUNK 256 // columns per chunk of a GS sweep row, a multiple of the 4-cell recurrence block
+#define SIM_KERN_GS_BLOCK_BYTES (256 * 1024) // working set of a temporally blocked GS solve, a conservative share of L2
+#define SIM_KERN_CHUNK_CELLS (16 * 1024) // cells per parallel chunk of a row loop, small grids stay on one thread
+
+typedef struct {
+    float v_max; // advect: largest |vx| or |vy| the backtraces read
+    float d_max; // advect: largest value written, at least 0
+    double d_sum; // advect: sum of the values written to the first field
+    double v2_sum; // advect: sum of vx^2 + vy^2 the backtraces read
+    float div_max; // gradient: largest |divergence| left behind
+    float res_max; // gradient: largest |residual| of the pressure equation
+} sim_kern_stats_t; // reductions of a kernel, taken in its loop rather than by another pass
+
+typedef struct {
+    sim_isa_e isa;
+    void(*gs_row)(float* row/* inout */, const float* up, const float* dn, const float* src, int32_t i_begin, int32_t i_end, float a, float c_recip); // one run of a row of a lexicographic sweep
+    void(*advect)(float* d, const float* d0, const float* vx, const float* vy, int32_t N, int32_t j, int32_t i_begin, int32_t i_end, float dt, sim_kern_stats_t* stats/* inout */);
+    void(*advect_channels)(float* const* d, const float* const* d0, int32_t count, const float* vx, const float* vy, int32_t N, int32_t j, int32_t i_begin, int32_t i_end, float dt, sim_kern_stats_t* stats/* inout */); // one backtrace for `count` fields, each as by `advect`
+    void(*divergence)(float* div, float* p, const float* vx, const float* vy, int32_t N, int32_t j, int32_t i_begin, int32_t i_end); // also zeroes `p`
+    void(*gradient)(float* vx/* inout */, float* vy/* inout */, const float* p, int32_t N, int32_t j, int32_t i_begin, int32_t i_end); // subtracts grad(p)
+    void(*gradient_stats)(float* vx/* inout */, float* vy/* inout */, const float* p, const float* div, int32_t N, int32_t j, int32_t i_begin, int32_t i_end, int32_t k_begin, sim_kern_stats_t* stats/* inout */); // as `gradient`, with the residual of `4 p - sum(p of neighbours) = div` and, from `k_begin` on, the divergence left behind
+    void(*trace)(float* px/* inout */, float* py/* inout */, int32_t count, const float* vx, const float* vy, int32_t N, float h); // midpoint (RK2) step of points in cell coordinates, `h` scales velocity to cells
+    void(*filter_rows)(float* dst, const float* r0, const float* r1, const float* r2, const float* r3, const float* w, int32_t count); // `dst[k] = sum(w[t] * r<t>[k])`
+    void(*filter_cols)(float* dst, const float* src, const int32_t* idx, const float* w, int32_t count); // `dst[k] = sum(w[t * count + k] * src[idx[k] + t])`, 4 taps
+    void(*fade)(float* d/* inout */, int32_t size, float step);
+    void(*shade)(pixel_t* out, const float* d, int32_t count, bool_t grayscale); // density to color
+} sim_kern_table_t;
+
+const sim_kern_table_t* sim_kern_get_table(sim_isa_e isa); // NOTE: NULL if `isa` is not compiled in or not supported by the cpu.
+const sim_kern_table_t* sim_kern_get_default_table(void); // NOTE: Best supported isa, or `FLUID_SIM_ISA` (scalar, sse4.2, avx2, avx512) if set.
+
+void sim_kern_set_bounds(sim_mask_obj_t mask, int32_t b, mat2f_obj_t m_x/* inout */);
+void sim_kern_solve_gauss_seidel(const sim_kern_table_t* kt, sim_mask_obj_t mask, int32_t b, mat2f_obj_t m_x/* inout */, mat2f_obj_t m_x0, float a, float c, int32_t iter_size);
+void sim_kern_solve_gauss_seidel_blocked(const sim_kern_table_t* kt, sim_mask_obj_t mask, int32_t b, mat2f_obj_t m_x/* inout */, mat2f_obj_t m_x0, float a, float c, int32_t iter_size, int32_t block_depth); // NOTE: Same result for any `block_depth`.
+int32_t sim_kern_get_gs_block_depth(int32_t N, int32_t iter_size); // NOTE: Sweeps per block so a block fits `SIM_KERN_GS_BLOCK_BYTES`.
+void sim_kern_diffuse(const sim_kern_table_t* kt, sim_mask_obj_t mask, int32_t b, mat2f_obj_t m_x/* inout */, mat2f_obj_t m_x0, float diff, float dt, int32_t solve_iter_size);
+void sim_kern_divergence(const sim_kern_table_t* kt, pool_obj_t pool, sim_mask_obj_t mask, mat2f_obj_t m_div/* inout */, mat2f_obj_t m_p/* inout */, mat2f_obj_t m_vx, mat2f_obj_t m_vy); // NOTE: Also zeroes `m_p`, and sets the bounds of both (b = 0).
+void sim_kern_gradient(const sim_kern_table_t* kt, pool_obj_t pool, sim_mask_obj_t mask, mat2f_obj_t m_vx/* inout */, mat2f_obj_t m_vy/* inout */, mat2f_obj_t m_p, mat2f_obj_t m_div, sim_kern_stats_t* stats/* out */); // NOTE: Also sets the bounds of `m_vx` (b = 1) and `m_vy` (b = 2). `stats` of the interior fluid cells, may be NULL. `m_div`, the divergence `m_p` was solved for, is only read for them.
+void sim_kern_project(const sim_kern_table_t* kt, pool_obj_t pool, sim_mask_obj_t mask, mat2f_obj_t m_vx/* inout */, mat2f_obj_t m_vy/* inout */, mat2f_obj_t m_p/* inout */, mat2f_obj_t m_div/* inout */, int32_t solve_iter_size, sim_kern_stats_t* stats/* out */); // NOTE: `stats` of the gradient, may be NULL.
+void sim_kern_advect(const sim_kern_table_t* kt, pool_obj_t pool, sim_mask_obj_t mask, int32_t b, mat2f_obj_t m_d/* inout */, mat2f_obj_t m_d0, mat2f_obj_t m_vx, mat2f_obj_t m_vy, float dt, sim_kern_stats_t* stats/* out */); // NOTE: `stats` of the interior fluid cells, may be NULL.
+void sim_kern_advect_channels(const sim_kern_table_t* kt, pool_obj_t pool, sim_mask_obj_t mask, int32_t b, const mat2f_obj_t* m_d/* inout */, const mat2f_obj_t* m_d0, int32_t count, mat2f_obj_t m_vx, mat2f_obj_t m_vy, float dt, sim_kern_stats_t* stats/* out */); // NOTE: Up to `SIM_MAX_CHANNELS` fields, each gets the values of `sim_kern_advect()`. `stats` of all fields, may be NULL.
+void sim_kern_fade_density(const sim_kern_table_t* kt, pool_obj_t pool, mat2f_obj_t m_d/* inout */, float step);
+int32_t sim_kern_get_row_grain(int32_t N); // NOTE: Rows per parallel chunk of an `N`-wide grid.
+
+void sim_kern_set_bounds_tiled(int32_t b, mat2f_obj_t m_x/* inout */);
+void sim_kern_solve_gauss_seidel_tiled(int32_t b, mat2f_obj_t m_x/* inout */, mat2f_obj_t m_x0, float a, float c, int32_t iter_size);
+void sim_kern_advect_tiled(pool_obj_t pool, int32_t b, mat2f_obj_t m_d/* inout */, mat2f_obj_t m_d0, mat2f_obj_t m_vx, mat2f_obj_t m_vy, float dt); // NOTE: Parallel over rows of tiles.
+
+static inline pixel_t sim_kern_hsl2rgb(
+    float H/* ∈ [0, 360] */,
+    float S/* ∈ [0, 1] */,
+    float L/* ∈ [0, 1] */)
+{
+    float R, G, B;/* ∈ [0, 1] */
+    float P, Q, T, fract;
+
+    (H == 360.0f) ? (H = 0.0f) : (H /= 60.0f);
+    fract = H - floorf(H);
+
+    P = L * (1.0f - S);
+    Q = L * (1.0f - S * fract);
+    T = L * (1.0f - S * (1.0f - fract));
+
+    if (0.0f <= H && H < 1.0f) {
+        R = L, G = T, B = P;
+    } else if (1.0f <= H && H < 2.0f) {
+        R = Q, G = L, B = P;
+    } else if (2.0f <= H && H < 3.0f) {
+        R = P, G = L, B = T;
+    } else if (3.0f <= H && H < 4.0f) {
+        R = P, G = Q, B = L;
+    } else if (4.0f <= H && H < 5.0f) {
+        R = T, G = P, B = L;
+    } else if (5.0f <= H && H < 6.0f) {
+        R = L, G = P, B = Q;
+    } else {
+        R = 0.0f, G = 0.0f, B = 0.0f;
+    }
+
+    return (pixel_t) { 
+        .a = 0xff,
+        .r = (uint8_t)roundf(R * 255.0f),
+        .g = (uint8_t)roundf(G * 255.0f),
+        .b = (uint8_t)roundf(B * 255.0f),
+    };
+}
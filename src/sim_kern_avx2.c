@@ -0,0 +1,41 @@
+﻿#include "sim_kern.h"
+#include "misc.h"
+#include <immintrin.h>
+
+// NOTE: Built with AVX2 enabled (see `CMakeLists.txt`), only called when cpuid reports it.
+
+#define SIMD_W 8
+
+typedef __m256 vf_t;
+typedef __m256i vi_t;
+typedef __m256 vm_t;
+
+#define VF_LOADU(P)       _mm256_loadu_ps(P)
+#define VF_STOREU(P, V)   _mm256_storeu_ps((P), (V))
+#define VF_SET1(X)        _mm256_set1_ps(X)
+#define VF_LANES()        _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)
+#define VF_ADD(A, B)      _mm256_add_ps((A), (B))
+#define VF_SUB(A, B)      _mm256_sub_ps((A), (B))
+#define VF_MUL(A, B)      _mm256_mul_ps((A), (B))
+#define VF_DIV(A, B)      _mm256_div_ps((A), (B))
+#define VF_MIN(A, B)      _mm256_min_ps((A), (B))
+#define VF_MAX(A, B)      _mm256_max_ps((A), (B))
+#define VF_FLOOR(A)       _mm256_floor_ps(A)
+#define VF_GE(A, B)       _mm256_cmp_ps((A), (B), _CMP_GE_OQ)
+#define VF_LT(A, B)       _mm256_cmp_ps((A), (B), _CMP_LT_OQ)
+#define VF_BLEND(M, A, B) _mm256_blendv_ps((A), (B), (M))
+#define VF_GATHER(P, I)   _mm256_i32gather_ps((P), (I), 4)
+#define VF_TO_VI(A)       _mm256_cvttps_epi32(A)
+#define VI_TO_VF(A)       _mm256_cvtepi32_ps(A)
+#define VI_SET1(X)        _mm256_set1_epi32(X)
+#define VI_ADD(A, B)      _mm256_add_epi32((A), (B))
+#define VI_MIN(A, B)      _mm256_min_epi32((A), (B))
+#define VI_MUL(A, B)      _mm256_mullo_epi32((A), (B))
+#define VI_OR(A, B)       _mm256_or_si256((A), (B))
+#define VI_SLLI(A, N)     _mm256_slli_epi32((A), (N))
+#define VI_LOADU(P)       _mm256_loadu_si256((const __m256i*)(P))
+#define VI_STOREU(P, V)   _mm256_storeu_si256((__m256i*)(P), (V))
+
+#define SIM_KERN_ISA   SIM_ISA_AVX2
+#define SIM_KERN_TABLE g_sim_kern_table_avx2
+#include "sim_kern_simd.inl"
@@ -0,0 +1,41 @@
+﻿#include "sim_kern.h"
+#include "misc.h"
+#include <immintrin.h>
+
+// NOTE: Built with AVX-512F enabled (see `CMakeLists.txt`), only called when cpuid reports it.
+
+#define SIMD_W 16
+
+typedef __m512 vf_t;
+typedef __m512i vi_t;
+typedef __mmask16 vm_t;
+
+#define VF_LOADU(P)       _mm512_loadu_ps(P)
+#define VF_STOREU(P, V)   _mm512_storeu_ps((P), (V))
+#define VF_SET1(X)        _mm512_set1_ps(X)
+#define VF_LANES()        _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f)
+#define VF_ADD(A, B)      _mm512_add_ps((A), (B))
+#define VF_SUB(A, B)      _mm512_sub_ps((A), (B))
+#define VF_MUL(A, B)      _mm512_mul_ps((A), (B))
+#define VF_DIV(A, B)      _mm512_div_ps((A), (B))
+#define VF_MIN(A, B)      _mm512_min_ps((A), (B))
+#define VF_MAX(A, B)      _mm512_max_ps((A), (B))
+#define VF_FLOOR(A)       _mm512_roundscale_ps((A), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)
+#define VF_GE(A, B)       _mm512_cmp_ps_mask((A), (B), _CMP_GE_OQ)
+#define VF_LT(A, B)       _mm512_cmp_ps_mask((A), (B), _CMP_LT_OQ)
+#define VF_BLEND(M, A, B) _mm512_mask_blend_ps((M), (A), (B))
+#define VF_GATHER(P, I)   _mm512_i32gather_ps((I), (P), 4)
+#define VF_TO_VI(A)       _mm512_cvttps_epi32(A)
+#define VI_TO_VF(A)       _mm512_cvtepi32_ps(A)
+#define VI_SET1(X)        _mm512_set1_epi32(X)
+#define VI_ADD(A, B)      _mm512_add_epi32((A), (B))
+#define VI_MIN(A, B)      _mm512_min_epi32((A), (B))
+#define VI_MUL(A, B)      _mm512_mullo_epi32((A), (B))
+#define VI_OR(A, B)       _mm512_or_si512((A), (B))
+#define VI_SLLI(A, N)     _mm512_slli_epi32((A), (N))
+#define VI_LOADU(P)       _mm512_loadu_si512((const void*)(P))
+#define VI_STOREU(P, V)   _mm512_storeu_si512((void*)(P), (V))
+
+#define SIM_KERN_ISA   SIM_ISA_AVX512
+#define SIM_KERN_TABLE g_sim_kern_table_avx512
+#include "sim_kern_simd.inl"
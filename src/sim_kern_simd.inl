@@ -0,0 +1,674 @@
+﻿// SIMD kernel variants, included by `sim_kern_<isa>.c` after defining the vector primitives below
+// for its instruction set. Every lane performs the same operations in the same order as the scalar
+// kernels in `sim_kern.c`, so all variants produce bit-identical fields.
+//
+//   SIMD_W                         lane count
+//   vf_t, vi_t, vm_t               float, int32 and mask vectors
+//   VF_LOADU(p), VF_STOREU(p, v)   unaligned float load/store
+//   VF_SET1(x), VF_LANES()         broadcast, { 0, 1, ..., SIMD_W - 1 }
+//   VF_ADD, VF_SUB, VF_MUL, VF_DIV, VF_MIN, VF_MAX, VF_FLOOR
+//   VF_GE(a, b), VF_LT(a, b)       compare to mask
+//   VF_BLEND(m, a, b)              `m ? b : a` per lane
+//   VF_GATHER(base, vi)            base[vi] per lane
+//   VF_TO_VI(v), VI_TO_VF(v)       truncating conversion, int to float
+//   VI_SET1, VI_ADD, VI_MIN, VI_MUL, VI_OR, VI_SLLI(v, n), VI_STOREU(p, v)
+
+static void _sim_kern_simd_gs_row(
+    float* row/* inout */,
+    const float* up,
+    const float* dn,
+    const float* src,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const float a,
+    const float c_recip)
+{
+    const float ac = a * c_recip, ac2 = ac * ac, ac3 = ac2 * ac, ac4 = ac2 * ac2;
+    const vf_t va = VF_SET1(a), vc = VF_SET1(c_recip);
+    const __m128 v_ac = _mm_set1_ps(ac), v_ac2 = _mm_set1_ps(ac2), v_acn = _mm_setr_ps(ac, ac2, ac3, ac4);
+    float t[SIM_KERN_GS_CHUNK];
+
+    for (int32_t i0 = i_begin; i0 < i_end; i0 += SIM_KERN_GS_CHUNK) {
+        const int32_t n = min(SIM_KERN_GS_CHUNK, i_end - i0);
+
+        // Everything but the left neighbour, the right one still holds the previous sweep.
+        int32_t k = 0;
+        for (; k + SIMD_W <= n; k += SIMD_W) {
+            const int32_t i = i0 + k;
+            const vf_t sum = VF_ADD(VF_ADD(VF_LOADU(row + i + 1), VF_LOADU(up + i)), VF_LOADU(dn + i));
+            VF_STOREU(t + k, VF_MUL(vc, VF_ADD(VF_LOADU(src + i), VF_MUL(va, sum))));
+        }
+        for (; k < n; ++k) {
+            const int32_t i = i0 + k;
+            t[k] = c_recip * (src[i] + a * ((row[i+1] + up[i]) + dn[i]));
+        }
+
+        // The left neighbour is a linear recurrence, resolved 4 cells at a time with a prefix scan.
+        float left = row[i0 - 1];
+        for (k = 0; k + 4 <= n; k += 4) {
+            __m128 sc = _mm_loadu_ps(t + k);
+            sc = _mm_add_ps(sc, _mm_mul_ps(v_ac, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sc), 4))));
+            sc = _mm_add_ps(sc, _mm_mul_ps(v_ac2, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sc), 8))));
+            sc = _mm_add_ps(sc, _mm_mul_ps(v_acn, _mm_set1_ps(left)));
+            _mm_storeu_ps(row + i0 + k, sc);
+            left = _mm_cvtss_f32(_mm_shuffle_ps(sc, sc, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+        for (; k < n; ++k) {
+            left = t[k] + ac * left;
+            row[i0 + k] = left;
+        }
+    }
+}
+
+static inline float _sim_kern_simd_reduce_max(vf_t v, float x)
+{
+    float lanes[SIMD_W];
+    VF_STOREU(lanes, v);
+    for (int32_t k = 0; k < SIMD_W; ++k) {
+        x = max(x, lanes[k]);
+    }
+    return x;
+}
+
+static inline float _sim_kern_simd_reduce_sum(vf_t v)
+{
+    float lanes[SIMD_W], x = 0;
+    VF_STOREU(lanes, v);
+    for (int32_t k = 0; k < SIMD_W; ++k) {
+        x += lanes[k];
+    }
+    return x;
+}
+
+static inline vf_t _sim_kern_simd_abs(vf_t v)
+{
+    return VF_MAX(v, VF_SUB(VF_SET1(0.0f), v));
+}
+
+static void _sim_kern_simd_advect(
+    float* d,
+    const float* d0,
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const float dt,
+    sim_kern_stats_t* stats/* inout */)
+{
+    const float
+        dt_x = dt * (N-2),
+        dt_y = dt * (N-2),
+        N_f32 = (float)N;
+
+    const vf_t
+        v_dt_x = VF_SET1(dt_x),
+        v_dt_y = VF_SET1(dt_y),
+        v_lo = VF_SET1(0.5f),
+        v_hi = VF_SET1(N_f32 + 0.5f),
+        v_one = VF_SET1(1.0f),
+        v_zero = VF_SET1(0.0f),
+        v_lanes = VF_LANES();
+    const vi_t
+        vi_one = VI_SET1(1),
+        vi_last = VI_SET1(N-1),
+        vi_N = VI_SET1(N);
+
+    const vf_t v_j = VF_SET1((float)j);
+    vf_t v_vmax = v_zero, v_dmax = v_zero, v_dsum = v_zero, v_v2sum = v_zero;
+    int32_t i = i_begin;
+    for (; i + SIMD_W <= i_end; i += SIMD_W) {
+        const int32_t idx = j * N + i;
+        const vf_t
+            u = VF_LOADU(vx + idx),
+            v = VF_LOADU(vy + idx);
+        const vf_t
+            x = VF_MIN(VF_MAX(VF_SUB(VF_ADD(VF_SET1((float)i), v_lanes), VF_MUL(v_dt_x, u)), v_lo), v_hi),
+            y = VF_MIN(VF_MAX(VF_SUB(v_j, VF_MUL(v_dt_y, v)), v_lo), v_hi);
+        v_vmax = VF_MAX(v_vmax, VF_MAX(_sim_kern_simd_abs(u), _sim_kern_simd_abs(v)));
+        v_v2sum = VF_ADD(v_v2sum, VF_ADD(VF_MUL(u, u), VF_MUL(v, v)));
+
+        const vf_t
+            i0 = VF_FLOOR(x),
+            j0 = VF_FLOOR(y);
+
+        const vf_t
+            s1 = VF_SUB(x, i0),
+            s0 = VF_SUB(v_one, s1),
+            t1 = VF_SUB(y, j0),
+            t0 = VF_SUB(v_one, t1);
+
+        const vi_t
+            i0_i32 = VF_TO_VI(i0),
+            j0_i32 = VF_TO_VI(j0),
+            i1_i32 = VI_MIN(VI_ADD(i0_i32, vi_one), vi_last),
+            j1_row = VI_MUL(VI_MIN(VI_ADD(j0_i32, vi_one), vi_last), vi_N),
+            j0_row = VI_MUL(VI_MIN(j0_i32, vi_last), vi_N),
+            i0_col = VI_MIN(i0_i32, vi_last);
+
+        const vf_t
+            d00 = VF_GATHER(d0, VI_ADD(j0_row, i0_col)),
+            d10 = VF_GATHER(d0, VI_ADD(j1_row, i0_col)),
+            d01 = VF_GATHER(d0, VI_ADD(j0_row, i1_i32)),
+            d11 = VF_GATHER(d0, VI_ADD(j1_row, i1_i32));
+
+        const vf_t out = VF_ADD(
+            VF_MUL(s0, VF_ADD(VF_MUL(t0, d00), VF_MUL(t1, d10))),
+            VF_MUL(s1, VF_ADD(VF_MUL(t0, d01), VF_MUL(t1, d11)))
+        );
+        VF_STOREU(d + idx, out);
+        v_dmax = VF_MAX(v_dmax, out);
+        v_dsum = VF_ADD(v_dsum, out);
+    }
+    float
+        v_max = _sim_kern_simd_reduce_max(v_vmax, stats->v_max),
+        d_max = _sim_kern_simd_reduce_max(v_dmax, stats->d_max),
+        d_sum = _sim_kern_simd_reduce_sum(v_dsum),
+        v2_sum = _sim_kern_simd_reduce_sum(v_v2sum);
+    for (; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        const float
+            x = clamp((float)i - (dt_x * vx[idx]), 0.5f, N_f32 + 0.5f),
+            y = clamp((float)j - (dt_y * vy[idx]), 0.5f, N_f32 + 0.5f);
+        v_max = max(v_max, max(fabsf(vx[idx]), fabsf(vy[idx])));
+        v2_sum += vx[idx] * vx[idx] + vy[idx] * vy[idx];
+        const float
+            i0 = floorf(x),
+            j0 = floorf(y);
+        const float
+            s1 = x - i0,
+            s0 = 1.0f - s1,
+            t1 = y - j0,
+            t0 = 1.0f - t1;
+        const int32_t
+            i0_i32 = min((int32_t)i0, N-1),
+            i1_i32 = min((int32_t)i0 + 1, N-1),
+            j0_i32 = min((int32_t)j0, N-1) * N,
+            j1_i32 = min((int32_t)j0 + 1, N-1) * N;
+        d[idx] =
+            s0 * (t0 * d0[j0_i32 + i0_i32] + t1 * d0[j1_i32 + i0_i32]) +
+            s1 * (t0 * d0[j0_i32 + i1_i32] + t1 * d0[j1_i32 + i1_i32]);
+        d_max = max(d_max, d[idx]);
+        d_sum += d[idx];
+    }
+    stats->v_max = v_max;
+    stats->d_max = d_max;
+    stats->d_sum += d_sum;
+    stats->v2_sum += v2_sum;
+}
+
+static void _sim_kern_simd_advect_channels(
+    float* const* d,
+    const float* const* d0,
+    const int32_t count,
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const float dt,
+    sim_kern_stats_t* stats/* inout */)
+{
+    const float
+        dt_x = dt * (N-2),
+        dt_y = dt * (N-2),
+        N_f32 = (float)N;
+
+    const vf_t
+        v_dt_x = VF_SET1(dt_x),
+        v_dt_y = VF_SET1(dt_y),
+        v_lo = VF_SET1(0.5f),
+        v_hi = VF_SET1(N_f32 + 0.5f),
+        v_one = VF_SET1(1.0f),
+        v_zero = VF_SET1(0.0f),
+        v_lanes = VF_LANES();
+    const vi_t
+        vi_one = VI_SET1(1),
+        vi_last = VI_SET1(N-1),
+        vi_N = VI_SET1(N);
+
+    // NOTE: Same arithmetic as `_sim_kern_simd_advect()`, the taps and weights are shared by the channels.
+    const vf_t v_j = VF_SET1((float)j);
+    vf_t v_vmax = v_zero, v_dmax = v_zero, v_dsum = v_zero, v_v2sum = v_zero;
+    int32_t i = i_begin;
+    for (; i + SIMD_W <= i_end; i += SIMD_W) {
+        const int32_t idx = j * N + i;
+        const vf_t
+            u = VF_LOADU(vx + idx),
+            v = VF_LOADU(vy + idx);
+        const vf_t
+            x = VF_MIN(VF_MAX(VF_SUB(VF_ADD(VF_SET1((float)i), v_lanes), VF_MUL(v_dt_x, u)), v_lo), v_hi),
+            y = VF_MIN(VF_MAX(VF_SUB(v_j, VF_MUL(v_dt_y, v)), v_lo), v_hi);
+        v_vmax = VF_MAX(v_vmax, VF_MAX(_sim_kern_simd_abs(u), _sim_kern_simd_abs(v)));
+        v_v2sum = VF_ADD(v_v2sum, VF_ADD(VF_MUL(u, u), VF_MUL(v, v)));
+
+        const vf_t
+            i0 = VF_FLOOR(x),
+            j0 = VF_FLOOR(y);
+
+        const vf_t
+            s1 = VF_SUB(x, i0),
+            s0 = VF_SUB(v_one, s1),
+            t1 = VF_SUB(y, j0),
+            t0 = VF_SUB(v_one, t1);
+
+        const vi_t
+            i0_i32 = VF_TO_VI(i0),
+            j0_i32 = VF_TO_VI(j0),
+            i1_i32 = VI_MIN(VI_ADD(i0_i32, vi_one), vi_last),
+            j1_row = VI_MUL(VI_MIN(VI_ADD(j0_i32, vi_one), vi_last), vi_N),
+            j0_row = VI_MUL(VI_MIN(j0_i32, vi_last), vi_N),
+            i0_col = VI_MIN(i0_i32, vi_last);
+
+        const vi_t
+            tap00 = VI_ADD(j0_row, i0_col),
+            tap10 = VI_ADD(j1_row, i0_col),
+            tap01 = VI_ADD(j0_row, i1_i32),
+            tap11 = VI_ADD(j1_row, i1_i32);
+
+        for (int32_t c = 0; c < count; ++c) {
+            const vf_t
+                d00 = VF_GATHER(d0[c], tap00),
+                d10 = VF_GATHER(d0[c], tap10),
+                d01 = VF_GATHER(d0[c], tap01),
+                d11 = VF_GATHER(d0[c], tap11);
+
+            const vf_t out = VF_ADD(
+                VF_MUL(s0, VF_ADD(VF_MUL(t0, d00), VF_MUL(t1, d10))),
+                VF_MUL(s1, VF_ADD(VF_MUL(t0, d01), VF_MUL(t1, d11)))
+            );
+            VF_STOREU(d[c] + idx, out);
+            v_dmax = VF_MAX(v_dmax, out);
+        }
+        v_dsum = VF_ADD(v_dsum, VF_LOADU(d[0] + idx));
+    }
+    float
+        v_max = _sim_kern_simd_reduce_max(v_vmax, stats->v_max),
+        d_max = _sim_kern_simd_reduce_max(v_dmax, stats->d_max),
+        d_sum = _sim_kern_simd_reduce_sum(v_dsum),
+        v2_sum = _sim_kern_simd_reduce_sum(v_v2sum);
+    for (; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        const float
+            x = clamp((float)i - (dt_x * vx[idx]), 0.5f, N_f32 + 0.5f),
+            y = clamp((float)j - (dt_y * vy[idx]), 0.5f, N_f32 + 0.5f);
+        v_max = max(v_max, max(fabsf(vx[idx]), fabsf(vy[idx])));
+        v2_sum += vx[idx] * vx[idx] + vy[idx] * vy[idx];
+        const float
+            i0 = floorf(x),
+            j0 = floorf(y);
+        const float
+            s1 = x - i0,
+            s0 = 1.0f - s1,
+            t1 = y - j0,
+            t0 = 1.0f - t1;
+        const int32_t
+            i0_i32 = min((int32_t)i0, N-1),
+            i1_i32 = min((int32_t)i0 + 1, N-1),
+            j0_i32 = min((int32_t)j0, N-1) * N,
+            j1_i32 = min((int32_t)j0 + 1, N-1) * N;
+        for (int32_t c = 0; c < count; ++c) {
+            const float* const src = d0[c];
+            d[c][idx] =
+                s0 * (t0 * src[j0_i32 + i0_i32] + t1 * src[j1_i32 + i0_i32]) +
+                s1 * (t0 * src[j0_i32 + i1_i32] + t1 * src[j1_i32 + i1_i32]);
+            d_max = max(d_max, d[c][idx]);
+        }
+        d_sum += d[0][idx];
+    }
+    stats->v_max = v_max;
+    stats->d_max = d_max;
+    stats->d_sum += d_sum;
+    stats->v2_sum += v2_sum;
+}
+
+static void _sim_kern_simd_divergence(
+    float* div,
+    float* p,
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end)
+{
+    const float coef = -0.5f * (1.0f / (float)N);
+    const vf_t v_coef = VF_SET1(coef), v_zero = VF_SET1(0.0f);
+    int32_t i = i_begin;
+    for (; i + SIMD_W <= i_end; i += SIMD_W) {
+        const int32_t idx = j * N + i;
+        const vf_t sum = VF_SUB(VF_ADD(VF_SUB(VF_LOADU(vx + idx + 1), VF_LOADU(vx + idx - 1)), VF_LOADU(vy + idx + N)), VF_LOADU(vy + idx - N));
+        VF_STOREU(div + idx, VF_MUL(v_coef, sum));
+        VF_STOREU(p + idx, v_zero);
+    }
+    for (; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        div[idx] = coef * (vx[idx+1] - vx[idx-1] + vy[idx+N] - vy[idx-N]);
+        p[idx] = 0;
+    }
+}
+
+static void _sim_kern_simd_gradient(
+    float* vx/* inout */,
+    float* vy/* inout */,
+    const float* p,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end)
+{
+    const float coef = 0.5f * (float)N;
+    const vf_t v_coef = VF_SET1(coef);
+    int32_t i = i_begin;
+    for (; i + SIMD_W <= i_end; i += SIMD_W) {
+        const int32_t idx = j * N + i;
+        VF_STOREU(vx + idx, VF_SUB(VF_LOADU(vx + idx), VF_MUL(v_coef, VF_SUB(VF_LOADU(p + idx + 1), VF_LOADU(p + idx - 1)))));
+        VF_STOREU(vy + idx, VF_SUB(VF_LOADU(vy + idx), VF_MUL(v_coef, VF_SUB(VF_LOADU(p + idx + N), VF_LOADU(p + idx - N)))));
+    }
+    for (; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        vx[idx] -= coef * (p[idx+1] - p[idx-1]);
+        vy[idx] -= coef * (p[idx+N] - p[idx-N]);
+    }
+}
+
+static inline void _sim_kern_simd_gradient_stats_run(
+    float* vx/* inout */,
+    float* vy/* inout */,
+    const float* p,
+    const float* div,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const bool_t fl_div,
+    float* pdiv_max/* inout */,
+    float* pres_max/* inout */)
+{
+    const float coef = 0.5f * (float)N;
+    const vf_t v_coef = VF_SET1(coef), v_four = VF_SET1(4.0f), v_quarter = VF_SET1(0.25f);
+    vf_t v_divmax = VF_SET1(0.0f), v_resmax = VF_SET1(0.0f);
+    int32_t i = i_begin;
+    for (; i + SIMD_W <= i_end; i += SIMD_W) {
+        const int32_t idx = j * N + i;
+        const vf_t
+            p_l = VF_LOADU(p + idx - 1),
+            p_r = VF_LOADU(p + idx + 1),
+            p_u = VF_LOADU(p + idx - N),
+            p_d = VF_LOADU(p + idx + N),
+            p_c4 = VF_MUL(v_four, VF_LOADU(p + idx)),
+            d_c = VF_LOADU(div + idx);
+        VF_STOREU(vx + idx, VF_SUB(VF_LOADU(vx + idx), VF_MUL(v_coef, VF_SUB(p_r, p_l))));
+        VF_STOREU(vy + idx, VF_SUB(VF_LOADU(vy + idx), VF_MUL(v_coef, VF_SUB(p_d, p_u))));
+        v_resmax = VF_MAX(v_resmax, _sim_kern_simd_abs(VF_SUB(VF_ADD(d_c, VF_ADD(VF_ADD(p_l, p_r), VF_ADD(p_u, p_d))), p_c4)));
+        if (fl_div) {
+            const vf_t wide = VF_ADD(
+                VF_ADD(VF_LOADU(p + idx - 2), VF_LOADU(p + idx + 2)),
+                VF_ADD(VF_LOADU(p + idx - 2*N), VF_LOADU(p + idx + 2*N))
+            );
+            v_divmax = VF_MAX(v_divmax, _sim_kern_simd_abs(VF_ADD(d_c, VF_MUL(v_quarter, VF_SUB(wide, p_c4)))));
+        }
+    }
+    float div_max = _sim_kern_simd_reduce_max(v_divmax, *pdiv_max), res_max = _sim_kern_simd_reduce_max(v_resmax, *pres_max);
+    for (; i < i_end; ++i) {
+        const int32_t idx = j * N + i;
+        vx[idx] -= coef * (p[idx+1] - p[idx-1]);
+        vy[idx] -= coef * (p[idx+N] - p[idx-N]);
+        res_max = max(res_max, fabsf(div[idx] + ((p[idx-1] + p[idx+1]) + (p[idx-N] + p[idx+N])) - 4.0f * p[idx]));
+        if (fl_div) {
+            div_max = max(div_max, fabsf(div[idx] + 0.25f * (((p[idx-2] + p[idx+2]) + (p[idx-2*N] + p[idx+2*N])) - 4.0f * p[idx])));
+        }
+    }
+    *pdiv_max = div_max;
+    *pres_max = res_max;
+}
+
+static void _sim_kern_simd_gradient_stats(
+    float* vx/* inout */,
+    float* vy/* inout */,
+    const float* p,
+    const float* div,
+    const int32_t N,
+    const int32_t j,
+    const int32_t i_begin,
+    const int32_t i_end,
+    const int32_t k_begin,
+    sim_kern_stats_t* stats/* inout */)
+{
+    _sim_kern_simd_gradient_stats_run(vx, vy, p, div, N, j, i_begin, k_begin, FALSE, &stats->div_max, &stats->res_max);
+    _sim_kern_simd_gradient_stats_run(vx, vy, p, div, N, j, k_begin, i_end, TRUE, &stats->div_max, &stats->res_max);
+}
+
+static inline void _sim_kern_simd_sample(
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    vf_t x,
+    vf_t y,
+    vf_t* pu/* out */,
+    vf_t* pv/* out */)
+{
+    const vf_t v_lo = VF_SET1(0.5f), v_hi = VF_SET1((float)N - 1.5f), v_one = VF_SET1(1.0f);
+    x = VF_MIN(VF_MAX(x, v_lo), v_hi);
+    y = VF_MIN(VF_MAX(y, v_lo), v_hi);
+
+    const vf_t
+        i0 = VF_FLOOR(x),
+        j0 = VF_FLOOR(y);
+
+    const vf_t
+        s1 = VF_SUB(x, i0),
+        s0 = VF_SUB(v_one, s1),
+        t1 = VF_SUB(y, j0),
+        t0 = VF_SUB(v_one, t1);
+
+    const vi_t
+        idx00 = VI_ADD(VI_MUL(VF_TO_VI(j0), VI_SET1(N)), VF_TO_VI(i0)),
+        idx10 = VI_ADD(idx00, VI_SET1(N)),
+        idx01 = VI_ADD(idx00, VI_SET1(1)),
+        idx11 = VI_ADD(idx00, VI_SET1(N + 1));
+
+    *pu = VF_ADD(
+        VF_MUL(s0, VF_ADD(VF_MUL(t0, VF_GATHER(vx, idx00)), VF_MUL(t1, VF_GATHER(vx, idx10)))),
+        VF_MUL(s1, VF_ADD(VF_MUL(t0, VF_GATHER(vx, idx01)), VF_MUL(t1, VF_GATHER(vx, idx11))))
+    );
+    *pv = VF_ADD(
+        VF_MUL(s0, VF_ADD(VF_MUL(t0, VF_GATHER(vy, idx00)), VF_MUL(t1, VF_GATHER(vy, idx10)))),
+        VF_MUL(s1, VF_ADD(VF_MUL(t0, VF_GATHER(vy, idx01)), VF_MUL(t1, VF_GATHER(vy, idx11))))
+    );
+}
+
+static void _sim_kern_simd_trace(
+    float* px/* inout */,
+    float* py/* inout */,
+    const int32_t count,
+    const float* vx,
+    const float* vy,
+    const int32_t N,
+    const float h)
+{
+    const float h_half = 0.5f * h;
+    const vf_t v_h = VF_SET1(h), v_h_half = VF_SET1(h_half);
+    int32_t k = 0;
+    for (; k + SIMD_W <= count; k += SIMD_W) {
+        const vf_t x = VF_LOADU(px + k), y = VF_LOADU(py + k);
+        vf_t u, v;
+        _sim_kern_simd_sample(vx, vy, N, x, y, &u, &v);
+        _sim_kern_simd_sample(vx, vy, N, VF_ADD(x, VF_MUL(v_h_half, u)), VF_ADD(y, VF_MUL(v_h_half, v)), &u, &v);
+        VF_STOREU(px + k, VF_ADD(x, VF_MUL(v_h, u)));
+        VF_STOREU(py + k, VF_ADD(y, VF_MUL(v_h, v)));
+    }
+    for (; k < count; ++k) {
+        float u[2], v[2];
+        for (int32_t m = 0; m < 2; ++m) {
+            const float
+                x = clamp(m ? px[k] + h_half * u[0] : px[k], 0.5f, (float)N - 1.5f),
+                y = clamp(m ? py[k] + h_half * v[0] : py[k], 0.5f, (float)N - 1.5f);
+            const float
+                i0 = floorf(x),
+                j0 = floorf(y);
+            const float
+                s1 = x - i0,
+                s0 = 1.0f - s1,
+                t1 = y - j0,
+                t0 = 1.0f - t1;
+            const int32_t idx = (int32_t)j0 * N + (int32_t)i0;
+            u[m] = s0 * (t0 * vx[idx] + t1 * vx[idx+N]) + s1 * (t0 * vx[idx+1] + t1 * vx[idx+N+1]);
+            v[m] = s0 * (t0 * vy[idx] + t1 * vy[idx+N]) + s1 * (t0 * vy[idx+1] + t1 * vy[idx+N+1]);
+        }
+        px[k] += h * u[1];
+        py[k] += h * v[1];
+    }
+}
+
+static void _sim_kern_simd_filter_rows(
+    float* dst,
+    const float* r0,
+    const float* r1,
+    const float* r2,
+    const float* r3,
+    const float* w,
+    const int32_t count)
+{
+    const vf_t w0 = VF_SET1(w[0]), w1 = VF_SET1(w[1]), w2 = VF_SET1(w[2]), w3 = VF_SET1(w[3]);
+    int32_t k = 0;
+    for (; k + SIMD_W <= count; k += SIMD_W) {
+        VF_STOREU(dst + k, VF_ADD(VF_ADD(VF_ADD(
+            VF_MUL(w0, VF_LOADU(r0 + k)),
+            VF_MUL(w1, VF_LOADU(r1 + k))),
+            VF_MUL(w2, VF_LOADU(r2 + k))),
+            VF_MUL(w3, VF_LOADU(r3 + k))
+        ));
+    }
+    for (; k < count; ++k) {
+        dst[k] = w[0] * r0[k] + w[1] * r1[k] + w[2] * r2[k] + w[3] * r3[k];
+    }
+}
+
+static void _sim_kern_simd_filter_cols(
+    float* dst,
+    const float* src,
+    const int32_t* idx,
+    const float* w,
+    const int32_t count)
+{
+    const vi_t v_one = VI_SET1(1);
+    int32_t k = 0;
+    for (; k + SIMD_W <= count; k += SIMD_W) {
+        const vi_t i0 = VI_LOADU(idx + k), i1 = VI_ADD(i0, v_one), i2 = VI_ADD(i1, v_one), i3 = VI_ADD(i2, v_one);
+        VF_STOREU(dst + k, VF_ADD(VF_ADD(VF_ADD(
+            VF_MUL(VF_LOADU(w + k), VF_GATHER(src, i0)),
+            VF_MUL(VF_LOADU(w + count + k), VF_GATHER(src, i1))),
+            VF_MUL(VF_LOADU(w + 2 * count + k), VF_GATHER(src, i2))),
+            VF_MUL(VF_LOADU(w + 3 * count + k), VF_GATHER(src, i3))
+        ));
+    }
+    for (; k < count; ++k) {
+        const float* const s = src + idx[k];
+        dst[k] = w[k] * s[0] + w[count + k] * s[1] + w[2 * count + k] * s[2] + w[3 * count + k] * s[3];
+    }
+}
+
+static void _sim_kern_simd_fade(
+    float* d/* inout */,
+    const int32_t size,
+    const float step)
+{
+    const vf_t v_step = VF_SET1(step), v_zero = VF_SET1(0.0f);
+    int32_t i = 0;
+    for (; i + SIMD_W <= size; i += SIMD_W) {
+        VF_STOREU(d + i, VF_MAX(VF_SUB(VF_LOADU(d + i), v_step), v_zero));
+    }
+    for (; i < size; ++i) {
+        d[i] = max(d[i] - step, 0.0f);
+    }
+}
+
+static inline vi_t _sim_kern_simd_to_u8(vf_t v)
+{
+    // NOTE: `roundf()` (half away from zero) on [0, 255], the fraction of a float is exact.
+    v = VF_MIN(VF_MAX(VF_MUL(v, VF_SET1(255.0f)), VF_SET1(0.0f)), VF_SET1(255.0f));
+    const vf_t fl = VF_FLOOR(v);
+    return VF_TO_VI(VF_BLEND(VF_GE(VF_SUB(v, fl), VF_SET1(0.5f)), fl, VF_ADD(fl, VF_SET1(1.0f))));
+}
+
+static void _sim_kern_simd_shade(
+    pixel_t* out,
+    const float* d,
+    const int32_t count,
+    const bool_t grayscale)
+{
+    float const h_offset = 235.0f;
+    const float S = grayscale ? 0.0f : 0.7f, L_max = grayscale ? 200.0f : 255.0f;
+    const vf_t
+        v_S = VF_SET1(S),
+        v_L_max = VF_SET1(L_max),
+        v_one = VF_SET1(1.0f),
+        v_zero = VF_SET1(0.0f),
+        v_360 = VF_SET1(360.0f),
+        v_361 = VF_SET1(361.0f);
+
+    int32_t i = 0;
+    for (; i + SIMD_W <= count; i += SIMD_W) {
+        const vf_t v_d = VF_LOADU(d + i);
+
+        // H = (int)(h_offset + d) % 361, exact while the hue fits in the 24-bit mantissa.
+        const vf_t h = VI_TO_VF(VF_TO_VI(VF_ADD(VF_SET1(h_offset), v_d)));
+        const vf_t h_mod = VF_SUB(h, VF_MUL(v_361, VF_FLOOR(VF_DIV(h, v_361))));
+        const vm_t m_neg = VF_LT(h, v_zero); // C remainder keeps the sign, `sim_kern_hsl2rgb()` maps it to black
+
+        const vf_t H = VF_BLEND(VF_GE(h_mod, v_360), VF_DIV(h_mod, VF_SET1(60.0f)), v_zero);
+        const vf_t fract = VF_SUB(H, VF_FLOOR(H));
+        const vf_t L = VF_MUL(VF_MIN(v_d, v_L_max), VF_SET1(1.0f / 255.0f));
+
+        const vf_t
+            P = VF_MUL(L, VF_SUB(v_one, v_S)),
+            Q = VF_MUL(L, VF_SUB(v_one, VF_MUL(v_S, fract))),
+            T = VF_MUL(L, VF_SUB(v_one, VF_MUL(v_S, VF_SUB(v_one, fract))));
+
+        const vm_t
+            m1 = VF_GE(H, VF_SET1(1.0f)),
+            m2 = VF_GE(H, VF_SET1(2.0f)),
+            m3 = VF_GE(H, VF_SET1(3.0f)),
+            m4 = VF_GE(H, VF_SET1(4.0f)),
+            m5 = VF_GE(H, VF_SET1(5.0f));
+
+        vf_t R = L, G = T, B = P;
+        R = VF_BLEND(m1, R, Q); R = VF_BLEND(m2, R, P); R = VF_BLEND(m4, R, T); R = VF_BLEND(m5, R, L);
+        G = VF_BLEND(m1, G, L); G = VF_BLEND(m3, G, Q); G = VF_BLEND(m4, G, P);
+        B = VF_BLEND(m2, B, T); B = VF_BLEND(m3, B, L); B = VF_BLEND(m5, B, Q);
+        R = VF_BLEND(m_neg, R, v_zero);
+        G = VF_BLEND(m_neg, G, v_zero);
+        B = VF_BLEND(m_neg, B, v_zero);
+
+        const vi_t px = VI_OR(
+            VI_OR(VI_SET1((int32_t)0xff000000u), VI_SLLI(_sim_kern_simd_to_u8(R), 16)),
+            VI_OR(VI_SLLI(_sim_kern_simd_to_u8(G), 8), _sim_kern_simd_to_u8(B))
+        );
+        VI_STOREU(out + i, px);
+    }
+    for (; i < count; ++i) {
+        out[i] = sim_kern_hsl2rgb(
+            (float)((int32_t)(h_offset + d[i]) % 361),
+            S,
+            min(d[i], L_max) * (1.0f / 255.0f)
+        );
+    }
+}
+
+const sim_kern_table_t SIM_KERN_TABLE = {
+    .isa = SIM_KERN_ISA,
+    .gs_row = _sim_kern_simd_gs_row,
+    .advect = _sim_kern_simd_advect,
+    .advect_channels = _sim_kern_simd_advect_channels,
+    .divergence = _sim_kern_simd_divergence,
+    .gradient = _sim_kern_simd_gradient,
+    .gradient_stats = _sim_kern_simd_gradient_stats,
+    .trace = _sim_kern_simd_trace,
+    .filter_rows = _sim_kern_simd_filter_rows,
+    .filter_cols = _sim_kern_simd_filter_cols,
+    .fade = _sim_kern_simd_fade,
+    .shade = _sim_kern_simd_shade,
+};
@@ -0,0 +1,48 @@
+﻿#include "sim_kern.h"
+#include "misc.h"
+#include <nmmintrin.h>
+
+// NOTE: Built with SSE4.2 enabled (see `CMakeLists.txt`), only called when cpuid reports it.
+
+#define SIMD_W 4
+
+typedef __m128 vf_t;
+typedef __m128i vi_t;
+typedef __m128 vm_t;
+
+static inline __m128 _sim_kern_sse42_gather(const float* base, __m128i idx)
+{
+    int32_t i[4];
+    _mm_storeu_si128((__m128i*)i, idx);
+    return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+}
+
+#define VF_LOADU(P)       _mm_loadu_ps(P)
+#define VF_STOREU(P, V)   _mm_storeu_ps((P), (V))
+#define VF_SET1(X)        _mm_set1_ps(X)
+#define VF_LANES()        _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)
+#define VF_ADD(A, B)      _mm_add_ps((A), (B))
+#define VF_SUB(A, B)      _mm_sub_ps((A), (B))
+#define VF_MUL(A, B)      _mm_mul_ps((A), (B))
+#define VF_DIV(A, B)      _mm_div_ps((A), (B))
+#define VF_MIN(A, B)      _mm_min_ps((A), (B))
+#define VF_MAX(A, B)      _mm_max_ps((A), (B))
+#define VF_FLOOR(A)       _mm_floor_ps(A)
+#define VF_GE(A, B)       _mm_cmpge_ps((A), (B))
+#define VF_LT(A, B)       _mm_cmplt_ps((A), (B))
+#define VF_BLEND(M, A, B) _mm_blendv_ps((A), (B), (M))
+#define VF_GATHER(P, I)   _sim_kern_sse42_gather((P), (I))
+#define VF_TO_VI(A)       _mm_cvttps_epi32(A)
+#define VI_TO_VF(A)       _mm_cvtepi32_ps(A)
+#define VI_SET1(X)        _mm_set1_epi32(X)
+#define VI_ADD(A, B)      _mm_add_epi32((A), (B))
+#define VI_MIN(A, B)      _mm_min_epi32((A), (B))
+#define VI_MUL(A, B)      _mm_mullo_epi32((A), (B))
+#define VI_OR(A, B)       _mm_or_si128((A), (B))
+#define VI_SLLI(A, N)     _mm_slli_epi32((A), (N))
+#define VI_LOADU(P)       _mm_loadu_si128((const __m128i*)(P))
+#define VI_STOREU(P, V)   _mm_storeu_si128((__m128i*)(P), (V))
+
+#define SIM_KERN_ISA   SIM_ISA_SSE42
+#define SIM_KERN_TABLE g_sim_kern_table_sse42
+#include "sim_kern_simd.inl"
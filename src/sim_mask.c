@@ -0,0 +1,187 @@
+﻿#include "sim_mask.h"
+#include "misc.h"
+
+struct _sim_mask_obj_t {
+    int32_t N;
+    int32_t solid_count;
+    int32_t* span_offs; // `N + 1`, the spans of row `j` are `[span_offs[j], span_offs[j + 1])`
+    sim_mask_span_t* spans;
+    size_t spans_cap;
+    int32_t* bnd_offs; // `N + 1`, same for the boundary cells
+    sim_mask_bnd_t* bnds;
+    size_t bnds_cap;
+};
+
+static bool_t _sim_mask_reserve(void** pbuff, size_t* pcap, size_t count, size_t elem_sz)
+{
+    if (*pcap >= count) {
+        return TRUE;
+    }
+    const size_t new_cap = max(count, *pcap * 2);
+    void* const new_buff = realloc(*pbuff, new_cap * elem_sz);
+    if (!new_buff) {
+        return FALSE;
+    }
+    *pbuff = new_buff;
+    *pcap = new_cap;
+    return TRUE;
+}
+
+static inline bool_t _sim_mask_is_fluid(const uint8_t* solid, const int32_t N, const int32_t idx)
+{
+    // NOTE: Only called for the neighbours of interior cells, the box border counts as solid.
+    const int32_t i = idx % N, j = idx / N;
+    return 0 < i && i < N-1 && 0 < j && j < N-1 && !solid[idx];
+}
+
+sim_mask_obj_t sim_mask_create(int32_t box_size) {
+    if (box_size < 3) {
+        return NULL;
+    }
+
+    sim_mask_obj_t newobj = (sim_mask_obj_t)calloc(1, sizeof(struct _sim_mask_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    const int32_t N = box_size;
+    newobj->N = N;
+    newobj->span_offs = (int32_t*)calloc((size_t)N + 1, sizeof(int32_t));
+    newobj->bnd_offs = (int32_t*)calloc((size_t)N + 1, sizeof(int32_t));
+    if (
+        !newobj->span_offs ||
+        !newobj->bnd_offs ||
+        !_sim_mask_reserve((void**)&newobj->spans, &newobj->spans_cap, (size_t)N, sizeof(sim_mask_span_t)) ||
+        !_sim_mask_reserve((void**)&newobj->bnds, &newobj->bnds_cap, (size_t)N, sizeof(sim_mask_bnd_t))
+        )
+    {
+        sim_mask_destroy(&newobj);
+        return NULL;
+    }
+
+    // Open box, one span over the interior of every interior row.
+    for (int32_t j = 1; j < N-1; ++j) {
+        newobj->spans[j - 1] = (sim_mask_span_t) { .i_begin = 1, .i_end = N-1 };
+        newobj->span_offs[j + 1] = j;
+    }
+    newobj->span_offs[N] = N-2;
+
+    return newobj;
+}
+
+void sim_mask_destroy(sim_mask_obj_t* pself) {
+    if (pself && *pself) {
+        SAFE_FREE((*pself)->span_offs);
+        SAFE_FREE((*pself)->spans);
+        SAFE_FREE((*pself)->bnd_offs);
+        SAFE_FREE((*pself)->bnds);
+        SAFE_FREE(*pself);
+    }
+}
+
+bool_t sim_mask_compile(sim_mask_obj_t self, const uint8_t* solid) {
+    assert(self);
+    assert(solid);
+
+    const int32_t N = self->N;
+
+    // Count first, so a failed allocation leaves the previous lists intact.
+    size_t span_count = 0, bnd_count = 0;
+    for (int32_t j = 1; j < N-1; ++j) {
+        const uint8_t* const row = solid + j * N;
+        for (int32_t i = 1; i < N-1; ++i) {
+            if (!row[i]) {
+                span_count += (i == 1 || row[i - 1]);
+            } else {
+                const int32_t idx = j * N + i;
+                bnd_count += (
+                    _sim_mask_is_fluid(solid, N, idx - 1) ||
+                    _sim_mask_is_fluid(solid, N, idx + 1) ||
+                    _sim_mask_is_fluid(solid, N, idx - N) ||
+                    _sim_mask_is_fluid(solid, N, idx + N)
+                );
+            }
+        }
+    }
+
+    if (!_sim_mask_reserve((void**)&self->spans, &self->spans_cap, span_count, sizeof(sim_mask_span_t)) ||
+        !_sim_mask_reserve((void**)&self->bnds, &self->bnds_cap, bnd_count, sizeof(sim_mask_bnd_t)))
+    {
+        return FALSE;
+    }
+
+    const int32_t offs[4] = { -1, 1, -N, N };
+    int32_t span_n = 0, bnd_n = 0, solid_count = 0;
+    self->span_offs[0] = self->span_offs[1] = 0;
+    self->bnd_offs[0] = self->bnd_offs[1] = 0;
+    for (int32_t j = 1; j < N-1; ++j) {
+        const uint8_t* const row = solid + j * N;
+        for (int32_t i = 1; i < N-1; ++i) {
+            if (!row[i]) {
+                if (i == 1 || row[i - 1]) {
+                    self->spans[span_n++] = (sim_mask_span_t) { .i_begin = i, .i_end = i + 1 };
+                } else {
+                    self->spans[span_n - 1].i_end = i + 1;
+                }
+                continue;
+            }
+
+            ++solid_count;
+            const int32_t idx = j * N + i;
+            sim_mask_bnd_t bnd = { .idx = idx };
+            int32_t count = 0;
+            for (int32_t k = 0; k < 4; ++k) {
+                if (_sim_mask_is_fluid(solid, N, idx + offs[k])) {
+                    bnd.off[count++] = offs[k];
+                }
+            }
+            if (!count) {
+                continue;
+            }
+
+            const float w = 1.0f / (float)count;
+            for (int32_t k = 0; k < count; ++k) {
+                const bool_t horz = (bnd.off[k] == -1 || bnd.off[k] == 1);
+                bnd.w[0][k] = w;
+                bnd.w[1][k] = horz ? -w : w;
+                bnd.w[2][k] = horz ? w : -w;
+            }
+            self->bnds[bnd_n++] = bnd;
+        }
+        self->span_offs[j + 1] = span_n;
+        self->bnd_offs[j + 1] = bnd_n;
+    }
+    self->span_offs[N] = span_n;
+    self->bnd_offs[N] = bnd_n;
+    self->solid_count = solid_count;
+
+    return TRUE;
+}
+
+int32_t sim_mask_get_solid_count(sim_mask_obj_t self) {
+    assert(self);
+    return self->solid_count;
+}
+
+const sim_mask_span_t* sim_mask_get_row_spans(sim_mask_obj_t self, int32_t j, int32_t* pcount) {
+    assert(self);
+    assert(0 <= j && j < self->N);
+    assert(pcount);
+    *pcount = self->span_offs[j + 1] - self->span_offs[j];
+    return self->spans + self->span_offs[j];
+}
+
+const sim_mask_bnd_t* sim_mask_get_row_bounds(sim_mask_obj_t self, int32_t j, int32_t* pcount) {
+    assert(self);
+    assert(0 <= j && j < self->N);
+    assert(pcount);
+    *pcount = self->bnd_offs[j + 1] - self->bnd_offs[j];
+    return self->bnds + self->bnd_offs[j];
+}
+
+const sim_mask_bnd_t* sim_mask_get_bounds(sim_mask_obj_t self, int32_t* pcount) {
+    assert(self);
+    assert(pcount);
+    *pcount = self->bnd_offs[self->N];
+    return self->bnds;
+}
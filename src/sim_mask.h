@@ -0,0 +1,32 @@
+﻿#pragma once
+#include "common.h"
+
+// Compiled obstacle mask of `sim`.
+// Solid cells are turned into two packed lists, so the kernels never test the mask per cell:
+// the fluid runs of every row, which the row kernels sweep instead of the whole interior, and the
+// solid cells next to fluid, each with the offsets of its fluid neighbours and one weight per
+// neighbour and `b`. Applying the boundary condition is then a linear loop over just those cells.
+//
+// A boundary cell takes the average of its fluid neighbours, negated across the faces normal to the
+// velocity component (`b` 1: left/right neighbours, `b` 2: up/down neighbours), like the box edges
+// of `sim_kern_set_bounds()`. Solid cells without fluid neighbours are never read by the kernels.
+
+DECL_OBJECT(sim_mask_obj_t);
+
+typedef struct {
+    int32_t i_begin, i_end; // fluid cells `[i_begin, i_end)` of one row
+} sim_mask_span_t;
+
+typedef struct {
+    int32_t idx; // solid cell with at least one fluid neighbour
+    int32_t off[4]; // offsets of its fluid neighbours, unused slots are 0 (weight 0)
+    float w[3][4]; // weight of each neighbour per `b`
+} sim_mask_bnd_t;
+
+sim_mask_obj_t sim_mask_create(int32_t box_size);
+void sim_mask_destroy(sim_mask_obj_t*);
+bool_t sim_mask_compile(sim_mask_obj_t, const uint8_t* solid); // NOTE: Row-major `N * N` bytes, nonzero is solid, the box border is ignored. FALSE if out of memory, the previous lists are kept.
+int32_t sim_mask_get_solid_count(sim_mask_obj_t); // NOTE: Solid interior cells, 0 for an open box.
+const sim_mask_span_t* sim_mask_get_row_spans(sim_mask_obj_t, int32_t j, int32_t* pcount);
+const sim_mask_bnd_t* sim_mask_get_row_bounds(sim_mask_obj_t, int32_t j, int32_t* pcount); // NOTE: Boundary cells of row `j`.
+const sim_mask_bnd_t* sim_mask_get_bounds(sim_mask_obj_t, int32_t* pcount); // NOTE: All boundary cells, ordered by row.
@@ -0,0 +1,218 @@
+﻿#include "sim_spec.h"
+#include "dct.h"
+#include "misc.h"
+#include <math.h>
+
+struct _sim_spec_obj_t {
+    int32_t N;
+    dct_obj_t dct; // length `N - 2`, the interior
+    float* lambda_even; // eigenvalues of 2x[i] - x[i-1] - x[i+1] with mirrored edges
+    float* lambda_odd; // same with negated edges
+    float* lambda_wide; // eigenvalues of -(central difference)^2, the operator `sim_kern_project()` approximates
+    float* lines; // `DCT_LANES` interleaved lines of the interior
+};
+
+static void _sim_spec_transform_rows(
+    sim_spec_obj_t self,
+    float* x/* inout */,
+    const bool_t odd,
+    const bool_t inverse)
+{
+    const int32_t N = self->N, n = N - 2;
+    float* const lines = self->lines;
+    for (int32_t j0 = 1; j0 < N-1; j0 += DCT_LANES) {
+        const int32_t w = min(DCT_LANES, N-1 - j0);
+        for (int32_t r = 0; r < w; ++r) {
+            const float* const src = x + (j0 + r) * N + 1;
+            for (int32_t i = 0; i < n; ++i) {
+                lines[i * DCT_LANES + r] = src[i];
+            }
+        }
+
+        if (inverse) {
+            dct_inverse(self->dct, lines, odd);
+        } else {
+            dct_forward(self->dct, lines, odd);
+        }
+
+        for (int32_t r = 0; r < w; ++r) {
+            float* const dst = x + (j0 + r) * N + 1;
+            for (int32_t i = 0; i < n; ++i) {
+                dst[i] = lines[i * DCT_LANES + r];
+            }
+        }
+    }
+}
+
+// Solves (c0 + a * (Lx + Ly)) x = x0 on the interior in place, where Lx, Ly are separable operators
+// with eigenvalues `lx`, `ly` in the basis picked by `odd_x`, `odd_y`.
+// A zero eigenvalue (the constant mode of a pure Poisson problem) is solved as zero.
+static void _sim_spec_solve(
+    sim_spec_obj_t self,
+    float* x/* inout */,
+    const bool_t odd_x,
+    const bool_t odd_y,
+    const float* lx,
+    const float* ly,
+    const float c0,
+    const float a)
+{
+    const int32_t N = self->N, n = N - 2;
+    float* const lines = self->lines;
+
+    _sim_spec_transform_rows(self, x, odd_x, FALSE);
+
+    // NOTE: A batch of columns is transformed, divided by the eigenvalues and transformed back
+    //       in one go, so the vertical transforms cost a single pass over the grid.
+    for (int32_t i0 = 1; i0 < N-1; i0 += DCT_LANES) {
+        const int32_t w = min(DCT_LANES, N-1 - i0);
+        for (int32_t j = 0; j < n; ++j) {
+            memcpy(lines + j * DCT_LANES, x + (j + 1) * N + i0, (size_t)w * sizeof(float));
+        }
+
+        dct_forward(self->dct, lines, odd_y);
+        for (int32_t j = 0; j < n; ++j) {
+            float* const line = lines + j * DCT_LANES;
+            for (int32_t c = 0; c < w; ++c) {
+                const float denom = c0 + a * (lx[i0 - 1 + c] + ly[j]);
+                line[c] = (denom != 0.0f) ? line[c] / denom : 0.0f;
+            }
+        }
+        dct_inverse(self->dct, lines, odd_y);
+
+        for (int32_t j = 0; j < n; ++j) {
+            memcpy(x + (j + 1) * N + i0, lines + j * DCT_LANES, (size_t)w * sizeof(float));
+        }
+    }
+
+    _sim_spec_transform_rows(self, x, odd_x, TRUE);
+}
+
+sim_spec_obj_t sim_spec_create(int32_t box_size) {
+    if (box_size < 3) {
+        return NULL;
+    }
+
+    sim_spec_obj_t newobj = (sim_spec_obj_t)calloc(1, sizeof(struct _sim_spec_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    const int32_t n = box_size - 2;
+    newobj->N = box_size;
+    newobj->dct = dct_create(n);
+    newobj->lambda_even = (float*)malloc((size_t)n * sizeof(float));
+    newobj->lambda_odd = (float*)malloc((size_t)n * sizeof(float));
+    newobj->lambda_wide = (float*)malloc((size_t)n * sizeof(float));
+    newobj->lines = (float*)calloc((size_t)n * DCT_LANES, sizeof(float));
+    if (
+        !newobj->dct ||
+        !newobj->lambda_even ||
+        !newobj->lambda_odd ||
+        !newobj->lambda_wide ||
+        !newobj->lines
+        )
+    {
+        sim_spec_destroy(&newobj);
+        return NULL;
+    }
+
+    // NOTE: The odd basis is the DST-II with a reversed spectrum (see dct.h), so its eigenvalue at
+    //       index k is that of frequency n - k: 2 - 2cos(pi * (n - k) / n) = 2 + 2cos(pi * k / n).
+    for (int32_t k = 0; k < n; ++k) {
+        const double theta = 3.14159265358979323846 * k / n;
+        newobj->lambda_even[k] = (float)(2.0 - 2.0 * cos(theta));
+        newobj->lambda_odd[k] = (float)(2.0 + 2.0 * cos(theta));
+        newobj->lambda_wide[k] = (float)(sin(theta) * sin(theta));
+    }
+
+    return newobj;
+}
+
+void sim_spec_destroy(sim_spec_obj_t* pself) {
+    if (pself && *pself) {
+        dct_destroy(&(*pself)->dct);
+        SAFE_FREE((*pself)->lambda_even);
+        SAFE_FREE((*pself)->lambda_odd);
+        SAFE_FREE((*pself)->lambda_wide);
+        SAFE_FREE((*pself)->lines);
+        SAFE_FREE(*pself);
+    }
+}
+
+void sim_spec_diffuse(
+    sim_spec_obj_t self,
+    const int32_t b,
+    const mat2f_obj_t m_x/* inout */,
+    const mat2f_obj_t m_x0,
+    const float diff,
+    const float dt)
+{
+    assert(self);
+    assert(mat2f_get_rows(m_x) == self->N
+        && mat2f_get_cols(m_x) == self->N
+        && mat2f_is_shape_eq(m_x, m_x0)
+    );
+
+    const int32_t N = self->N;
+    const float a = dt * diff * (N-2) * (N-2);
+
+    mat2f_copy(m_x, m_x0);
+    if (a != 0.0f) {
+        const bool_t odd_x = b == 1, odd_y = b == 2;
+        _sim_spec_solve(
+            self,
+            mat2f_at_index(m_x, 0),
+            odd_x, odd_y,
+            odd_x ? self->lambda_odd : self->lambda_even,
+            odd_y ? self->lambda_odd : self->lambda_even,
+            1.0f,
+            a
+        );
+    }
+    sim_kern_set_bounds(NULL, b, m_x);
+}
+
+void sim_spec_project(
+    sim_spec_obj_t self,
+    const sim_kern_table_t* kt,
+    const pool_obj_t pool,
+    const mat2f_obj_t m_vx/* inout */,
+    const mat2f_obj_t m_vy/* inout */,
+    const mat2f_obj_t m_p/* inout */,
+    const mat2f_obj_t m_div/* inout */,
+    sim_kern_stats_t* stats/* out */)
+{
+    assert(self);
+    assert(kt);
+    assert(mat2f_get_rows(m_vx) == self->N
+        && mat2f_get_cols(m_vx) == self->N
+        && mat2f_is_shape_eq(m_vx, m_vy)
+        && mat2f_is_shape_eq(m_vx, m_p)
+        && mat2f_is_shape_eq(m_vx, m_div)
+    );
+
+    sim_kern_divergence(kt, pool, NULL, m_div, m_p, m_vx, m_vy);
+
+    // NOTE: `sim_kern_project()` iterates on the compact 5-point Laplacian, which only approximates
+    //       the central difference divergence of the central difference gradient the kernels apply.
+    //       Here the latter is inverted directly (both diagonalize in the same bases, the velocity
+    //       edges being odd and the pressure edges even), so the projected field has zero
+    //       divergence up to rounding. It is an orthogonal projection, no mode is amplified.
+    mat2f_copy(m_p, m_div);
+    _sim_spec_solve(
+        self,
+        mat2f_at_index(m_p, 0),
+        FALSE, FALSE,
+        self->lambda_wide,
+        self->lambda_wide,
+        0.0f,
+        1.0f
+    );
+    sim_kern_set_bounds(NULL, 0, m_p);
+
+    sim_kern_gradient(kt, pool, NULL, m_vx, m_vy, m_p, m_div, stats);
+    if (stats) {
+        stats->res_max = stats->div_max; // NOTE: The wide Laplacian of `m_p` against `m_div` is the divergence left.
+    }
+}
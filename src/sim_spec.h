@@ -0,0 +1,18 @@
+﻿#pragma once
+#include "common.h"
+#include "mat.h"
+#include "sim_kern.h"
+
+// Spectral solver for the linear systems of `sim_kern_diffuse()` and `sim_kern_project()`.
+// The difference operators of the solver, with the mirrored edges of `sim_kern_set_bounds()`, are
+// diagonal in a separable DCT-II basis (DST-II along an axis where the edge is negated), so each
+// system is solved exactly with one forward and one inverse 2-D transform of the interior, in
+// O(N^2 log N). The projection leaves no divergence behind, see `sim_spec_project()`.
+// Only valid for an open box, the transforms know nothing about internal obstacles.
+
+DECL_OBJECT(sim_spec_obj_t);
+
+sim_spec_obj_t sim_spec_create(int32_t box_size);
+void sim_spec_destroy(sim_spec_obj_t*);
+void sim_spec_diffuse(sim_spec_obj_t, int32_t b, mat2f_obj_t m_x/* inout */, mat2f_obj_t m_x0, float diff, float dt);
+void sim_spec_project(sim_spec_obj_t, const sim_kern_table_t* kt, pool_obj_t pool, mat2f_obj_t m_vx/* inout */, mat2f_obj_t m_vy/* inout */, mat2f_obj_t m_p/* inout */, mat2f_obj_t m_div/* inout */, sim_kern_stats_t* stats/* out */); // NOTE: `stats` as by `sim_kern_project()`, the residual is that of the system solved here, may be NULL.
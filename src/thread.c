@@ -0,0 +1,188 @@
+﻿#include "thread.h"
+
+#if defined(_WIN32)
+#  include <Windows.h>
+#  include <process.h>
+#else
+#  include <pthread.h>
+#  include <unistd.h>
+#  include <time.h>
+#endif
+
+struct _thread_obj_t {
+    thread_fn_t fn;
+    void* ctx;
+#if defined(_WIN32)
+    HANDLE handle;
+#else
+    pthread_t handle;
+    bool_t fl_started;
+#endif
+};
+
+struct _thread_sem_obj_t {
+#if defined(_WIN32)
+    HANDLE handle;
+#else
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+    int32_t count;
+    bool_t fl_initialized;
+#endif
+};
+
+#if defined(_WIN32)
+static unsigned __stdcall _thread_entry(void* arg)
+{
+    const thread_obj_t self = (thread_obj_t)arg;
+    self->fn(self->ctx);
+    return 0;
+}
+#else
+static void* _thread_entry(void* arg)
+{
+    const thread_obj_t self = (thread_obj_t)arg;
+    self->fn(self->ctx);
+    return NULL;
+}
+#endif
+
+thread_obj_t thread_create(thread_fn_t fn, void* ctx) {
+    assert(fn);
+
+    thread_obj_t newobj = (thread_obj_t)calloc(1, sizeof(struct _thread_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->fn = fn;
+    newobj->ctx = ctx;
+
+#if defined(_WIN32)
+    newobj->handle = (HANDLE)_beginthreadex(NULL, 0, _thread_entry, newobj, 0, NULL);
+    if (!newobj->handle) {
+        thread_destroy(&newobj);
+        return NULL;
+    }
+#else
+    if (pthread_create(&newobj->handle, NULL, _thread_entry, newobj) != 0) {
+        thread_destroy(&newobj);
+        return NULL;
+    }
+    newobj->fl_started = TRUE;
+#endif
+
+    return newobj;
+}
+
+void thread_destroy(thread_obj_t* pself) {
+    if (pself && *pself) {
+#if defined(_WIN32)
+        if ((*pself)->handle) {
+            WaitForSingleObject((*pself)->handle, INFINITE);
+            CloseHandle((*pself)->handle);
+        }
+#else
+        if ((*pself)->fl_started) {
+            pthread_join((*pself)->handle, NULL);
+        }
+#endif
+        SAFE_FREE(*pself);
+    }
+}
+
+thread_sem_obj_t thread_sem_create(int32_t initial_count) {
+    thread_sem_obj_t newobj = (thread_sem_obj_t)calloc(1, sizeof(struct _thread_sem_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    newobj->handle = CreateSemaphoreA(NULL, initial_count, LONG_MAX, NULL);
+    if (!newobj->handle) {
+        thread_sem_destroy(&newobj);
+        return NULL;
+    }
+#else
+    if (pthread_mutex_init(&newobj->mtx, NULL) != 0) {
+        thread_sem_destroy(&newobj);
+        return NULL;
+    }
+    if (pthread_cond_init(&newobj->cv, NULL) != 0) {
+        pthread_mutex_destroy(&newobj->mtx);
+        thread_sem_destroy(&newobj);
+        return NULL;
+    }
+    newobj->count = initial_count;
+    newobj->fl_initialized = TRUE;
+#endif
+
+    return newobj;
+}
+
+void thread_sem_destroy(thread_sem_obj_t* pself) {
+    if (pself && *pself) {
+#if defined(_WIN32)
+        if ((*pself)->handle) {
+            CloseHandle((*pself)->handle);
+        }
+#else
+        if ((*pself)->fl_initialized) {
+            pthread_cond_destroy(&(*pself)->cv);
+            pthread_mutex_destroy(&(*pself)->mtx);
+        }
+#endif
+        SAFE_FREE(*pself);
+    }
+}
+
+void thread_sem_post(thread_sem_obj_t self, int32_t count) {
+    assert(self);
+    assert(count > 0);
+#if defined(_WIN32)
+    ReleaseSemaphore(self->handle, count, NULL);
+#else
+    pthread_mutex_lock(&self->mtx);
+    self->count += count;
+    if (count == 1) {
+        pthread_cond_signal(&self->cv);
+    } else {
+        pthread_cond_broadcast(&self->cv);
+    }
+    pthread_mutex_unlock(&self->mtx);
+#endif
+}
+
+void thread_sem_wait(thread_sem_obj_t self) {
+    assert(self);
+#if defined(_WIN32)
+    WaitForSingleObject(self->handle, INFINITE);
+#else
+    pthread_mutex_lock(&self->mtx);
+    while (self->count <= 0) {
+        pthread_cond_wait(&self->cv, &self->mtx);
+    }
+    --self->count;
+    pthread_mutex_unlock(&self->mtx);
+#endif
+}
+
+int32_t thread_get_cpu_count() {
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int32_t)si.dwNumberOfProcessors;
+#else
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int32_t)n : 1;
+#endif
+}
+
+void thread_sleep_ms(uint32_t ms) {
+#if defined(_WIN32)
+    Sleep(ms);
+#else
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+﻿#pragma once
+#include "common.h"
+
+DECL_OBJECT(thread_obj_t);
+DECL_OBJECT(thread_sem_obj_t);
+
+typedef void(*thread_fn_t)(void* ctx);
+
+thread_obj_t thread_create(thread_fn_t fn, void* ctx);
+void thread_destroy(thread_obj_t*); // NOTE: Blocks until the thread function returns.
+thread_sem_obj_t thread_sem_create(int32_t initial_count);
+void thread_sem_destroy(thread_sem_obj_t*);
+void thread_sem_post(thread_sem_obj_t, int32_t count);
+void thread_sem_wait(thread_sem_obj_t);
+int32_t thread_get_cpu_count();
+void thread_sleep_ms(uint32_t ms);
\ No newline at end of file
@@ -0,0 +1,374 @@
+﻿#include "tracer.h"
+#include "sim_kern.h"
+#include "pool.h"
+#include "misc.h"
+#include <math.h>
+
+#define TRACER_CHUNK 16384 // particles per chunk, the unit of work and of compaction
+#define TRACER_RENDER_BAND_ROWS 8 // framebuffer rows per task of the resolve pass
+#define TRACER_LIFE_UNLIMITED INT32_MAX
+
+typedef struct {
+    float x, y, radius;
+    float rate; // particles per step
+    float carry; // fraction of a particle left over from the previous steps
+} tracer_emitter_t;
+
+struct _tracer_obj_t {
+    int32_t N;
+    int32_t capacity;
+    int32_t chunk_count;
+    int32_t count;
+    float* x; // chunk `c` holds its `counts[c]` live particles at `[c * TRACER_CHUNK, ...)`
+    float* y;
+    int32_t* life; // remaining steps
+    int32_t* counts;
+    int32_t lifetime; // for new particles, `TRACER_LIFE_UNLIMITED` if 0 was set
+    int32_t spawn_chunk; // chunks before it are full
+    uint32_t rng;
+
+    tracer_emitter_t* emitters;
+    int32_t emitter_count;
+    size_t emitters_cap;
+
+    int32_t plane_count; // counter planes in `hits`
+
+    // Current update
+    const sim_kern_table_t* kt;
+    const float* vx;
+    const float* vy;
+    const uint8_t* solid; // NULL without obstacles
+    float h;
+
+    // Current render
+    uint32_t* hits; // one `fb_rows * fb_cols` counter plane per worker, zero between renders
+    size_t hits_cap;
+    pixel_t* fb;
+    int32_t fb_cols, fb_rows;
+    pixel_t clr;
+    float intensity;
+};
+
+static inline float _tracer_rand(tracer_obj_t self)
+{
+    // xorshift32, [0, 1)
+    uint32_t x = self->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    self->rng = x;
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline int32_t _tracer_get_chunk_capacity(tracer_obj_t self, int32_t chunk_idx)
+{
+    return min(TRACER_CHUNK, self->capacity - chunk_idx * TRACER_CHUNK);
+}
+
+static void _tracer_update_chunk(void* ctx, int32_t worker_idx, int32_t chunk_idx)
+{
+    UNUSED_PARAM(worker_idx);
+
+    const tracer_obj_t self = (tracer_obj_t)ctx;
+    const int32_t n = self->counts[chunk_idx], N = self->N;
+    if (!n) {
+        return;
+    }
+
+    float* const x = self->x + (size_t)chunk_idx * TRACER_CHUNK;
+    float* const y = self->y + (size_t)chunk_idx * TRACER_CHUNK;
+    int32_t* const life = self->life + (size_t)chunk_idx * TRACER_CHUNK;
+    self->kt->trace(x, y, n, self->vx, self->vy, N, self->h);
+
+    // Compact in place, survivors keep their order.
+    const float lo = 0.5f, hi = (float)N - 1.5f;
+    const uint8_t* const solid = self->solid;
+    int32_t live = 0;
+    for (int32_t k = 0; k < n; ++k) {
+        const float px = x[k], py = y[k];
+        const int32_t l = life[k] - 1;
+        if (!(px >= lo && px < hi && py >= lo && py < hi) || l <= 0) {
+            continue; // NOTE: Also drops NaN positions.
+        }
+        if (solid && solid[(int32_t)(py + 0.5f) * N + (int32_t)(px + 0.5f)]) {
+            continue;
+        }
+        x[live] = px;
+        y[live] = py;
+        life[live] = l;
+        ++live;
+    }
+    self->counts[chunk_idx] = live;
+}
+
+static void _tracer_splat_chunk(void* ctx, int32_t worker_idx, int32_t chunk_idx)
+{
+    const tracer_obj_t self = (tracer_obj_t)ctx;
+    const int32_t n = self->counts[chunk_idx], cols = self->fb_cols, rows = self->fb_rows;
+    const float* const x = self->x + (size_t)chunk_idx * TRACER_CHUNK;
+    const float* const y = self->y + (size_t)chunk_idx * TRACER_CHUNK;
+    uint32_t* const hits = self->hits + (size_t)worker_idx * rows * cols;
+
+    // NOTE: Cell `i` covers [i - 0.5, i + 0.5), the framebuffer covers the whole box.
+    const float sx = (float)cols / (float)self->N, sy = (float)rows / (float)self->N;
+    for (int32_t k = 0; k < n; ++k) {
+        const int32_t
+            col = min((int32_t)((x[k] + 0.5f) * sx), cols - 1),
+            row = min((int32_t)((y[k] + 0.5f) * sy), rows - 1);
+        ++hits[row * cols + col];
+    }
+}
+
+static int32_t _tracer_get_worker_count(pool_obj_t pool)
+{
+    return pool ? pool_get_worker_count(pool) : 1;
+}
+
+static void _tracer_run(pool_obj_t pool, pool_task_fn_t fn, void* ctx, int32_t task_count)
+{
+    if (pool) {
+        pool_run(pool, fn, ctx, task_count);
+        return;
+    }
+    for (int32_t i = 0; i < task_count; ++i) {
+        fn(ctx, 0, i);
+    }
+}
+
+static void _tracer_resolve_band(void* ctx, int32_t worker_idx, int32_t band_idx)
+{
+    UNUSED_PARAM(worker_idx);
+
+    const tracer_obj_t self = (tracer_obj_t)ctx;
+    const int32_t
+        cols = self->fb_cols,
+        size = self->fb_rows * cols,
+        worker_count = self->plane_count,
+        begin = band_idx * TRACER_RENDER_BAND_ROWS * cols,
+        end = min(begin + TRACER_RENDER_BAND_ROWS * cols, size);
+    const pixel_t clr = self->clr;
+
+    for (int32_t p = begin; p < end; ++p) {
+        uint32_t h = 0;
+        for (int32_t w = 0; w < worker_count; ++w) {
+            uint32_t* const hits = self->hits + (size_t)w * size + p;
+            h += *hits;
+            *hits = 0;
+        }
+        if (!h) {
+            continue;
+        }
+
+        const float a = min((float)h * self->intensity, 1.0f);
+        pixel_t* const px = &self->fb[p];
+        px->r = (uint8_t)((float)px->r + (float)(clr.r - px->r) * a + 0.5f);
+        px->g = (uint8_t)((float)px->g + (float)(clr.g - px->g) * a + 0.5f);
+        px->b = (uint8_t)((float)px->b + (float)(clr.b - px->b) * a + 0.5f);
+    }
+}
+
+tracer_obj_t tracer_create(int32_t box_size, int32_t capacity) {
+    if (box_size < 3 || capacity <= 0) {
+        return NULL;
+    }
+
+    tracer_obj_t newobj = (tracer_obj_t)calloc(1, sizeof(struct _tracer_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->N = box_size;
+    newobj->capacity = capacity;
+    newobj->chunk_count = (capacity + TRACER_CHUNK - 1) / TRACER_CHUNK;
+    newobj->lifetime = TRACER_LIFE_UNLIMITED;
+    newobj->rng = 0x2545f491u;
+    newobj->x = (float*)malloc((size_t)capacity * sizeof(float));
+    newobj->y = (float*)malloc((size_t)capacity * sizeof(float));
+    newobj->life = (int32_t*)malloc((size_t)capacity * sizeof(int32_t));
+    newobj->counts = (int32_t*)calloc((size_t)newobj->chunk_count, sizeof(int32_t));
+    if (
+        !newobj->x ||
+        !newobj->y ||
+        !newobj->life ||
+        !newobj->counts
+        )
+    {
+        tracer_destroy(&newobj);
+        return NULL;
+    }
+
+    return newobj;
+}
+
+void tracer_destroy(tracer_obj_t* pself) {
+    if (pself && *pself) {
+        SAFE_FREE((*pself)->x);
+        SAFE_FREE((*pself)->y);
+        SAFE_FREE((*pself)->life);
+        SAFE_FREE((*pself)->counts);
+        SAFE_FREE((*pself)->emitters);
+        SAFE_FREE((*pself)->hits);
+        SAFE_FREE(*pself);
+    }
+}
+
+int32_t tracer_get_count(tracer_obj_t self) {
+    assert(self);
+    return self->count;
+}
+
+int32_t tracer_get_capacity(tracer_obj_t self) {
+    assert(self);
+    return self->capacity;
+}
+
+void tracer_set_lifetime(tracer_obj_t self, int32_t steps) {
+    assert(self);
+    self->lifetime = (steps > 0) ? steps : TRACER_LIFE_UNLIMITED;
+}
+
+int32_t tracer_emit(tracer_obj_t self, float x, float y, float radius, int32_t count) {
+    assert(self);
+
+    int32_t spawned = 0;
+    while (spawned < count && self->spawn_chunk < self->chunk_count) {
+        const int32_t c = self->spawn_chunk;
+        const int32_t n = min(_tracer_get_chunk_capacity(self, c) - self->counts[c], count - spawned);
+        if (n <= 0) {
+            ++self->spawn_chunk;
+            continue;
+        }
+
+        const size_t base = (size_t)c * TRACER_CHUNK + self->counts[c];
+        for (int32_t k = 0; k < n; ++k) {
+            const float
+                r = radius * sqrtf(_tracer_rand(self)),
+                theta = 6.28318530718f * _tracer_rand(self);
+            self->x[base + k] = x + r * cosf(theta);
+            self->y[base + k] = y + r * sinf(theta);
+            self->life[base + k] = self->lifetime;
+        }
+        self->counts[c] += n;
+        spawned += n;
+    }
+
+    self->count += spawned;
+    return spawned;
+}
+
+bool_t tracer_add_emitter(tracer_obj_t self, float x, float y, float radius, float rate) {
+    assert(self);
+    if ((size_t)self->emitter_count == self->emitters_cap) {
+        const size_t new_cap = self->emitters_cap ? self->emitters_cap * 2 : 8;
+        tracer_emitter_t* const new_emitters = (tracer_emitter_t*)realloc(self->emitters, new_cap * sizeof(tracer_emitter_t));
+        if (!new_emitters) {
+            return FALSE;
+        }
+        self->emitters = new_emitters;
+        self->emitters_cap = new_cap;
+    }
+
+    self->emitters[self->emitter_count++] = (tracer_emitter_t) {
+        .x = x,
+        .y = y,
+        .radius = radius,
+        .rate = max(rate, 0.0f),
+    };
+    return TRUE;
+}
+
+void tracer_clear_emitters(tracer_obj_t self) {
+    assert(self);
+    self->emitter_count = 0;
+}
+
+void tracer_clear(tracer_obj_t self) {
+    assert(self);
+    memset(self->counts, 0, (size_t)self->chunk_count * sizeof(int32_t));
+    self->count = 0;
+    self->spawn_chunk = 0;
+}
+
+void tracer_resize(tracer_obj_t self, int32_t box_size) {
+    assert(self);
+    assert(box_size >= 3);
+
+    // NOTE: Same mapping as `sim_resize()`, the interiors of both boxes are aligned.
+    const float scale = (float)(box_size - 2) / (float)(self->N - 2);
+    for (int32_t c = 0; c < self->chunk_count; ++c) {
+        float* const x = self->x + (size_t)c * TRACER_CHUNK;
+        float* const y = self->y + (size_t)c * TRACER_CHUNK;
+        for (int32_t k = 0; k < self->counts[c]; ++k) {
+            x[k] = 0.5f + (x[k] - 0.5f) * scale;
+            y[k] = 0.5f + (y[k] - 0.5f) * scale;
+        }
+    }
+    for (int32_t i = 0; i < self->emitter_count; ++i) {
+        tracer_emitter_t* const e = &self->emitters[i];
+        e->x = 0.5f + (e->x - 0.5f) * scale;
+        e->y = 0.5f + (e->y - 0.5f) * scale;
+        e->radius *= scale;
+    }
+    self->N = box_size;
+}
+
+void tracer_update(tracer_obj_t self, sim_obj_t sim) {
+    assert(self);
+    assert(sim);
+    assert(sim_get_rows(sim) == self->N && sim_get_cols(sim) == self->N);
+
+    for (int32_t i = 0; i < self->emitter_count; ++i) {
+        tracer_emitter_t* const e = &self->emitters[i];
+        e->carry += e->rate;
+        const int32_t n = (int32_t)e->carry;
+        e->carry -= (float)n;
+        tracer_emit(self, e->x, e->y, e->radius, n);
+    }
+
+    self->kt = sim_kern_get_table(sim_get_isa(sim));
+    self->vx = sim_get_field_data(sim, SIM_FIELD_VX);
+    self->vy = sim_get_field_data(sim, SIM_FIELD_VY);
+    self->solid = sim_has_obstacles(sim) ? sim_get_obstacles(sim) : NULL;
+    self->h = sim_get_time_step(sim) * (float)(self->N - 2); // NOTE: Same scale as the backtrace of `sim_kern_advect()`.
+    _tracer_run(sim_get_pool(sim), _tracer_update_chunk, self, self->chunk_count);
+
+    int32_t count = 0;
+    for (int32_t c = 0; c < self->chunk_count; ++c) {
+        count += self->counts[c];
+    }
+    self->count = count;
+    self->spawn_chunk = 0;
+}
+
+bool_t tracer_render(tracer_obj_t self, pool_obj_t pool, pixel_t* fb, int32_t cols, int32_t rows, pixel_t clr, float intensity) {
+    assert(self);
+    assert(fb && cols > 0 && rows > 0);
+
+    const size_t
+        size = (size_t)rows * cols,
+        plane_count = (size_t)_tracer_get_worker_count(pool);
+    if (self->fb_cols != cols || self->fb_rows != rows || self->plane_count != (int32_t)plane_count) {
+        if (self->hits_cap < plane_count * size) {
+            uint32_t* const new_hits = (uint32_t*)realloc(self->hits, plane_count * size * sizeof(uint32_t));
+            if (!new_hits) {
+                return FALSE;
+            }
+            self->hits = new_hits;
+            self->hits_cap = plane_count * size;
+        }
+        memset(self->hits, 0, plane_count * size * sizeof(uint32_t));
+    }
+
+    self->plane_count = (int32_t)plane_count;
+    self->fb = fb;
+    self->fb_cols = cols;
+    self->fb_rows = rows;
+    self->clr = clr;
+    self->intensity = intensity;
+
+    // NOTE: Every worker counts hits into its own plane, so the splat pass needs no atomics,
+    //       then the planes are summed, cleared and blended into the framebuffer band by band.
+    _tracer_run(pool, _tracer_splat_chunk, self, self->chunk_count);
+    _tracer_run(pool, _tracer_resolve_band, self, (rows + TRACER_RENDER_BAND_ROWS - 1) / TRACER_RENDER_BAND_ROWS);
+    return TRUE;
+}
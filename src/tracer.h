@@ -0,0 +1,28 @@
+﻿#pragma once
+#include "common.h"
+#include "pixel.h"
+#include "sim.h"
+
+// Passive tracer particles, advected through the velocity field of a `sim` to visualize the flow.
+// Positions are kept as structure of arrays in cell coordinates (x: column, y: row), split into
+// fixed-size chunks that are the unit of work of the worker pool. Each chunk is advected with the
+// `trace` kernel of the sim's instruction set (bilinear sampling, midpoint integration) and compacted
+// in place by the worker that advected it, so dead particles never cost a serial pass; spawning
+// refills the chunks with free slots.
+//
+// Particles die when they enter the box border or a solid cell, or when their lifetime runs out.
+
+DECL_OBJECT(tracer_obj_t);
+
+tracer_obj_t tracer_create(int32_t box_size, int32_t capacity);
+void tracer_destroy(tracer_obj_t*);
+int32_t tracer_get_count(tracer_obj_t);
+int32_t tracer_get_capacity(tracer_obj_t);
+void tracer_set_lifetime(tracer_obj_t, int32_t steps); // NOTE: 0 (default) for unlimited, applies to particles spawned afterwards.
+int32_t tracer_emit(tracer_obj_t, float x, float y, float radius, int32_t count); // NOTE: Spawns uniformly in a disc, returns the number spawned (limited by the capacity).
+bool_t tracer_add_emitter(tracer_obj_t, float x, float y, float radius, float rate); // NOTE: Emits `rate` particles per step from `tracer_update()` on. FALSE if out of memory.
+void tracer_clear_emitters(tracer_obj_t);
+void tracer_clear(tracer_obj_t);
+void tracer_resize(tracer_obj_t, int32_t box_size); // NOTE: Moves the particles and emitters onto a box resized by `sim_resize()`.
+void tracer_update(tracer_obj_t, sim_obj_t sim); // NOTE: One step of `sim`, call after `sim_update()`. Runs on the workers of `sim`.
+bool_t tracer_render(tracer_obj_t, pool_obj_t pool, pixel_t* fb/* inout */, int32_t cols, int32_t rows, pixel_t clr, float intensity); // NOTE: Row-major `rows * cols` framebuffer covering the box, each particle blends `intensity` of `clr` into its pixel. Runs on `pool`, NULL on the calling thread. FALSE if out of memory.
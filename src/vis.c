@@ -12,6 +12,10 @@ struct _vis_obj_t {
     int32_t num_pixel_channels;
     pixel_t* frm_buff;
     size_t frm_buff_sz;
+    pixel_t* img_buff; // full-resolution image of `vis_present()`
+    size_t img_buff_sz;
+    int32_t img_width, img_height;
+    bool_t fl_image; // show `img_buff` instead of `frm_buff`
 
     int32_t scaled_grid_pixel_size;
     int32_t scaled_width_pixels, scaled_height_pixels;
@@ -173,13 +177,17 @@ static inline void _vis_update_window_frame(vis_obj_t self)
     const pixel_t* const frm_buff = self->frm_buff;
     uint8_t* const pvbits = (uint8_t*)self->pvbits;
 
-    for (int32_t y = 0; y < scaled_height_pixels; y += scaled_grid_pixel_size) {
-        for (int32_t x = 0; x < scaled_width_pixels; x += scaled_grid_pixel_size) {
-            const pixel_t src = frm_buff[(y / scaled_grid_pixel_size) * grid_cols + (x / scaled_grid_pixel_size)];
-            for (int32_t yy = 0; yy < scaled_grid_pixel_size; ++yy) {
-                for (int32_t xx = 0; xx < scaled_grid_pixel_size; ++xx) {
-                    const int32_t pvbits_idx = (y + yy) * stride_bytes + (x + xx) * num_pixel_channels;
-                    *(pixel_t*)(pvbits + pvbits_idx) = src; // byte order: BGRA
+    if (self->fl_image && self->img_width == scaled_width_pixels && self->img_height == scaled_height_pixels) {
+        memcpy(pvbits, self->img_buff, (size_t)scaled_height_pixels * stride_bytes); // NOTE: 32bpp DIB rows need no padding.
+    } else {
+        for (int32_t y = 0; y < scaled_height_pixels; y += scaled_grid_pixel_size) {
+            for (int32_t x = 0; x < scaled_width_pixels; x += scaled_grid_pixel_size) {
+                const pixel_t src = frm_buff[(y / scaled_grid_pixel_size) * grid_cols + (x / scaled_grid_pixel_size)];
+                for (int32_t yy = 0; yy < scaled_grid_pixel_size; ++yy) {
+                    for (int32_t xx = 0; xx < scaled_grid_pixel_size; ++xx) {
+                        const int32_t pvbits_idx = (y + yy) * stride_bytes + (x + xx) * num_pixel_channels;
+                        *(pixel_t*)(pvbits + pvbits_idx) = src; // byte order: BGRA
+                    }
                 }
             }
         }
@@ -458,6 +466,7 @@ void vis_destroy(vis_obj_t* pself) {
         }
 
         SAFE_FREE((*pself)->frm_buff);
+        SAFE_FREE((*pself)->img_buff);
         SAFE_FREE(*pself);
     }
 }
@@ -477,6 +486,13 @@ bool_t vis_poll(vis_obj_t self) {
     return !self->fl_should_close;
 }
 
+bool_t vis_wait(vis_obj_t self, uint32_t timeout_ms) {
+    assert(self);
+    MsgWaitForMultipleObjectsEx(0, NULL, (timeout_ms == VIS_WAIT_FOREVER) ? INFINITE : timeout_ms, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+    vis_poll(self);
+    return TRUE;
+}
+
 bool_t vis_should_close(vis_obj_t self) {
     assert(self);
     return !!self->fl_should_close;
@@ -534,6 +550,21 @@ int32_t vis_get_rows(vis_obj_t self) {
     return self->grid_rows;
 }
 
+int32_t vis_get_width(vis_obj_t self) {
+    assert(self);
+    return self->scaled_width_pixels;
+}
+
+int32_t vis_get_height(vis_obj_t self) {
+    assert(self);
+    return self->scaled_height_pixels;
+}
+
+void vis_begin_draw(vis_obj_t self) {
+    assert(self);
+    self->fl_image = FALSE;
+}
+
 void vis_draw(vis_obj_t self, int32_t col, int32_t row, pixel_t clr) {
     assert(self);
     const size_t idx = (row * self->grid_cols) + col;
@@ -541,6 +572,27 @@ void vis_draw(vis_obj_t self, int32_t col, int32_t row, pixel_t clr) {
     self->frm_buff[idx] = clr;
 }
 
+bool_t vis_present(vis_obj_t self, const pixel_t* img, int32_t width, int32_t height) {
+    assert(self);
+    assert(img && width > 0 && height > 0);
+
+    const size_t sz = (size_t)width * height;
+    if (self->img_buff_sz < sz) {
+        pixel_t* const new_buff = (pixel_t*)realloc(self->img_buff, sz * sizeof(pixel_t));
+        if (!new_buff) {
+            return FALSE;
+        }
+        self->img_buff = new_buff;
+        self->img_buff_sz = sz;
+    }
+
+    memcpy(self->img_buff, img, sz * sizeof(pixel_t));
+    self->img_width = width;
+    self->img_height = height;
+    self->fl_image = TRUE;
+    return TRUE;
+}
+
 void vis_update(vis_obj_t self) {
     assert(self);
     InvalidateRgn(self->hwnd, NULL, FALSE);
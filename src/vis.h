@@ -2,6 +2,8 @@
 #include "common.h"
 #include "pixel.h"
 
+#define VIS_WAIT_FOREVER UINT32_MAX
+
 DECL_OBJECT(vis_obj_t);
 
 typedef enum {
@@ -64,6 +66,7 @@ vis_obj_t vis_create(int32_t cols, int32_t rows, const char* title);
 void vis_destroy(vis_obj_t*);
 void vis_close(vis_obj_t);
 bool_t vis_poll(vis_obj_t);
+bool_t vis_wait(vis_obj_t, uint32_t timeout_ms); // NOTE: Blocks until input arrives or `timeout_ms` passes (`VIS_WAIT_FOREVER` for none), then polls. FALSE at once if the backend takes no input (streaming).
 bool_t vis_should_close(vis_obj_t);
 void vis_set_user_context(vis_obj_t, void* user_ctx);
 void* vis_get_user_context(vis_obj_t);
@@ -75,5 +78,9 @@ void vis_set_overlay_visibility(vis_obj_t, bool_t visible);
 void vis_set_overlay_text(vis_obj_t, const char* str, int32_t cch); // NOTE: `vis` object does not own string memory, just holds a pointer. so user must keep the lifetime of string memory valid until the frame is rendered.
 int32_t vis_get_cols(vis_obj_t);
 int32_t vis_get_rows(vis_obj_t);
-void vis_draw(vis_obj_t, int32_t col, int32_t row, pixel_t clr);
+int32_t vis_get_width(vis_obj_t); // NOTE: Client area in pixels, the grid scaled by the dpi. Changes with the dpi.
+int32_t vis_get_height(vis_obj_t);
+void vis_begin_draw(vis_obj_t); // NOTE: Shows the grid cells again after `vis_present()`, call on the drawing thread before the `vis_draw()` calls of a frame.
+void vis_draw(vis_obj_t, int32_t col, int32_t row, pixel_t clr); // NOTE: Only writes its own cell, so distinct cells may be drawn concurrently.
+bool_t vis_present(vis_obj_t, const pixel_t* img, int32_t width, int32_t height); // NOTE: Copies a row-major `width * height` image that is shown instead of the grid cells until the next `vis_begin_draw()`, if it matches the client area. FALSE if out of memory.
 void vis_update(vis_obj_t);
\ No newline at end of file
@@ -0,0 +1,497 @@
+﻿#include "vis.h"
+#include "misc.h"
+#include "thread.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+
+#if defined(HAS_SSE2)
+#  include <emmintrin.h>
+#endif
+
+// Windowless backend of `vis.h`, for hosts without a display.
+// Every `vis_update()` appends one frame to a YUV4MPEG2 (I420) or raw BGRA stream on a file
+// descriptor, so frames can be piped straight into an encoder. Frames are converted into one of two
+// buffers while a writer thread drains the other, so the caller only waits when the reader is more
+// than a frame behind. There is no input and no overlay text; the stream ends when the reader goes away.
+//
+// Configured from the environment:
+//   FLUID_VIS_FORMAT  `y4m` (default) or `bgra`
+//   FLUID_VIS_OUT     output path, stdout if unset (stdout is then redirected to stderr, so logs can't corrupt the stream)
+//   FLUID_VIS_SCALE   pixels per grid cell (default 8, like the window at 96 dpi)
+//   FLUID_VIS_FPS     frame rate written to the y4m header (default 60)
+
+#define DEFAULT_GRID_PX_SIZE  8
+#define DEFAULT_FPS           60
+
+typedef enum {
+    VIS_STREAM_FORMAT_Y4M,
+    VIS_STREAM_FORMAT_BGRA,
+} vis_stream_format_e;
+
+struct _vis_obj_t {
+    int32_t grid_cols, grid_rows;
+    pixel_t* frm_buff;
+    size_t frm_buff_sz;
+    pixel_t* img_buff; // full-resolution image of `vis_present()`, or the grid scaled up
+    size_t img_buff_sz;
+    bool_t fl_image; // `img_buff` holds a presented image, otherwise it is rebuilt from `frm_buff`
+
+    int32_t width, height; // output frame size
+    int32_t grid_pixel_size;
+    vis_stream_format_e format;
+
+    int fd;
+    int stdout_fd; // original stdout while it is redirected, -1 otherwise
+    uint8_t* out_buffs[2]; // encoded frames, including the y4m frame header
+    size_t out_size;
+    int32_t fill_idx; // buffer filled by `vis_update()`
+    int64_t pushed_count; // written by `vis_update()` only
+    int64_t written_count; // written by the writer only
+    thread_sem_obj_t sem_free; // buffers ready to be filled
+    thread_sem_obj_t sem_ready; // buffers ready to be written, plus a final post to stop
+    thread_obj_t writer;
+    volatile int32_t fl_io_error;
+
+    bool_t fl_should_close;
+    bool_t fl_render_overlay;
+
+    vis_key_fn_t cb_key;
+    vis_mousebtn_fn_t cb_mousebtn;
+    vis_cursorenter_fn_t cb_cursorenter;
+    vis_cursorpos_fn_t cb_cursorpos;
+
+    void* user_ctx;
+    const char* overlay_buff;
+    int32_t overlay_buff_cch;
+};
+
+static int32_t _vis_stream_getenv_i32(const char* name, int32_t default_value)
+{
+    const char* const env = getenv(name);
+    const int32_t value = env ? atoi(env) : 0;
+    return (value > 0) ? value : default_value;
+}
+
+static bool_t _vis_stream_write_all(int fd, const uint8_t* p, size_t size)
+{
+    while (size) {
+        const ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return TRUE;
+}
+
+static void _vis_stream_writer_proc(void* ctx)
+{
+    const vis_obj_t self = (vis_obj_t)ctx;
+    for (;;) {
+        thread_sem_wait(self->sem_ready);
+        if (self->written_count == self->pushed_count) {
+            break; // NOTE: Posted by `vis_destroy()` after the last frame.
+        }
+        const uint8_t* const buff = self->out_buffs[self->written_count & 1];
+        if (!self->fl_io_error && !_vis_stream_write_all(self->fd, buff, self->out_size)) {
+            self->fl_io_error = TRUE; // NOTE: Frames are still consumed, so `vis_update()` never waits forever.
+        }
+        ++self->written_count;
+        thread_sem_post(self->sem_free, 1);
+    }
+}
+
+// BGRA to I420, BT.601 limited range.
+// NOTE: Chroma is the average of each 2x2 block (centered, `C420jpeg`), the last row and column are
+//       repeated for odd sizes. The SSE2 path computes the same integers as the scalar one.
+
+static inline uint8_t _vis_stream_luma(pixel_t p)
+{
+    return (uint8_t)(((25 * p.b + 129 * p.g + 66 * p.r + 128) >> 8) + 16);
+}
+
+static inline void _vis_stream_chroma(pixel_t p00, pixel_t p01, pixel_t p10, pixel_t p11, uint8_t* pu/* out */, uint8_t* pv/* out */)
+{
+    const int32_t
+        b = p00.b + p01.b + p10.b + p11.b,
+        g = p00.g + p01.g + p10.g + p11.g,
+        r = p00.r + p01.r + p10.r + p11.r;
+    *pu = (uint8_t)(((112 * b - 74 * g - 38 * r + 512) >> 10) + 128);
+    *pv = (uint8_t)(((-18 * b - 94 * g + 112 * r + 512) >> 10) + 128);
+}
+
+#if defined(HAS_SSE2)
+static inline __m128i _vis_stream_dot4_sse2(__m128i lo, __m128i hi, __m128i coef)
+{
+    // 16-bit BGRA of 2 pixels in each of `lo` and `hi`, to 4 dot products with `coef` (32-bit).
+    const __m128
+        m_lo = _mm_castsi128_ps(_mm_madd_epi16(lo, coef)),
+        m_hi = _mm_castsi128_ps(_mm_madd_epi16(hi, coef));
+    return _mm_add_epi32(
+        _mm_castps_si128(_mm_shuffle_ps(m_lo, m_hi, _MM_SHUFFLE(2, 0, 2, 0))),
+        _mm_castps_si128(_mm_shuffle_ps(m_lo, m_hi, _MM_SHUFFLE(3, 1, 3, 1)))
+    );
+}
+
+static inline __m128i _vis_stream_luma4_sse2(__m128i px)
+{
+    const __m128i zero = _mm_setzero_si128(), coef = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+    const __m128i dot = _vis_stream_dot4_sse2(_mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero), coef);
+    return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(dot, _mm_set1_epi32(128)), 8), _mm_set1_epi32(16));
+}
+
+static inline __m128i _vis_stream_block_sums_sse2(const pixel_t* row0, const pixel_t* row1)
+{
+    // 4 pixels of 2 rows to the 16-bit BGRA sums of their 2 2x2 blocks.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i
+        a = _mm_loadu_si128((const __m128i*)row0),
+        b = _mm_loadu_si128((const __m128i*)row1);
+    const __m128i
+        lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+        hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+    return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+}
+
+static inline uint32_t _vis_stream_pack4_sse2(__m128i v)
+{
+    v = _mm_packs_epi32(v, v);
+    return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+}
+#endif
+
+static void _vis_stream_convert_i420(const pixel_t* img, int32_t width, int32_t height, uint8_t* out/* out */)
+{
+    const int32_t cw = (width + 1) / 2, ch = (height + 1) / 2;
+    uint8_t* const y_plane = out;
+    uint8_t* const u_plane = y_plane + (size_t)width * height;
+    uint8_t* const v_plane = u_plane + (size_t)cw * ch;
+
+    for (int32_t y = 0; y < height; ++y) {
+        const pixel_t* const src = img + (size_t)y * width;
+        uint8_t* const dst = y_plane + (size_t)y * width;
+        int32_t x = 0;
+#if defined(HAS_SSE2)
+        for (; x + 16 <= width; x += 16) {
+            const __m128i
+                y0 = _vis_stream_luma4_sse2(_mm_loadu_si128((const __m128i*)(src + x))),
+                y1 = _vis_stream_luma4_sse2(_mm_loadu_si128((const __m128i*)(src + x + 4))),
+                y2 = _vis_stream_luma4_sse2(_mm_loadu_si128((const __m128i*)(src + x + 8))),
+                y3 = _vis_stream_luma4_sse2(_mm_loadu_si128((const __m128i*)(src + x + 12)));
+            _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3)));
+        }
+#endif
+        for (; x < width; ++x) {
+            dst[x] = _vis_stream_luma(src[x]);
+        }
+    }
+
+    for (int32_t j = 0; j < ch; ++j) {
+        const pixel_t* const row0 = img + (size_t)(2 * j) * width;
+        const pixel_t* const row1 = img + (size_t)min(2 * j + 1, height - 1) * width;
+        uint8_t* const u = u_plane + (size_t)j * cw;
+        uint8_t* const v = v_plane + (size_t)j * cw;
+        int32_t i = 0;
+#if defined(HAS_SSE2)
+        const __m128i
+            coef_u = _mm_setr_epi16(112, -74, -38, 0, 112, -74, -38, 0),
+            coef_v = _mm_setr_epi16(-18, -94, 112, 0, -18, -94, 112, 0),
+            round = _mm_set1_epi32(512),
+            bias = _mm_set1_epi32(128);
+        for (; 2 * i + 8 <= width; i += 4) {
+            const __m128i
+                s0 = _vis_stream_block_sums_sse2(row0 + 2 * i, row1 + 2 * i),
+                s1 = _vis_stream_block_sums_sse2(row0 + 2 * i + 4, row1 + 2 * i + 4);
+            const uint32_t
+                u4 = _vis_stream_pack4_sse2(_mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_vis_stream_dot4_sse2(s0, s1, coef_u), round), 10), bias)),
+                v4 = _vis_stream_pack4_sse2(_mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_vis_stream_dot4_sse2(s0, s1, coef_v), round), 10), bias));
+            memcpy(u + i, &u4, sizeof(u4));
+            memcpy(v + i, &v4, sizeof(v4));
+        }
+#endif
+        for (; i < cw; ++i) {
+            const int32_t x0 = 2 * i, x1 = min(2 * i + 1, width - 1);
+            _vis_stream_chroma(row0[x0], row0[x1], row1[x0], row1[x1], u + i, v + i);
+        }
+    }
+}
+
+static void _vis_stream_build_image(vis_obj_t self)
+{
+    // NOTE: Scales the grid up into `img_buff`, like the window backend draws it.
+    const int32_t s = self->grid_pixel_size, width = self->width;
+    for (int32_t row = 0; row < self->grid_rows; ++row) {
+        pixel_t* const dst = self->img_buff + (size_t)row * s * width;
+        const pixel_t* const src = self->frm_buff + (size_t)row * self->grid_cols;
+        for (int32_t col = 0; col < self->grid_cols; ++col) {
+            for (int32_t xx = 0; xx < s; ++xx) {
+                dst[col * s + xx] = src[col];
+            }
+        }
+        for (int32_t yy = 1; yy < s; ++yy) {
+            memcpy(dst + (size_t)yy * width, dst, (size_t)width * sizeof(pixel_t));
+        }
+    }
+}
+
+vis_obj_t vis_create(int32_t cols, int32_t rows, const char* title) {
+    UNUSED_PARAM(title);
+
+    vis_obj_t newobj = (vis_obj_t)calloc(1, sizeof(struct _vis_obj_t));
+    if (!newobj) {
+        return NULL;
+    }
+
+    newobj->fd = -1;
+    newobj->stdout_fd = -1;
+    newobj->grid_cols = cols;
+    newobj->grid_rows = rows;
+    newobj->grid_pixel_size = _vis_stream_getenv_i32("FLUID_VIS_SCALE", DEFAULT_GRID_PX_SIZE);
+    newobj->width = cols * newobj->grid_pixel_size;
+    newobj->height = rows * newobj->grid_pixel_size;
+
+    const char* const format = getenv("FLUID_VIS_FORMAT");
+    if (!format || !strcmp(format, "y4m")) {
+        newobj->format = VIS_STREAM_FORMAT_Y4M;
+    } else if (!strcmp(format, "bgra")) {
+        newobj->format = VIS_STREAM_FORMAT_BGRA;
+    } else {
+        fprintf(stderr, "unknown FLUID_VIS_FORMAT '%s'!\n", format);
+        vis_destroy(&newobj);
+        return NULL;
+    }
+
+    char header[128];
+    size_t header_size = 0;
+    if (newobj->format == VIS_STREAM_FORMAT_Y4M) {
+        const int32_t cw = (newobj->width + 1) / 2, ch = (newobj->height + 1) / 2;
+        newobj->out_size = strlen("FRAME\n") + (size_t)newobj->width * newobj->height + 2 * (size_t)cw * ch;
+        header_size = (size_t)snprintf(header, sizeof(header),
+            "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n"
+            , newobj->width
+            , newobj->height
+            , _vis_stream_getenv_i32("FLUID_VIS_FPS", DEFAULT_FPS)
+        );
+    } else {
+        newobj->out_size = (size_t)newobj->width * newobj->height * sizeof(pixel_t);
+    }
+
+    newobj->frm_buff_sz = (size_t)cols * rows;
+    newobj->frm_buff = (pixel_t*)calloc(newobj->frm_buff_sz, sizeof(pixel_t));
+    newobj->img_buff_sz = (size_t)newobj->width * newobj->height;
+    newobj->img_buff = (pixel_t*)calloc(newobj->img_buff_sz, sizeof(pixel_t));
+    newobj->out_buffs[0] = (uint8_t*)malloc(newobj->out_size);
+    newobj->out_buffs[1] = (uint8_t*)malloc(newobj->out_size);
+    newobj->sem_free = thread_sem_create(2);
+    newobj->sem_ready = thread_sem_create(0);
+    if (
+        !newobj->frm_buff ||
+        !newobj->img_buff ||
+        !newobj->out_buffs[0] ||
+        !newobj->out_buffs[1] ||
+        !newobj->sem_free ||
+        !newobj->sem_ready
+        )
+    {
+        vis_destroy(&newobj);
+        return NULL;
+    }
+
+    const char* const out_path = getenv("FLUID_VIS_OUT");
+    if (out_path && *out_path) {
+        newobj->fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (newobj->fd < 0) {
+            fprintf(stderr, "failed to open '%s'!\n", out_path);
+            vis_destroy(&newobj);
+            return NULL;
+        }
+    } else {
+        // NOTE: The stream keeps the real stdout, `printf()` goes to stderr from now on.
+        fflush(stdout);
+        newobj->fd = dup(STDOUT_FILENO);
+        if (newobj->fd < 0) {
+            vis_destroy(&newobj);
+            return NULL;
+        }
+        newobj->stdout_fd = newobj->fd;
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    signal(SIGPIPE, SIG_IGN); // NOTE: A reader that goes away shows up as a write error instead.
+    if (header_size && !_vis_stream_write_all(newobj->fd, (const uint8_t*)header, header_size)) {
+        vis_destroy(&newobj);
+        return NULL;
+    }
+
+    newobj->writer = thread_create(_vis_stream_writer_proc, newobj);
+    if (!newobj->writer) {
+        vis_destroy(&newobj);
+        return NULL;
+    }
+
+    return newobj;
+}
+
+void vis_destroy(vis_obj_t* pself) {
+    if (pself && *pself) {
+        if ((*pself)->writer) {
+            thread_sem_post((*pself)->sem_ready, 1); // NOTE: Stops the writer once the pending frames are written.
+            thread_destroy(&(*pself)->writer);
+        }
+
+        if ((*pself)->stdout_fd >= 0) {
+            fflush(stdout);
+            dup2((*pself)->stdout_fd, STDOUT_FILENO);
+        }
+
+        if ((*pself)->fd >= 0) {
+            close((*pself)->fd);
+        }
+
+        thread_sem_destroy(&(*pself)->sem_free);
+        thread_sem_destroy(&(*pself)->sem_ready);
+        SAFE_FREE((*pself)->out_buffs[0]);
+        SAFE_FREE((*pself)->out_buffs[1]);
+        SAFE_FREE((*pself)->frm_buff);
+        SAFE_FREE((*pself)->img_buff);
+        SAFE_FREE(*pself);
+    }
+}
+
+void vis_close(vis_obj_t self) {
+    assert(self);
+    self->fl_should_close = TRUE;
+}
+
+bool_t vis_poll(vis_obj_t self) {
+    assert(self);
+    if (self->fl_io_error) {
+        self->fl_should_close = TRUE;
+    }
+    return !self->fl_should_close;
+}
+
+bool_t vis_wait(vis_obj_t self, uint32_t timeout_ms) {
+    assert(self);
+    UNUSED_PARAM(self);
+    UNUSED_PARAM(timeout_ms);
+    return FALSE; // NOTE: No input to wait for, the stream is paced by its reader.
+}
+
+bool_t vis_should_close(vis_obj_t self) {
+    assert(self);
+    return !!self->fl_should_close;
+}
+
+void vis_set_user_context(vis_obj_t self, void* user_ctx) {
+    assert(self);
+    self->user_ctx = user_ctx;
+}
+
+void* vis_get_user_context(vis_obj_t self) {
+    assert(self);
+    return self->user_ctx;
+}
+
+void vis_set_key_cb(vis_obj_t self, vis_key_fn_t cb) {
+    assert(self);
+    self->cb_key = cb;
+}
+
+void vis_set_mousebtn_cb(vis_obj_t self, vis_mousebtn_fn_t cb) {
+    assert(self);
+    self->cb_mousebtn = cb;
+}
+
+void vis_set_cursorenter_cb(vis_obj_t self, vis_cursorenter_fn_t cb) {
+    assert(self);
+    self->cb_cursorenter = cb;
+}
+
+void vis_set_cursorpos_cb(vis_obj_t self, vis_cursorpos_fn_t cb) {
+    assert(self);
+    self->cb_cursorpos = cb;
+}
+
+void vis_set_overlay_visibility(vis_obj_t self, bool_t visible) {
+    assert(self);
+    self->fl_render_overlay = visible;
+}
+
+void vis_set_overlay_text(vis_obj_t self, const char* str, int32_t cch) {
+    assert(self);
+    assert(cch >= 0 && !!str == !!cch);
+    self->overlay_buff = str;
+    self->overlay_buff_cch = cch;
+}
+
+int32_t vis_get_cols(vis_obj_t self) {
+    assert(self);
+    return self->grid_cols;
+}
+
+int32_t vis_get_rows(vis_obj_t self) {
+    assert(self);
+    return self->grid_rows;
+}
+
+int32_t vis_get_width(vis_obj_t self) {
+    assert(self);
+    return self->width;
+}
+
+int32_t vis_get_height(vis_obj_t self) {
+    assert(self);
+    return self->height;
+}
+
+void vis_begin_draw(vis_obj_t self) {
+    assert(self);
+    self->fl_image = FALSE;
+}
+
+void vis_draw(vis_obj_t self, int32_t col, int32_t row, pixel_t clr) {
+    assert(self);
+    assert(0 <= col && col < self->grid_cols && 0 <= row && row < self->grid_rows);
+    const size_t idx = (size_t)row * self->grid_cols + col;
+    self->frm_buff[idx] = clr;
+}
+
+bool_t vis_present(vis_obj_t self, const pixel_t* img, int32_t width, int32_t height) {
+    assert(self);
+    assert(img && width > 0 && height > 0);
+
+    if (width != self->width || height != self->height) {
+        return TRUE; // NOTE: Like the window, a mismatched image is not shown.
+    }
+
+    memcpy(self->img_buff, img, (size_t)width * height * sizeof(pixel_t));
+    self->fl_image = TRUE;
+    return TRUE;
+}
+
+void vis_update(vis_obj_t self) {
+    assert(self);
+
+    if (!self->fl_image) {
+        _vis_stream_build_image(self);
+    }
+
+    thread_sem_wait(self->sem_free);
+    uint8_t* const out = self->out_buffs[self->fill_idx];
+    if (self->format == VIS_STREAM_FORMAT_Y4M) {
+        memcpy(out, "FRAME\n", strlen("FRAME\n"));
+        _vis_stream_convert_i420(self->img_buff, self->width, self->height, out + strlen("FRAME\n"));
+    } else {
+        memcpy(out, self->img_buff, self->out_size);
+    }
+    self->fill_idx ^= 1;
+    ++self->pushed_count;
+    thread_sem_post(self->sem_ready, 1);
+}